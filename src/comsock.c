@@ -80,8 +80,12 @@ natsSock_SetCommonTcpOptions(natsSock fd)
 
 #define MAX_HOST_NAME   (256)
 
-natsStatus
-natsSock_ConnectTcp(natsSockCtx *ctx, const char *phost, int port)
+// Resolves the host, which may be an IPv6 address in brackets, according to
+// the context's IP resolution order. On success, the caller needs to free
+// the 'numServInfo' entries of 'servInfos'.
+static natsStatus
+_resolve(natsSockCtx *ctx, const char *phost, int port,
+         struct addrinfo **servInfos, int *numServInfo, int *numIPs)
 {
     natsStatus      s    = NATS_OK;
     int             res;
@@ -91,12 +95,9 @@ natsSock_ConnectTcp(natsSockCtx *ctx, const char *phost, int port)
     char            hosta[MAX_HOST_NAME];
     int             hostLen;
     char            *host;
-    struct addrinfo *servInfos[2] = {NULL, NULL};
-    int             numServInfo   = 0;
-    int             numIPs        = 0;
-    int64_t         start         = 0;
-    int64_t         totalTimeout  = 0;
-    int64_t         timeoutPerIP  = 0;
+
+    *numServInfo = 0;
+    *numIPs      = 0;
 
     if (phost == NULL)
         return nats_setError(NATS_ADDRESS_MISSING, "%s", "No host specified");
@@ -118,8 +119,6 @@ natsSock_ConnectTcp(natsSockCtx *ctx, const char *phost, int port)
     if ((ctx->orderIP == 46) || (ctx->orderIP == 64))
         max = 2;
 
-    start = nats_Now();
-
     for (i=0; i<max; i++)
     {
         struct addrinfo hints;
@@ -144,24 +143,100 @@ natsSock_ConnectTcp(natsSockCtx *ctx, const char *phost, int port)
                               gai_strerror(res));
             continue;
         }
-        servInfos[numServInfo++] = servinfo;
+        servInfos[(*numServInfo)++] = servinfo;
         for (p = servinfo; (p != NULL); p = p->ai_next)
-            numIPs++;
+            (*numIPs)++;
     }
     // If we got a getaddrinfo() and there is no servInfos to try to connect to
     // bail out now.
-    if ((s != NATS_OK) && (numServInfo == 0))
+    if ((s != NATS_OK) && (*numServInfo == 0))
         return NATS_UPDATE_ERR_STACK(s);
 
     // I don't think it can be the case if s == OK and/or numServInfo >= 1...
-    if (numIPs == 0)
+    if (*numIPs == 0)
     {
-        for (i=0; i<numServInfo; i++)
+        for (i=0; i<*numServInfo; i++)
             nats_FreeAddrInfo(servInfos[i]);
 
+        *numServInfo = 0;
+
         return NATS_UPDATE_ERR_STACK(NATS_NO_SERVER);
     }
 
+    return NATS_OK;
+}
+
+// Creates a non-blocking socket and initiates the connection to this address.
+// On success, 'pending' indicates if the connect is still in progress.
+static natsStatus
+_startConnect(struct addrinfo *p, natsSock *pfd, bool *pending)
+{
+    natsStatus  s  = NATS_OK;
+    natsSock    fd;
+    int         res;
+
+    *pfd     = NATS_SOCK_INVALID;
+    *pending = false;
+
+    fd = socket(p->ai_family, p->ai_socktype, p->ai_protocol);
+    if (fd == NATS_SOCK_INVALID)
+        return nats_setError(NATS_SYS_ERROR, "socket error: %d", NATS_SOCK_GET_ERROR);
+
+#ifdef SO_NOSIGPIPE
+    int set = 1;
+    if (setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, (void*)&set, sizeof(int)) == -1)
+    {
+        s = nats_setError(NATS_SYS_ERROR,
+                          "setsockopt SO_NOSIGPIPE error: %d",
+                          NATS_SOCK_GET_ERROR);
+    }
+#endif
+    if (s == NATS_OK)
+        s = natsSock_SetBlocking(fd, false);
+
+    if (s == NATS_OK)
+    {
+        res = connect(fd, p->ai_addr, (natsSockLen) p->ai_addrlen);
+        if ((res == NATS_SOCK_ERROR)
+            && (NATS_SOCK_GET_ERROR == NATS_SOCK_CONNECT_IN_PROGRESS))
+        {
+            *pending = true;
+        }
+        else if (res == NATS_SOCK_ERROR)
+        {
+            s = nats_setDefaultError(NATS_NO_SERVER);
+        }
+    }
+
+    if (s != NATS_OK)
+    {
+        _closeFd(fd);
+        return NATS_UPDATE_ERR_STACK(s);
+    }
+
+    *pfd = fd;
+
+    return NATS_OK;
+}
+
+natsStatus
+natsSock_ConnectTcp(natsSockCtx *ctx, const char *phost, int port)
+{
+    natsStatus      s    = NATS_OK;
+    int             i;
+    struct addrinfo *servInfos[2] = {NULL, NULL};
+    int             numServInfo   = 0;
+    int             numIPs        = 0;
+    int64_t         start         = 0;
+    int64_t         totalTimeout  = 0;
+    int64_t         timeoutPerIP  = 0;
+
+    start = nats_Now();
+
+    s = _resolve(ctx, phost, port, servInfos, &numServInfo, &numIPs);
+    if (s != NATS_OK)
+        return NATS_UPDATE_ERR_STACK(s);
+
     // Check if there has been a deadline set.
     totalTimeout = natsDeadline_GetTimeout(&(ctx->writeDeadline));
     if (totalTimeout > 0)
@@ -180,45 +255,17 @@ natsSock_ConnectTcp(natsSockCtx *ctx, const char *phost, int port)
 
         for (p = servInfos[i]; (p != NULL); p = p->ai_next)
         {
-            ctx->fd = socket(p->ai_family, p->ai_socktype, p->ai_protocol);
-            if (ctx->fd == NATS_SOCK_INVALID)
-            {
-                s = nats_setError(NATS_SYS_ERROR, "socket error: %d", NATS_SOCK_GET_ERROR);
-                continue;
-            }
-
-            // Reset 's' for this loop iteration.
-            s = NATS_OK;
+            bool pending = false;
 
-#ifdef SO_NOSIGPIPE
-            int set = 1;
-            if (setsockopt(ctx->fd, SOL_SOCKET, SO_NOSIGPIPE, (void*)&set, sizeof(int)) == -1)
+            s = _startConnect(p, &(ctx->fd), &pending);
+            if ((s == NATS_OK) && pending)
             {
-                s = nats_setError(NATS_SYS_ERROR,
-                                  "setsockopt SO_NOSIGPIPE error: %d",
-                                  NATS_SOCK_GET_ERROR);
-            }
-#endif
-            if (s == NATS_OK)
-                s = natsSock_SetBlocking(ctx->fd, false);
+                if (timeoutPerIP > 0)
+                    natsDeadline_Init(&(ctx->writeDeadline), timeoutPerIP);
 
-            if (s == NATS_OK)
-            {
-                res = connect(ctx->fd, p->ai_addr, (natsSockLen) p->ai_addrlen);
-                if ((res == NATS_SOCK_ERROR)
-                    && (NATS_SOCK_GET_ERROR == NATS_SOCK_CONNECT_IN_PROGRESS))
-                {
-                    if (timeoutPerIP > 0)
-                        natsDeadline_Init(&(ctx->writeDeadline), timeoutPerIP);
-
-                    s = natsSock_WaitReady(WAIT_FOR_CONNECT, ctx);
-                    if ((s == NATS_OK) && !natsSock_IsConnected(ctx->fd))
-                        s = NATS_TIMEOUT;
-                }
-                else if (res == NATS_SOCK_ERROR)
-                {
-                    s = nats_setDefaultError(NATS_NO_SERVER);
-                }
+                s = natsSock_WaitReady(WAIT_FOR_CONNECT, ctx);
+                if ((s == NATS_OK) && !natsSock_IsConnected(ctx->fd))
+                    s = NATS_TIMEOUT;
             }
 
             if (s == NATS_OK)
@@ -255,6 +302,273 @@ natsSock_ConnectTcp(natsSockCtx *ctx, const char *phost, int port)
     return NATS_UPDATE_ERR_STACK(s);
 }
 
+// Copies the 'n' addresses of 'src' to 'dst', alternating between the
+// family of the first address and the other one.
+static void
+_interleaveFamilies(struct addrinfo **src, int n, struct addrinfo **dst)
+{
+    int ia  = 0;
+    int ib  = 0;
+    int j   = 0;
+    int fam = src[0]->ai_family;
+
+    while (j < n)
+    {
+        while ((ia < n) && (src[ia]->ai_family != fam))
+            ia++;
+        if (ia < n)
+            dst[j++] = src[ia++];
+
+        while ((ib < n) && (src[ib]->ai_family == fam))
+            ib++;
+        if (ib < n)
+            dst[j++] = src[ib++];
+    }
+}
+
+natsStatus
+natsSock_ConnectTcpRacing(natsSockCtx *ctx, const char **hosts, const int *ports,
+                          int count, int64_t delay, int *winner)
+{
+    natsStatus      s           = NATS_OK;
+    natsStatus      ls          = NATS_OK;
+    struct addrinfo **servInfos = NULL;
+    int             numServInfo = 0;
+    struct addrinfo **addrs     = NULL;
+    struct addrinfo **order     = NULL;
+    int             *owners     = NULL;
+    int             *offsets    = NULL;
+    int             *lens       = NULL;
+    int             numAddrs    = 0;
+    int             maxLen      = 0;
+    natsSock        fds[NATS_SOCK_MAX_RACING];
+    int             fdOwners[NATS_SOCK_MAX_RACING];
+    bool            done[NATS_SOCK_MAX_RACING];
+    natsSock        connected   = NATS_SOCK_INVALID;
+    int             active      = 0;
+    int             next        = 0;
+    int64_t         start       = 0;
+    int64_t         nextStart   = 0;
+    int64_t         totalTimeout= 0;
+    int             i, k, r;
+
+    for (i=0; i<NATS_SOCK_MAX_RACING; i++)
+        fds[i] = NATS_SOCK_INVALID;
+
+    start = nats_Now();
+
+    servInfos = (struct addrinfo**) NATS_CALLOC(2 * count, sizeof(struct addrinfo*));
+    offsets   = (int*) NATS_CALLOC(count, sizeof(int));
+    lens      = (int*) NATS_CALLOC(count, sizeof(int));
+    if ((servInfos == NULL) || (offsets == NULL) || (lens == NULL))
+        s = nats_setDefaultError(NATS_NO_MEMORY);
+
+    // Resolve all servers. We need at least one of them to be resolved.
+    for (k=0; (s == NATS_OK) && (k<count); k++)
+    {
+        int n = 0;
+
+        ls = _resolve(ctx, hosts[k], ports[k], servInfos + numServInfo, &n, &(lens[k]));
+        if (ls == NATS_OK)
+        {
+            numServInfo += n;
+            numAddrs    += lens[k];
+            if (lens[k] > maxLen)
+                maxLen = lens[k];
+        }
+    }
+    if ((s == NATS_OK) && (numAddrs == 0))
+        s = NATS_UPDATE_ERR_STACK(ls);
+    if (s == NATS_OK)
+        nats_clearLastError();
+
+    if (s == NATS_OK)
+    {
+        addrs  = (struct addrinfo**) NATS_CALLOC(numAddrs, sizeof(struct addrinfo*));
+        order  = (struct addrinfo**) NATS_CALLOC(numAddrs, sizeof(struct addrinfo*));
+        owners = (int*) NATS_CALLOC(numAddrs, sizeof(int));
+        if ((addrs == NULL) || (order == NULL) || (owners == NULL))
+            s = nats_setDefaultError(NATS_NO_MEMORY);
+    }
+    if (s == NATS_OK)
+    {
+        struct addrinfo *p;
+        int             n = 0;
+        int             j = 0;
+
+        // Collect the addresses of each server (the servers that could
+        // not be resolved have no entry in servInfos), ...
+        for (k=0; k<count; k++)
+        {
+            int first = n;
+
+            offsets[k] = first;
+            while (n < first + lens[k])
+            {
+                for (p = servInfos[j++]; (p != NULL); p = p->ai_next)
+                    order[n++] = p;
+            }
+            if (lens[k] > 0)
+                _interleaveFamilies(order + first, lens[k], addrs + first);
+        }
+        // ... then take the first address of each server, then the second, etc..
+        n = 0;
+        for (r=0; r<maxLen; r++)
+        {
+            for (k=0; k<count; k++)
+            {
+                if (r >= lens[k])
+                    continue;
+
+                order[n]  = addrs[offsets[k] + r];
+                owners[n] = k;
+                n++;
+            }
+        }
+    }
+
+    totalTimeout = natsDeadline_GetTimeout(&(ctx->writeDeadline));
+    nextStart    = start;
+
+    while (s == NATS_OK)
+    {
+        int64_t now     = nats_Now();
+        int     timeout = -1;
+
+        // Start the next attempt when it is its turn, or right away if
+        // there is no attempt in progress.
+        while ((connected == NATS_SOCK_INVALID)
+               && (next < numAddrs)
+               && (active < NATS_SOCK_MAX_RACING)
+               && ((active == 0) || (now >= nextStart)))
+        {
+            natsSock    fd      = NATS_SOCK_INVALID;
+            bool        pending = false;
+
+            ls = _startConnect(order[next], &fd, &pending);
+            if ((ls == NATS_OK) && !pending)
+            {
+                ls = natsSock_SetCommonTcpOptions(fd);
+                if (ls == NATS_OK)
+                {
+                    connected = fd;
+                    *winner   = owners[next];
+                }
+                else
+                    _closeFd(fd);
+            }
+            else if (ls == NATS_OK)
+            {
+                for (i=0; fds[i] != NATS_SOCK_INVALID; i++) {}
+
+                fds[i]      = fd;
+                fdOwners[i] = owners[next];
+                active++;
+                nextStart   = now + delay;
+            }
+            next++;
+        }
+        if (connected != NATS_SOCK_INVALID)
+            break;
+
+        if (active == 0)
+        {
+            s = (ls != NATS_OK ? ls : nats_setDefaultError(NATS_NO_SERVER));
+            break;
+        }
+
+        if ((next < numAddrs) && (active < NATS_SOCK_MAX_RACING))
+            timeout = (int) (nextStart > now ? nextStart - now : 0);
+
+        if (totalTimeout > 0)
+        {
+            int64_t left = totalTimeout - (now - start);
+
+            if (left <= 0)
+            {
+                s = nats_setDefaultError(NATS_TIMEOUT);
+                break;
+            }
+            if ((timeout == -1) || (left < timeout))
+                timeout = (int) left;
+        }
+
+        ls = natsSock_WaitConnects(fds, done, NATS_SOCK_MAX_RACING, timeout);
+        if (ls == NATS_TIMEOUT)
+        {
+            nats_clearLastError();
+            continue;
+        }
+        else if (ls != NATS_OK)
+        {
+            s = NATS_UPDATE_ERR_STACK(ls);
+            break;
+        }
+
+        for (i=0; i<NATS_SOCK_MAX_RACING; i++)
+        {
+            if (!done[i])
+                continue;
+
+            if ((connected == NATS_SOCK_INVALID) && natsSock_IsConnected(fds[i]))
+                ls = natsSock_SetCommonTcpOptions(fds[i]);
+            else
+                ls = nats_setDefaultError(NATS_NO_SERVER);
+
+            if ((ls == NATS_OK) && (connected == NATS_SOCK_INVALID))
+            {
+                connected = fds[i];
+                *winner   = fdOwners[i];
+            }
+            else
+            {
+                _closeFd(fds[i]);
+
+                // Do not wait to start the next attempt.
+                nextStart = now;
+            }
+            fds[i] = NATS_SOCK_INVALID;
+            active--;
+        }
+        if (connected != NATS_SOCK_INVALID)
+            break;
+    }
+
+    // Abandon the attempts still in progress.
+    for (i=0; i<NATS_SOCK_MAX_RACING; i++)
+        _closeFd(fds[i]);
+
+    if (connected != NATS_SOCK_INVALID)
+    {
+        ctx->fd = connected;
+        s = NATS_OK;
+
+        // Clear the error stack from the attempts that failed.
+        nats_clearLastError();
+    }
+
+    for (i=0; i<numServInfo; i++)
+        nats_FreeAddrInfo(servInfos[i]);
+
+    NATS_FREE(servInfos);
+    NATS_FREE(offsets);
+    NATS_FREE(lens);
+    NATS_FREE(addrs);
+    NATS_FREE(order);
+    NATS_FREE(owners);
+
+    // If there was a deadline, reset the deadline with whatever is left.
+    if (totalTimeout > 0)
+    {
+        int64_t used = nats_Now() - start;
+        int64_t left = totalTimeout - used;
+
+        natsDeadline_Init(&(ctx->writeDeadline), (left > 0 ? left : 0));
+    }
+
+    return NATS_UPDATE_ERR_STACK(s);
+}
+
 natsStatus
 natsSock_ReadLine(natsSockCtx *ctx, char *buffer, size_t maxBufferSize)
 {
@@ -342,6 +656,15 @@ natsSock_Read(natsSockCtx *ctx, char *buffer, size_t maxBufferSize, int *n)
     int         readBytes = 0;
     bool        needRead  = true;
 
+#if defined(NATS_HAS_IO_URING)
+    if ((ctx->uring != NULL) && !(ctx->readDeadline.active))
+    {
+        s = natsSock_UringRead(ctx, buffer, maxBufferSize, n);
+        if (ctx->uring != NULL)
+            return NATS_UPDATE_ERR_STACK(s);
+    }
+#endif
+
     while (needRead)
     {
 #if defined(NATS_HAS_TLS)
@@ -365,6 +688,9 @@ natsSock_Read(natsSockCtx *ctx, char *buffer, size_t maxBufferSize, int *n)
                 if (sslErr == SSL_ERROR_ZERO_RETURN)
                     return nats_setDefaultError(NATS_CONNECTION_CLOSED);
 
+                if (sslErr == SSL_ERROR_SSL)
+                    ctx->sslFailed = true;
+
                 if ((sslErr == SSL_ERROR_WANT_READ) || (sslErr == SSL_ERROR_WANT_WRITE))
                 {
                     int waitMode = (sslErr == SSL_ERROR_WANT_READ ? WAIT_FOR_READ : WAIT_FOR_WRITE);
@@ -426,6 +752,17 @@ natsSock_Write(natsSockCtx *ctx, const char *data, int len, int *n)
     int         bytes     = 0;
     bool        needWrite = true;
 
+#if defined(NATS_HAS_IO_URING)
+    if ((ctx->wuring != NULL) && (ctx->ssl == NULL) && !(ctx->useEventLoop))
+    {
+        natsSockVec vec = {data, len};
+
+        s = natsSock_UringWriteV(ctx, &vec, 1, n);
+        if (ctx->wuring != NULL)
+            return NATS_UPDATE_ERR_STACK(s);
+    }
+#endif
+
     while (needWrite)
     {
 #if defined(NATS_HAS_TLS)
@@ -453,6 +790,9 @@ natsSock_Write(natsSockCtx *ctx, const char *data, int len, int *n)
                 if (sslErr == SSL_ERROR_ZERO_RETURN)
                     return nats_setDefaultError(NATS_CONNECTION_CLOSED);
 
+                if (sslErr == SSL_ERROR_SSL)
+                    ctx->sslFailed = true;
+
                 if ((sslErr == SSL_ERROR_WANT_READ) || (sslErr == SSL_ERROR_WANT_WRITE))
                 {
                     int waitMode = (sslErr == SSL_ERROR_WANT_READ ? WAIT_FOR_READ : WAIT_FOR_WRITE);
@@ -542,6 +882,141 @@ natsSock_WriteFully(natsSockCtx *ctx, const char *data, int len)
     return NATS_UPDATE_ERR_STACK(s);
 }
 
+natsStatus
+natsSock_WriteV(natsSockCtx *ctx, natsSockVec *vecs, int count, int *n)
+{
+    natsStatus  s         = NATS_OK;
+    int         bytes     = 0;
+
+    // Skip the empty vectors at the front.
+    while ((count > 0) && (vecs[0].len == 0))
+    {
+        vecs++;
+        count--;
+    }
+    if (count == 0)
+    {
+        if (n != NULL)
+            *n = 0;
+
+        return NATS_OK;
+    }
+
+#if defined(NATS_HAS_TLS)
+    // There is no vectored SSL_write, so write the first vector only.
+    if (ctx->ssl != NULL)
+    {
+        s = natsSock_Write(ctx, vecs[0].data, vecs[0].len, n);
+        return NATS_UPDATE_ERR_STACK(s);
+    }
+#endif
+
+    if (count > NATS_SOCK_MAX_VECS)
+        count = NATS_SOCK_MAX_VECS;
+
+#if defined(NATS_HAS_IO_URING)
+    if ((ctx->wuring != NULL) && !(ctx->useEventLoop))
+    {
+        s = natsSock_UringWriteV(ctx, vecs, count, n);
+        if (ctx->wuring != NULL)
+            return NATS_UPDATE_ERR_STACK(s);
+    }
+#endif
+
+    while (true)
+    {
+        bytes = natsSock_SendV(ctx->fd, vecs, count);
+
+        if (bytes == 0)
+        {
+            return nats_setDefaultError(NATS_CONNECTION_CLOSED);
+        }
+        else if (bytes < 0)
+        {
+            if (NATS_SOCK_GET_ERROR != NATS_SOCK_WOULD_BLOCK)
+                return nats_setError(NATS_IO_ERROR, "send error: %d",
+                                     NATS_SOCK_GET_ERROR);
+
+            if (ctx->useEventLoop)
+            {
+                // With external event loop, we are done now, we will be
+                // called later for more.
+                if (n != NULL)
+                    *n = 0;
+
+                return NATS_OK;
+            }
+
+            // For non-blocking sockets, if the write would block, we need to
+            // wait up to the deadline.
+            s = natsSock_WaitReady(WAIT_FOR_WRITE, ctx);
+            if (s != NATS_OK)
+                return NATS_UPDATE_ERR_STACK(s);
+
+            continue;
+        }
+
+        break;
+    }
+
+    if (n != NULL)
+        *n = bytes;
+
+    return NATS_OK;
+}
+
+natsStatus
+natsSock_WriteVFully(natsSockCtx *ctx, natsSockVec *vecs, int count)
+{
+    natsStatus  s     = NATS_OK;
+    int         n     = 0;
+
+    do
+    {
+        // Skip the vectors that have been fully written.
+        while ((count > 0) && (vecs[0].len == 0))
+        {
+            vecs++;
+            count--;
+        }
+        if (count == 0)
+            return NATS_OK;
+
+        s = natsSock_WriteV(ctx, vecs, count, &n);
+        if (s == NATS_OK)
+        {
+            // Consume what has been written.
+            while (n > 0)
+            {
+                if (n >= vecs[0].len)
+                {
+                    n -= vecs[0].len;
+                    vecs[0].len = 0;
+                    vecs++;
+                    count--;
+                }
+                else
+                {
+                    vecs[0].data += n;
+                    vecs[0].len  -= n;
+                    n = 0;
+                }
+            }
+        }
+    }
+    while (s == NATS_OK);
+
+    // If we are using a write deadline, shutdown the socket to trigger a
+    // possible reconnect
+    if (s == NATS_TIMEOUT)
+    {
+        natsSock_Shutdown(ctx->fd);
+        ctx->fdActive = false;
+    }
+
+    return NATS_UPDATE_ERR_STACK(s);
+}
+
 void
 natsSock_ClearDeadline(natsSockCtx *ctx)
 {
@@ -16,6 +16,20 @@
 
 #include "natsp.h"
 
+// Maximum number of vectors passed to a single vectored write.
+#define NATS_SOCK_MAX_VECS  (8)
+
+// Maximum number of connect attempts that can be in flight at the same
+// time in natsSock_ConnectTcpRacing().
+#define NATS_SOCK_MAX_RACING    (16)
+
+typedef struct __natsSockVec
+{
+    const char  *data;
+    int         len;
+
+} natsSockVec;
+
 natsStatus
 natsSock_Init(natsSockCtx *ctx);
 
@@ -26,6 +40,24 @@ natsSock_WaitReady(int waitMode, natsSockCtx *ctx);
 natsStatus
 natsSock_ConnectTcp(natsSockCtx *ctx, const char *host, int port);
 
+// Connects to any of the 'count' servers, resolving each of them like
+// natsSock_ConnectTcp() does. Rather than trying one address after the
+// other, a new attempt is started every 'delay' milliseconds (or as soon
+// as the previous one fails) while the previous ones are still pending.
+// The first attempt to complete wins and the others are abandoned.
+// Attempts alternate between servers, and between address families for
+// a given server. On success, 'winner' is the index of the server.
+natsStatus
+natsSock_ConnectTcpRacing(natsSockCtx *ctx, const char **hosts, const int *ports,
+                          int count, int64_t delay, int *winner);
+
+// Waits up to 'timeout' milliseconds (-1 for no limit) for some of the
+// non-blocking connects of 'fds' to complete, successfully or not. Those
+// have their 'done' entry set to true. Invalid sockets are ignored.
+// Returns NATS_TIMEOUT if none did.
+natsStatus
+natsSock_WaitConnects(natsSock *fds, bool *done, int count, int timeout);
+
 natsStatus
 natsSock_SetBlocking(natsSock fd, bool blocking);
 
@@ -69,9 +101,48 @@ natsSock_Write(natsSockCtx *ctx, const char *data, int len, int *n);
 natsStatus
 natsSock_WriteFully(natsSockCtx *ctx, const char *data, int len);
 
+// Writes up to the sum of the vectors' lengths to the socket, with a single
+// system call when possible (the data is gathered by the kernel, so there is
+// no need to copy it into a contiguous buffer). Same blocking behavior than
+// natsSock_Write(). With TLS, only the first non-empty vector is written.
+// At most NATS_SOCK_MAX_VECS vectors are considered.
+natsStatus
+natsSock_WriteV(natsSockCtx *ctx, natsSockVec *vecs, int count, int *n);
+
+// Writes all the data described by the vectors to the socket. Does not return
+// until all bytes have been written, unless the socket is closed or an error
+// occurs (including write timeout). The content of 'vecs' is modified.
+natsStatus
+natsSock_WriteVFully(natsSockCtx *ctx, natsSockVec *vecs, int count);
+
+// Platform specific vectored send. Returns the number of bytes sent, or
+// NATS_SOCK_ERROR.
+int
+natsSock_SendV(natsSock fd, natsSockVec *vecs, int count);
+
 natsStatus
 natsSock_Flush(natsSock fd);
 
+// Enables MSG_ZEROCOPY sends on this socket. Returns false if the platform
+// or the socket does not support it.
+bool
+natsSock_EnableZeroCopy(natsSock fd);
+
+// Sends data with MSG_ZEROCOPY: the kernel references the caller's pages
+// instead of copying them, so they must not be modified or freed until the
+// send is reported complete. Each call that sends something consumes the
+// next sequence number (starting at 0 once enabled). Returns the number of
+// bytes sent, or NATS_SOCK_ERROR.
+int
+natsSock_SendZeroCopy(natsSock fd, const char *data, int len);
+
+// Reads the next completion notification from the socket's error queue
+// without blocking. Returns true if there was one, with the sends from
+// 'from' to 'to' (inclusive) complete. The ranges are not necessarily
+// reported in send order.
+bool
+natsSock_ReadZeroCopyDone(natsSock fd, uint32_t *from, uint32_t *to);
+
 void
 natsSock_Close(natsSock fd);
 
@@ -90,4 +161,45 @@ natsSock_InitDeadline(natsSockCtx *ctx, int64_t timeout);
 natsStatus
 natsSock_GetLocalIPAndPort(natsSockCtx *ctx, char **ip, int *port);
 
+#if defined(NATS_HAS_IO_URING)
+// Sets up an io_uring to read from the socket, with a multishot receive
+// filling a ring of buffers of 'bufSize' bytes. Returns false if io_uring
+// can't be used (TLS, event loop, kernel support), in which case the
+// regular reads are used. Only the thread reading from the socket can
+// use the ring.
+bool
+natsSock_UringStart(natsSockCtx *ctx, int bufSize);
+
+// Terminates the receive and frees the ring. Must be invoked by the
+// reading thread before closing the socket.
+void
+natsSock_UringStop(natsSockCtx *ctx);
+
+// Same than natsSock_Read() (without deadline). If the kernel turns out
+// not to support multishot receives, the ring is stopped and this returns
+// NATS_OK with 'n' == 0, so that the caller can read the regular way.
+natsStatus
+natsSock_UringRead(natsSockCtx *ctx, char *buffer, size_t maxBufferSize, int *n);
+
+// Sets up an io_uring to write to the socket. Returns false if io_uring
+// can't be used (TLS, event loop, kernel support), in which case the
+// regular writes are used. Writes must be serialized by the caller, as
+// they already are by the connection's lock.
+bool
+natsSock_UringStartWrites(natsSockCtx *ctx);
+
+// Frees the write ring.
+void
+natsSock_UringStopWrites(natsSockCtx *ctx);
+
+// Same than natsSock_WriteV() for a socket that is not attached to an
+// event loop. The send is submitted to the ring, and the kernel waits for
+// the socket to become writable (up to the write deadline) instead of
+// returning EAGAIN. If the kernel turns out not to support it, the ring
+// is stopped and this returns NATS_OK with 'n' == 0, so that the caller
+// can write the regular way.
+natsStatus
+natsSock_UringWriteV(natsSockCtx *ctx, natsSockVec *vecs, int count, int *n);
+#endif
+
 #endif /* SOCK_H_ */
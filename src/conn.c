@@ -29,6 +29,10 @@
 #include "timer.h"
 #include "sub.h"
 #include "msg.h"
+#include "msgpool.h"
+#include "msgring.h"
+#include "subtable.h"
+#include "subpart.h"
 #include "asynccb.h"
 #include "comsock.h"
 #include "nkeys.h"
@@ -38,6 +42,22 @@
 #define MAX_INFO_MESSAGE_SIZE   (32768)
 #define DEFAULT_FLUSH_TIMEOUT   (10000)
 
+// Intervals (in ms) of the timer polling the completions of zero copy sends,
+// and how long closing the socket waits for them.
+#define ZC_POLL_MIN_INTERVAL    (1)
+#define ZC_POLL_MAX_INTERVAL    (100)
+#define ZC_IDLE_INTERVAL        (60 * 60 * 1000)
+#define ZC_DRAIN_TIMEOUT        (500)
+
+// Payloads of at least this size are referenced by the pending output
+// instead of being copied (see natsConn_bufferWritePayload()). Past the
+// max, the pending output is written in place, as if it had been copied.
+#define OUT_REF_MIN_SIZE        (16 * 1024)
+#define OUT_REF_MAX_BYTES       (8 * 1024 * 1024)
+
+// Bytes of the pending output: the write buffer and the referenced payloads.
+#define _outLen(c)              (natsBuf_Len((c)->bw) + (c)->out.bytes)
+
 #define NATS_EVENT_ACTION_ADD       (true)
 #define NATS_EVENT_ACTION_REMOVE    (false)
 
@@ -58,7 +78,6 @@ void natsConn_Unlock(natsConnection *nc) { natsMutex_Unlock(nc->mu); }
 
 #endif // DEV_MODE
 
-
 // CLIENT_PROTO_ZERO is the original client protocol from 2009.
 // http://nats.io/documentation/internals/nats-protocol/
 #define CLIENT_PROTO_ZERO   (0)
@@ -91,6 +110,18 @@ _processAuthError(natsConnection *nc, int errCode, char *error);
 static int
 _checkAuthError(char *error);
 
+static natsZeroCopyBuf*
+_zeroCopyReleaseAll(natsConnection *nc);
+
+static void
+_zeroCopyRelease(natsConnection *nc, natsZeroCopyBuf *list);
+
+static void
+_clearSSL(natsConnection *nc);
+
+static void
+_outReset(natsConnection *nc);
+
 /*
  * ----------------------------------------
  */
@@ -177,28 +208,42 @@ _clearServerInfo(natsServerInfo *si)
 static void
 _freeConn(natsConnection *nc)
 {
+    int i;
+
     if (nc == NULL)
         return;
 
     natsTimer_Destroy(nc->ptmr);
+    _zeroCopyRelease(nc, _zeroCopyReleaseAll(nc));
+    natsTimer_Destroy(nc->zc.tmr);
+    NATS_FREE(nc->zc.ranges);
     natsBuf_Destroy(nc->pending);
     natsBuf_Destroy(nc->scratch);
+    _outReset(nc);
+    NATS_FREE(nc->out.refs);
+#if defined(NATS_HAS_IO_URING)
+    natsSock_UringStopWrites(&(nc->sockCtx));
+#endif
     natsBuf_Destroy(nc->bw);
     natsSrvPool_Destroy(nc->srvPool);
     _clearServerInfo(&(nc->info));
     natsCondition_Destroy(nc->flusherCond);
     natsCondition_Destroy(nc->pongs.cond);
     natsParser_Destroy(nc->ps);
+    natsMsgPool_Close(nc->msgPool);
     natsThread_Destroy(nc->readLoopThread);
     natsThread_Destroy(nc->flusherThread);
-    natsHash_Destroy(nc->subs);
+    natsSubTable_Destroy(nc->subs);
     natsOptions_Destroy(nc->opts);
-    if (nc->sockCtx.ssl != NULL)
-        SSL_free(nc->sockCtx.ssl);
+    _clearSSL(nc);
     NATS_FREE(nc->el.buffer);
     natsConn_destroyRespPool(nc);
     natsInbox_Destroy(nc->respSub);
-    natsStrHash_Destroy(nc->respMap);
+    for (i=0; i<NATS_RESP_MAP_STRIPES; i++)
+    {
+        natsHash_Destroy(nc->respMap[i].map);
+        natsMutex_Destroy(nc->respMap[i].mu);
+    }
     natsCondition_Destroy(nc->reconnectCond);
     natsMutex_Destroy(nc->subsMu);
     natsMutex_Destroy(nc->mu);
@@ -259,48 +304,217 @@ natsConn_unlockAndRelease(natsConnection *nc)
         _freeConn(nc);
 }
 
+// Fills 'vecs' with the start of the pending output, that is, the write
+// buffer interleaved with the payloads it references. Returns the number
+// of vectors, at most 'max'.
+static int
+_outVecs(natsConnection *nc, natsSockVec *vecs, int max)
+{
+    const char  *buf    = natsBuf_Data(nc->bw);
+    int         pos     = 0;
+    int         count   = 0;
+    natsOutRef  *ref;
+    int         i;
+
+    for (i=0; (i<nc->out.count) && (count < max); i++)
+    {
+        ref = &(nc->out.refs[i]);
+        if (ref->pos > pos)
+        {
+            vecs[count].data = buf + pos;
+            vecs[count].len  = ref->pos - pos;
+            pos = ref->pos;
+            if (++count == max)
+                break;
+        }
+        vecs[count].data = ref->data;
+        vecs[count].len  = ref->len;
+        count++;
+    }
+    if ((count < max) && (natsBuf_Len(nc->bw) > pos))
+    {
+        vecs[count].data = buf + pos;
+        vecs[count].len  = natsBuf_Len(nc->bw) - pos;
+        count++;
+    }
+    return count;
+}
+
+// Removes the first 'n' bytes of the pending output. The messages whose
+// payload has been fully sent are released.
+static void
+_outConsume(natsConnection *nc, int n)
+{
+    natsOutRef  *ref;
+    int         pos  = 0;
+    int         done = 0;
+    int         k;
+    int         i;
+
+    while ((n > 0) && (done < nc->out.count))
+    {
+        ref = &(nc->out.refs[done]);
+        if (ref->pos > pos)
+        {
+            k = (n < ref->pos - pos ? n : ref->pos - pos);
+            pos += k;
+            n   -= k;
+            continue;
+        }
+        k = (n < ref->len ? n : ref->len);
+        ref->data += k;
+        ref->len  -= k;
+        nc->out.bytes -= k;
+        n -= k;
+        if (ref->len == 0)
+        {
+            natsMsg_Destroy(ref->msg);
+            done++;
+        }
+    }
+    pos += n;
+
+    if (done > 0)
+    {
+        nc->out.count -= done;
+        memmove(nc->out.refs, nc->out.refs + done, nc->out.count * sizeof(natsOutRef));
+    }
+    for (i=0; i<nc->out.count; i++)
+        nc->out.refs[i].pos -= pos;
+
+    if (pos >= natsBuf_Len(nc->bw))
+        natsBuf_Reset(nc->bw);
+    else if (pos > 0)
+        natsBuf_Consume(nc->bw, pos);
+}
+
+// Discards the pending output.
+static void
+_outReset(natsConnection *nc)
+{
+    int i;
+
+    for (i=0; i<nc->out.count; i++)
+        natsMsg_Destroy(nc->out.refs[i].msg);
+    nc->out.count = 0;
+    nc->out.bytes = 0;
+
+    if (nc->bw != NULL)
+        natsBuf_Reset(nc->bw);
+}
+
+// Writes the pending output with vectored writes, so that the referenced
+// payloads do not need to be copied. On error, the caller is expected
+// to discard what is left.
+static natsStatus
+_outWriteFully(natsConnection *nc)
+{
+    natsStatus  s = NATS_OK;
+    natsSockVec vecs[NATS_SOCK_MAX_VECS];
+    int         count;
+    int         total;
+    int         i;
+
+    while ((s == NATS_OK)
+           && ((count = _outVecs(nc, vecs, NATS_SOCK_MAX_VECS)) > 0))
+    {
+        for (total=0, i=0; i<count; i++)
+            total += vecs[i].len;
+
+        s = natsSock_WriteVFully(&(nc->sockCtx), vecs, count);
+        if (s == NATS_OK)
+            _outConsume(nc, total);
+    }
+
+    return NATS_UPDATE_ERR_STACK(s);
+}
+
+// Copies the pending output at the end of 'buf', and discards it.
+static natsStatus
+_outMoveTo(natsConnection *nc, natsBuffer *buf)
+{
+    natsStatus  s = NATS_OK;
+    natsSockVec vecs[NATS_SOCK_MAX_VECS];
+    int         count;
+    int         i;
+
+    while ((s == NATS_OK)
+           && ((count = _outVecs(nc, vecs, NATS_SOCK_MAX_VECS)) > 0))
+    {
+        for (i=0; (s == NATS_OK) && (i<count); i++)
+        {
+            s = natsBuf_Append(buf, vecs[i].data, vecs[i].len);
+            if (s == NATS_OK)
+                _outConsume(nc, vecs[i].len);
+        }
+    }
+    _outReset(nc);
+
+    return NATS_UPDATE_ERR_STACK(s);
+}
+
+// Asks the external event loop to notify us when the socket is writable.
+static natsStatus
+_outAddWriteEvent(natsConnection *nc)
+{
+    natsStatus s = NATS_OK;
+
+    if (!(nc->el.writeAdded))
+    {
+        nc->el.writeAdded = true;
+        s = nc->opts->evCbs.write(nc->el.data, NATS_EVENT_ACTION_ADD);
+        if (s != NATS_OK)
+            nats_setError(s, "Error processing write request: %d - %s",
+                          s, natsStatus_GetText(s));
+    }
+
+    return NATS_UPDATE_ERR_STACK(s);
+}
+
 natsStatus
 natsConn_bufferFlush(natsConnection *nc)
 {
     natsStatus  s      = NATS_OK;
-    int         bufLen = natsBuf_Len(nc->bw);
 
-    if (bufLen == 0)
+    if (_outLen(nc) == 0)
         return NATS_OK;
 
     if (nc->usePending)
     {
-        s = natsBuf_Append(nc->pending, natsBuf_Data(nc->bw), bufLen);
+        s = _outMoveTo(nc, nc->pending);
     }
     else if (nc->sockCtx.useEventLoop)
     {
-        if (!(nc->el.writeAdded))
-        {
-            nc->el.writeAdded = true;
-            s = nc->opts->evCbs.write(nc->el.data, NATS_EVENT_ACTION_ADD);
-            if (s != NATS_OK)
-                nats_setError(s, "Error processing write request: %d - %s",
-                              s, natsStatus_GetText(s));
-        }
+        s = _outAddWriteEvent(nc);
 
         return NATS_UPDATE_ERR_STACK(s);
     }
+    else if (nc->out.count == 0)
+    {
+        s = natsSock_WriteFully(&(nc->sockCtx), natsBuf_Data(nc->bw), natsBuf_Len(nc->bw));
+    }
     else
     {
-        s = natsSock_WriteFully(&(nc->sockCtx), natsBuf_Data(nc->bw), bufLen);
+        s = _outWriteFully(nc);
     }
 
-    natsBuf_Reset(nc->bw);
+    // Even on error: what has been written must not be sent again.
+    _outReset(nc);
 
     return NATS_UPDATE_ERR_STACK(s);
 }
 
+// Small writes are copied into the write buffer and coalesced. When the
+// data does not fit, the pending output and the data are written in place.
+// When the data is kept for later, that is, while reconnecting, with an
+// external event loop, or when sending in place is disabled, it is always
+// copied, since the caller may reuse it as soon as this call returns. See
+// natsConn_bufferWritePayload() for payloads that can be referenced instead.
 natsStatus
 natsConn_bufferWrite(natsConnection *nc, const char *buffer, int len)
 {
     natsStatus  s = NATS_OK;
-    int         offset = 0;
-    int         avail  = 0;
+    natsSockVec vecs[2];
 
     if (len <= 0)
         return NATS_OK;
@@ -311,16 +525,8 @@ natsConn_bufferWrite(natsConnection *nc, const char *buffer, int len)
     if (nc->sockCtx.useEventLoop)
     {
         s = natsBuf_Append(nc->bw, buffer, len);
-        if ((s == NATS_OK)
-            && (natsBuf_Len(nc->bw) >= nc->opts->ioBufSize)
-            && !(nc->el.writeAdded))
-        {
-            nc->el.writeAdded = true;
-            s = nc->opts->evCbs.write(nc->el.data, NATS_EVENT_ACTION_ADD);
-            if (s != NATS_OK)
-                nats_setError(s, "Error processing write request: %d - %s",
-                              s, natsStatus_GetText(s));
-        }
+        if ((s == NATS_OK) && (_outLen(nc) >= nc->opts->ioBufSize))
+            s = _outAddWriteEvent(nc);
 
         return NATS_UPDATE_ERR_STACK(s);
     }
@@ -332,42 +538,106 @@ natsConn_bufferWrite(natsConnection *nc, const char *buffer, int len)
         return NATS_UPDATE_ERR_STACK(s);
     }
 
-    // If we have more data that can fit..
-    while ((s == NATS_OK) && (len > natsBuf_Available(nc->bw)))
+    // If the data fits in the buffer, simply copy it there. Small writes
+    // are coalesced and sent when the buffer is flushed.
+    if (len <= natsBuf_Available(nc->bw))
     {
-        // If there is nothing in the buffer...
-        if (natsBuf_Len(nc->bw) == 0)
-        {
-            // Do a single socket write to avoid a copy
-            s = natsSock_WriteFully(&(nc->sockCtx), buffer + offset, len);
+        s = natsBuf_Append(nc->bw, buffer, len);
 
-            // We are done
-            return NATS_UPDATE_ERR_STACK(s);
-        }
+        return NATS_UPDATE_ERR_STACK(s);
+    }
 
-        // We already have data in the buffer, check how many more bytes
-        // can we fit
-        avail = natsBuf_Available(nc->bw);
+    // If there is nothing pending...
+    if (_outLen(nc) == 0)
+    {
+        // Do a single socket write to avoid a copy
+        s = natsSock_WriteFully(&(nc->sockCtx), buffer, len);
 
-        // Append that much bytes
-        s = natsBuf_Append(nc->bw, buffer + offset, avail);
+        return NATS_UPDATE_ERR_STACK(s);
+    }
 
-        // Flush the buffer
-        if (s == NATS_OK)
-            s = natsConn_bufferFlush(nc);
+    // What is pending goes first. If there are no referenced payloads,
+    // send the buffer and the new data with a single vectored write.
+    if (nc->out.count == 0)
+    {
+        vecs[0].data = natsBuf_Data(nc->bw);
+        vecs[0].len  = natsBuf_Len(nc->bw);
+        vecs[1].data = buffer;
+        vecs[1].len  = len;
 
-        // If success, then decrement what's left to send and update the
-        // offset.
+        s = natsSock_WriteVFully(&(nc->sockCtx), vecs, 2);
+    }
+    else
+    {
+        s = _outWriteFully(nc);
         if (s == NATS_OK)
+            s = natsSock_WriteFully(&(nc->sockCtx), buffer, len);
+    }
+
+    // As in natsConn_bufferFlush(), even on error.
+    _outReset(nc);
+
+    return NATS_UPDATE_ERR_STACK(s);
+}
+
+// Adds the message's payload to the pending output. Large payloads of
+// messages allocated by the library are not copied: the message is retained
+// and the payload is sent from it by the flusher, or when the socket is
+// writable with an external event loop.
+natsStatus
+natsConn_bufferWritePayload(natsConnection *nc, natsMsg *msg)
+{
+    natsStatus  s   = NATS_OK;
+    int         len = msg->dataLen;
+    natsOutRef  *ref;
+
+    // While reconnecting, what is pending may be kept for a long time.
+    if ((len < OUT_REF_MIN_SIZE)
+        || !natsMsg_canRetain(msg)
+        || nc->usePending
+        || nc->dontSendInPlace)
+    {
+        s = natsConn_bufferWrite(nc, msg->data, len);
+
+        return NATS_UPDATE_ERR_STACK(s);
+    }
+
+    // Without an external event loop, do not let referenced payloads pile
+    // up, which would retain an unbounded number of messages: write in place.
+    if (!(nc->sockCtx.useEventLoop) && (_outLen(nc) + len > OUT_REF_MAX_BYTES))
+    {
+        s = natsConn_bufferWrite(nc, msg->data, len);
+
+        return NATS_UPDATE_ERR_STACK(s);
+    }
+
+    if (nc->out.count == nc->out.cap)
+    {
+        int newCap = (nc->out.cap == 0 ? 8 : 2 * nc->out.cap);
+
+        ref = (natsOutRef*) NATS_REALLOC(nc->out.refs, newCap * sizeof(natsOutRef));
+        if (ref == NULL)
         {
-            len    -= avail;
-            offset += avail;
+            // Fall back to the copy.
+            s = natsConn_bufferWrite(nc, msg->data, len);
+
+            return NATS_UPDATE_ERR_STACK(s);
         }
+        nc->out.refs = ref;
+        nc->out.cap  = newCap;
     }
 
-    // If there is data left, the buffer can now hold this data.
-    if ((s == NATS_OK) && (len > 0))
-        s = natsBuf_Append(nc->bw, buffer + offset, len);
+    natsMsg_retain(msg);
+
+    ref = &(nc->out.refs[nc->out.count++]);
+    ref->msg  = msg;
+    ref->data = msg->data;
+    ref->len  = len;
+    ref->pos  = natsBuf_Len(nc->bw);
+    nc->out.bytes += len;
+
+    if (nc->sockCtx.useEventLoop && (_outLen(nc) >= nc->opts->ioBufSize))
+        s = _outAddWriteEvent(nc);
 
     return NATS_UPDATE_ERR_STACK(s);
 }
@@ -380,10 +650,412 @@ natsConn_bufferWriteString(natsConnection *nc, const char *string)
     return NATS_UPDATE_ERR_STACK(s);
 }
 
+bool
+natsConn_canZeroCopy(natsConnection *nc, int len)
+{
+    // The socket needs to be blocking: with a non-blocking one, the pending
+    // completions would make the read loop's poll() return right away.
+    return (nc->zc.enabled
+            && (nc->opts->zeroCopyThreshold > 0)
+            && (len >= nc->opts->zeroCopyThreshold)
+            && (nc->opts->writeDeadline <= 0)
+            && !(nc->usePending)
+            && !(nc->sockCtx.useEventLoop)
+            && !(nc->dontSendInPlace)
+            && (nc->sockCtx.ssl == NULL)
+            && nc->sockCtx.fdActive);
+}
+
+// Records that the sends from 'from' to 'to' are complete. Since ranges
+// can be reported out of order, those past the first send that is not
+// complete are kept until the gap is filled.
+void
+natsConn_zeroCopyComplete(natsConnection *nc, uint32_t from, uint32_t to)
+{
+    natsZeroCopyRange   *ranges = nc->zc.ranges;
+    int                 count   = nc->zc.rangesCount;
+    int                 n       = 0;
+    int                 i;
+
+    // Sequence numbers wrap around, compare them as distances.
+    if ((int32_t) (to - nc->zc.doneId) < 0)
+        return;
+
+    if ((int32_t) (from - nc->zc.doneId) > 0)
+    {
+        if (count == nc->zc.rangesCap)
+        {
+            int newCap = (count == 0 ? 4 : 2 * count);
+
+            // If we can't keep the range, the buffers from this one on will
+            // only be released when the connection is closed.
+            ranges = (natsZeroCopyRange*) NATS_REALLOC(ranges, newCap * sizeof(natsZeroCopyRange));
+            if (ranges == NULL)
+                return;
+
+            nc->zc.ranges    = ranges;
+            nc->zc.rangesCap = newCap;
+        }
+        for (i=count; (i > 0) && ((int32_t) (ranges[i-1].from - from) > 0); i--)
+            ranges[i] = ranges[i-1];
+
+        ranges[i].from = from;
+        ranges[i].to   = to;
+        nc->zc.rangesCount++;
+        return;
+    }
+
+    nc->zc.doneId = to + 1;
+
+    // Consume the kept ranges that are now contiguous.
+    while ((n < count) && ((int32_t) (ranges[n].from - nc->zc.doneId) <= 0))
+    {
+        if ((int32_t) (ranges[n].to + 1 - nc->zc.doneId) > 0)
+            nc->zc.doneId = ranges[n].to + 1;
+        n++;
+    }
+    if (n > 0)
+    {
+        memmove(ranges, ranges + n, (count - n) * sizeof(natsZeroCopyRange));
+        nc->zc.rangesCount -= n;
+    }
+}
+
+// Reads the completions from the socket's error queue, and moves the buffers
+// whose sends are all complete, or all of them if 'all' is true, to the list
+// of buffers to release. Returns true if any buffer was moved.
+static bool
+_zeroCopyReap(natsConnection *nc, bool all)
+{
+    natsZeroCopyBuf *zb     = NULL;
+    uint32_t        from    = 0;
+    uint32_t        to      = 0;
+    bool            moved   = false;
+
+    if (!all && (nc->zc.head != NULL) && (nc->sockCtx.fd != NATS_SOCK_INVALID))
+    {
+        while (natsSock_ReadZeroCopyDone(nc->sockCtx.fd, &from, &to))
+            natsConn_zeroCopyComplete(nc, from, to);
+    }
+
+    // Release in send order: a buffer goes only when all the sends up
+    // to its last one are complete.
+    while (((zb = nc->zc.head) != NULL)
+           && (all || ((int32_t) (zb->lastId - nc->zc.doneId) < 0)))
+    {
+        nc->zc.head = zb->next;
+        zb->next    = nc->zc.done;
+        nc->zc.done = zb;
+        moved       = true;
+    }
+    if (nc->zc.head == NULL)
+        nc->zc.tail = NULL;
+
+    return moved;
+}
+
+// Invokes the release callbacks of the buffers that the kernel is done
+// with. Must be called without the connection's lock held.
+static void
+_zeroCopyRelease(natsConnection *nc, natsZeroCopyBuf *list)
+{
+    natsZeroCopyBuf *zb = NULL;
+    natsZeroCopyBuf *prev = NULL;
+
+    // The list is in reverse order, restore the send order.
+    while ((zb = list) != NULL)
+    {
+        list     = zb->next;
+        zb->next = prev;
+        prev     = zb;
+    }
+    while ((zb = prev) != NULL)
+    {
+        prev = zb->next;
+        zb->cb(nc, zb->data, zb->dataLen, zb->closure);
+        NATS_FREE(zb);
+    }
+}
+
+static void
+_zeroCopyTimerCb(natsTimer *timer, void *closure)
+{
+    natsConnection  *nc       = (natsConnection*) closure;
+    natsZeroCopyBuf *done     = NULL;
+    int64_t         interval  = 0;
+    bool            moved;
+
+    natsConn_Lock(nc);
+
+    moved = _zeroCopyReap(nc, false);
+
+    done        = nc->zc.done;
+    nc->zc.done = NULL;
+
+    // Back off while the completions are not coming in, and park the
+    // timer (rather than stopping it, which can't be undone safely while
+    // in the callback) when there is nothing left to wait for.
+    if (nc->zc.polling)
+    {
+        if (nc->zc.head == NULL)
+        {
+            nc->zc.polling = false;
+            interval = ZC_IDLE_INTERVAL;
+        }
+        else if (moved)
+            interval = ZC_POLL_MIN_INTERVAL;
+        else if ((interval = 2 * nc->zc.interval) > ZC_POLL_MAX_INTERVAL)
+            interval = ZC_POLL_MAX_INTERVAL;
+
+        if (interval != nc->zc.interval)
+        {
+            nc->zc.interval = interval;
+            natsTimer_Reset(timer, interval);
+        }
+    }
+
+    natsConn_Unlock(nc);
+
+    _zeroCopyRelease(nc, done);
+}
+
+static void
+_zeroCopyTimerStopped(natsTimer *timer, void *closure)
+{
+    natsConnection *nc = (natsConnection*) closure;
+
+    natsConn_release(nc);
+}
+
+// Makes sure that the completions are polled while there are sends
+// waiting for them. The timer is stopped when the connection is closed.
+static natsStatus
+_zeroCopyPoll(natsConnection *nc)
+{
+    natsStatus s = NATS_OK;
+
+    if (nc->zc.polling)
+        return NATS_OK;
+
+    nc->zc.interval = ZC_POLL_MIN_INTERVAL;
+
+    if (nc->zc.tmr == NULL)
+    {
+        _retain(nc);
+
+        s = natsTimer_Create(&(nc->zc.tmr), _zeroCopyTimerCb,
+                             _zeroCopyTimerStopped, nc->zc.interval,
+                             (void*) nc);
+        if (s != NATS_OK)
+            _release(nc);
+    }
+    else
+    {
+        natsTimer_Reset(nc->zc.tmr, nc->zc.interval);
+    }
+    if (s == NATS_OK)
+        nc->zc.polling = true;
+
+    return NATS_UPDATE_ERR_STACK(s);
+}
+
+// Invokes the release callbacks of the buffers found complete while
+// publishing, so that they don't wait for the timer.
+void
+natsConn_zeroCopyReleaseDone(natsConnection *nc)
+{
+    natsZeroCopyBuf *done = NULL;
+
+    natsConn_Lock(nc);
+    done        = nc->zc.done;
+    nc->zc.done = NULL;
+    natsConn_Unlock(nc);
+
+    _zeroCopyRelease(nc, done);
+}
+
+// Called with the connection's lock held, before the socket is closed.
+// Waits for the kernel to be done with the buffers, which happens once the
+// server has acknowledged the data. Past ZC_DRAIN_TIMEOUT, the socket is
+// closed anyway: it lingers with a 0 timeout (see natsSock_SetCommonTcpOptions),
+// so the close discards the unsent data and the kernel's references to the
+// buffers, which can then be released.
+static void
+_zeroCopyDrain(natsConnection *nc)
+{
+    int64_t deadline;
+
+    if (nc->zc.head == NULL)
+        return;
+
+    deadline = nats_Now() + ZC_DRAIN_TIMEOUT;
+    for (;;)
+    {
+        (void) _zeroCopyReap(nc, false);
+        if ((nc->zc.head == NULL) || (nats_Now() >= deadline))
+            break;
+
+        natsConn_Unlock(nc);
+        nats_Sleep(1);
+        natsConn_Lock(nc);
+    }
+}
+
+// Called when the connection is closed, after its socket has been closed
+// (see _zeroCopyDrain()). Returns the list to pass to _zeroCopyRelease().
+static natsZeroCopyBuf*
+_zeroCopyReleaseAll(natsConnection *nc)
+{
+    natsZeroCopyBuf *done = NULL;
+
+    nc->zc.polling = false;
+    if (nc->zc.tmr != NULL)
+        natsTimer_Stop(nc->zc.tmr);
+
+    (void) _zeroCopyReap(nc, true);
+
+    done        = nc->zc.done;
+    nc->zc.done = NULL;
+
+    return done;
+}
+
+// Called when the connection has a new socket. The previous one has been
+// closed (see _zeroCopyDrain()), and the buffers sent on it are released by
+// the timer, which is polling if there are any.
+static void
+_zeroCopyNewSocket(natsConnection *nc)
+{
+    (void) _zeroCopyReap(nc, true);
+
+    nc->zc.nextId       = 0;
+    nc->zc.doneId       = 0;
+    nc->zc.rangesCount  = 0;
+    nc->zc.enabled      = ((nc->opts->zeroCopyThreshold > 0)
+                           && natsSock_EnableZeroCopy(nc->sockCtx.fd));
+}
+
+natsStatus
+natsConn_zeroCopyWrite(natsConnection *nc, const char *data, int len,
+                       natsBufferReleaseHandler cb, void *closure,
+                       bool *queued)
+{
+    natsStatus      s       = NATS_OK;
+    natsZeroCopyBuf *zb     = NULL;
+    const char      *ptr    = data;
+    int             left    = len;
+    bool            sent    = false;
+    int             n;
+
+    *queued = false;
+
+    // Collect what completed since the last time, the caller invokes the
+    // callbacks (see natsConn_zeroCopyReleaseDone()).
+    (void) _zeroCopyReap(nc, false);
+
+    zb = (natsZeroCopyBuf*) NATS_CALLOC(1, sizeof(natsZeroCopyBuf));
+    if (zb == NULL)
+        return nats_setDefaultError(NATS_NO_MEMORY);
+
+    // What is buffered goes first, and can't be sent without a copy.
+    s = natsConn_bufferFlush(nc);
+
+    while ((s == NATS_OK) && (left > 0))
+    {
+        n = natsSock_SendZeroCopy(nc->sockCtx.fd, ptr, left);
+        if (n == NATS_SOCK_ERROR)
+        {
+            if (NATS_SOCK_GET_ERROR == EINTR)
+                continue;
+
+            // Typically ENOBUFS, when the socket is out of memory to track
+            // the pinned pages. Send the rest the regular way, which also
+            // reports the error if the socket is broken.
+            break;
+        }
+        zb->lastId = nc->zc.nextId++;
+        sent       = true;
+        ptr       += n;
+        left      -= n;
+    }
+    if ((s == NATS_OK) && (left > 0))
+        s = natsSock_WriteFully(&(nc->sockCtx), ptr, left);
+
+    // Even on error, what was sent zero copy is referenced by the socket.
+    if (sent)
+    {
+        zb->data    = (const void*) data;
+        zb->dataLen = len;
+        zb->cb      = cb;
+        zb->closure = closure;
+
+        if (nc->zc.tail != NULL)
+            nc->zc.tail->next = zb;
+        else
+            nc->zc.head = zb;
+        nc->zc.tail = zb;
+
+        *queued = true;
+
+        // If the timer can't be created, the buffer will be released when
+        // the connection is closed.
+        (void) _zeroCopyPoll(nc);
+    }
+    else
+    {
+        NATS_FREE(zb);
+    }
+
+    return NATS_UPDATE_ERR_STACK(s);
+}
+
+// Connects to the first of the 'count' servers of 'srvs' that accepts a TCP
+// connection, and makes it the current server. If 'srvs' is NULL, connects
+// to the current server.
+static natsStatus
+_connectTcpRacing(natsConnection *nc, natsSrv **srvs, int count)
+{
+    natsStatus  s       = NATS_OK;
+    const char  **hosts = NULL;
+    int         *ports  = NULL;
+    int         winner  = 0;
+    int         i;
+
+    if (srvs == NULL)
+    {
+        srvs  = &(nc->cur);
+        count = 1;
+    }
+
+    hosts = (const char**) NATS_CALLOC(count, sizeof(char*));
+    ports = (int*) NATS_CALLOC(count, sizeof(int));
+    if ((hosts == NULL) || (ports == NULL))
+        s = nats_setDefaultError(NATS_NO_MEMORY);
+
+    for (i=0; (s == NATS_OK) && (i<count); i++)
+    {
+        hosts[i] = srvs[i]->url->host;
+        ports[i] = srvs[i]->url->port;
+    }
+
+    if (s == NATS_OK)
+        s = natsSock_ConnectTcpRacing(&(nc->sockCtx), hosts, ports, count,
+                                      nc->opts->racingDelay, &winner);
+    if (s == NATS_OK)
+        nc->cur = srvs[winner];
+
+    NATS_FREE(hosts);
+    NATS_FREE(ports);
+
+    return NATS_UPDATE_ERR_STACK(s);
+}
+
 // _createConn will connect to the server and do the right thing when an
-// existing connection is in place.
+// existing connection is in place. If 'srvs' is not NULL, the TCP connect
+// races across those 'count' servers and the winner becomes the current
+// server.
 static natsStatus
-_createConn(natsConnection *nc)
+_createConn(natsConnection *nc, natsSrv **srvs, int count)
 {
     natsStatus  s = NATS_OK;
 
@@ -395,9 +1067,15 @@ _createConn(natsConnection *nc)
     // Set the IP resolution order
     nc->sockCtx.orderIP = nc->opts->orderIP;
 
-    s = natsSock_ConnectTcp(&(nc->sockCtx), nc->cur->url->host, nc->cur->url->port);
+    if (nc->opts->racingDelay > 0)
+        s = _connectTcpRacing(nc, srvs, count);
+    else
+        s = natsSock_ConnectTcp(&(nc->sockCtx), nc->cur->url->host, nc->cur->url->port);
     if (s == NATS_OK)
+    {
         nc->sockCtx.fdActive = true;
+        _zeroCopyNewSocket(nc);
+    }
 
     // Need to create or reset the buffer even on failure in case we allow
     // retry on failed connect
@@ -408,7 +1086,7 @@ _createConn(natsConnection *nc)
         if (nc->bw == NULL)
             ls = natsBuf_Create(&(nc->bw), nc->opts->ioBufSize);
         else
-            natsBuf_Reset(nc->bw);
+            _outReset(nc);
 
         if (s == NATS_OK)
             s = ls;
@@ -629,6 +1307,52 @@ _collectSSLErr(int preverifyOk, X509_STORE_CTX* ctx)
 
     return preverifyOk;
 }
+
+static void
+_tlsSessionKey(natsConnection *nc, char *key, size_t keySize)
+{
+    snprintf(key, keySize, "%s:%d", nc->cur->url->host, nc->cur->url->port);
+}
+
+int
+natsConn_newTLSSession(SSL *ssl, SSL_SESSION *sess)
+{
+    natsConnection  *nc     = (natsConnection*) SSL_get_ex_data(ssl, 0);
+    natsSSLCtx      *ctx    = NULL;
+    void            *old    = NULL;
+    natsStatus      s       = NATS_OK;
+    char            key[280];
+
+    // This is invoked during the handshake, or with TLS 1.3, when the
+    // server sends a session ticket, which is read by the read loop.
+    // The current server does not change until the read loop exits.
+    if (nc == NULL)
+        return 0;
+
+    ctx = nc->opts->sslCtx;
+    _tlsSessionKey(nc, key, sizeof(key));
+
+    // The lock protects the hash and the lifetime of the cached sessions:
+    // a connection offering a session takes its own reference under it.
+    natsMutex_Lock(ctx->lock);
+    if (ctx->sessions == NULL)
+        s = natsStrHash_Create(&(ctx->sessions), 4);
+    if (s == NATS_OK)
+        s = natsStrHash_Set(ctx->sessions, key, true, (void*) sess, &old);
+    if (old != NULL)
+        SSL_SESSION_free((SSL_SESSION*) old);
+    natsMutex_Unlock(ctx->lock);
+
+    if (s != NATS_OK)
+    {
+        // Not being able to cache the session is not an error.
+        nats_clearLastError();
+        return 0;
+    }
+
+    // We keep the reference that we were given.
+    return 1;
+}
 #endif
 
 // makeTLSConn will wrap an existing Conn using TLS
@@ -659,6 +1383,13 @@ _makeTLSConn(natsConnection *nc)
             nats_sslRegisterThreadForCleanup();
 
             SSL_set_ex_data(ssl, 0, (void*) nc);
+
+#if defined(NATS_HAS_KTLS)
+            // The keys are handed to the kernel during the handshake,
+            // so this needs to be set before.
+            if (nc->opts->useKernelTLS)
+                SSL_set_options(ssl, SSL_OP_ENABLE_KTLS);
+#endif
         }
     }
     if (s == NATS_OK)
@@ -711,6 +1442,31 @@ _makeTLSConn(natsConnection *nc)
         }
 #endif
     }
+    if (s == NATS_OK)
+    {
+        natsSSLCtx  *ctx  = nc->opts->sslCtx;
+        SSL_SESSION *sess = NULL;
+        char        key[280];
+
+        // Offer the session from the last connection to this server, if
+        // any, for an abbreviated handshake. Otherwise, or if the server
+        // rejects it, this is a full handshake.
+        // The context's lock is already held for the handshake, but other
+        // connections replace (and free) cached sessions under it, so be
+        // explicit: it must cover the lookup and SSL_set_session(), which
+        // takes its own reference on the session.
+        _tlsSessionKey(nc, key, sizeof(key));
+        natsMutex_Lock(ctx->lock);
+        if (ctx->sessions != NULL)
+            sess = (SSL_SESSION*) natsStrHash_Get(ctx->sessions, key);
+#if OPENSSL_VERSION_NUMBER >= 0x10101000L
+        if ((sess != NULL) && !SSL_SESSION_is_resumable(sess))
+            sess = NULL;
+#endif
+        if (sess != NULL)
+            (void) SSL_set_session(ssl, sess);
+        natsMutex_Unlock(ctx->lock);
+    }
     if ((s == NATS_OK) && (SSL_do_handshake(ssl) != 1))
     {
         s = nats_setError(NATS_SSL_ERROR,
@@ -735,6 +1491,18 @@ _makeTLSConn(natsConnection *nc)
     else
     {
         nc->sockCtx.ssl = ssl;
+
+        if (SSL_session_reused(ssl))
+            nc->stats.tlsSessionHits++;
+        else
+            nc->stats.tlsSessionMisses++;
+
+#if defined(NATS_HAS_KTLS)
+        // Offload may engage in one direction only, or not at all (no
+        // kernel support, cipher not supported by the kernel, etc..)
+        nc->sockCtx.ktlsSend = (BIO_get_ktls_send(SSL_get_wbio(ssl)) > 0);
+        nc->sockCtx.ktlsRecv = (BIO_get_ktls_recv(SSL_get_rbio(ssl)) > 0);
+#endif
     }
 
     return NATS_UPDATE_ERR_STACK(s);
@@ -1038,7 +1806,7 @@ _resendSubscriptions(natsConnection *nc)
 {
     natsStatus          s    = NATS_OK;
     natsSubscription    *sub = NULL;
-    natsHashIter        iter;
+    natsSubTableIter    iter;
     char                *proto;
     int                 res;
     int                 adjustedMax;
@@ -1050,22 +1818,17 @@ _resendSubscriptions(natsConnection *nc)
     // be holding the subsMu lock (which is used in processMsg). So copy
     // the subscriptions in a temporary array.
     natsMutex_Lock(nc->subsMu);
-    if (natsHash_Count(nc->subs) > 0)
+    if (natsSubTable_Count(nc->subs) > 0)
     {
-        subs = NATS_CALLOC(natsHash_Count(nc->subs), sizeof(natsSubscription*));
+        subs = NATS_CALLOC(natsSubTable_Count(nc->subs), sizeof(natsSubscription*));
         if (subs == NULL)
             s = NATS_NO_MEMORY;
 
         if (s == NATS_OK)
         {
-            void *p = NULL;
-
-            natsHashIter_Init(&iter, nc->subs);
-            while (natsHashIter_Next(&iter, NULL, &p))
-            {
-                subs[count++] = (natsSubscription*) p;
-            }
-            natsHashIter_Done(&iter);
+            natsSubTableIter_Init(&iter, nc->subs);
+            while ((sub = natsSubTableIter_Next(&iter)) != NULL)
+                subs[count++] = sub;
         }
     }
     natsMutex_Unlock(nc->subsMu);
@@ -1087,8 +1850,14 @@ _resendSubscriptions(natsConnection *nc)
         }
         if (sub->max > 0)
         {
-            if (sub->delivered < sub->max)
-                adjustedMax = (int)(sub->max - sub->delivered);
+            uint64_t delivered = natsSub_delivered(sub);
+
+            // Partitions count the messages they hand to the callback.
+            if (sub->parts != NULL)
+                delivered = (uint64_t) nats_atomicGet(&(sub->parts->dispatched));
+
+            if (delivered < sub->max)
+                adjustedMax = (int)(sub->max - delivered);
 
             // The adjusted max could be 0 here if the number of delivered
             // messages have reached the max, if so, unsubscribe.
@@ -1202,6 +1971,8 @@ _clearPendingFlushRequests(natsConnection *nc)
 void
 natsConn_disposeRespInfo(natsConnection *nc, respInfo *resp, bool needsLock)
 {
+    natsMsg *m = NULL;
+
     if (resp == NULL)
         return;
 
@@ -1212,6 +1983,12 @@ natsConn_disposeRespInfo(natsConnection *nc, respInfo *resp, bool needsLock)
         natsMsg_Destroy(resp->msg);
         resp->msg = NULL;
     }
+    // Same for the replies of a request collecting more than one.
+    while ((m = resp->msgList.head) != NULL)
+    {
+        resp->msgList.head = m->next;
+        natsMsg_Destroy(m);
+    }
     if (!resp->pooled)
     {
         natsCondition_Destroy(resp->cond);
@@ -1226,6 +2003,20 @@ natsConn_disposeRespInfo(natsConnection *nc, respInfo *resp, bool needsLock)
         resp->closed = false;
         resp->closedSts = NATS_OK;
         resp->removed = false;
+        resp->nc = NULL;
+        resp->cb = NULL;
+        resp->cbClosure = NULL;
+        resp->timer = NULL;
+        resp->many = false;
+        resp->maxReplies = 0;
+        resp->replies = 0;
+        resp->deadline = 0;
+        resp->stallTimeout = 0;
+        resp->lastReply = 0;
+        memset(&(resp->msgList), 0, sizeof(natsMsgList));
+        resp->inCb = 0;
+        resp->donePending = false;
+        resp->doneSts = NATS_OK;
         nc->respPool[nc->respPoolIdx++] = resp;
 
         if (needsLock)
@@ -1249,6 +2040,35 @@ natsConn_destroyRespPool(natsConnection *nc)
     NATS_FREE(nc->respPool);
 }
 
+// Adds the request to the request/response map.
+natsStatus
+natsConn_setRespInfo(natsConnection *nc, respInfo *resp)
+{
+    natsRespStripe  *stripe = natsConn_respStripe(nc, resp->reqId);
+    natsStatus      s;
+
+    natsMutex_Lock(stripe->mu);
+    s = natsHash_Set(stripe->map, resp->reqId, (void*) resp, NULL);
+    natsMutex_Unlock(stripe->mu);
+
+    return NATS_UPDATE_ERR_STACK(s);
+}
+
+// Removes the request from the request/response map. Returns NULL if it was
+// not found.
+respInfo*
+natsConn_removeRespInfo(natsConnection *nc, int64_t reqId)
+{
+    natsRespStripe  *stripe = natsConn_respStripe(nc, reqId);
+    respInfo        *resp   = NULL;
+
+    natsMutex_Lock(stripe->mu);
+    resp = (respInfo*) natsHash_Remove(stripe->map, reqId);
+    natsMutex_Unlock(stripe->mu);
+
+    return resp;
+}
+
 // Creates a new respInfo object, binds it to the request's specific
 // subject (that is set in respInbox). The respInfo object is returned.
 // Connection's lock is held on entry.
@@ -1280,57 +2100,22 @@ natsConn_addRespInfo(respInfo **newResp, natsConnection *nc, char *respInbox, in
 
     if (s == NATS_OK)
     {
-        nc->respId[nc->respIdPos] = '0' + nc->respIdVal;
-        nc->respId[nc->respIdPos + 1] = '\0';
+        char    id[NATS_MAX_REQ_ID_LEN];
+        int     i = (int) sizeof(id);
+        int64_t v;
 
-        // Build the response inbox
-        memcpy(respInbox, nc->respSub, NATS_REQ_ID_OFFSET);
-        respInbox[NATS_REQ_ID_OFFSET-1] = '.';
-        memcpy(respInbox+NATS_REQ_ID_OFFSET, nc->respId, nc->respIdPos + 2); // copy the '\0' of respId
-
-        nc->respIdVal++;
-        if (nc->respIdVal == 10)
-        {
-            nc->respIdVal = 0;
-            if (nc->respIdPos > 0)
-            {
-                bool shift = true;
-                int  i, j;
-
-                for (i=nc->respIdPos-1; i>=0; i--)
-                {
-                    if (nc->respId[i] != '9')
-                    {
-                        nc->respId[i]++;
-
-                        for (j=i+1; j<=nc->respIdPos-1; j++)
-                            nc->respId[j] = '0';
-
-                        shift = false;
-                        break;
-                    }
-                }
-                if (shift)
-                {
-                    nc->respId[0] = '1';
+        resp->reqId = ++(nc->respId);
 
-                    for (i=1; i<=nc->respIdPos; i++)
-                        nc->respId[i] = '0';
+        for (v = resp->reqId; v > 0; v /= 10)
+            id[--i] = (char) ('0' + (v % 10));
 
-                    nc->respIdPos++;
-                }
-            }
-            else
-            {
-                nc->respId[0] = '1';
-                nc->respIdPos++;
-            }
-            if (nc->respIdPos == NATS_MAX_REQ_ID_LEN)
-                nc->respIdPos = 0;
-        }
+        // Build the response inbox: <respSub>.<reqId>
+        memcpy(respInbox, nc->respSub, NATS_REQ_ID_OFFSET);
+        respInbox[NATS_REQ_ID_OFFSET-1] = '.';
+        memcpy(respInbox+NATS_REQ_ID_OFFSET, id+i, sizeof(id) - i);
+        respInbox[NATS_REQ_ID_OFFSET + sizeof(id) - i] = '\0';
 
-        s = natsStrHash_Set(nc->respMap, respInbox+NATS_REQ_ID_OFFSET, true,
-                            (void*) resp, NULL);
+        s = natsConn_setRespInfo(nc, resp);
     }
 
     if (s == NATS_OK)
@@ -1346,27 +2131,42 @@ natsConn_addRespInfo(respInfo **newResp, natsConnection *nc, char *respInbox, in
 natsStatus
 natsConn_initResp(natsConnection *nc, natsMsgHandler cb)
 {
-    natsStatus s = NATS_OK;
-    char       ginbox[NATS_INBOX_PRE_LEN + NUID_BUFFER_LEN + 1 + 1 + 1]; // _INBOX.<nuid>.*
+    natsStatus      s = NATS_OK;
+    char            ginbox[NATS_INBOX_PRE_LEN + NUID_BUFFER_LEN + 1 + 1 + 1]; // _INBOX.<nuid>.*
+    natsSubParams   params;
+    int             i;
 
     nc->respPool = NATS_CALLOC(RESP_INFO_POOL_MAX_SIZE, sizeof(respInfo*));
     if (nc->respPool == NULL)
         s = nats_setDefaultError(NATS_NO_MEMORY);
-    if (s == NATS_OK)
-        s = natsStrHash_Create(&nc->respMap, 4);
+    for (i=0; (s == NATS_OK) && (i<NATS_RESP_MAP_STRIPES); i++)
+    {
+        s = natsMutex_Create(&(nc->respMap[i].mu));
+        if (s == NATS_OK)
+            s = natsHash_Create(&(nc->respMap[i].map), 4);
+    }
     if (s == NATS_OK)
         s = natsInbox_Create(&nc->respSub);
     if (s == NATS_OK)
     {
         snprintf(ginbox, sizeof(ginbox), "%s.*", nc->respSub);
-        s = natsConn_subscribeNoPoolNoLock(&(nc->respMux), nc, ginbox, cb, (void*) nc);
+
+        memset(&params, 0, sizeof(params));
+        params.inlineDlv = nc->opts->inlineResponses;
+
+        s = natsConn_subscribeNoPoolNoLockWithParams(&(nc->respMux), nc, ginbox, cb, (void*) nc, &params);
     }
     if (s != NATS_OK)
     {
         natsInbox_Destroy(nc->respSub);
         nc->respSub = NULL;
-        natsStrHash_Destroy(nc->respMap);
-        nc->respMap = NULL;
+        for (i=0; i<NATS_RESP_MAP_STRIPES; i++)
+        {
+            natsHash_Destroy(nc->respMap[i].map);
+            nc->respMap[i].map = NULL;
+            natsMutex_Destroy(nc->respMap[i].mu);
+            nc->respMap[i].mu = NULL;
+        }
         NATS_FREE(nc->respPool);
         nc->respPool = NULL;
     }
@@ -1374,30 +2174,51 @@ natsConn_initResp(natsConnection *nc, natsMsgHandler cb)
     return NATS_UPDATE_ERR_STACK(s);
 }
 
-// This will clear any pending Request calls.
-// Lock is assumed to be held by the caller.
 static void
-_clearPendingRequestCalls(natsConnection *nc, natsStatus reason)
+_clearPendingRequestStripe(natsRespStripe *stripe, natsStatus reason)
 {
-    natsStrHashIter iter;
+    natsHashIter    iter;
     void            *p = NULL;
 
-    if (nc->respMap == NULL)
-        return;
+    natsMutex_Lock(stripe->mu);
 
-    natsStrHashIter_Init(&iter, nc->respMap);
-    while (natsStrHashIter_Next(&iter, NULL, &p))
+    natsHashIter_Init(&iter, stripe->map);
+    while (natsHashIter_Next(&iter, NULL, &p))
     {
         respInfo *val = (respInfo*) p;
         natsMutex_Lock(val->mu);
         val->closed = true;
         val->closedSts = reason;
-        val->removed = true;
+        // An asynchronous request is completed from its timer's callback.
+        if (val->cb != NULL)
+        {
+            if (!val->removed)
+                natsTimer_Reset(val->timer, 0);
+        }
+        else
+            val->removed = true;
         natsCondition_Signal(val->cond);
         natsMutex_Unlock(val->mu);
-        natsStrHashIter_RemoveCurrent(&iter);
+        natsHashIter_RemoveCurrent(&iter);
     }
-    natsStrHashIter_Done(&iter);
+    natsHashIter_Done(&iter);
+
+    natsMutex_Unlock(stripe->mu);
+}
+
+// This will clear any pending Request calls.
+// Lock is assumed to be held by the caller.
+static void
+_clearPendingRequestCalls(natsConnection *nc, natsStatus reason)
+{
+    int i;
+
+    // The map is created with the response subscription.
+    if (nc->respMap[0].map == NULL)
+        return;
+
+    for (i=0; i<NATS_RESP_MAP_STRIPES; i++)
+        _clearPendingRequestStripe(&(nc->respMap[i]), reason);
 }
 
 static void
@@ -1406,8 +2227,19 @@ _clearSSL(natsConnection *nc)
     if (nc->sockCtx.ssl == NULL)
         return;
 
+#if defined(NATS_HAS_TLS)
+    // There is no TLS level shutdown of the connection, in which case
+    // OpenSSL would consider the session bad and prevent its resumption
+    // on reconnect. Unless the connection failed with an SSL error, the
+    // session is not compromised, so mark it as done.
+    if (!nc->sockCtx.sslFailed)
+        SSL_set_shutdown(nc->sockCtx.ssl, SSL_SENT_SHUTDOWN | SSL_RECEIVED_SHUTDOWN);
+#endif
     SSL_free(nc->sockCtx.ssl);
     nc->sockCtx.ssl = NULL;
+    nc->sockCtx.ktlsSend = false;
+    nc->sockCtx.ktlsRecv = false;
+    nc->sockCtx.sslFailed = false;
 }
 
 // Try to reconnect using the option parameters.
@@ -1512,7 +2344,7 @@ _doReconnect(void *arg)
         nc->cur->reconnects += 1;
 
         // Try to create a new connection
-        s = _createConn(nc);
+        s = _createConn(nc, NULL, 0);
         if (s != NATS_OK)
         {
             // Reset error here. We will return NATS_NO_SERVERS at the end of
@@ -1572,7 +2404,7 @@ _doReconnect(void *arg)
             // We need to re-activate the use of pending since we
             // may go back to sleep and release the lock
             nc->usePending = true;
-            natsBuf_Reset(nc->bw);
+            _outReset(nc);
 
             // We need to cleanup some things if the connection was SSL.
             _clearSSL(nc);
@@ -1673,10 +2505,22 @@ natsConn_flushOrKickFlusher(natsConnection *nc)
     {
         s = natsConn_bufferFlush(nc);
     }
-    else if (!(nc->flusherSignaled) && (nc->bw != NULL))
+    else if (nc->bw != NULL)
     {
-        nc->flusherSignaled = true;
-        natsCondition_Signal(nc->flusherCond);
+        if (!(nc->flusherSignaled))
+        {
+            nc->flusherSignaled = true;
+            nc->flusherKickTime = nats_NowInNanoSeconds();
+            natsCondition_Signal(nc->flusherCond);
+        }
+        else if ((nc->flusherWaitBytes > 0)
+                 && (_outLen(nc) >= nc->flusherWaitBytes))
+        {
+            // The flusher is waiting for enough data to accumulate,
+            // wake it up now.
+            nc->flusherWaitBytes = 0;
+            natsCondition_Signal(nc->flusherCond);
+        }
     }
     return s;
 }
@@ -1847,6 +2691,12 @@ _processConnInit(natsConnection *nc)
    if ((s == NATS_OK) && (nc->opts->writeDeadline <= 0))
        s = natsSock_SetBlocking(nc->sockCtx.fd, true);
 
+#if defined(NATS_HAS_IO_URING)
+    // The ring is kept across reconnects, each write names the socket.
+    if ((s == NATS_OK) && (nc->opts->evLoop == NULL) && (nc->sockCtx.wuring == NULL))
+        (void) natsSock_UringStartWrites(&(nc->sockCtx));
+#endif
+
     // Start the readLoop and flusher threads
     if (s == NATS_OK)
         s = _spinUpSocketWatchers(nc);
@@ -1920,9 +2770,30 @@ _connect(natsConnection *nc)
         // The pool may change inside the loop iteration due to INFO protocol.
         for (i = 0; i < natsSrvPool_GetSize(pool); i++)
         {
+            int n = 1;
+
             nc->cur = natsSrvPool_GetSrv(pool,i);
 
-            s = _createConn(nc);
+            // Possibly race the connect across this server and the next ones.
+            if ((nc->opts->racingDelay > 0) && (nc->opts->racingServers > 1))
+            {
+                n = natsSrvPool_GetSize(pool) - i;
+                if (n > nc->opts->racingServers)
+                    n = nc->opts->racingServers;
+            }
+
+            s = _createConn(nc, &(natsSrvPool_GetSrv(pool,i)), n);
+
+            // Move to the server that won the race, or past the ones that
+            // all failed.
+            if (s == NATS_OK)
+            {
+                while (natsSrvPool_GetSrv(pool,i) != nc->cur)
+                    i++;
+            }
+            else
+                i += n - 1;
+
             if (s == NATS_OK)
             {
                 s = _processConnInit(nc);
@@ -2105,28 +2976,62 @@ _processOpError(natsConnection *nc, natsStatus s, bool initialConnect)
     return false;
 }
 
+// Parses what was read from the socket. Subscriptions are looked up in the
+// table without locking, so this is a read section for the table.
+static natsStatus
+_parse(natsConnection *nc, char *buf, int bufLen)
+{
+    natsStatus s;
+
+    natsSubTable_ReadBegin(nc->subs);
+    s = natsParser_Parse(nc, buf, bufLen);
+    if (natsSubTable_ReadEnd(nc->subs))
+    {
+        natsMutex_Lock(nc->subsMu);
+        natsSubTable_Reclaim(nc->subs);
+        natsMutex_Unlock(nc->subsMu);
+    }
+    return s;
+}
+
 static void
 _readLoop(void  *arg)
 {
-    natsStatus  s = NATS_OK;
-    char        *buffer;
+    natsStatus  s       = NATS_OK;
+    char        *buffer = NULL;
     int         n;
     int         bufSize;
+    bool        zeroCopy;
 
     natsConnection *nc = (natsConnection*) arg;
 
     natsConn_Lock(nc);
 
-    bufSize = nc->opts->ioBufSize;
-    buffer = NATS_MALLOC(bufSize);
-    if (buffer == NULL)
-        s = nats_setDefaultError(NATS_NO_MEMORY);
+    bufSize  = nc->opts->ioBufSize;
+    zeroCopy = nc->opts->inboundZeroCopy;
+    if (zeroCopy)
+    {
+        s = natsMsgChunk_Create(&(nc->readChunk), bufSize);
+        if (s == NATS_OK)
+            buffer = nc->readChunk->data;
+    }
+    else
+    {
+        buffer = NATS_MALLOC(bufSize);
+        if (buffer == NULL)
+            s = nats_setDefaultError(NATS_NO_MEMORY);
+    }
 
     if (nc->sockCtx.ssl != NULL)
         nats_sslRegisterThreadForCleanup();
 
     natsDeadline_Clear(&(nc->sockCtx.readDeadline));
 
+#if defined(NATS_HAS_IO_URING)
+    if (s == NATS_OK)
+        (void) natsSock_UringStart(&(nc->sockCtx), bufSize);
+#endif
+
     if (nc->ps == NULL)
         s = natsParser_Create(&(nc->ps));
 
@@ -2142,7 +3047,22 @@ _readLoop(void  *arg)
         if ((s == NATS_IO_ERROR) && (NATS_SOCK_GET_ERROR == NATS_SOCK_WOULD_BLOCK))
             s = NATS_OK;
         if ((s == NATS_OK) && (n > 0))
-            s = natsParser_Parse(nc, buffer, n);
+            s = _parse(nc, buffer, n);
+
+        // If messages still reference the read chunk, we can't read into it
+        // anymore. Release our reference and get a new one.
+        if ((s == NATS_OK)
+            && (nc->readChunk != NULL)
+            && (nats_atomicGet(&(nc->readChunk->refs)) > 1))
+        {
+            natsMsgChunk_Release(nc->readChunk);
+            nc->readChunk = NULL;
+            buffer        = NULL;
+
+            s = natsMsgChunk_Create(&(nc->readChunk), bufSize);
+            if (s == NATS_OK)
+                buffer = nc->readChunk->data;
+        }
 
         if (s != NATS_OK)
             _processOpError(nc, s, false);
@@ -2150,7 +3070,21 @@ _readLoop(void  *arg)
         natsConn_Lock(nc);
     }
 
-    NATS_FREE(buffer);
+    if (zeroCopy)
+    {
+        natsMsgChunk_Release(nc->readChunk);
+        nc->readChunk = NULL;
+    }
+    else
+    {
+        NATS_FREE(buffer);
+    }
+
+#if defined(NATS_HAS_IO_URING)
+    natsSock_UringStop(&(nc->sockCtx));
+#endif
+
+    _zeroCopyDrain(nc);
 
     natsSock_Close(nc->sockCtx.fd);
     nc->sockCtx.fd       = NATS_SOCK_INVALID;
@@ -2167,6 +3101,44 @@ _readLoop(void  *arg)
     natsConn_unlockAndRelease(nc);
 }
 
+// Returns how long (in nanoseconds) the flusher should wait for more data
+// to accumulate before flushing, based on the flush policy.
+// Connection lock is held on entry.
+static int64_t
+_getFlusherDelay(natsConnection *nc, int64_t now)
+{
+    natsOptions *opts = nc->opts;
+    int64_t     delay = opts->flushMaxDelay * 1000;
+
+    if (opts->flushPolicy == NATS_FLUSH_POLICY_THROUGHPUT)
+        return delay;
+
+    if (opts->flushPolicy == NATS_FLUSH_POLICY_ADAPTIVE)
+    {
+        int64_t elapsed = now - nc->flusherRateTime;
+
+        // Update the average publish rate (messages per nanosecond) with
+        // the number of messages published since last sample.
+        if ((nc->flusherRateTime > 0) && (elapsed > 0))
+        {
+            double rate = (double) (nc->stats.outMsgs - nc->flusherRateMsgs) / (double) elapsed;
+
+            nc->flusherRate = (nc->flusherRate * 0.75) + (rate * 0.25);
+        }
+        nc->flusherRateTime = now;
+        nc->flusherRateMsgs = nc->stats.outMsgs;
+
+        // If we don't expect at least a couple of messages within the
+        // delay, waiting would only add latency.
+        if ((nc->flusherRate * (double) delay) < 2.0)
+            return 0;
+
+        return delay;
+    }
+
+    return 0;
+}
+
 static void
 _flusher(void *arg)
 {
@@ -2186,14 +3158,40 @@ _flusher(void *arg)
             break;
         }
 
-        //TODO: If we process the request right away, performance
-        //      will suffer when sending quickly very small messages.
-        //      The buffer is going to be always flushed, which
-        //      defeats the purpose of a write buffer.
-        //      We need to revisit this.
+        if (nc->opts->flushPolicy == NATS_FLUSH_POLICY_DEFAULT)
+        {
+            // Give a chance to accumulate more requests...
+            natsCondition_TimedWait(nc->flusherCond, nc->mu, 1);
+        }
+        else
+        {
+            int64_t now   = nats_NowInNanoSeconds();
+            int64_t delay = _getFlusherDelay(nc, now);
 
-        // Give a chance to accumulate more requests...
-        natsCondition_TimedWait(nc->flusherCond, nc->mu, 1);
+            if (delay > 0)
+            {
+                int64_t target = nc->flusherKickTime + delay;
+
+                // Wait until enough data is buffered, or the delay elapses.
+                // Publishers will signal us when the buffer reaches the
+                // expected size.
+                nc->flusherWaitBytes = nc->opts->flushMaxBytes;
+                while (!(nc->flusherStop)
+                       && ((nc->flusherWaitBytes == 0)
+                           || (_outLen(nc) < nc->flusherWaitBytes)))
+                {
+                    if (natsCondition_AbsoluteTimedWaitNano(nc->flusherCond,
+                                                            nc->mu, target) == NATS_TIMEOUT)
+                    {
+                        break;
+                    }
+                    // If maxBytes is not set, only the delay matters.
+                    if ((nc->opts->flushMaxBytes > 0) && (nc->flusherWaitBytes == 0))
+                        break;
+                }
+                nc->flusherWaitBytes = 0;
+            }
+        }
 
         nc->flusherSignaled = false;
 
@@ -2203,12 +3201,28 @@ _flusher(void *arg)
             break;
         }
 
-        if (nc->sockCtx.fdActive && (natsBuf_Len(nc->bw) > 0))
+        if (nc->sockCtx.fdActive && (_outLen(nc) > 0))
         {
+            int bufLen = _outLen(nc);
+
             SET_WRITE_DEADLINE(nc);
             s = natsConn_bufferFlush(nc);
             if ((s != NATS_OK) && (nc->err == NATS_OK))
                 nc->err = s;
+
+            if (s == NATS_OK)
+            {
+                int64_t ttf = (nats_NowInNanoSeconds() - nc->flusherKickTime) / 1000;
+
+                if (ttf < 0)
+                    ttf = 0;
+
+                nc->stats.flushes++;
+                nc->stats.flushedBytes += (uint64_t) bufLen;
+                nc->stats.flushTime    += (uint64_t) ttf;
+                if ((uint64_t) ttf > nc->stats.maxFlushTime)
+                    nc->stats.maxFlushTime = (uint64_t) ttf;
+            }
         }
 
         natsConn_Unlock(nc);
@@ -2348,22 +3362,22 @@ _spinUpSocketWatchers(natsConnection *nc)
 static void
 _removeAllSubscriptions(natsConnection *nc)
 {
-    natsHashIter     iter;
-    void             *p = NULL;
+    natsSubTableIter iter;
+    natsSubscription *sub = NULL;
+    bool             release;
 
     natsMutex_Lock(nc->subsMu);
-    natsHashIter_Init(&iter, nc->subs);
-    while (natsHashIter_Next(&iter, NULL, &p))
+    natsSubTableIter_Init(&iter, nc->subs);
+    while ((sub = natsSubTableIter_Next(&iter)) != NULL)
     {
-        natsSubscription *sub = (natsSubscription*) p;
-
-        (void) natsHashIter_RemoveCurrent(&iter);
+        (void) natsSubTable_Remove(nc->subs, sub->sid, &release);
 
         natsSub_close(sub, true);
 
-        natsSub_release(sub);
+        if (release)
+            natsSub_release(sub);
     }
-    natsHashIter_Done(&iter);
+    natsSubTable_Reclaim(nc->subs);
     natsMutex_Unlock(nc->subsMu);
 }
 
@@ -2378,6 +3392,7 @@ _close(natsConnection *nc, natsConnStatus status, bool fromPublicClose, bool doC
     bool                    sockWasActive = false;
     bool                    detach = false;
     natsSubscription        *sub = NULL;
+    natsZeroCopyBuf         *zcDone = NULL;
 
     natsConn_lockAndRetain(nc);
 
@@ -2388,7 +3403,7 @@ _close(natsConnection *nc, natsConnStatus status, bool fromPublicClose, bool doC
     if (fromPublicClose
             && (nc->status == NATS_CONN_STATUS_CONNECTED)
             && nc->sockCtx.fdActive
-            && (natsBuf_Len(nc->bw) > 0))
+            && (_outLen(nc) > 0))
     {
         _flushTimeout(nc, 500);
     }
@@ -2473,6 +3488,10 @@ _close(natsConnection *nc, natsConnStatus status, bool fromPublicClose, bool doC
 
     nc->status = status;
 
+    // The socket is closed, after waiting for the kernel to be done with
+    // the buffers sent with zero copy, or discarding what was not sent.
+    zcDone = _zeroCopyReleaseAll(nc);
+
     if (nc->el.attached)
     {
         nc->el.attached = false;
@@ -2480,7 +3499,11 @@ _close(natsConnection *nc, natsConnStatus status, bool fromPublicClose, bool doC
         _retain(nc);
     }
 
-    natsConn_unlockAndRelease(nc);
+    natsConn_Unlock(nc);
+
+    _zeroCopyRelease(nc, zcDone);
+
+    natsConn_release(nc);
 
     if (detach)
     {
@@ -2505,13 +3528,107 @@ _createMsg(natsMsg **newMsg, natsConnection *nc, char *buf, int bufLen, int hdrL
         replyLen = natsBuf_Len(nc->ps->ma.reply);
     }
 
-    s = natsMsg_create(newMsg,
-                       (const char*) natsBuf_Data(nc->ps->ma.subject), subjLen,
-                       (const char*) reply, replyLen,
-                       (const char*) buf, bufLen, hdrLen);
+    // If zero-copy is enabled and the message is entirely in the read
+    // chunk (that is, it was not split across reads), reference it.
+    if ((nc->readChunk != NULL) && (hdrLen <= 0)
+        && natsMsgChunk_Contains(nc->readChunk, natsBuf_Data(nc->ps->ma.subject), subjLen)
+        && ((reply == NULL) || natsMsgChunk_Contains(nc->readChunk, reply, replyLen))
+        && natsMsgChunk_Contains(nc->readChunk, buf, bufLen))
+    {
+        s = natsMsg_createFromChunk(newMsg, nc->msgPool, nc->readChunk,
+                                    natsBuf_Data(nc->ps->ma.subject), subjLen,
+                                    reply, replyLen,
+                                    buf, bufLen);
+        return s;
+    }
+
+    s = natsMsg_createFromPool(newMsg, nc->msgPool,
+                               (const char*) natsBuf_Data(nc->ps->ma.subject), subjLen,
+                               (const char*) reply, replyLen,
+                               (const char*) buf, bufLen, hdrLen);
     return s;
 }
 
+static void
+_processSlowConsumer(natsConnection *nc, natsSubscription *sub)
+{
+    natsConn_Lock(nc);
+
+    nc->err = NATS_SLOW_CONSUMER;
+
+    if (nc->opts->asyncErrCb != NULL)
+        natsAsyncCb_PostErrHandler(nc, sub, NATS_SLOW_CONSUMER);
+
+    natsConn_Unlock(nc);
+}
+
+// Adds the message to the subscription's ring. The subscription's lock is
+// acquired only if the message is dropped, the max pending counters need
+// to be raised, or the delivery thread needs to be signaled. Returns true if the subscription becomes a slow consumer.
+static bool
+_pushToRing(natsSubscription *sub, natsMsg *msg)
+{
+    int     dl    = msg->dataLen;
+    int     msgs  = 0;
+    int     bytes = 0;
+    bool    sc    = false;
+
+    // Those are set under the subscription's lock, but it is fine to read
+    // them without it: at worst a message is added and then discarded.
+    if (sub->closed || sub->drainSkip)
+    {
+        natsMsg_Destroy(msg);
+        return false;
+    }
+
+    // Messages of the batch already handed to the callback are not pending.
+    msgs  = nats_atomicIncr(&(sub->msgList.msgs)) - nats_atomicGet(&(sub->dlvBatchMsgs));
+    bytes = nats_atomicAdd(&(sub->msgList.bytes), dl) - nats_atomicGet(&(sub->dlvBatchBytes));
+
+    if (((sub->msgsLimit > 0) && (msgs > sub->msgsLimit))
+        || ((sub->bytesLimit > 0) && (bytes > sub->bytesLimit))
+        || !natsMsgRing_Push(sub->ring, msg))
+    {
+        nats_atomicDecr(&(sub->msgList.msgs));
+        nats_atomicAdd(&(sub->msgList.bytes), -dl);
+
+        natsMsg_Destroy(msg);
+
+        natsSub_Lock(sub);
+        sub->dropped++;
+        sc = !sub->slowConsumer;
+        sub->slowConsumer = true;
+        natsSub_Unlock(sub);
+
+        return sc;
+    }
+
+    // Those are read by natsSubscription_GetStats() and reset by
+    // natsSubscription_ClearMaxPending() under the subscription's lock.
+    // Checking them without it is fine, the lock is only needed when
+    // there is a new max, which is not the common case.
+    if ((msgs > sub->msgsMax) || (bytes > sub->bytesMax))
+    {
+        natsSub_Lock(sub);
+        if (msgs > sub->msgsMax)
+            sub->msgsMax = msgs;
+
+        if (bytes > sub->bytesMax)
+            sub->bytesMax = bytes;
+        natsSub_Unlock(sub);
+    }
+
+    if (sub->slowConsumer || (nats_atomicGet(&(sub->ring->parked)) > 0))
+    {
+        natsSub_Lock(sub);
+        sub->slowConsumer = false;
+        natsCondition_Broadcast(sub->cond);
+        natsSub_Unlock(sub);
+    }
+
+    return false;
+}
+
 natsStatus
 natsConn_processMsg(natsConnection *nc, char *buf, int bufLen)
 {
@@ -2520,16 +3637,19 @@ natsConn_processMsg(natsConnection *nc, char *buf, int bufLen)
     natsMsg          *msg = NULL;
     natsMsgDlvWorker *ldw = NULL;
     bool             sc   = false;
+    bool             grow = false;
+    bool             closed= false;
     int              dl   = 0;
+    int              msgs = 0;
+    int              bytes= 0;
 
-    natsMutex_Lock(nc->subsMu);
-
-    nc->stats.inMsgs  += 1;
-    nc->stats.inBytes += (uint64_t) bufLen;
-
-    sub = natsHash_Get(nc->subs, nc->ps->ma.sid);
+    // Updated by the reader without the connection's lock, see
+    // natsConnection_GetStats().
+    nats_atomicAdd64(&(nc->stats.inMsgs), 1);
+    nats_atomicAdd64(&(nc->stats.inBytes), (uint64_t) bufLen);
 
-    natsMutex_Unlock(nc->subsMu);
+    // No lock needed, we are in a read section (see _parse()).
+    sub = natsSubTable_Get(nc->subs, nc->ps->ma.sid);
 
     if (sub == NULL)
         return NATS_OK;
@@ -2545,6 +3665,45 @@ natsConn_processMsg(natsConnection *nc, char *buf, int bufLen)
     // computed as the bufLen - header size.
     dl = msg->dataLen;
 
+    // Skip the handoff to the subscription's delivery thread. This is used
+    // for responses to requests, see natsOptions_UseInlineResponses().
+    if (sub->inlineDlv)
+    {
+        // The message is never pending, but count it as delivered, as
+        // the subscription's delivery thread would.
+        natsSub_Lock(sub);
+        closed = sub->closed;
+        if (!closed)
+            sub->delivered++;
+        natsSub_Unlock(sub);
+
+        if (closed)
+            natsMsg_Destroy(msg);
+        else
+            (*(sub->msgCb))(nc, sub, msg, sub->msgCbClosure);
+
+        return NATS_OK;
+    }
+
+    if (sub->ring != NULL)
+    {
+        if (_pushToRing(sub, msg))
+            _processSlowConsumer(nc, sub);
+
+        return NATS_OK;
+    }
+
+    if (sub->parts != NULL)
+    {
+        // As for the ring, reading those without the lock is fine.
+        if (sub->closed || sub->drainSkip)
+            natsMsg_Destroy(msg);
+        else if (natsSubParts_Push(sub->parts, msg))
+            _processSlowConsumer(nc, sub);
+
+        return NATS_OK;
+    }
+
     if ((ldw = sub->libDlvWorker) != NULL)
         natsMutex_Lock(ldw->lock);
     else
@@ -2564,8 +3723,12 @@ natsConn_processMsg(natsConnection *nc, char *buf, int bufLen)
     sub->msgList.msgs++;
     sub->msgList.bytes += dl;
 
-    if (((sub->msgsLimit > 0) && (sub->msgList.msgs > sub->msgsLimit))
-        || ((sub->bytesLimit > 0) && (sub->msgList.bytes > sub->bytesLimit)))
+    // Messages of the batch already handed to the callback are not pending.
+    msgs  = natsSub_pendingMsgs(sub);
+    bytes = natsSub_pendingBytes(sub);
+
+    if (((sub->msgsLimit > 0) && (msgs > sub->msgsLimit))
+        || ((sub->bytesLimit > 0) && (bytes > sub->bytesLimit)))
     {
         natsMsg_Destroy(msg);
 
@@ -2580,25 +3743,18 @@ natsConn_processMsg(natsConnection *nc, char *buf, int bufLen)
     }
     else
     {
-        natsMsgList *list = NULL;
+        natsMsgList *list = &sub->msgList;
 
-        if (sub->msgList.msgs > sub->msgsMax)
-            sub->msgsMax = sub->msgList.msgs;
+        if (msgs > sub->msgsMax)
+            sub->msgsMax = msgs;
 
-        if (sub->msgList.bytes > sub->bytesMax)
-            sub->bytesMax = sub->msgList.bytes;
+        if (bytes > sub->bytesMax)
+            sub->bytesMax = bytes;
 
         sub->slowConsumer = false;
 
         if (ldw != NULL)
-        {
             msg->sub = sub;
-            list = &ldw->msgList;
-        }
-        else
-        {
-            list = &sub->msgList;
-        }
 
         if (list->head == NULL)
             list->head = msg;
@@ -2610,8 +3766,7 @@ natsConn_processMsg(natsConnection *nc, char *buf, int bufLen)
 
         if (ldw != NULL)
         {
-            if (ldw->inWait)
-                natsCondition_Broadcast(ldw->cond);
+            grow = natsLib_msgDeliveryReady(ldw, sub);
         }
         else
         {
@@ -2625,17 +3780,11 @@ natsConn_processMsg(natsConnection *nc, char *buf, int bufLen)
     else
         natsSub_Unlock(sub);
 
-    if (sc)
-    {
-        natsConn_Lock(nc);
-
-        nc->err = NATS_SLOW_CONSUMER;
+    if (grow)
+        natsLib_msgDeliveryGrow();
 
-        if (nc->opts->asyncErrCb != NULL)
-            natsAsyncCb_PostErrHandler(nc, sub, NATS_SLOW_CONSUMER);
-
-        natsConn_Unlock(nc);
-    }
+    if (sc)
+        _processSlowConsumer(nc, sub);
 
     return s;
 }
@@ -2777,14 +3926,10 @@ natsStatus
 natsConn_addSubcription(natsConnection *nc, natsSubscription *sub)
 {
     natsStatus          s       = NATS_OK;
-    void                *oldSub = NULL;
 
-    s = natsHash_Set(nc->subs, sub->sid, (void*) sub, &oldSub);
+    s = natsSubTable_Set(nc->subs, sub);
     if (s == NATS_OK)
-    {
-        assert(oldSub == NULL);
         natsSub_retain(sub);
-    }
 
     return NATS_UPDATE_ERR_STACK(s);
 }
@@ -2792,11 +3937,12 @@ natsConn_addSubcription(natsConnection *nc, natsSubscription *sub)
 void
 natsConn_removeSubscription(natsConnection *nc, natsSubscription *removedSub)
 {
-    natsSubscription *sub = NULL;
+    natsSubscription *sub    = NULL;
+    bool             release = false;
 
     natsMutex_Lock(nc->subsMu);
 
-    sub = natsHash_Remove(nc->subs, removedSub->sid);
+    sub = natsSubTable_Remove(nc->subs, removedSub->sid, &release);
 
     // Note that the sub may have already been removed, so 'sub == NULL'
     // is not an error.
@@ -2805,8 +3951,9 @@ natsConn_removeSubscription(natsConnection *nc, natsSubscription *removedSub)
 
     natsMutex_Unlock(nc->subsMu);
 
-    // If we really removed the subscription, then release it.
-    if (sub != NULL)
+    // If we really removed the subscription, then release it, unless the
+    // reader may still be using it, in which case the table will.
+    if ((sub != NULL) && release)
         natsSub_release(sub);
 }
 
@@ -2853,7 +4000,7 @@ natsStatus
 natsConn_subscribeImpl(natsSubscription **newSub,
                        natsConnection *nc, bool lock, const char *subj, const char *queue,
                        int64_t timeout, natsMsgHandler cb, void *cbClosure,
-                       bool preventUseOfLibDlvPool)
+                       bool preventUseOfLibDlvPool, natsSubParams *params)
 {
     natsStatus          s    = NATS_OK;
     natsSubscription    *sub = NULL;
@@ -2886,7 +4033,7 @@ natsConn_subscribeImpl(natsSubscription **newSub,
         return nats_setDefaultError(NATS_DRAINING);
     }
 
-    s = natsSub_create(&sub, nc, subj, queue, timeout, cb, cbClosure, preventUseOfLibDlvPool);
+    s = natsSub_create(&sub, nc, subj, queue, timeout, cb, cbClosure, preventUseOfLibDlvPool, params);
     if (s == NATS_OK)
     {
         natsMutex_Lock(nc->subsMu);
@@ -2991,7 +4138,7 @@ natsConn_unsubscribe(natsConnection *nc, natsSubscription *sub, int max, bool dr
     }
 
     natsMutex_Lock(nc->subsMu);
-    sub = natsHash_Get(nc->subs, sub->sid);
+    sub = natsSubTable_Get(nc->subs, sub->sid);
     natsMutex_Unlock(nc->subsMu);
     if ((sub == NULL) || !natsSubscription_IsValid(sub))
     {
@@ -3084,7 +4231,7 @@ natsConn_create(natsConnection **newConn, natsOptions *options)
     if (s == NATS_OK)
         s = _setupServerPool(nc);
     if (s == NATS_OK)
-        s = natsHash_Create(&(nc->subs), 8);
+        s = natsSubTable_Create(&(nc->subs));
     if (s == NATS_OK)
         s = natsSock_Init(&nc->sockCtx);
     if (s == NATS_OK)
@@ -3099,6 +4246,8 @@ natsConn_create(natsConnection **newConn, natsOptions *options)
         s = natsCondition_Create(&(nc->pongs.cond));
     if (s == NATS_OK)
         s = natsCondition_Create(&(nc->reconnectCond));
+    if ((s == NATS_OK) && nc->opts->useMsgPool)
+        s = natsMsgPool_Create(&(nc->msgPool));
 
     if (s == NATS_OK)
         *newConn = nc;
@@ -3430,23 +4579,20 @@ _iterateSubsAndInvokeFunc(natsStatus callerSts, natsConnection *nc, subIterFunc
     natsStatus       s    = NATS_OK;
     natsStatus       ls   = NATS_OK;
     natsSubscription *sub = NULL;
-    void             *p   = NULL;
-    natsHashIter     iter;
+    natsSubTableIter iter;
 
     natsMutex_Lock(nc->subsMu);
-    if (natsHash_Count(nc->subs) == 0)
+    if (natsSubTable_Count(nc->subs) == 0)
     {
         natsMutex_Unlock(nc->subsMu);
         return NATS_OK;
     }
-    natsHashIter_Init(&iter, nc->subs);
-    while (natsHashIter_Next(&iter, NULL, &p))
+    natsSubTableIter_Init(&iter, nc->subs);
+    while ((sub = natsSubTableIter_Next(&iter)) != NULL)
     {
-        sub = (natsSubscription*) p;
         ls = (f)(callerSts, nc, sub);
         s = (s == NATS_OK ? ls : s);
     }
-    natsHashIter_Done(&iter);
     natsMutex_Unlock(nc->subsMu);
 
     return NATS_UPDATE_ERR_STACK(s);
@@ -3508,7 +4654,7 @@ _flushAndDrain(void *closure)
     timeout = nc->drainTimeout;
     closed  = natsConn_isClosed(nc);
     natsMutex_Lock(nc->subsMu);
-    doSubs = (natsHash_Count(nc->subs) > 0 ? true : false);
+    doSubs = (natsSubTable_Count(nc->subs) > 0 ? true : false);
     natsMutex_Unlock(nc->subsMu);
     natsConn_Unlock(nc);
 
@@ -3544,7 +4690,7 @@ _flushAndDrain(void *closure)
             if (!(closed = natsConn_isClosed(nc)))
             {
                 natsMutex_Lock(nc->subsMu);
-                subsDone = (natsHash_Count(nc->subs) == 0 ? true : false);
+                subsDone = (natsSubTable_Count(nc->subs) == 0 ? true : false);
                 natsMutex_Unlock(nc->subsMu);
             }
             natsConn_Unlock(nc);
@@ -3664,7 +4810,7 @@ natsConnection_Buffered(natsConnection *nc)
     natsConn_Lock(nc);
 
     if ((nc->status != NATS_CONN_STATUS_CLOSED) && (nc->bw != NULL))
-        buffered = natsBuf_Len(nc->bw);
+        buffered = _outLen(nc);
 
     natsConn_Unlock(nc);
 
@@ -3697,11 +4843,22 @@ natsConnection_GetStats(natsConnection *nc, natsStatistics *stats)
         return nats_setDefaultError(NATS_INVALID_ARG);
 
     // Stats are updated either under connection's mu or subsMu mutexes.
-    // Lock both to safely get them.
+    // Lock both to safely get them. The inbound counters are updated by
+    // the reader with atomic operations instead.
     natsConn_Lock(nc);
     natsMutex_Lock(nc->subsMu);
 
     memcpy(stats, &(nc->stats), sizeof(natsStatistics));
+    stats->inMsgs  = (uint64_t) nats_atomicGet64(&(nc->stats.inMsgs));
+    stats->inBytes = (uint64_t) nats_atomicGet64(&(nc->stats.inBytes));
+
+    // Those are updated by the read loop without locking, so the
+    // values may be slightly behind.
+    if (nc->msgPool != NULL)
+    {
+        stats->msgPoolHits   = nc->msgPool->hits;
+        stats->msgPoolMisses = nc->msgPool->misses;
+    }
 
     natsMutex_Unlock(nc->subsMu);
     natsConn_Unlock(nc);
@@ -3918,7 +5075,7 @@ natsConnection_ProcessReadEvent(natsConnection *nc)
     // So return and we will be called back later by the event loop.
     s = natsSock_Read(&(nc->sockCtx), buffer, size, &n);
     if (s == NATS_OK)
-        s = natsParser_Parse(nc, buffer, n);
+        s = _parse(nc, buffer, n);
 
     if (s != NATS_OK)
         _processOpError(nc, s, false);
@@ -3931,8 +5088,8 @@ natsConnection_ProcessWriteEvent(natsConnection *nc)
 {
     natsStatus  s = NATS_OK;
     int         n = 0;
-    char        *buf;
-    int         len;
+    natsSockVec vecs[NATS_SOCK_MAX_VECS];
+    int         count;
 
     natsConn_Lock(nc);
 
@@ -3942,17 +5099,19 @@ natsConnection_ProcessWriteEvent(natsConnection *nc)
         return;
     }
 
-    buf = natsBuf_Data(nc->bw);
-    len = natsBuf_Len(nc->bw);
+    // The buffer and the payloads it references are sent with a single
+    // vectored write.
+    count = _outVecs(nc, vecs, NATS_SOCK_MAX_VECS);
 
-    s = natsSock_Write(&(nc->sockCtx), buf, len, &n);
+    s = natsSock_WriteV(&(nc->sockCtx), vecs, count, &n);
     if (s == NATS_OK)
     {
-        if (n == len)
-        {
-            // We sent all the data, reset buffer and remove WRITE event.
-            natsBuf_Reset(nc->bw);
+        // Remove what was sent, the payloads that are done are released.
+        _outConsume(nc, n);
 
+        if (_outLen(nc) == 0)
+        {
+            // We sent all the data, remove WRITE event.
             s = nc->opts->evCbs.write(nc->el.data, NATS_EVENT_ACTION_REMOVE);
             if (s == NATS_OK)
                 nc->el.writeAdded = false;
@@ -3960,11 +5119,6 @@ natsConnection_ProcessWriteEvent(natsConnection *nc)
                 nats_setError(s, "Error processing write request: %d - %s",
                               s, natsStatus_GetText(s));
         }
-        else
-        {
-            // We sent some part of the buffer. Move the remaining at the beginning.
-            natsBuf_Consume(nc->bw, n);
-        }
     }
 
     natsConn_Unlock(nc);
@@ -4228,3 +5382,29 @@ natsConnection_GetLocalIPAndPort(natsConnection *nc, char **ip, int *port)
 
     return NATS_UPDATE_ERR_STACK(s);
 }
+
+natsStatus
+natsConnection_GetKernelTLS(natsConnection *nc, bool *send, bool *recv)
+{
+    natsStatus s = NATS_OK;
+
+    if ((nc == NULL) || (send == NULL) || (recv == NULL))
+        return nats_setDefaultError(NATS_INVALID_ARG);
+
+    *send = false;
+    *recv = false;
+
+    natsConn_Lock(nc);
+    if (natsConn_isClosed(nc))
+        s = nats_setDefaultError(NATS_CONNECTION_CLOSED);
+    else if (!nc->sockCtx.fdActive)
+        s = nats_setDefaultError(NATS_CONNECTION_DISCONNECTED);
+    else
+    {
+        *send = nc->sockCtx.ktlsSend;
+        *recv = nc->sockCtx.ktlsRecv;
+    }
+    natsConn_Unlock(nc);
+
+    return s;
+}
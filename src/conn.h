@@ -46,9 +46,43 @@ natsConn_release(natsConnection *nc);
 natsStatus
 natsConn_bufferWrite(natsConnection *nc, const char *buffer, int len);
 
+// Same as natsConn_bufferWrite() for the payload of the message, which is
+// retained and referenced instead of copied when possible.
+natsStatus
+natsConn_bufferWritePayload(natsConnection *nc, natsMsg *msg);
+
 natsStatus
 natsConn_bufferFlush(natsConnection *nc);
 
+// Returns true if a payload of this size can be sent with MSG_ZEROCOPY.
+bool
+natsConn_canZeroCopy(natsConnection *nc, int len);
+
+// Flushes the buffer and sends the payload with MSG_ZEROCOPY. If 'queued'
+// is true on return, 'cb' will be invoked once the kernel is done with the
+// data, otherwise it is up to the caller to invoke it.
+natsStatus
+natsConn_zeroCopyWrite(natsConnection *nc, const char *data, int len,
+                       natsBufferReleaseHandler cb, void *closure,
+                       bool *queued);
+
+// Records that the zero copy sends from 'from' to 'to' (inclusive) are
+// complete. Ranges may be reported in any order.
+void
+natsConn_zeroCopyComplete(natsConnection *nc, uint32_t from, uint32_t to);
+
+// Invokes the release callbacks of the buffers that natsConn_zeroCopyWrite()
+// found complete. Must be called without the connection's lock held.
+void
+natsConn_zeroCopyReleaseDone(natsConnection *nc);
+
+#if defined(NATS_HAS_TLS)
+// OpenSSL's new session callback: keeps the session to resume it on the
+// next connect to the same server.
+int
+natsConn_newTLSSession(SSL *ssl, SSL_SESSION *sess);
+#endif
+
 bool
 natsConn_isClosed(natsConnection *nc);
 
@@ -73,21 +107,23 @@ natsConn_processPing(natsConnection *nc);
 void
 natsConn_processPong(natsConnection *nc);
 
-#define natsConn_subscribeNoPool(sub, nc, subj, cb, closure)                            natsConn_subscribeImpl((sub), (nc), true, (subj), NULL, 0, (cb), (closure), true)
-#define natsConn_subscribeNoPoolNoLock(sub, nc, subj, cb, closure)                      natsConn_subscribeImpl((sub), (nc), false, (subj), NULL, 0, (cb), (closure), true)
+#define natsConn_subscribeNoPool(sub, nc, subj, cb, closure)                            natsConn_subscribeImpl((sub), (nc), true, (subj), NULL, 0, (cb), (closure), true, NULL)
+#define natsConn_subscribeNoPoolNoLock(sub, nc, subj, cb, closure)                      natsConn_subscribeImpl((sub), (nc), false, (subj), NULL, 0, (cb), (closure), true, NULL)
+#define natsConn_subscribeNoPoolNoLockWithParams(sub, nc, subj, cb, closure, params)    natsConn_subscribeImpl((sub), (nc), false, (subj), NULL, 0, (cb), (closure), true, (params))
 #define natsConn_subscribeSyncNoPool(sub, nc, subj)                                     natsConn_subscribeNoPool((sub), (nc), (subj), NULL, NULL)
-#define natsConn_subscribeWithTimeout(sub, nc, subj, timeout, cb, closure)              natsConn_subscribeImpl((sub), (nc), true, (subj), NULL, (timeout), (cb), (closure), false)
+#define natsConn_subscribeWithTimeout(sub, nc, subj, timeout, cb, closure)              natsConn_subscribeImpl((sub), (nc), true, (subj), NULL, (timeout), (cb), (closure), false, NULL)
 #define natsConn_subscribe(sub, nc, subj, cb, closure)                                  natsConn_subscribeWithTimeout((sub), (nc), (subj), 0, (cb), (closure))
 #define natsConn_subscribeSync(sub, nc, subj)                                           natsConn_subscribe((sub), (nc), (subj), NULL, NULL)
-#define natsConn_queueSubscribeWithTimeout(sub, nc, subj, queue, timeout, cb, closure)  natsConn_subscribeImpl((sub), (nc), true, (subj), (queue), (timeout), (cb), (closure), false)
+#define natsConn_queueSubscribeWithTimeout(sub, nc, subj, queue, timeout, cb, closure)  natsConn_subscribeImpl((sub), (nc), true, (subj), (queue), (timeout), (cb), (closure), false, NULL)
 #define natsConn_queueSubscribe(sub, nc, subj, queue, cb, closure)                      natsConn_queueSubscribeWithTimeout((sub), (nc), (subj), (queue), 0, (cb), (closure))
 #define natsConn_queueSubscribeSync(sub, nc, subj, queue)                               natsConn_queueSubscribe((sub), (nc), (subj), (queue), NULL, NULL)
+#define natsConn_subscribeWithParams(sub, nc, subj, cb, closure, params)               natsConn_subscribeImpl((sub), (nc), true, (subj), NULL, 0, (cb), (closure), false, (params))
 
 natsStatus
 natsConn_subscribeImpl(natsSubscription **newSub,
                        natsConnection *nc, bool lock, const char *subj, const char *queue,
                        int64_t timeout, natsMsgHandler cb, void *cbClosure,
-                       bool preventUseOfLibDlvPool);
+                       bool preventUseOfLibDlvPool, natsSubParams *params);
 
 natsStatus
 natsConn_unsubscribe(natsConnection *nc, natsSubscription *sub, int max, bool drainMode, int64_t timeout);
@@ -110,9 +146,18 @@ natsConn_removeSubscription(natsConnection *nc, natsSubscription *sub);
 void
 natsConn_processAsyncINFO(natsConnection *nc, char *buf, int len);
 
+#define natsConn_respStripeIdx(id)   ((int) ((uint64_t) (id) % NATS_RESP_MAP_STRIPES))
+#define natsConn_respStripe(nc, id)  (&((nc)->respMap[natsConn_respStripeIdx(id)]))
+
 natsStatus
 natsConn_addRespInfo(respInfo **newResp, natsConnection *nc, char *respInbox, int respInboxSize);
 
+natsStatus
+natsConn_setRespInfo(natsConnection *nc, respInfo *resp);
+
+respInfo*
+natsConn_removeRespInfo(natsConnection *nc, int64_t reqId);
+
 void
 natsConn_disposeRespInfo(natsConnection *nc, respInfo *resp, bool needsLock);
 
@@ -28,11 +28,27 @@ typedef struct __natsGCItem
 
 } natsGCItem;
 
+// Number of items a library thread defers before handing them off to
+// the garbage collector thread.
+#define NATS_GC_BATCH_SIZE  (64)
+
 // Gives the object to the garbage collector.
 // Returns 'true' if the GC takes ownership, 'false' otherwise (in this case,
 // the caller is responsible for freeing the object).
+// Only objects destroyed from library threads (for instance in callbacks)
+// are deferred. They are added to a per-thread batch that is handed off
+// to the GC thread when full, or freed by natsGC_freeThreadBatch().
 bool
 natsGC_collect(natsGCItem *item);
 
+// Returns 'true' if the current thread has deferred items.
+bool
+natsGC_hasThreadBatch(void);
+
+// Frees the items deferred by the current thread. Library threads call
+// this before going idle.
+void
+natsGC_freeThreadBatch(void);
+
 
 #endif /* GC_H_ */
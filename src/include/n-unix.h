@@ -59,6 +59,19 @@ typedef size_t          natsRecvLen;
 
 #define __NATS_FUNCTION__ __func__
 
+// Atomic operations on a 32-bit integer. Incr/Decr/Add return the new value.
+#define nats_atomicIncr(p)  __sync_add_and_fetch((p), 1)
+#define nats_atomicDecr(p)  __sync_sub_and_fetch((p), 1)
+#define nats_atomicGet(p)   __sync_add_and_fetch((p), 0)
+#define nats_atomicAdd(p, v) __sync_add_and_fetch((p), (v))
+
+// Same on a 64-bit integer.
+#define nats_atomicAdd64(p, v)  __sync_add_and_fetch((p), (v))
+#define nats_atomicGet64(p)     __sync_add_and_fetch((p), 0)
+
+// Full memory barrier, used before publishing a pointer to lock-free readers.
+#define nats_memoryBarrier() __sync_synchronize()
+
 #define nats_asprintf       asprintf
 #define nats_strcasestr     strcasestr
 #define nats_vsnprintf      vsnprintf
@@ -54,6 +54,19 @@ typedef int                 natsRecvLen;
 
 #define __NATS_FUNCTION__ __FUNCTION__
 
+// Atomic operations on a 32-bit integer. Incr/Decr/Add return the new value.
+#define nats_atomicIncr(p)  InterlockedIncrement((LONG volatile*)(p))
+#define nats_atomicDecr(p)  InterlockedDecrement((LONG volatile*)(p))
+#define nats_atomicGet(p)   InterlockedCompareExchange((LONG volatile*)(p), 0, 0)
+#define nats_atomicAdd(p, v) (InterlockedExchangeAdd((LONG volatile*)(p), (LONG)(v)) + (LONG)(v))
+
+// Same on a 64-bit integer.
+#define nats_atomicAdd64(p, v)  (InterlockedExchangeAdd64((LONGLONG volatile*)(p), (LONGLONG)(v)) + (LONGLONG)(v))
+#define nats_atomicGet64(p)     InterlockedCompareExchange64((LONGLONG volatile*)(p), 0, 0)
+
+// Full memory barrier, used before publishing a pointer to lock-free readers.
+#define nats_memoryBarrier() MemoryBarrier()
+
 // Windows doesn't have those..
 // snprintf support is introduced starting MSVC 14.0 (_MSC_VER 1900: Visual Studio 2015)
 #if _MSC_VER < 1900
@@ -0,0 +1,581 @@
+// Copyright 2021 The NATS Authors
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "natsp.h"
+
+#include <string.h>
+
+#include "mem.h"
+#include "conn.h"
+#include "gc.h"
+#include "ioengine.h"
+
+#if defined(__linux__)
+
+#include <errno.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+#define _MAX_EVENTS (64)
+
+typedef struct __natsIOConn natsIOConn;
+
+// An I/O thread polls the sockets of the connections assigned to it.
+typedef struct __natsIOThread
+{
+    // Protects the fields below and the state of the assigned connections.
+    natsMutex       *mu;
+    natsThread      *thread;
+    int             epfd;
+    int             wakeFd;
+
+    // Connections detached from this thread, freed by the thread once it
+    // is done with the events it is processing.
+    natsIOConn      *detached;
+    bool            shutdown;
+    bool            stopped;
+
+    // Number of connections assigned to this thread (engine's lock).
+    int             conns;
+
+} natsIOThread;
+
+struct __natsIOConn
+{
+    natsConnection  *nc;
+    natsIOThread    *owner;
+    natsSock        fd;
+    bool            wantRead;
+    bool            wantWrite;
+    bool            registered;
+    natsIOConn      *next;
+};
+
+typedef struct __natsIOEngine
+{
+    natsMutex       *lock;
+    natsIOThread    **threads;
+    int             count;
+    int             cap;
+    int             maxThreads;
+    bool            shutdown;
+
+} natsIOEngine;
+
+static natsIOEngine gEngine;
+
+bool
+natsIOEngine_Supported(void)
+{
+    return true;
+}
+
+void*
+natsIOEngine_Loop(void)
+{
+    return (void*) &gEngine;
+}
+
+natsStatus
+natsIOEngine_Init(void)
+{
+    natsStatus s;
+
+    memset(&gEngine, 0, sizeof(natsIOEngine));
+    gEngine.maxThreads = NATS_IO_ENGINE_DEFAULT_THREADS;
+
+    s = natsMutex_Create(&(gEngine.lock));
+
+    return NATS_UPDATE_ERR_STACK(s);
+}
+
+natsStatus
+natsIOEngine_SetThreads(int count)
+{
+    if (count <= 0)
+        return nats_setError(NATS_INVALID_ARG, "%s", "Number of I/O threads must be positive");
+
+    natsMutex_Lock(gEngine.lock);
+    // Threads already started keep running, no new thread is started
+    // above this limit.
+    gEngine.maxThreads = count;
+    natsMutex_Unlock(gEngine.lock);
+
+    return NATS_OK;
+}
+
+static void
+_freeIOConn(natsIOConn *c)
+{
+    natsConn_release(c->nc);
+    NATS_FREE(c);
+}
+
+static void
+_wakeThread(natsIOThread *t)
+{
+    uint64_t one = 1;
+
+    // If the counter is saturated the thread is being woken up anyway.
+    if (write(t->wakeFd, &one, sizeof(one)) < 0) {}
+}
+
+// Owner's lock held on entry.
+static natsStatus
+_updateEvents(natsIOConn *c)
+{
+    struct epoll_event  ev;
+    int                 epfd = c->owner->epfd;
+    int                 rc;
+
+    memset(&ev, 0, sizeof(ev));
+    ev.events   = (c->wantRead ? EPOLLIN : 0) | (c->wantWrite ? EPOLLOUT : 0);
+    ev.data.ptr = (void*) c;
+
+    // Remove the socket rather than polling for nothing: errors and hang ups
+    // are always reported and we don't want to be woken up for them.
+    if (ev.events == 0)
+    {
+        if (c->registered)
+            (void) epoll_ctl(epfd, EPOLL_CTL_DEL, c->fd, &ev);
+        c->registered = false;
+        return NATS_OK;
+    }
+
+    // The socket may have been closed (which removes it from the epoll set)
+    // and the descriptor reused, so fall back on the other operation.
+    if (c->registered)
+    {
+        rc = epoll_ctl(epfd, EPOLL_CTL_MOD, c->fd, &ev);
+        if ((rc != 0) && (errno == ENOENT))
+            rc = epoll_ctl(epfd, EPOLL_CTL_ADD, c->fd, &ev);
+    }
+    else
+    {
+        rc = epoll_ctl(epfd, EPOLL_CTL_ADD, c->fd, &ev);
+        if ((rc != 0) && (errno == EEXIST))
+            rc = epoll_ctl(epfd, EPOLL_CTL_MOD, c->fd, &ev);
+    }
+    if (rc != 0)
+        return nats_setError(NATS_SYS_ERROR, "epoll_ctl error: %d", errno);
+
+    c->registered = true;
+
+    return NATS_OK;
+}
+
+static void
+_ioThread(void *arg)
+{
+    natsIOThread        *t = (natsIOThread*) arg;
+    struct epoll_event  events[_MAX_EVENTS];
+    natsIOConn          *c;
+    natsIOConn          *detached;
+    uint64_t            val;
+    bool                shutdown = false;
+    int                 n, i;
+
+    while (!shutdown)
+    {
+        n = epoll_wait(t->epfd, events, _MAX_EVENTS, -1);
+        if ((n < 0) && (errno != EINTR))
+            break;
+
+        for (i=0; i<n; i++)
+        {
+            c = (natsIOConn*) events[i].data.ptr;
+            if (c == NULL)
+            {
+                if (read(t->wakeFd, &val, sizeof(val)) < 0) {}
+                continue;
+            }
+            // A connection detached while processing this batch is only
+            // freed below, so 'c' is still valid here.
+            if (events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP))
+                natsConnection_ProcessReadEvent(c->nc);
+            if (events[i].events & EPOLLOUT)
+                natsConnection_ProcessWriteEvent(c->nc);
+        }
+
+        natsMutex_Lock(t->mu);
+        detached    = t->detached;
+        t->detached = NULL;
+        shutdown    = t->shutdown;
+        natsMutex_Unlock(t->mu);
+
+        while ((c = detached) != NULL)
+        {
+            detached = c->next;
+            _freeIOConn(c);
+        }
+
+        // Before polling again, free what callbacks may have deferred.
+        if (natsGC_hasThreadBatch())
+            natsGC_freeThreadBatch();
+    }
+
+    // From now on, connections are freed when detached.
+    natsMutex_Lock(t->mu);
+    t->stopped  = true;
+    detached    = t->detached;
+    t->detached = NULL;
+    natsMutex_Unlock(t->mu);
+
+    while ((c = detached) != NULL)
+    {
+        detached = c->next;
+        _freeIOConn(c);
+    }
+
+    natsLib_Release();
+}
+
+static void
+_freeIOThread(natsIOThread *t)
+{
+    if (t == NULL)
+        return;
+
+    natsThread_Destroy(t->thread);
+    if (t->epfd >= 0)
+        close(t->epfd);
+    if (t->wakeFd >= 0)
+        close(t->wakeFd);
+    natsMutex_Destroy(t->mu);
+    NATS_FREE(t);
+}
+
+// Engine's lock held on entry.
+static natsStatus
+_startIOThread(natsIOThread **newThread)
+{
+    natsStatus          s  = NATS_OK;
+    natsIOThread        *t = NULL;
+    natsIOThread        **threads;
+    struct epoll_event  ev;
+
+    if (gEngine.count == gEngine.cap)
+    {
+        int newCap = (gEngine.cap == 0 ? gEngine.maxThreads : 2 * gEngine.cap);
+
+        threads = (natsIOThread**) NATS_REALLOC(gEngine.threads, newCap * sizeof(natsIOThread*));
+        if (threads == NULL)
+            return nats_setDefaultError(NATS_NO_MEMORY);
+
+        gEngine.threads = threads;
+        gEngine.cap     = newCap;
+    }
+
+    t = (natsIOThread*) NATS_CALLOC(1, sizeof(natsIOThread));
+    if (t == NULL)
+        return nats_setDefaultError(NATS_NO_MEMORY);
+
+    t->epfd   = -1;
+    t->wakeFd = -1;
+
+    s = natsMutex_Create(&(t->mu));
+    if ((s == NATS_OK) && ((t->epfd = epoll_create1(EPOLL_CLOEXEC)) < 0))
+        s = nats_setError(NATS_SYS_ERROR, "epoll_create1 error: %d", errno);
+    if ((s == NATS_OK) && ((t->wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0))
+        s = nats_setError(NATS_SYS_ERROR, "eventfd error: %d", errno);
+    if (s == NATS_OK)
+    {
+        memset(&ev, 0, sizeof(ev));
+        ev.events   = EPOLLIN;
+        ev.data.ptr = NULL;
+        if (epoll_ctl(t->epfd, EPOLL_CTL_ADD, t->wakeFd, &ev) != 0)
+            s = nats_setError(NATS_SYS_ERROR, "epoll_ctl error: %d", errno);
+    }
+    if (s == NATS_OK)
+    {
+        natsLib_Retain();
+        s = natsThread_Create(&(t->thread), _ioThread, (void*) t);
+        if (s != NATS_OK)
+            natsLib_Release();
+    }
+    if (s == NATS_OK)
+    {
+        gEngine.threads[gEngine.count++] = t;
+        *newThread = t;
+    }
+    else
+    {
+        _freeIOThread(t);
+    }
+
+    return NATS_UPDATE_ERR_STACK(s);
+}
+
+// Assigns a connection to the thread with the fewest connections, unless
+// they all have some and more threads can be started.
+// Engine's lock held on entry.
+static natsStatus
+_assignThread(natsIOThread **owner)
+{
+    natsStatus      s       = NATS_OK;
+    natsIOThread    *best   = NULL;
+    int             i;
+
+    for (i=0; i<gEngine.count; i++)
+    {
+        if ((best == NULL) || (gEngine.threads[i]->conns < best->conns))
+            best = gEngine.threads[i];
+    }
+    if (((best == NULL) || (best->conns > 0)) && (gEngine.count < gEngine.maxThreads))
+        s = _startIOThread(&best);
+
+    if (s == NATS_OK)
+    {
+        best->conns++;
+        *owner = best;
+    }
+
+    return NATS_UPDATE_ERR_STACK(s);
+}
+
+natsStatus
+natsIOEngine_Attach(void **userData, void *loop, natsConnection *nc, natsSock socket)
+{
+    natsStatus  s       = NATS_OK;
+    natsIOConn  *c      = (natsIOConn*) *userData;
+    bool        created = false;
+
+    // On reconnect, the connection stays with the same thread.
+    if (c == NULL)
+    {
+        c = (natsIOConn*) NATS_CALLOC(1, sizeof(natsIOConn));
+        if (c == NULL)
+            return nats_setDefaultError(NATS_NO_MEMORY);
+
+        natsMutex_Lock(gEngine.lock);
+        if (gEngine.shutdown)
+            s = nats_setError(NATS_ILLEGAL_STATE, "%s", "The library is closing");
+        else
+            s = _assignThread(&(c->owner));
+        natsMutex_Unlock(gEngine.lock);
+
+        if (s != NATS_OK)
+        {
+            NATS_FREE(c);
+            return NATS_UPDATE_ERR_STACK(s);
+        }
+        natsConn_retain(nc);
+        c->nc   = nc;
+        created = true;
+    }
+
+    natsMutex_Lock(c->owner->mu);
+    if (c->owner->stopped)
+    {
+        s = nats_setError(NATS_ILLEGAL_STATE, "%s", "The library is closing");
+    }
+    else
+    {
+        c->fd        = socket;
+        c->wantRead  = true;
+        c->wantWrite = false;
+        s = _updateEvents(c);
+    }
+    natsMutex_Unlock(c->owner->mu);
+
+    if ((s != NATS_OK) && created)
+    {
+        natsMutex_Lock(gEngine.lock);
+        c->owner->conns--;
+        natsMutex_Unlock(gEngine.lock);
+
+        _freeIOConn(c);
+    }
+    else if (s == NATS_OK)
+    {
+        *userData = (void*) c;
+    }
+
+    return NATS_UPDATE_ERR_STACK(s);
+}
+
+natsStatus
+natsIOEngine_Read(void *userData, bool add)
+{
+    natsIOConn  *c = (natsIOConn*) userData;
+    natsStatus  s;
+
+    natsMutex_Lock(c->owner->mu);
+    c->wantRead = add;
+    s = _updateEvents(c);
+    natsMutex_Unlock(c->owner->mu);
+
+    return NATS_UPDATE_ERR_STACK(s);
+}
+
+natsStatus
+natsIOEngine_Write(void *userData, bool add)
+{
+    natsIOConn  *c = (natsIOConn*) userData;
+    natsStatus  s;
+
+    natsMutex_Lock(c->owner->mu);
+    c->wantWrite = add;
+    s = _updateEvents(c);
+    natsMutex_Unlock(c->owner->mu);
+
+    return NATS_UPDATE_ERR_STACK(s);
+}
+
+natsStatus
+natsIOEngine_Detach(void *userData)
+{
+    natsIOConn      *c      = (natsIOConn*) userData;
+    natsIOThread    *t      = c->owner;
+    bool            freeNow = false;
+
+    natsMutex_Lock(t->mu);
+    c->wantRead  = false;
+    c->wantWrite = false;
+    (void) _updateEvents(c);
+    // The thread may have returned 'c' from epoll_wait() already, so let
+    // it free it once done with its current events.
+    if (t->stopped)
+    {
+        freeNow = true;
+    }
+    else
+    {
+        c->next     = t->detached;
+        t->detached = c;
+        _wakeThread(t);
+    }
+    natsMutex_Unlock(t->mu);
+
+    natsMutex_Lock(gEngine.lock);
+    t->conns--;
+    natsMutex_Unlock(gEngine.lock);
+
+    if (freeNow)
+        _freeIOConn(c);
+
+    return NATS_OK;
+}
+
+void
+natsIOEngine_Shutdown(void)
+{
+    natsIOThread    *t;
+    int             i;
+
+    natsMutex_Lock(gEngine.lock);
+    gEngine.shutdown = true;
+    for (i=0; i<gEngine.count; i++)
+    {
+        t = gEngine.threads[i];
+
+        natsMutex_Lock(t->mu);
+        t->shutdown = true;
+        _wakeThread(t);
+        natsMutex_Unlock(t->mu);
+    }
+    natsMutex_Unlock(gEngine.lock);
+}
+
+void
+natsIOEngine_Join(void)
+{
+    int i;
+
+    for (i=0; i<gEngine.count; i++)
+        natsThread_Join(gEngine.threads[i]->thread);
+}
+
+void
+natsIOEngine_Free(void)
+{
+    int i;
+
+    for (i=0; i<gEngine.count; i++)
+        _freeIOThread(gEngine.threads[i]);
+
+    NATS_FREE(gEngine.threads);
+    natsMutex_Destroy(gEngine.lock);
+    memset(&gEngine, 0, sizeof(natsIOEngine));
+}
+
+#else
+
+bool
+natsIOEngine_Supported(void)
+{
+    return false;
+}
+
+void*
+natsIOEngine_Loop(void)
+{
+    return NULL;
+}
+
+natsStatus
+natsIOEngine_Init(void)
+{
+    return NATS_OK;
+}
+
+natsStatus
+natsIOEngine_SetThreads(int count)
+{
+    if (count <= 0)
+        return nats_setError(NATS_INVALID_ARG, "%s", "Number of I/O threads must be positive");
+
+    return nats_setError(NATS_NOT_PERMITTED, "%s", "The I/O engine is not supported on this platform");
+}
+
+natsStatus
+natsIOEngine_Attach(void **userData, void *loop, natsConnection *nc, natsSock socket)
+{
+    return nats_setError(NATS_NOT_PERMITTED, "%s", "The I/O engine is not supported on this platform");
+}
+
+natsStatus
+natsIOEngine_Read(void *userData, bool add)
+{
+    return nats_setDefaultError(NATS_NOT_PERMITTED);
+}
+
+natsStatus
+natsIOEngine_Write(void *userData, bool add)
+{
+    return nats_setDefaultError(NATS_NOT_PERMITTED);
+}
+
+natsStatus
+natsIOEngine_Detach(void *userData)
+{
+    return NATS_OK;
+}
+
+void
+natsIOEngine_Shutdown(void)
+{
+}
+
+void
+natsIOEngine_Join(void)
+{
+}
+
+void
+natsIOEngine_Free(void)
+{
+}
+
+#endif
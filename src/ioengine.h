@@ -0,0 +1,64 @@
+// Copyright 2021 The NATS Authors
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef IOENGINE_H_
+#define IOENGINE_H_
+
+#include "natsp.h"
+
+// The I/O engine is an event loop built into the library: connections
+// created with natsOptions_UseIOEngine() are attached to it through the
+// regular event loop callbacks, and a small pool of threads polls their
+// sockets and invokes natsConnection_ProcessReadEvent() and
+// natsConnection_ProcessWriteEvent().
+
+#define NATS_IO_ENGINE_DEFAULT_THREADS  (1)
+
+// Returns true if the engine is available on this platform.
+bool
+natsIOEngine_Supported(void);
+
+// Returns the object to pass as the event loop to natsOptions.
+void*
+natsIOEngine_Loop(void);
+
+// Event loop callbacks.
+natsStatus
+natsIOEngine_Attach(void **userData, void *loop, natsConnection *nc, natsSock socket);
+
+natsStatus
+natsIOEngine_Read(void *userData, bool add);
+
+natsStatus
+natsIOEngine_Write(void *userData, bool add);
+
+natsStatus
+natsIOEngine_Detach(void *userData);
+
+// Library lifecycle, invoked from nats.c.
+natsStatus
+natsIOEngine_Init(void);
+
+natsStatus
+natsIOEngine_SetThreads(int count);
+
+void
+natsIOEngine_Shutdown(void);
+
+void
+natsIOEngine_Join(void);
+
+void
+natsIOEngine_Free(void);
+
+#endif /* IOENGINE_H_ */
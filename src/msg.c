@@ -20,6 +20,7 @@
 
 #include "mem.h"
 #include "msg.h"
+#include "msgpool.h"
 
 int
 natsMsgHeader_encodedLen(natsMsg *msg)
@@ -786,7 +787,13 @@ natsMsg_free(void *object)
         natsStrHash_Destroy(msg->headers);
     }
 
-    NATS_FREE(msg);
+    if (msg->chunk != NULL)
+        natsMsgChunk_Release(msg->chunk);
+
+    if (msg->pool != NULL)
+        natsMsgPool_Free(msg);
+    else
+        NATS_FREE(msg);
 }
 
 void
@@ -795,7 +802,12 @@ natsMsg_Destroy(natsMsg *msg)
     if (msg == NULL)
         return;
 
-    if (natsGC_collect((natsGCItem *) msg))
+    // The payload may still be referenced by a connection's pending output.
+    if (natsMsg_canRetain(msg) && (nats_atomicDecr(&(msg->refs)) > 0))
+        return;
+
+    // Pooled messages are cheap to free: no need to defer to the GC.
+    if ((msg->pool == NULL) && natsGC_collect((natsGCItem *) msg))
         return;
 
     natsMsg_free((void*) msg);
@@ -842,12 +854,25 @@ natsMsg_create(natsMsg **newMsg,
                const char *subject, int subjLen,
                const char *reply, int replyLen,
                const char *buf, int bufLen, int hdrLen)
+{
+    return natsMsg_createFromPool(newMsg, NULL,
+                                  subject, subjLen,
+                                  reply, replyLen,
+                                  buf, bufLen, hdrLen);
+}
+
+natsStatus
+natsMsg_createFromPool(natsMsg **newMsg, natsMsgPool *pool,
+                       const char *subject, int subjLen,
+                       const char *reply, int replyLen,
+                       const char *buf, int bufLen, int hdrLen)
 {
     natsMsg     *msg      = NULL;
     char        *ptr      = NULL;
     int         bufSize   = 0;
     int         dataLen   = bufLen;
     bool        hasHdrs   = (hdrLen > 0 ? true : false);
+    int         poolClass = -1;
 
     bufSize  = subjLen;
     bufSize += 1;
@@ -861,7 +886,10 @@ natsMsg_create(natsMsg **newMsg,
     if (hasHdrs)
         bufSize++;
 
-    msg = NATS_MALLOC(sizeof(natsMsg) + bufSize);
+    if (pool != NULL)
+        msg = natsMsgPool_Alloc(pool, (int) sizeof(natsMsg) + bufSize, &poolClass);
+    else
+        msg = NATS_MALLOC(sizeof(natsMsg) + bufSize);
     if (msg == NULL)
         return nats_setDefaultError(NATS_NO_MEMORY);
 
@@ -879,6 +907,10 @@ natsMsg_create(natsMsg **newMsg,
     msg->hdrLift = false;
     msg->headers = NULL;
     msg->sub     = NULL;
+    msg->chunk   = NULL;
+    msg->pool    = (poolClass >= 0 ? pool : NULL);
+    msg->poolClass = poolClass;
+    msg->refs    = 1;
     msg->next    = NULL;
 
     ptr = (char*) (((char*) &(msg->next)) + sizeof(msg->next));
@@ -927,6 +959,96 @@ natsMsg_create(natsMsg **newMsg,
     return NATS_OK;
 }
 
+natsStatus
+natsMsg_createFromChunk(natsMsg **newMsg, natsMsgPool *pool,
+                        natsMsgChunk *chunk,
+                        char *subject, int subjLen,
+                        char *reply, int replyLen,
+                        char *data, int dataLen)
+{
+    natsMsg *msg        = NULL;
+    int     poolClass   = -1;
+
+    if (pool != NULL)
+        msg = natsMsgPool_Alloc(pool, (int) sizeof(natsMsg), &poolClass);
+    else
+        msg = NATS_MALLOC(sizeof(natsMsg));
+    if (msg == NULL)
+        return nats_setDefaultError(NATS_NO_MEMORY);
+
+    // See natsMsg_create() regarding initialization of the fields.
+    memset(&(msg->gc), 0, sizeof(natsGCItem));
+
+    // The bytes following subject, reply and data are protocol separators
+    // that have already been processed by the parser, so we can replace
+    // them with the NULL terminating character.
+    subject[subjLen] = '\0';
+    msg->subject = (const char*) subject;
+
+    if (replyLen > 0)
+    {
+        reply[replyLen] = '\0';
+        msg->reply = (const char*) reply;
+    }
+    else
+    {
+        msg->reply = NULL;
+    }
+
+    data[dataLen] = '\0';
+    msg->data    = (const char*) data;
+    msg->dataLen = dataLen;
+
+    msg->hdr     = NULL;
+    msg->hdrLen  = 0;
+    msg->hdrLift = false;
+    msg->headers = NULL;
+    msg->sub     = NULL;
+    msg->pool    = (poolClass >= 0 ? pool : NULL);
+    msg->poolClass = poolClass;
+    msg->refs    = 1;
+    msg->next    = NULL;
+
+    natsMsgChunk_Retain(chunk);
+    msg->chunk = chunk;
+
+    msg->gc.freeCb = natsMsg_free;
+
+    *newMsg = msg;
+
+    return NATS_OK;
+}
+
+natsStatus
+natsMsgChunk_Create(natsMsgChunk **newChunk, int size)
+{
+    natsMsgChunk *chunk = NULL;
+
+    // Allocate one more byte so that a NULL terminating character can
+    // always be added after data ending at the end of the chunk.
+    chunk = NATS_MALLOC(sizeof(natsMsgChunk) + size + 1);
+    if (chunk == NULL)
+        return nats_setDefaultError(NATS_NO_MEMORY);
+
+    chunk->refs = 1;
+    chunk->size = size;
+    chunk->data = (char*) (((char*) chunk) + sizeof(natsMsgChunk));
+
+    *newChunk = chunk;
+
+    return NATS_OK;
+}
+
+void
+natsMsgChunk_Release(natsMsgChunk *chunk)
+{
+    if (chunk == NULL)
+        return;
+
+    if (nats_atomicDecr(&(chunk->refs)) == 0)
+        NATS_FREE(chunk);
+}
+
 // Used internally to initialize a message structure, generally defined on the stack,
 // that will then be passed as a reference to publish functions.
 void
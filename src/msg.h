@@ -27,6 +27,21 @@
 #define HDR_STATUS_LEN      (3)
 
 struct __natsMsg;
+struct __natsMsgPool;
+
+// A block of memory the read loop reads socket data into. When zero-copy
+// of inbound messages is enabled, messages reference this memory instead
+// of holding a copy of their subject, reply and payload. The block is
+// freed when the last reference is released.
+typedef struct __natsMsgChunk
+{
+    int32_t volatile    refs;
+    int                 size;
+
+    // Points to the memory right after this structure.
+    char                *data;
+
+} natsMsgChunk;
 
 struct __natsMsg
 {
@@ -48,6 +63,19 @@ struct __natsMsg
     // subscription (needed when delivery done by connection)
     struct __natsSubscription *sub;
 
+    // If not NULL, subject/reply/data point to this chunk instead
+    // of the memory following this structure.
+    natsMsgChunk        *chunk;
+
+    // If not NULL, the memory of this message belongs to this pool and
+    // is returned to it when the message is destroyed.
+    struct __natsMsgPool *pool;
+    int                 poolClass;
+
+    // Messages allocated by the library are freed when the last reference
+    // is released, see natsMsg_retain().
+    int32_t volatile    refs;
+
     // Must be last field!
     struct __natsMsg    *next;
 
@@ -82,6 +110,44 @@ natsMsg_create(natsMsg **newMsg,
                const char *reply, int replyLen,
                const char *buf, int bufLen, int hdrLen);
 
+// Same as natsMsg_create() but the message memory is obtained from the
+// given pool, if not NULL.
+natsStatus
+natsMsg_createFromPool(natsMsg **newMsg, struct __natsMsgPool *pool,
+                       const char *subject, int subjLen,
+                       const char *reply, int replyLen,
+                       const char *buf, int bufLen, int hdrLen);
+
+// Creates a message whose subject, reply and data reference the given
+// chunk (no copy is made). The subject, reply and data must be followed
+// by at least one byte that belongs to the chunk, since it is overwritten
+// with the NULL terminating character. Headers are not supported.
+// The message structure is obtained from the given pool, if not NULL.
+natsStatus
+natsMsg_createFromChunk(natsMsg **newMsg, struct __natsMsgPool *pool,
+                        natsMsgChunk *chunk,
+                        char *subject, int subjLen,
+                        char *reply, int replyLen,
+                        char *data, int dataLen);
+
+natsStatus
+natsMsgChunk_Create(natsMsgChunk **newChunk, int size);
+
+// Only messages allocated by the library can be retained, not those
+// initialized with natsMsg_init(). A retained message is released with
+// natsMsg_Destroy(), which frees it once the last reference is gone.
+#define natsMsg_canRetain(m)    ((m)->gc.freeCb != NULL)
+#define natsMsg_retain(m)       ((void) nats_atomicIncr(&((m)->refs)))
+
+#define natsMsgChunk_Retain(c)  ((void) nats_atomicIncr(&((c)->refs)))
+
+void
+natsMsgChunk_Release(natsMsgChunk *chunk);
+
+// Returns true if the 'len' bytes starting at 'ptr' are inside the chunk.
+#define natsMsgChunk_Contains(c, ptr, len) \
+    (((ptr) >= (c)->data) && (((ptr) + (len)) <= ((c)->data + (c)->size)))
+
 // This needs to follow the nats_FreeObjectCb prototype (see gc.h)
 void
 natsMsg_free(void *object);
@@ -0,0 +1,256 @@
+// Copyright 2021 The NATS Authors
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "natsp.h"
+
+#include "mem.h"
+#include "msg.h"
+#include "msgpool.h"
+
+// Messages freed by a thread are cached here and returned to their pool
+// in batches, so that the pool's lock is not acquired for every message.
+typedef struct __natsMsgPoolCache
+{
+    natsMsgPool     *pool;
+    natsMsgFreeList lists[NATS_MSG_POOL_CLASSES];
+
+} natsMsgPoolCache;
+
+static void
+_freeList(natsMsgFreeList *list)
+{
+    natsMsg *msg;
+
+    while ((msg = list->head) != NULL)
+    {
+        list->head = msg->next;
+        NATS_FREE(msg);
+    }
+    list->tail  = NULL;
+    list->count = 0;
+}
+
+static void
+_appendList(natsMsgFreeList *dst, natsMsgFreeList *src)
+{
+    if (src->head == NULL)
+        return;
+
+    if (dst->tail != NULL)
+        dst->tail->next = src->head;
+    else
+        dst->head = src->head;
+    dst->tail   = src->tail;
+    dst->count += src->count;
+
+    memset(src, 0, sizeof(natsMsgFreeList));
+}
+
+static void
+_freePool(natsMsgPool *pool)
+{
+    int i;
+
+    for (i=0; i<NATS_MSG_POOL_CLASSES; i++)
+    {
+        _freeList(&(pool->shared[i]));
+        _freeList(&(pool->local[i]));
+    }
+    natsMutex_Destroy(pool->mu);
+    NATS_FREE(pool);
+}
+
+static void
+_release(natsMsgPool *pool, int count)
+{
+    if (nats_atomicAdd(&(pool->refs), -count) == 0)
+        _freePool(pool);
+}
+
+natsStatus
+natsMsgPool_Create(natsMsgPool **newPool)
+{
+    natsStatus  s     = NATS_OK;
+    natsMsgPool *pool = NULL;
+
+    pool = (natsMsgPool*) NATS_CALLOC(1, sizeof(natsMsgPool));
+    if (pool == NULL)
+        return nats_setDefaultError(NATS_NO_MEMORY);
+
+    s = natsMutex_Create(&(pool->mu));
+    if (s != NATS_OK)
+    {
+        NATS_FREE(pool);
+        return NATS_UPDATE_ERR_STACK(s);
+    }
+    pool->refs = 1;
+
+    *newPool = pool;
+
+    return NATS_OK;
+}
+
+void*
+natsMsgPool_Alloc(natsMsgPool *pool, int size, int *poolClass)
+{
+    natsMsgFreeList *list = NULL;
+    natsMsg         *msg  = NULL;
+    int             cls   = 0;
+
+    while ((cls < NATS_MSG_POOL_CLASSES) && (size > (NATS_MSG_POOL_MIN_SIZE << cls)))
+        cls++;
+
+    if (cls == NATS_MSG_POOL_CLASSES)
+    {
+        *poolClass = -1;
+        return NATS_MALLOC(size);
+    }
+
+    list = &(pool->local[cls]);
+    if (list->head == NULL)
+    {
+        // Take all messages that other threads have returned.
+        natsMutex_Lock(pool->mu);
+        _appendList(list, &(pool->shared[cls]));
+        natsMutex_Unlock(pool->mu);
+    }
+    if ((msg = list->head) != NULL)
+    {
+        list->head = msg->next;
+        if (list->head == NULL)
+            list->tail = NULL;
+        list->count--;
+        pool->hits++;
+    }
+    else
+    {
+        msg = (natsMsg*) NATS_MALLOC(NATS_MSG_POOL_MIN_SIZE << cls);
+        if (msg == NULL)
+            return NULL;
+        pool->misses++;
+    }
+    nats_atomicIncr(&(pool->refs));
+
+    *poolClass = cls;
+
+    return (void*) msg;
+}
+
+static void
+_flushCache(natsMsgPoolCache *cache)
+{
+    natsMsgPool     *pool   = cache->pool;
+    natsMsgFreeList toFree;
+    int             count   = 0;
+    int             i;
+
+    if (pool == NULL)
+        return;
+
+    memset(&toFree, 0, sizeof(natsMsgFreeList));
+
+    natsMutex_Lock(pool->mu);
+    for (i=0; i<NATS_MSG_POOL_CLASSES; i++)
+    {
+        natsMsgFreeList *list = &(cache->lists[i]);
+
+        count += list->count;
+
+        if (pool->closed || (pool->shared[i].count >= NATS_MSG_POOL_MAX_FREE))
+            _appendList(&toFree, list);
+        else
+            _appendList(&(pool->shared[i]), list);
+    }
+    natsMutex_Unlock(pool->mu);
+
+    _freeList(&toFree);
+
+    cache->pool = NULL;
+
+    if (count > 0)
+        _release(pool, count);
+}
+
+void
+natsMsgPool_Free(natsMsg *msg)
+{
+    natsMsgPool         *pool   = msg->pool;
+    natsMsgPoolCache    *cache  = NULL;
+    natsMsgFreeList     *list   = NULL;
+
+    cache = (natsMsgPoolCache*) nats_getMsgPoolThreadCache();
+    if (cache == NULL)
+    {
+        cache = (natsMsgPoolCache*) NATS_CALLOC(1, sizeof(natsMsgPoolCache));
+        if ((cache != NULL) && (nats_setMsgPoolThreadCache(cache) != NATS_OK))
+        {
+            NATS_FREE(cache);
+            cache = NULL;
+        }
+        if (cache == NULL)
+        {
+            NATS_FREE(msg);
+            _release(pool, 1);
+            return;
+        }
+    }
+
+    // The cache holds messages of a single pool at a time.
+    if (cache->pool != pool)
+    {
+        _flushCache(cache);
+        cache->pool = pool;
+    }
+
+    msg->next = NULL;
+    list = &(cache->lists[msg->poolClass]);
+    if (list->tail != NULL)
+        list->tail->next = msg;
+    else
+        list->head = msg;
+    list->tail = msg;
+    list->count++;
+
+    if ((list->count >= NATS_MSG_POOL_THREAD_CACHE) || nats_atomicGet(&(pool->closed)))
+        _flushCache(cache);
+}
+
+void
+natsMsgPool_Close(natsMsgPool *pool)
+{
+    int i;
+
+    if (pool == NULL)
+        return;
+
+    natsMutex_Lock(pool->mu);
+    nats_atomicIncr(&(pool->closed));
+    for (i=0; i<NATS_MSG_POOL_CLASSES; i++)
+    {
+        _freeList(&(pool->shared[i]));
+        _freeList(&(pool->local[i]));
+    }
+    natsMutex_Unlock(pool->mu);
+
+    _release(pool, 1);
+}
+
+void
+natsMsgPool_ReleaseThreadCache(void *cache)
+{
+    if (cache == NULL)
+        return;
+
+    _flushCache((natsMsgPoolCache*) cache);
+    NATS_FREE(cache);
+}
@@ -0,0 +1,90 @@
+// Copyright 2021 The NATS Authors
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MSGPOOL_H_
+#define MSGPOOL_H_
+
+#include "natsp.h"
+
+// Number of size classes. The size of class 'i' is
+// NATS_MSG_POOL_MIN_SIZE << i, so from 256 bytes to 8KB.
+#define NATS_MSG_POOL_CLASSES       (6)
+#define NATS_MSG_POOL_MIN_SIZE      (256)
+#define NATS_MSG_POOL_MAX_SIZE      (NATS_MSG_POOL_MIN_SIZE << (NATS_MSG_POOL_CLASSES - 1))
+
+// Number of messages a thread caches per size class before returning
+// them to the pool in one batch.
+#define NATS_MSG_POOL_THREAD_CACHE  (32)
+
+// Maximum number of free messages the pool keeps per size class.
+#define NATS_MSG_POOL_MAX_FREE      (1024)
+
+typedef struct __natsMsgFreeList
+{
+    natsMsg     *head;
+    natsMsg     *tail;
+    int         count;
+
+} natsMsgFreeList;
+
+// A pool of message objects owned by a connection. Messages are allocated
+// by the connection's read loop only, but can be freed from any thread.
+typedef struct __natsMsgPool
+{
+    natsMutex           *mu;
+
+    // One reference for the owner, plus one per message that is not
+    // in the pool's free lists (in use or cached by a thread).
+    int32_t volatile    refs;
+
+    // Set to 1 when the owner closes the pool. Returned messages are
+    // then freed instead of being added to the free lists.
+    int32_t volatile    closed;
+
+    // Free messages returned by other threads. Protected by 'mu'.
+    natsMsgFreeList     shared[NATS_MSG_POOL_CLASSES];
+
+    // Free messages available to the allocating thread without locking.
+    natsMsgFreeList     local[NATS_MSG_POOL_CLASSES];
+
+    // Updated by the allocating thread only.
+    uint64_t            hits;
+    uint64_t            misses;
+
+} natsMsgPool;
+
+natsStatus
+natsMsgPool_Create(natsMsgPool **newPool);
+
+// Returns memory for a message of 'size' bytes (including the natsMsg
+// structure). If the memory comes from the pool, 'poolClass' is set to
+// the size class, otherwise it is set to -1 and the memory must be freed
+// with NATS_FREE.
+void*
+natsMsgPool_Alloc(natsMsgPool *pool, int size, int *poolClass);
+
+// Returns the message to its pool. The message content (headers, etc..)
+// must have been released.
+void
+natsMsgPool_Free(natsMsg *msg);
+
+// Called by the owner when it no longer allocates from the pool.
+void
+natsMsgPool_Close(natsMsgPool *pool);
+
+// Returns the messages cached by the current thread to their pool. This is
+// the destructor of the thread-local cache.
+void
+natsMsgPool_ReleaseThreadCache(void *cache);
+
+#endif /* MSGPOOL_H_ */
@@ -0,0 +1,164 @@
+// Copyright 2021 The NATS Authors
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "natsp.h"
+
+#include "mem.h"
+#include "msgring.h"
+
+#define NATS_MSG_RING_MIN_SIZE  (16)
+#define NATS_MSG_RING_MAX_SIZE  (0x40000000)
+
+static natsMsgRingSeg*
+_createSeg(uint32_t size)
+{
+    natsMsgRingSeg *seg = NULL;
+
+    seg = (natsMsgRingSeg*) NATS_CALLOC(1, sizeof(natsMsgRingSeg));
+    if (seg == NULL)
+        return NULL;
+
+    seg->items = (natsMsg**) NATS_CALLOC(size, sizeof(natsMsg*));
+    if (seg->items == NULL)
+    {
+        NATS_FREE(seg);
+        return NULL;
+    }
+    seg->mask = size - 1;
+
+    return seg;
+}
+
+static void
+_freeSeg(natsMsgRingSeg *seg)
+{
+    NATS_FREE(seg->items);
+    NATS_FREE(seg);
+}
+
+natsStatus
+natsMsgRing_Create(natsMsgRing **newRing, int capacity)
+{
+    natsMsgRing *ring   = NULL;
+    uint32_t    maxSize = NATS_MSG_RING_MIN_SIZE;
+
+    if (capacity <= 0)
+        return nats_setDefaultError(NATS_INVALID_ARG);
+
+    while ((maxSize < (uint32_t) capacity) && (maxSize < NATS_MSG_RING_MAX_SIZE))
+        maxSize <<= 1;
+
+    ring = (natsMsgRing*) NATS_CALLOC(1, sizeof(natsMsgRing));
+    if (ring == NULL)
+        return nats_setDefaultError(NATS_NO_MEMORY);
+
+    ring->head = _createSeg(NATS_MSG_RING_MIN_SIZE);
+    if (ring->head == NULL)
+    {
+        NATS_FREE(ring);
+        return nats_setDefaultError(NATS_NO_MEMORY);
+    }
+    ring->tail    = ring->head;
+    ring->maxSize = maxSize;
+
+    *newRing = ring;
+
+    return NATS_OK;
+}
+
+bool
+natsMsgRing_Push(natsMsgRing *ring, natsMsg *msg)
+{
+    natsMsgRingSeg  *seg = ring->tail;
+    uint32_t        tail = seg->tail;
+
+    if ((tail - nats_atomicGet(&(seg->head))) > seg->mask)
+    {
+        natsMsgRingSeg  *next = NULL;
+        uint32_t        size  = seg->mask + 1;
+
+        if (size < ring->maxSize)
+            size <<= 1;
+
+        next = _createSeg(size);
+        if (next == NULL)
+            return false;
+
+        // This is a full barrier, so the consumer will see 'next' once
+        // it sees that the segment is closed.
+        seg->next = next;
+        nats_atomicIncr(&(seg->closed));
+
+        ring->tail = seg = next;
+        tail = 0;
+    }
+
+    seg->items[tail & seg->mask] = msg;
+
+    // This is a full barrier, so the consumer will see the message
+    // before it sees the new tail.
+    nats_atomicIncr(&(seg->tail));
+
+    return true;
+}
+
+natsMsg*
+natsMsgRing_Peek(natsMsgRing *ring)
+{
+    natsMsgRingSeg  *seg = ring->head;
+    uint32_t        head;
+    bool            closed;
+
+    for (;;)
+    {
+        head = seg->head;
+
+        // Check if the segment is closed before checking if it is empty:
+        // the producer does not add messages after closing it, so if it is
+        // empty, it is done with.
+        closed = (nats_atomicGet(&(seg->closed)) != 0);
+
+        if (nats_atomicGet(&(seg->tail)) != head)
+            return seg->items[head & seg->mask];
+
+        if (!closed)
+            return NULL;
+
+        ring->head = seg->next;
+        _freeSeg(seg);
+        seg = ring->head;
+    }
+}
+
+void
+natsMsgRing_Pop(natsMsgRing *ring)
+{
+    nats_atomicIncr(&(ring->head->head));
+}
+
+void
+natsMsgRing_Destroy(natsMsgRing *ring)
+{
+    natsMsg *msg;
+
+    if (ring == NULL)
+        return;
+
+    while ((msg = natsMsgRing_Peek(ring)) != NULL)
+    {
+        natsMsgRing_Pop(ring);
+        natsMsg_Destroy(msg);
+    }
+    _freeSeg(ring->head);
+    NATS_FREE(ring);
+}
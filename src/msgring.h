@@ -0,0 +1,86 @@
+// Copyright 2021 The NATS Authors
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MSGRING_H_
+#define MSGRING_H_
+
+#include "natsp.h"
+
+// Segment of a ring: a bounded circular buffer of messages.
+typedef struct __natsMsgRingSeg
+{
+    natsMsg                     **items;
+    uint32_t                    mask;
+
+    // Only the consumer updates 'head', and only the producer 'tail'.
+    uint32_t volatile           head;
+    uint32_t volatile           tail;
+
+    // Set by the producer once it has moved to 'next'. It will not add
+    // messages to this segment anymore.
+    int32_t volatile            closed;
+    struct __natsMsgRingSeg     *next;
+
+} natsMsgRingSeg;
+
+// Single-producer/single-consumer queue of messages. The producer
+// (the connection's read loop) and the consumer (the subscription's
+// delivery thread) do not need a lock to push and pop messages.
+//
+// The ring starts small. When its segment is full, the producer moves to
+// a new one, twice as large up to the ring's capacity, and the consumer
+// frees the old segment once it has removed all of its messages.
+typedef struct __natsMsgRing
+{
+    // Segment the consumer removes messages from.
+    natsMsgRingSeg      *head;
+
+    // Segment the producer adds messages to.
+    natsMsgRingSeg      *tail;
+
+    // Size that segments do not grow past.
+    uint32_t            maxSize;
+
+    // Set by the consumer before it waits for messages, so that the
+    // producer knows that it needs to signal it.
+    int32_t volatile    parked;
+
+} natsMsgRing;
+
+// Creates a ring whose segments grow up to 'capacity' messages (the capacity
+// is rounded up to the next power of 2). The ring itself is not bounded, the
+// producer is expected to enforce its own limit.
+natsStatus
+natsMsgRing_Create(natsMsgRing **newRing, int capacity);
+
+// Adds the message to the ring. Returns false if the ring needed to grow
+// and the new segment could not be allocated.
+bool
+natsMsgRing_Push(natsMsgRing *ring, natsMsg *msg);
+
+// Returns the oldest message without removing it, or NULL if the ring is
+// empty. Consumer only.
+natsMsg*
+natsMsgRing_Peek(natsMsgRing *ring);
+
+// Removes the message returned by natsMsgRing_Peek().
+void
+natsMsgRing_Pop(natsMsgRing *ring);
+
+#define natsMsgRing_IsEmpty(r)  (natsMsgRing_Peek(r) == NULL)
+
+// Destroys the messages left in the ring and the ring itself.
+void
+natsMsgRing_Destroy(natsMsgRing *ring);
+
+#endif /* MSGRING_H_ */
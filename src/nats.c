@@ -31,6 +31,8 @@
 #include "sub.h"
 #include "nkeys.h"
 #include "crypto.h"
+#include "msgpool.h"
+#include "ioengine.h"
 
 static const char *inboxPrefix = "_INBOX.";
 
@@ -50,16 +52,27 @@ typedef struct natsTLError
 
 } natsTLError;
 
+// Active timers are kept in a 4-ary min-heap ordered by the time they need
+// to fire, so that adding, resetting and stopping a timer is O(log n).
 typedef struct __natsLibTimers
 {
     natsMutex       *lock;
     natsCondition   *cond;
     natsThread      *thread;
-    natsTimer       *timers;
+    natsTimer       **heap;
+    int             heapLen;
+    int             heapCap;
+    int             slots;
+    uint64_t        seq;
     int             count;
     bool            changed;
     bool            shutdown;
 
+    // Statistics, see nats_GetTimerStats().
+    uint64_t        fired;
+    int64_t         totalLag;
+    int64_t         maxLag;
+
 } natsLibTimers;
 
 typedef struct __natsLibAsyncCbs
@@ -82,8 +95,25 @@ typedef struct __natsGCList
     bool            shutdown;
     bool            inWait;
 
+    // Number of items deferred by library threads, and how many of
+    // those were handed off to the GC thread or freed by the deferring
+    // thread itself.
+    uint64_t        queued;
+    uint64_t        handedOff;
+    uint64_t        freedLocally;
+
 } natsGCList;
 
+// Items deferred by a library thread. The batch is handed off to the GC
+// thread when full, or freed by the thread itself when it becomes idle.
+typedef struct __natsGCBatch
+{
+    natsGCItem      *head;
+    natsGCItem      *tail;
+    int             count;
+
+} natsGCBatch;
+
 typedef struct __natsLibDlvWorkers
 {
     natsMutex           *lock;
@@ -92,6 +122,25 @@ typedef struct __natsLibDlvWorkers
     int                 maxSize;
     natsMsgDlvWorker    **workers;
 
+    // Threads above 'minSize' exit after being idle for 'idleTimeout'
+    // (if not 0). 'threads' is updated under 'lock'.
+    int                 minSize;
+    int64_t             idleTimeout;
+    int32_t volatile    threads;
+
+    // Number of subscriptions in the workers' ready lists.
+    int32_t volatile    ready;
+
+    // Idle threads wait on 'idleCond'. 'idleLock' is never held while
+    // acquiring another lock, so idle threads can be woken up while holding
+    // a worker's lock. 'wakeSeq' is incremented (under 'idleLock') when a
+    // subscription becomes ready while some threads are idle.
+    natsMutex           *idleLock;
+    natsCondition       *idleCond;
+    int32_t volatile    idle;
+    int32_t volatile    wakeSeq;
+    bool                shutdown;
+
 } natsLibDlvWorkers;
 
 typedef struct __natsLib
@@ -103,6 +152,8 @@ typedef struct __natsLib
     natsThreadLocal errTLKey;
     natsThreadLocal sslTLKey;
     natsThreadLocal natsThreadKey;
+    natsThreadLocal msgPoolTLKey;
+    natsThreadLocal gcTLKey;
     bool            initialized;
     bool            closed;
     natsCondition   *closeCompleteCond;
@@ -167,16 +218,71 @@ _finalCleanup(void)
 
     natsThreadLocal_DestroyKey(gLib.errTLKey);
     natsThreadLocal_DestroyKey(gLib.natsThreadKey);
+    natsThreadLocal_DestroyKey(gLib.msgPoolTLKey);
+    natsThreadLocal_DestroyKey(gLib.gcTLKey);
     natsMutex_Destroy(gLib.lock);
     gLib.lock = NULL;
 }
 
+static void
+_freeGCBatch(natsGCBatch *batch)
+{
+    natsGCItem  *list;
+    natsGCItem  *item;
+    int         count;
+
+    // Freeing an item may cause other items to be deferred to this
+    // batch, so loop until it is empty.
+    while ((list = batch->head) != NULL)
+    {
+        count = batch->count;
+        memset(batch, 0, sizeof(natsGCBatch));
+
+        while ((item = list) != NULL)
+        {
+            list = item->next;
+            item->next = NULL;
+
+            (*(item->freeCb))((void*) item);
+        }
+
+        natsMutex_Lock(gLib.gc.lock);
+        gLib.gc.queued       += (uint64_t) count;
+        gLib.gc.freedLocally += (uint64_t) count;
+        natsMutex_Unlock(gLib.gc.lock);
+    }
+}
+
+static void
+_destroyGCBatch(void *localStorage)
+{
+    natsGCBatch *batch = (natsGCBatch*) localStorage;
+
+    if (batch == NULL)
+        return;
+
+    _freeGCBatch(batch);
+    NATS_FREE(batch);
+}
+
 void
 nats_setNATSThreadKey(void)
 {
     natsThreadLocal_Set(gLib.natsThreadKey, (const void*)1);
 }
 
+void*
+nats_getMsgPoolThreadCache(void)
+{
+    return natsThreadLocal_Get(gLib.msgPoolTLKey);
+}
+
+natsStatus
+nats_setMsgPoolThreadCache(void *cache)
+{
+    return natsThreadLocal_SetEx(gLib.msgPoolTLKey, cache, false);
+}
+
 void
 nats_ReleaseThreadMemory(void)
 {
@@ -192,6 +298,20 @@ nats_ReleaseThreadMemory(void)
         natsThreadLocal_SetEx(gLib.errTLKey, NULL, false);
     }
 
+    tl = natsThreadLocal_Get(gLib.msgPoolTLKey);
+    if (tl != NULL)
+    {
+        natsMsgPool_ReleaseThreadCache(tl);
+        natsThreadLocal_SetEx(gLib.msgPoolTLKey, NULL, false);
+    }
+
+    tl = natsThreadLocal_Get(gLib.gcTLKey);
+    if (tl != NULL)
+    {
+        _destroyGCBatch(tl);
+        natsThreadLocal_SetEx(gLib.gcTLKey, NULL, false);
+    }
+
     tl = NULL;
 
     natsMutex_Lock(gLib.lock);
@@ -276,6 +396,7 @@ _freeTimers(void)
     natsThread_Destroy(timers->thread);
     natsCondition_Destroy(timers->cond);
     natsMutex_Destroy(timers->lock);
+    NATS_FREE(timers->heap);
 }
 
 static void
@@ -302,7 +423,6 @@ static void
 _freeDlvWorker(natsMsgDlvWorker *worker)
 {
     natsThread_Destroy(worker->thread);
-    natsCondition_Destroy(worker->cond);
     natsMutex_Destroy(worker->lock);
     NATS_FREE(worker);
 }
@@ -317,6 +437,8 @@ _freeDlvWorkers(void)
         _freeDlvWorker(workers->workers[i]);
 
     NATS_FREE(workers->workers);
+    natsCondition_Destroy(workers->idleCond);
+    natsMutex_Destroy(workers->idleLock);
     natsMutex_Destroy(workers->lock);
     workers->idx     = 0;
     workers->size    = 0;
@@ -333,6 +455,7 @@ _freeLib(void)
     _freeAsyncCbs();
     _freeGC();
     _freeDlvWorkers();
+    natsIOEngine_Free();
     natsNUID_free();
 
     natsCondition_Destroy(gLib.cond);
@@ -398,6 +521,10 @@ _doInitOnce(void)
         s = natsThreadLocal_CreateKey(&(gLib.errTLKey), _destroyErrTL);
     if (s == NATS_OK)
         s = natsThreadLocal_CreateKey(&(gLib.natsThreadKey), NULL);
+    if (s == NATS_OK)
+        s = natsThreadLocal_CreateKey(&(gLib.msgPoolTLKey), natsMsgPool_ReleaseThreadCache);
+    if (s == NATS_OK)
+        s = natsThreadLocal_CreateKey(&(gLib.gcTLKey), _destroyGCBatch);
     if (s != NATS_OK)
     {
         fprintf(stderr, "FATAL ERROR: Unable to initialize library!\n");
@@ -411,36 +538,112 @@ _doInitOnce(void)
     atexit(natsLib_Destructor);
 }
 
+#define _TIMER_HEAP_ARITY       (4)
+#define _timerHeapParent(i)     (((i) - 1) / _TIMER_HEAP_ARITY)
+
+// Returns true if `a` needs to fire before `b`. Timers firing at the same
+// time fire in the order they were (re)inserted.
+#define _timerBefore(a, b)      (((a)->absoluteTime < (b)->absoluteTime) \
+                                 || (((a)->absoluteTime == (b)->absoluteTime) && ((a)->seq < (b)->seq)))
+
 static void
-_insertTimer(natsTimer *t)
+_heapSet(natsLibTimers *timers, int idx, natsTimer *t)
+{
+    timers->heap[idx] = t;
+    t->heapIdx = idx;
+}
+
+static void
+_heapUp(natsLibTimers *timers, int idx)
 {
-    natsTimer *cur  = gLib.timers.timers;
-    natsTimer *prev = NULL;
+    natsTimer   *t = timers->heap[idx];
+    int         parent;
 
-    while ((cur != NULL) && (cur->absoluteTime <= t->absoluteTime))
+    while (idx > 0)
     {
-        prev = cur;
-        cur  = cur->next;
+        parent = _timerHeapParent(idx);
+        if (!_timerBefore(t, timers->heap[parent]))
+            break;
+
+        _heapSet(timers, idx, timers->heap[parent]);
+        idx = parent;
     }
+    _heapSet(timers, idx, t);
+}
 
-    if (cur != NULL)
-    {
-        t->prev = prev;
-        t->next = cur;
-        cur->prev = t;
+static void
+_heapDown(natsLibTimers *timers, int idx)
+{
+    natsTimer   *t = timers->heap[idx];
+    int         first;
+    int         last;
+    int         min;
+    int         i;
 
-        if (prev != NULL)
-            prev->next = t;
-    }
-    else if (prev != NULL)
+    while (true)
     {
-        prev->next = t;
-        t->prev = prev;
-        t->next = NULL;
+        first = (idx * _TIMER_HEAP_ARITY) + 1;
+        if (first >= timers->heapLen)
+            break;
+
+        last = first + _TIMER_HEAP_ARITY;
+        if (last > timers->heapLen)
+            last = timers->heapLen;
+
+        min = first;
+        for (i=first+1; i<last; i++)
+        {
+            if (_timerBefore(timers->heap[i], timers->heap[min]))
+                min = i;
+        }
+        if (!_timerBefore(timers->heap[min], t))
+            break;
+
+        _heapSet(timers, idx, timers->heap[min]);
+        idx = min;
     }
+    _heapSet(timers, idx, t);
+}
+
+// Moves the timer, that is in the heap, to its place after its
+// absolute time has changed.
+static void
+_heapFix(natsLibTimers *timers, natsTimer *t)
+{
+    int idx = t->heapIdx;
+
+    if ((idx > 0) && _timerBefore(t, timers->heap[_timerHeapParent(idx)]))
+        _heapUp(timers, idx);
+    else
+        _heapDown(timers, idx);
+}
+
+// There is always room in the heap for all the created timers, see
+// nats_addTimerSlot().
+static void
+_insertTimer(natsTimer *t)
+{
+    natsLibTimers *timers = &(gLib.timers);
+
+    t->seq = ++(timers->seq);
+    _heapSet(timers, timers->heapLen++, t);
+    _heapUp(timers, t->heapIdx);
+}
 
-    if (prev == NULL)
-        gLib.timers.timers = t;
+static void
+_heapRemove(natsLibTimers *timers, natsTimer *t)
+{
+    int         idx   = t->heapIdx;
+    natsTimer   *last = timers->heap[--(timers->heapLen)];
+
+    timers->heap[timers->heapLen] = NULL;
+    t->heapIdx = -1;
+
+    if (last == t)
+        return;
+
+    _heapSet(timers, idx, last);
+    _heapFix(timers, last);
 }
 
 // Locks must be held before entering this function
@@ -451,23 +654,67 @@ _removeTimer(natsLibTimers *timers, natsTimer *t)
     t->stopped = true;
 
     // It the timer was in the callback, it has already been removed from the
-    // list, so skip that.
+    // heap, so skip that.
     if (!(t->inCallback))
-    {
-        if (t->prev != NULL)
-            t->prev->next = t->next;
-        if (t->next != NULL)
-            t->next->prev = t->prev;
+        _heapRemove(timers, t);
+
+    // Decrease the global count of timers
+    timers->count--;
+}
 
-        if (t == gLib.timers.timers)
-            gLib.timers.timers = t->next;
+// The timer thread only needs to be woken up if the first timer to fire
+// has changed.
+static void
+_signalTimerThread(natsLibTimers *timers, natsTimer *first)
+{
+    if (((timers->heapLen > 0) ? timers->heap[0] : NULL) == first)
+        return;
 
-        t->prev = NULL;
-        t->next = NULL;
+    if (!(timers->changed))
+        natsCondition_Signal(timers->cond);
+
+    timers->changed = true;
+}
+
+natsStatus
+nats_addTimerSlot(void)
+{
+    natsLibTimers   *timers = &(gLib.timers);
+    natsStatus      s       = NATS_OK;
+
+    natsMutex_Lock(timers->lock);
+    if (timers->slots == timers->heapCap)
+    {
+        natsTimer   **heap  = NULL;
+        int         newCap  = (timers->heapCap == 0 ? 64 : 2 * timers->heapCap);
+
+        heap = (natsTimer**) NATS_REALLOC(timers->heap, newCap * sizeof(natsTimer*));
+        if (heap == NULL)
+        {
+            s = nats_setDefaultError(NATS_NO_MEMORY);
+        }
+        else
+        {
+            timers->heap    = heap;
+            timers->heapCap = newCap;
+        }
     }
+    if (s == NATS_OK)
+        timers->slots++;
+    natsMutex_Unlock(timers->lock);
 
-    // Decrease the global count of timers
-    timers->count--;
+    return s;
+}
+
+void
+nats_removeTimerSlot(void)
+{
+    natsLibTimers *timers = &(gLib.timers);
+
+    natsMutex_Lock(timers->lock);
+    if (timers->slots > 0)
+        timers->slots--;
+    natsMutex_Unlock(timers->lock);
 }
 
 int64_t
@@ -482,21 +729,13 @@ nats_setTargetTime(int64_t timeout)
 void
 nats_resetTimer(natsTimer *t, int64_t newInterval)
 {
-    natsLibTimers *timers = &(gLib.timers);
+    natsLibTimers   *timers = &(gLib.timers);
+    natsTimer       *first  = NULL;
 
     natsMutex_Lock(timers->lock);
     natsMutex_Lock(t->mu);
 
-    // If timer is active, we need first to remove it. This call does the
-    // right thing if the timer is in the callback.
-    if (!(t->stopped))
-        _removeTimer(timers, t);
-
-    // Bump the timer's global count (it as decreased in the _removeTimers call
-    timers->count++;
-
-    // Switch stopped flag
-    t->stopped = false;
+    first = ((timers->heapLen > 0) ? timers->heap[0] : NULL);
 
     // Set the new interval (may be same than it was before, but that's ok)
     t->interval = newInterval;
@@ -504,18 +743,39 @@ nats_resetTimer(natsTimer *t, int64_t newInterval)
     // If the timer is in the callback, the insertion and setting of the
     // absolute time will be done by the timer thread when returning from
     // the timer's callback.
-    if (!(t->inCallback))
+    if (t->inCallback)
     {
+        if (t->stopped)
+            timers->count++;
+    }
+    else if (t->stopped)
+    {
+        timers->count++;
         t->absoluteTime = nats_setTargetTime(t->interval);
         _insertTimer(t);
     }
+    else
+    {
+        // The timer is already in the heap, just move it.
+        t->absoluteTime = nats_setTargetTime(t->interval);
+        t->seq = ++(timers->seq);
+        _heapFix(timers, t);
+    }
+
+    // Switch stopped flag
+    t->stopped = false;
 
     natsMutex_Unlock(t->mu);
 
-    if (!(timers->changed))
-        natsCondition_Signal(timers->cond);
+    // If this timer was, or now is, the first to fire, the timer thread
+    // needs to know. Note that a timer in the callback is not in the heap.
+    if ((first == t) || (first == NULL) || ((timers->heapLen > 0) && (timers->heap[0] == t)))
+    {
+        if (!(timers->changed))
+            natsCondition_Signal(timers->cond);
 
-    timers->changed = true;
+        timers->changed = true;
+    }
 
     natsMutex_Unlock(timers->lock);
 }
@@ -524,6 +784,7 @@ void
 nats_stopTimer(natsTimer *t)
 {
     natsLibTimers   *timers = &(gLib.timers);
+    natsTimer       *first  = NULL;
     bool            doCb    = false;
 
     natsMutex_Lock(timers->lock);
@@ -538,16 +799,15 @@ nats_stopTimer(natsTimer *t)
         return;
     }
 
+    first = ((timers->heapLen > 0) ? timers->heap[0] : NULL);
+
     _removeTimer(timers, t);
 
     doCb = (!(t->inCallback) && (t->stopCb != NULL));
 
     natsMutex_Unlock(t->mu);
 
-    if (!(timers->changed))
-        natsCondition_Signal(timers->cond);
-
-    timers->changed = true;
+    _signalTimerThread(timers, first);
 
     natsMutex_Unlock(timers->lock);
 
@@ -573,16 +833,10 @@ int
 nats_getTimersCountInList(void)
 {
     int         count = 0;
-    natsTimer   *t;
 
     natsMutex_Lock(gLib.timers.lock);
 
-    t = gLib.timers.timers;
-    while (t != NULL)
-    {
-        count++;
-        t = t->next;
-    }
+    count = gLib.timers.heapLen;
 
     natsMutex_Unlock(gLib.timers.lock);
 
@@ -598,6 +852,7 @@ _timerThread(void *arg)
     natsStatus      s       = NATS_OK;
     bool            doStopCb;
     int64_t         target;
+    int64_t         lag;
 
     WAIT_LIB_INITIALIZED;
 
@@ -606,7 +861,7 @@ _timerThread(void *arg)
     while (!(timers->shutdown))
     {
         // Take the first timer that needs to fire.
-        t = timers->timers;
+        t = ((timers->heapLen > 0) ? timers->heap[0] : NULL);
 
         if (t == NULL)
         {
@@ -638,13 +893,16 @@ _timerThread(void *arg)
 
         natsMutex_Lock(t->mu);
 
-        // Remove timer from the list:
-        timers->timers = t->next;
-        if (t->next != NULL)
-            t->next->prev = NULL;
+        // Remove timer from the heap:
+        _heapRemove(timers, t);
 
-        t->prev = NULL;
-        t->next = NULL;
+        lag = nats_Now() - t->absoluteTime;
+        if (lag < 0)
+            lag = 0;
+        timers->fired++;
+        timers->totalLag += lag;
+        if (lag > timers->maxLag)
+            timers->maxLag = lag;
 
         t->inCallback = true;
 
@@ -667,8 +925,8 @@ _timerThread(void *arg)
         // the window the locks were released.
         doStopCb = (t->stopped && (t->stopCb != NULL));
 
-        // If not stopped, we need to put it back in our list
-        if (!doStopCb)
+        // If not stopped, we need to put it back in the heap
+        if (!(t->stopped))
         {
             // Reset our view of what is the time this timer should fire
             // because:
@@ -691,20 +949,22 @@ _timerThread(void *arg)
         natsMutex_Lock(timers->lock);
     }
 
-    // Process the timers that were left in the list (not stopped) when the
+    // Process the timers that were left in the heap (not stopped) when the
     // library is shutdown.
-    while ((t = timers->timers) != NULL)
+    while (timers->heapLen > 0)
     {
+        t = timers->heap[0];
+
         natsMutex_Lock(t->mu);
 
         // Check if we should invoke the callback. Note that although we are
-        // releasing the locks below, a timer present in the list here is
+        // releasing the locks below, a timer present in the heap here is
         // guaranteed not to have been stopped (because it would not be in
-        // the list otherwise, since there is no chance that it is in the
+        // the heap otherwise, since there is no chance that it is in the
         // timer's callback). So just check if there is a stopCb to invoke.
         doStopCb = (t->stopCb != NULL);
 
-        // Remove the timer from the list.
+        // Remove the timer from the heap.
         _removeTimer(timers, t);
 
         natsMutex_Unlock(t->mu);
@@ -743,7 +1003,17 @@ _asyncCbsThread(void *arg)
     while (true)
     {
         while (((cb = asyncCbs->head) == NULL) && !asyncCbs->shutdown)
+        {
+            // Before going idle, free what callbacks may have deferred.
+            if (natsGC_hasThreadBatch())
+            {
+                natsMutex_Unlock(asyncCbs->lock);
+                natsGC_freeThreadBatch();
+                natsMutex_Lock(asyncCbs->lock);
+                continue;
+            }
             natsCondition_Wait(asyncCbs->cond, asyncCbs->lock);
+        }
 
         if ((cb == NULL) && asyncCbs->shutdown)
             break;
@@ -883,6 +1153,9 @@ _garbageCollector(void *closure)
                 (*(item->freeCb))((void*) item);
             }
 
+            // Free items that may have been deferred by the above.
+            natsGC_freeThreadBatch();
+
             natsMutex_Lock(gc->lock);
         }
         while (gc->head != NULL);
@@ -897,36 +1170,141 @@ _garbageCollector(void *closure)
     natsLib_Release();
 }
 
+static void
+_handOffGCBatch(natsGCBatch *batch)
+{
+    natsGCList  *gc = &(gLib.gc);
+
+    natsMutex_Lock(gc->lock);
+
+    // The GC thread may be gone, in which case free the items here.
+    if (gc->shutdown)
+    {
+        natsMutex_Unlock(gc->lock);
+        _freeGCBatch(batch);
+        return;
+    }
+
+    // Add the whole batch to the front of the list.
+    batch->tail->next = gc->head;
+    gc->head = batch->head;
+
+    gc->queued    += (uint64_t) batch->count;
+    gc->handedOff += (uint64_t) batch->count;
+
+    // We will signal only if the GC is in the condition wait.
+    if (gc->inWait)
+        natsCondition_Signal(gc->cond);
+
+    natsMutex_Unlock(gc->lock);
+
+    memset(batch, 0, sizeof(natsGCBatch));
+}
+
 bool
 natsGC_collect(natsGCItem *item)
 {
-    natsGCList  *gc;
-    bool        signal;
+    natsGCBatch *batch;
 
     // If the object was not setup for garbage collection, return false
     // so the caller frees the object.
     if (item->freeCb == NULL)
         return false;
 
-    gc = &(gLib.gc);
+    // Deferring is only useful for library threads (that is, when the
+    // object is destroyed from a callback). Other threads free directly.
+    if (natsThreadLocal_Get(gLib.natsThreadKey) == NULL)
+        return false;
 
-    natsMutex_Lock(gc->lock);
+    batch = (natsGCBatch*) natsThreadLocal_Get(gLib.gcTLKey);
+    if (batch == NULL)
+    {
+        batch = (natsGCBatch*) NATS_CALLOC(1, sizeof(natsGCBatch));
+        if (batch == NULL)
+            return false;
 
-    // We will signal only if the GC is in the condition wait.
-    signal = gc->inWait;
+        if (natsThreadLocal_SetEx(gLib.gcTLKey, (const void*) batch, false) != NATS_OK)
+        {
+            NATS_FREE(batch);
+            return false;
+        }
+    }
 
-    // Add to the front of the list.
-    item->next = gc->head;
+    // Add to the end of the batch.
+    item->next = NULL;
+    if (batch->tail != NULL)
+        batch->tail->next = item;
+    else
+        batch->head = item;
+    batch->tail = item;
 
-    // Update head.
-    gc->head = item;
+    if (++(batch->count) >= NATS_GC_BATCH_SIZE)
+        _handOffGCBatch(batch);
 
-    if (signal)
-        natsCondition_Signal(gc->cond);
+    return true;
+}
 
+bool
+natsGC_hasThreadBatch(void)
+{
+    natsGCBatch *batch = (natsGCBatch*) natsThreadLocal_Get(gLib.gcTLKey);
+
+    return ((batch != NULL) && (batch->head != NULL));
+}
+
+void
+natsGC_freeThreadBatch(void)
+{
+    natsGCBatch *batch = (natsGCBatch*) natsThreadLocal_Get(gLib.gcTLKey);
+
+    if (batch != NULL)
+        _freeGCBatch(batch);
+}
+
+natsStatus
+nats_GetGCCounts(uint64_t *queued, uint64_t *handedOff, uint64_t *freedLocally)
+{
+    natsStatus  s;
+    natsGCList  *gc = &(gLib.gc);
+
+    s = nats_Open(-1);
+    if (s != NATS_OK)
+        return NATS_UPDATE_ERR_STACK(s);
+
+    natsMutex_Lock(gc->lock);
+    if (queued != NULL)
+        *queued = gc->queued;
+    if (handedOff != NULL)
+        *handedOff = gc->handedOff;
+    if (freedLocally != NULL)
+        *freedLocally = gc->freedLocally;
     natsMutex_Unlock(gc->lock);
 
-    return true;
+    return NATS_OK;
+}
+
+natsStatus
+nats_GetTimerStats(int *count, uint64_t *fired, int64_t *totalLag, int64_t *maxLag)
+{
+    natsStatus      s;
+    natsLibTimers   *timers = &(gLib.timers);
+
+    s = nats_Open(-1);
+    if (s != NATS_OK)
+        return NATS_UPDATE_ERR_STACK(s);
+
+    natsMutex_Lock(timers->lock);
+    if (count != NULL)
+        *count = timers->count;
+    if (fired != NULL)
+        *fired = timers->fired;
+    if (totalLag != NULL)
+        *totalLag = timers->totalLag;
+    if (maxLag != NULL)
+        *maxLag = timers->maxLag;
+    natsMutex_Unlock(timers->lock);
+
+    return NATS_OK;
 }
 
 static void
@@ -950,6 +1328,8 @@ _libTearDown(void)
     if (gLib.gc.thread != NULL)
         natsThread_Join(gLib.gc.thread);
 
+    natsIOEngine_Join();
+
     natsLib_Release();
 }
 
@@ -1029,9 +1409,15 @@ nats_Open(int64_t lockSpinCount)
     }
     if (s == NATS_OK)
         s = natsNUID_init();
+    if (s == NATS_OK)
+        s = natsIOEngine_Init();
 
     if (s == NATS_OK)
         s = natsMutex_Create(&(gLib.dlvWorkers.lock));
+    if (s == NATS_OK)
+        s = natsMutex_Create(&(gLib.dlvWorkers.idleLock));
+    if (s == NATS_OK)
+        s = natsCondition_Create(&(gLib.dlvWorkers.idleCond));
     if (s == NATS_OK)
     {
         char *defaultWriteDeadlineStr = getenv("NATS_DEFAULT_LIB_WRITE_DEADLINE");
@@ -1133,7 +1519,6 @@ _close(bool wait, int64_t timeout)
     natsStatus      s        = NATS_OK;
     natsCondition   *cond    = NULL;
     bool            complete = false;
-    int             i;
 
     // This is to protect against a call to nats_Close() while there
     // was no prior call to nats_Open(), either directly or indirectly.
@@ -1186,16 +1571,14 @@ _close(bool wait, int64_t timeout)
     natsMutex_Unlock(gLib.gc.lock);
 
     natsMutex_Lock(gLib.dlvWorkers.lock);
-    for (i=0; i<gLib.dlvWorkers.size; i++)
-    {
-        natsMsgDlvWorker *worker = gLib.dlvWorkers.workers[i];
-        natsMutex_Lock(worker->lock);
-        worker->shutdown = true;
-        natsCondition_Signal(worker->cond);
-        natsMutex_Unlock(worker->lock);
-    }
+    natsMutex_Lock(gLib.dlvWorkers.idleLock);
+    gLib.dlvWorkers.shutdown = true;
+    natsCondition_Broadcast(gLib.dlvWorkers.idleCond);
+    natsMutex_Unlock(gLib.dlvWorkers.idleLock);
     natsMutex_Unlock(gLib.dlvWorkers.lock);
 
+    natsIOEngine_Shutdown();
+
     natsMutex_Unlock(gLib.lock);
 
     nats_ReleaseThreadMemory();
@@ -1638,134 +2021,228 @@ nats_sslInit(void)
     return NATS_UPDATE_ERR_STACK(s);
 }
 
+// Adds the subscription at the end of the worker's ready list.
+// Worker lock held on entry.
 static void
-_deliverMsgs(void *arg)
+_pushReadySub(natsMsgDlvWorker *worker, natsSubscription *sub)
 {
-    natsMsgDlvWorker    *dlv = (natsMsgDlvWorker*) arg;
-    natsConnection      *nc;
-    natsSubscription    *sub;
-    natsMsgHandler      mcb;
-    void                *mcbClosure;
-    uint64_t            delivered;
-    uint64_t            max;
-    natsMsg             *msg;
-    bool                timerNeedReset = false;
+    sub->libDlvNext = NULL;
+    if (worker->readyTail != NULL)
+        worker->readyTail->libDlvNext = sub;
+    else
+        worker->readyHead = sub;
+    worker->readyTail = sub;
 
-    natsMutex_Lock(dlv->lock);
+    nats_atomicIncr(&(gLib.dlvWorkers.ready));
+}
 
-    while (true)
+// Worker lock held on entry.
+static natsSubscription*
+_popReadySub(natsMsgDlvWorker *worker)
+{
+    natsSubscription *sub = worker->readyHead;
+
+    if (sub == NULL)
+        return NULL;
+
+    worker->readyHead = sub->libDlvNext;
+    if (worker->readyTail == sub)
+        worker->readyTail = NULL;
+    sub->libDlvNext = NULL;
+
+    nats_atomicDecr(&(gLib.dlvWorkers.ready));
+
+    return sub;
+}
+
+// Returns the next ready subscription, taken from this thread's worker or,
+// if it has none, stolen from another worker. The subscription's worker is
+// returned, locked, in 'owner'.
+static natsSubscription*
+_nextReadySub(natsMsgDlvWorker *self, natsMsgDlvWorker **owner)
+{
+    natsLibDlvWorkers   *workers = &(gLib.dlvWorkers);
+    natsMsgDlvWorker    *worker;
+    natsSubscription    *sub     = NULL;
+    int                 i;
+
+    natsMutex_Lock(self->lock);
+    if ((sub = _popReadySub(self)) != NULL)
     {
-        while (((msg = dlv->msgList.head) == NULL) && !dlv->shutdown)
-        {
-            dlv->inWait = true;
-            natsCondition_Wait(dlv->cond, dlv->lock);
-            dlv->inWait = false;
-        }
+        *owner = self;
+        return sub;
+    }
+    natsMutex_Unlock(self->lock);
 
-        // Break out only when list is empty
-        if ((msg == NULL) && dlv->shutdown)
-        {
-            break;
-        }
+    if (nats_atomicGet(&(workers->ready)) == 0)
+        return NULL;
 
-        // Remove message from list now...
-        dlv->msgList.head = msg->next;
-        if (dlv->msgList.tail == msg)
-            dlv->msgList.tail = NULL;
-        msg->next = NULL;
+    natsMutex_Lock(workers->lock);
+    for (i=0; (sub == NULL) && (i<workers->size); i++)
+    {
+        worker = workers->workers[i];
+        if (worker == self)
+            continue;
 
-        // Get subscription reference from message
-        sub = msg->sub;
+        natsMutex_Lock(worker->lock);
+        if ((sub = _popReadySub(worker)) != NULL)
+            *owner = worker;
+        else
+            natsMutex_Unlock(worker->lock);
+    }
+    natsMutex_Unlock(workers->lock);
 
-        // Capture these under lock
-        nc = sub->conn;
-        mcb = sub->msgCb;
-        mcbClosure = sub->msgCbClosure;
-        max = sub->max;
+    return sub;
+}
 
-        // Is this a control message?
-        if (msg->subject[0] == '\0')
-        {
-            bool closed   = sub->closed;
-            bool timedOut = sub->timedOut;
-            bool draining = sub->libDlvDraining;
+// Delivers the pending messages of a subscription taken from the ready list
+// of its worker 'w', whose lock is held on entry and on return. This stops
+// after a control message or a batch of messages. The subscription then
+// goes back at the end of the ready list if it still has pending messages,
+// so that the other subscriptions get their turn.
+static void
+_deliverSubMsgs(natsMsgDlvWorker *w, natsSubscription *sub)
+{
+    natsConnection      *nc         = sub->conn;
+    natsMsgHandler      mcb         = sub->msgCb;
+    void                *mcbClosure = sub->msgCbClosure;
+    uint64_t            max         = sub->max;
+    uint64_t            base;
+    natsMsg             *msg;
+    natsMsg             *batch;
+    natsMsg             *last;
+    int                 limit;
+    int                 n;
+    int                 done;
+    int32_t             gen;
+    bool                rmSub;
+    bool                timerNeedReset = false;
 
-            // Switch off this flag.
-            if (draining)
-                sub->libDlvDraining = false;
+    msg = sub->msgList.head;
 
-            // We need to release this lock...
-            natsMutex_Unlock(dlv->lock);
+    // Is this a control message?
+    if ((msg != NULL) && (msg->subject[0] == '\0'))
+    {
+        bool closed   = sub->closed;
+        bool timedOut = sub->timedOut;
+        bool draining = sub->libDlvDraining;
 
-            // Release the message
-            natsMsg_Destroy(msg);
+        // Remove message from list now...
+        sub->msgList.head = msg->next;
+        if (sub->msgList.tail == msg)
+            sub->msgList.tail = NULL;
+        msg->next = NULL;
 
-            if (draining)
-            {
-                // Subscription is draining, we are past the last message,
-                // remove the subscription. This will schedule another
-                // control message for the close.
-                natsSub_setDrainCompleteState(sub);
-                natsConn_removeSubscription(nc, sub);
-            }
-            else if (closed)
-            {
-                natsOnCompleteCB cb         = NULL;
-                void             *closure   = NULL;
+        // Switch off this flag.
+        if (draining)
+            sub->libDlvDraining = false;
+
+        // We need to release this lock...
+        natsMutex_Unlock(w->lock);
 
-                // Call this in case the subscription was draining.
-                natsSub_setDrainCompleteState(sub);
+        // Release the message
+        natsMsg_Destroy(msg);
 
-                // Check for completion callback
-                natsSub_Lock(sub);
-                cb      = sub->onCompleteCB;
-                closure = sub->onCompleteCBClosure;
-                natsSub_Unlock(sub);
+        if (draining)
+        {
+            // Subscription is draining, we are past the last message,
+            // remove the subscription. This will schedule another
+            // control message for the close.
+            natsSub_setDrainCompleteState(sub);
+            natsConn_removeSubscription(nc, sub);
+        }
+        else if (closed)
+        {
+            natsOnCompleteCB cb         = NULL;
+            void             *closure   = NULL;
 
-                if (cb != NULL)
-                    (*cb)(closure);
+            // Call this in case the subscription was draining.
+            natsSub_setDrainCompleteState(sub);
 
-                // Subscription closed, just release
-                natsSub_release(sub);
-            }
-            else if (timedOut)
-            {
-                // Invoke the callback with a NULL message.
-                (*mcb)(nc, sub, NULL, mcbClosure);
-            }
+            // Check for completion callback
+            natsSub_Lock(sub);
+            cb      = sub->onCompleteCB;
+            closure = sub->onCompleteCBClosure;
+            natsSub_Unlock(sub);
 
-            // Grab the lock, we go back to beginning of loop.
-            natsMutex_Lock(dlv->lock);
+            if (cb != NULL)
+                (*cb)(closure);
 
-            if (!draining && !closed && timedOut)
-            {
-                // Reset the timedOut boolean to allow for the
-                // subscription to timeout again, and reset the
-                // timer to fire again starting from now.
-                sub->timedOut = false;
-                natsTimer_Reset(sub->timeoutTimer, sub->timeout);
-            }
+            // Subscription closed, just release. This is the last message
+            // for this subscription, which must not be accessed past this
+            // point and is not put back in the ready list.
+            natsSub_release(sub);
 
-            // Go back to top of loop.
-            continue;
+            natsMutex_Lock(w->lock);
+            return;
+        }
+        else if (timedOut)
+        {
+            // Invoke the callback with a NULL message.
+            (*mcb)(nc, sub, NULL, mcbClosure);
         }
 
-        // Update before checking closed state.
-        sub->msgList.msgs--;
-        sub->msgList.bytes -= msg->dataLen;
+        // Grab the lock back.
+        natsMutex_Lock(w->lock);
 
-        // Need to check for closed subscription again here.
+        if (!draining && !closed && timedOut)
+        {
+            // Reset the timedOut boolean to allow for the
+            // subscription to timeout again, and reset the
+            // timer to fire again starting from now.
+            sub->timedOut = false;
+            sub->lastActivity = nats_Now();
+            natsTimer_Reset(sub->timeoutTimer, sub->timeout);
+        }
+    }
+    else if (sub->closed)
+    {
         // The subscription could have been unsubscribed from a callback
-        // but there were already pending messages. The control message
-        // is queued up. Until it is processed, we need to simply
-        // discard the message and continue.
-        if (sub->closed)
+        // but there were already pending messages. Until the control
+        // message queued up at the close is processed, we need to simply
+        // discard the messages.
+        while (((msg = sub->msgList.head) != NULL) && (msg->subject[0] != '\0'))
         {
+            sub->msgList.head = msg->next;
+            if (sub->msgList.tail == msg)
+                sub->msgList.tail = NULL;
+
+            sub->msgList.msgs--;
+            sub->msgList.bytes -= msg->dataLen;
             natsMsg_Destroy(msg);
-            continue;
         }
+    }
+    else if (msg != NULL)
+    {
+        // Detach the messages up to the next control message, never past
+        // the max so that auto-unsubscribe is honored exactly.
+        base  = sub->delivered;
+        limit = natsSub_dlvBatchSize(sub);
+        if (max > 0)
+        {
+            if (base >= max)
+                limit = 1;
+            else if ((max - base) < (uint64_t) limit)
+                limit = (int) (max - base);
+        }
+        batch = NULL;
+        last  = NULL;
+        n     = 0;
+        while ((n < limit) && ((msg = sub->msgList.head) != NULL) && (msg->subject[0] != '\0'))
+        {
+            sub->msgList.head = msg->next;
+            if (sub->msgList.tail == msg)
+                sub->msgList.tail = NULL;
+            msg->next = NULL;
 
-        delivered = ++(sub->delivered);
+            if (last == NULL)
+                batch = msg;
+            else
+                last->next = msg;
+            last = msg;
+            n++;
+        }
+        gen = sub->dlvGen;
 
         // Is this a subscription that can timeout?
         if (!sub->draining && (sub->timeout != 0))
@@ -1773,27 +2250,17 @@ _deliverMsgs(void *arg)
             // Prevent the timer to post a timeout control message
             sub->timeoutSuspended = true;
 
-            // If we are dealing with the last pending message for this sub,
+            // If we are dealing with the last pending messages for this sub,
             // we will reset the timer after the user callback returns.
-            if (sub->msgList.msgs == 0)
+            if (sub->msgList.msgs == n)
                 timerNeedReset = true;
         }
 
-        natsMutex_Unlock(dlv->lock);
+        natsMutex_Unlock(w->lock);
 
-        if ((max == 0) || (delivered <= max))
-        {
-           (*mcb)(nc, sub, msg, mcbClosure);
-        }
-        else
-        {
-            // We need to destroy the message since the user can't do it
-            natsMsg_Destroy(msg);
-        }
+        batch = natsSub_deliverBatch(sub, mcb, mcbClosure, batch, base, max, gen, &done, &rmSub);
 
-        // Don't do 'else' because we need to remove when we have hit
-        // the max (after the callback returns).
-        if ((max > 0) && (delivered >= max))
+        if (rmSub)
         {
             // Call this blindly, it will be a no-op if the subscription was not draining.
             natsSub_setDrainCompleteState(sub);
@@ -1801,30 +2268,224 @@ _deliverMsgs(void *arg)
             natsConn_removeSubscription(nc, sub);
         }
 
-        natsMutex_Lock(dlv->lock);
+        natsMutex_Lock(w->lock);
 
-        // Check if timer need to be reset for subscriptions that can timeout.
-        if (!sub->closed && (sub->timeout != 0) && timerNeedReset)
+        natsSub_endBatch(sub, done);
+
+        // Put back the messages that were not delivered.
+        if (batch != NULL)
         {
+            for (last = batch; last->next != NULL; last = last->next)
+                ;
+            last->next = sub->msgList.head;
+            sub->msgList.head = batch;
+            if (sub->msgList.tail == NULL)
+                sub->msgList.tail = last;
+
+            // The timer will be reset after the last of those is delivered.
             timerNeedReset = false;
+        }
 
-            // Do this only on timer reset instead of after each return
-            // from callback. The reason is that if there are still pending
-            // messages for this subscription (this is the case otherwise
-            // timerNeedReset would be false), we should prevent
+        // Check if the timeout needs to restart for subscriptions that can
+        // timeout.
+        if (!sub->closed && (sub->timeout != 0) && timerNeedReset)
+        {
+            // Do this only after the last pending message instead of after
+            // each return from callback. The reason is that if there are
+            // still pending messages for this subscription (this is the case
+            // otherwise timerNeedReset would be false), we should prevent
             // the subscription to timeout anyway.
             sub->timeoutSuspended = false;
 
-            // Reset the timer to fire in `timeout` from now.
-            natsTimer_Reset(sub->timeoutTimer, sub->timeout);
+            // The timeout now starts from here. The timer is not reset, it
+            // will move its deadline based on this when it fires.
+            sub->lastActivity = nats_Now();
         }
     }
 
-    natsMutex_Unlock(dlv->lock);
+    if (sub->msgList.head != NULL)
+        _pushReadySub(w, sub);
+    else
+        sub->libDlvQueued = false;
+}
+
+// Called when the thread has been idle for the pool's idle timeout. Returns
+// true if the thread should exit because the pool is above its min size.
+static bool
+_shrinkPool(natsMsgDlvWorker *self)
+{
+    natsLibDlvWorkers   *workers = &(gLib.dlvWorkers);
+    bool                exit     = false;
+
+    natsMutex_Lock(workers->lock);
+    // Always keep one thread so that ready subscriptions get delivered.
+    if (!workers->shutdown
+        && (workers->threads > workers->minSize)
+        && (workers->threads > 1))
+    {
+        natsThread_Detach(self->thread);
+        natsThread_Destroy(self->thread);
+        self->thread = NULL;
+        nats_atomicDecr(&(workers->threads));
+        exit = true;
+    }
+    natsMutex_Unlock(workers->lock);
+
+    return exit;
+}
+
+// Waits for a subscription to become ready. If one is found, it is returned
+// in 'sub' with its worker, locked, in 'owner'. Returns true if the thread
+// should exit instead, because the library is closing or the pool shrinks.
+static bool
+_waitForReadySub(natsMsgDlvWorker *self, natsSubscription **sub, natsMsgDlvWorker **owner)
+{
+    natsLibDlvWorkers   *workers = &(gLib.dlvWorkers);
+    natsStatus          s        = NATS_OK;
+    bool                shutdown = false;
+    bool                exit     = false;
+    int32_t             seq;
+
+    // Once counted as idle, the thread is woken up when a subscription
+    // becomes ready, so it looks for one again before waiting.
+    nats_atomicIncr(&(workers->idle));
+
+    while (!exit)
+    {
+        seq = nats_atomicGet(&(workers->wakeSeq));
+
+        if ((*sub = _nextReadySub(self, owner)) != NULL)
+            break;
+
+        if (shutdown)
+        {
+            exit = true;
+            break;
+        }
+
+        natsMutex_Lock(workers->idleLock);
+        s = NATS_OK;
+        while ((s != NATS_TIMEOUT) && !workers->shutdown && (workers->wakeSeq == seq))
+        {
+            if (workers->idleTimeout > 0)
+                s = natsCondition_TimedWait(workers->idleCond, workers->idleLock, workers->idleTimeout);
+            else
+                natsCondition_Wait(workers->idleCond, workers->idleLock);
+        }
+        shutdown = workers->shutdown;
+        natsMutex_Unlock(workers->idleLock);
+
+        // Only exit on shutdown after checking for ready subscriptions.
+        if (!shutdown && (s == NATS_TIMEOUT))
+            exit = _shrinkPool(self);
+    }
+
+    nats_atomicDecr(&(workers->idle));
+
+    // This thread may have consumed a wake up: pass it on.
+    if (exit && !shutdown && (nats_atomicGet(&(workers->ready)) > 0))
+    {
+        natsMutex_Lock(workers->idleLock);
+        nats_atomicIncr(&(workers->wakeSeq));
+        natsCondition_Signal(workers->idleCond);
+        natsMutex_Unlock(workers->idleLock);
+    }
+
+    return exit;
+}
+
+static void
+_deliverMsgs(void *arg)
+{
+    natsMsgDlvWorker    *self  = (natsMsgDlvWorker*) arg;
+    natsMsgDlvWorker    *owner = NULL;
+    natsSubscription    *sub   = NULL;
+    bool                exit   = false;
+
+    while (!exit)
+    {
+        if ((sub = _nextReadySub(self, &owner)) == NULL)
+        {
+            // Before going idle, free what callbacks may have deferred.
+            if (natsGC_hasThreadBatch())
+            {
+                natsGC_freeThreadBatch();
+                continue;
+            }
+            exit = _waitForReadySub(self, &sub, &owner);
+        }
+        if (sub != NULL)
+        {
+            _deliverSubMsgs(owner, sub);
+            natsMutex_Unlock(owner->lock);
+        }
+    }
 
     natsLib_Release();
 }
 
+// Pool lock held on entry.
+static natsStatus
+_createDlvWorker(natsMsgDlvWorker **newWorker)
+{
+    natsStatus          s       = NATS_OK;
+    natsMsgDlvWorker    *worker = NULL;
+
+    worker = NATS_CALLOC(1, sizeof(natsMsgDlvWorker));
+    if (worker == NULL)
+        return nats_setDefaultError(NATS_NO_MEMORY);
+
+    s = natsMutex_Create(&worker->lock);
+    if (s == NATS_OK)
+        *newWorker = worker;
+    else
+        _freeDlvWorker(worker);
+
+    return NATS_UPDATE_ERR_STACK(s);
+}
+
+// Pool lock held on entry.
+static natsStatus
+_startDlvWorkerThread(natsMsgDlvWorker *worker)
+{
+    natsStatus s;
+
+    natsLib_Retain();
+    s = natsThread_Create(&worker->thread, _deliverMsgs, (void*) worker);
+    if (s == NATS_OK)
+        nats_atomicIncr(&(gLib.dlvWorkers.threads));
+    else
+        natsLib_Release();
+
+    return NATS_UPDATE_ERR_STACK(s);
+}
+
+// Pool lock held on entry.
+static natsStatus
+_growPoolMaxSize(natsLibDlvWorkers *workers, int max)
+{
+    natsMsgDlvWorker    **newArray;
+    int                 i;
+
+    // Do not error on max < workers->maxSize, the pool shrinks by having
+    // idle threads exit (see nats_SetMessageDeliveryPoolLimits()).
+    if (max <= workers->maxSize)
+        return NATS_OK;
+
+    newArray = NATS_CALLOC(max, sizeof(natsMsgDlvWorker*));
+    if (newArray == NULL)
+        return nats_setDefaultError(NATS_NO_MEMORY);
+
+    for (i=0; i<workers->size; i++)
+        newArray[i] = workers->workers[i];
+
+    NATS_FREE(workers->workers);
+    workers->workers = newArray;
+    workers->maxSize = max;
+
+    return NATS_OK;
+}
+
 natsStatus
 nats_SetMessageDeliveryPoolSize(int max)
 {
@@ -1846,23 +2507,41 @@ nats_SetMessageDeliveryPoolSize(int max)
         return nats_setError(NATS_ERR, "%s", "Pool size cannot be negative or zero");
     }
 
-    // Do not error on max < workers->maxSize in case we allow shrinking
-    // the pool in the future.
-    if (max > workers->maxSize)
+    s = _growPoolMaxSize(workers, max);
+
+    natsMutex_Unlock(workers->lock);
+
+    return NATS_UPDATE_ERR_STACK(s);
+}
+
+natsStatus
+nats_SetMessageDeliveryPoolLimits(int minSize, int maxSize, int64_t idleTimeout)
+{
+    natsStatus          s = NATS_OK;
+    natsLibDlvWorkers   *workers;
+
+    if ((minSize < 0) || (maxSize <= 0) || (minSize > maxSize) || (idleTimeout < 0))
+        return nats_setDefaultError(NATS_INVALID_ARG);
+
+    // Ensure the library is loaded
+    s = nats_Open(-1);
+    if (s != NATS_OK)
+        return s;
+
+    workers = &gLib.dlvWorkers;
+
+    natsMutex_Lock(workers->lock);
+
+    s = _growPoolMaxSize(workers, maxSize);
+    if (s == NATS_OK)
     {
-        natsMsgDlvWorker **newArray = NATS_CALLOC(max, sizeof(natsMsgDlvWorker*));
-        if (newArray == NULL)
-            s = nats_setDefaultError(NATS_NO_MEMORY);
-        if (s == NATS_OK)
-        {
-            int i;
-            for (i=0; i<workers->size; i++)
-                newArray[i] = workers->workers[i];
+        workers->minSize = minSize;
 
-            NATS_FREE(workers->workers);
-            workers->workers = newArray;
-            workers->maxSize = max;
-        }
+        // Idle threads will wait again, using the new timeout.
+        natsMutex_Lock(workers->idleLock);
+        workers->idleTimeout = idleTimeout;
+        natsCondition_Broadcast(workers->idleCond);
+        natsMutex_Unlock(workers->idleLock);
     }
 
     natsMutex_Unlock(workers->lock);
@@ -1870,7 +2549,102 @@ nats_SetMessageDeliveryPoolSize(int max)
     return NATS_UPDATE_ERR_STACK(s);
 }
 
-// Post a control message to the worker's queue.
+natsStatus
+nats_SetIOEngineThreads(int count)
+{
+    natsStatus s;
+
+    // Ensure the library is loaded
+    s = nats_Open(-1);
+    if (s == NATS_OK)
+        s = natsIOEngine_SetThreads(count);
+
+    return NATS_UPDATE_ERR_STACK(s);
+}
+
+// Schedules the delivery of the subscription's pending messages, unless a
+// thread is already (or will be) delivering them. Worker lock held on entry.
+// Returns true if there is no idle thread, in which case the caller should
+// call natsLib_msgDeliveryGrow() once it no longer holds any lock.
+bool
+natsLib_msgDeliveryReady(natsMsgDlvWorker *worker, natsSubscription *sub)
+{
+    natsLibDlvWorkers *workers = &(gLib.dlvWorkers);
+
+    if (sub->libDlvQueued)
+        return false;
+
+    sub->libDlvQueued = true;
+    _pushReadySub(worker, sub);
+
+    if (nats_atomicGet(&(workers->idle)) == 0)
+        return true;
+
+    // Any idle thread will do: if not the worker's own thread, it will
+    // steal the subscription.
+    natsMutex_Lock(workers->idleLock);
+    nats_atomicIncr(&(workers->wakeSeq));
+    natsCondition_Signal(workers->idleCond);
+    natsMutex_Unlock(workers->idleLock);
+
+    return false;
+}
+
+// Starts a thread, if the pool is below its max size, when subscriptions
+// are ready while all threads are busy. This thread will steal them.
+void
+natsLib_msgDeliveryGrow(void)
+{
+    natsLibDlvWorkers   *workers = &(gLib.dlvWorkers);
+    natsMsgDlvWorker    *worker  = NULL;
+    natsStatus          s        = NATS_OK;
+    bool                created  = false;
+    int                 i;
+
+    if (nats_atomicGet(&(workers->threads)) >= workers->maxSize)
+        return;
+
+    natsMutex_Lock(workers->lock);
+
+    if (workers->shutdown
+        || (workers->threads >= workers->maxSize)
+        || (nats_atomicGet(&(workers->idle)) > 0)
+        || (nats_atomicGet(&(workers->ready)) == 0))
+    {
+        natsMutex_Unlock(workers->lock);
+        return;
+    }
+
+    // Restart the thread of a worker whose thread has exited, or add a
+    // worker, which will also be assigned subscriptions from now on.
+    for (i=0; (worker == NULL) && (i<workers->size); i++)
+    {
+        if (workers->workers[i]->thread == NULL)
+            worker = workers->workers[i];
+    }
+    if ((worker == NULL) && (workers->size < workers->maxSize))
+    {
+        s = _createDlvWorker(&worker);
+        created = (s == NATS_OK);
+    }
+    if (worker != NULL)
+        s = _startDlvWorkerThread(worker);
+    if (created)
+    {
+        if (s == NATS_OK)
+            workers->workers[workers->size++] = worker;
+        else
+            _freeDlvWorker(worker);
+    }
+
+    natsMutex_Unlock(workers->lock);
+
+    // The busy threads will deliver the ready subscriptions anyway.
+    if (s != NATS_OK)
+        nats_clearLastError();
+}
+
+// Post a control message to the subscription's pending messages.
 natsStatus
 natsLib_msgDeliveryPostControlMsg(natsSubscription *sub)
 {
@@ -1888,15 +2662,15 @@ natsLib_msgDeliveryPostControlMsg(natsSubscription *sub)
 
         controlMsg->sub = sub;
 
-        l = &(worker->msgList);
+        l = &(sub->msgList);
         if (l->tail != NULL)
             l->tail->next = controlMsg;
         if (l->head == NULL)
             l->head = controlMsg;
         l->tail = controlMsg;
 
-        if (worker->inWait)
-            natsCondition_Signal(worker->cond);
+        // This is invoked with locks held, so the pool can't grow here.
+        (void) natsLib_msgDeliveryReady(worker, sub);
 
         natsMutex_Unlock(worker->lock);
     }
@@ -1921,28 +2695,19 @@ natsLib_msgDeliveryAssignWorker(natsSubscription *sub)
     worker = workers->workers[workers->idx];
     if (worker == NULL)
     {
-        worker = NATS_CALLOC(1, sizeof(natsMsgDlvWorker));
-        if (worker == NULL)
-            s = nats_setDefaultError(NATS_NO_MEMORY);
-        if (s == NATS_OK)
-            s = natsMutex_Create(&worker->lock);
-        if (s == NATS_OK)
-            s = natsCondition_Create(&worker->cond);
-        if (s == NATS_OK)
-        {
-            natsLib_Retain();
-            s = natsThread_Create(&worker->thread, _deliverMsgs, (void*) worker);
-            if (s != NATS_OK)
-                natsLib_Release();
-        }
+        s = _createDlvWorker(&worker);
         if (s == NATS_OK)
         {
-            workers->workers[workers->idx] = worker;
-            workers->size++;
-        }
-        else
-        {
-            _freeDlvWorker(worker);
+            s = _startDlvWorkerThread(worker);
+            if (s == NATS_OK)
+            {
+                workers->workers[workers->idx] = worker;
+                workers->size++;
+            }
+            else
+            {
+                _freeDlvWorker(worker);
+            }
         }
     }
     if (s == NATS_OK)
@@ -1981,3 +2746,14 @@ natsLib_getMsgDeliveryPoolInfo(int *maxSize, int *size, int *idx, natsMsgDlvWork
     *workersArray = workers->workers;
     natsMutex_Unlock(workers->lock);
 }
+
+void
+natsLib_getMsgDeliveryPoolThreads(int *threads, int *idle)
+{
+    natsLibDlvWorkers *workers = &gLib.dlvWorkers;
+
+    natsMutex_Lock(workers->lock);
+    *threads = workers->threads;
+    *idle    = nats_atomicGet(&(workers->idle));
+    natsMutex_Unlock(workers->lock);
+}
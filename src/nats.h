@@ -121,6 +121,13 @@ typedef struct __natsSubscription   natsSubscription;
  */
 typedef struct __natsMsg            natsMsg;
 
+/** \brief A request sent with #natsConnection_RequestAsync.
+ *
+ * A #natsRequest allows the application to cancel an asynchronous request
+ * that has not completed yet.
+ */
+typedef struct __natsRequest        natsRequest;
+
 /** \brief Way to configure a #natsConnection.
  *
  * Options can be used to create a customized #natsConnection.
@@ -136,6 +143,28 @@ typedef struct __natsOptions        natsOptions;
  */
 typedef char                        natsInbox;
 
+/** \brief Policy used to decide when buffered outbound data is flushed.
+ *
+ * Defines how the connection's flusher, which sends data that has been
+ * published asynchronously, decides when to write the buffered data to the
+ * socket.
+ *
+ * @see natsOptions_SetFlushPolicy()
+ */
+typedef enum
+{
+    NATS_FLUSH_POLICY_DEFAULT = 0,      ///< The flusher waits up to 1 millisecond
+                                        ///  to accumulate data before flushing.
+    NATS_FLUSH_POLICY_LATENCY,          ///< The flusher flushes as soon as it is signaled.
+    NATS_FLUSH_POLICY_THROUGHPUT,       ///< The flusher waits until a given number of bytes
+                                        ///  are pending, or a given delay has elapsed.
+    NATS_FLUSH_POLICY_ADAPTIVE,         ///< Based on the recent publish rate, the flusher
+                                        ///  flushes right away when the rate is low, or
+                                        ///  behaves as #NATS_FLUSH_POLICY_THROUGHPUT when
+                                        ///  more data is expected to arrive within the delay.
+
+} natsFlushPolicy;
+
 #if defined(NATS_HAS_STREAMING)
 /** \brief A connection to a `NATS Streaming Server`.
  *
@@ -199,6 +228,97 @@ typedef struct __stanSubOptions     stanSubOptions;
 typedef void (*natsMsgHandler)(
         natsConnection *nc, natsSubscription *sub, natsMsg *msg, void *closure);
 
+/** \brief Callback used to deliver messages in batches to the application.
+ *
+ * This is the callback that one provides when creating an asynchronous
+ * subscription with #natsConnection_SubscribeBatch. The library invokes
+ * this callback with up to the subscription's maximum batch size of
+ * messages, in the order they were received.
+ *
+ * The messages belong to the application, which needs to call
+ * #natsMsg_Destroy for each of them. The array itself is owned by the
+ * library and is valid only for the duration of the callback.
+ *
+ * @see natsConnection_SubscribeBatch()
+ */
+typedef void (*natsMsgBatchHandler)(
+        natsConnection *nc, natsSubscription *sub, natsMsg **msgs, int count, void *closure);
+
+/** \brief Callback used to complete asynchronous requests.
+ *
+ * This is the callback that one provides when sending a request with
+ * #natsConnection_RequestAsync. It is invoked once with either the reply
+ * and a `NATS_OK` status, or a `NULL` reply and the error: `NATS_TIMEOUT`,
+ * `NATS_NO_RESPONDERS`, or `NATS_CONNECTION_CLOSED` (or
+ * `NATS_CONNECTION_DISCONNECTED`, see #natsOptions_SetFailRequestsOnDisconnect).
+ *
+ * The reply belongs to the application, which needs to call #natsMsg_Destroy.
+ *
+ * For requests sent with #natsConnection_RequestManyAsync, the callback is
+ * invoked with each reply and a `NATS_OK` status, and then one last time
+ * with a `NULL` reply (see #natsConnection_RequestManyAsync for the status).
+ *
+ * \note The callback is invoked from a library thread that completes other
+ * requests too, so it should not block.
+ *
+ * @see natsConnection_RequestAsync()
+ * @see natsConnection_RequestManyAsync()
+ */
+typedef void (*natsReplyHandler)(
+        natsConnection *nc, natsMsg *reply, natsStatus status, void *closure);
+
+/** \brief Callback used to give back a buffer passed to the library.
+ *
+ * This is the callback that one provides when publishing with
+ * #natsConnection_PublishZeroCopy. It is invoked exactly once per call,
+ * when the library, and the operating system, no longer reference the
+ * data: only then can the application modify or free it.
+ *
+ * \note The callback may be invoked from the publishing thread (before
+ * #natsConnection_PublishZeroCopy returns), from a library thread, or from
+ * the thread closing the connection. It should not block.
+ *
+ * @see natsConnection_PublishZeroCopy()
+ */
+typedef void (*natsBufferReleaseHandler)(
+        natsConnection *nc, const void *data, int dataLen, void *closure);
+
+/** \brief Callback used to compute the partition key of a message.
+ *
+ * This is the callback that one can provide in #natsSubPartitionOptions
+ * when creating a subscription with #natsConnection_SubscribePartitioned.
+ * Messages with the same key are delivered, in order, by the same thread.
+ *
+ * The callback is invoked from the connection's reader thread before the
+ * message is handed to the application, so it should return quickly and
+ * must not destroy the message.
+ *
+ * @see natsConnection_SubscribePartitioned()
+ */
+typedef uint32_t (*natsMsgPartitionKeyHandler)(natsMsg *msg, void *closure);
+
+/** \brief Options of a partitioned subscription.
+ *
+ * Use #natsSubPartitionOptions_Init to initialize the structure before
+ * setting the fields of interest. The partition key is computed by, in
+ * order of precedence, `KeyCb`, the value of the header `Header`, the
+ * subject token at `SubjectToken`, or the whole subject. A message without
+ * the header or token has an empty key.
+ *
+ * @see natsConnection_SubscribePartitioned()
+ */
+typedef struct natsSubPartitionOptions
+{
+    int                         Partitions;         ///< Number of partitions, that is, of delivery threads.
+    natsMsgPartitionKeyHandler  KeyCb;              ///< Callback returning the partition key of a message.
+    void                        *KeyCbClosure;      ///< Closure passed to `KeyCb`.
+    const char                  *Header;            ///< Name of the header whose value is the key.
+    int                         SubjectToken;       ///< 1-based index of the subject token that is the key.
+    int                         PendingMsgsLimit;   ///< Pending messages limit of each partition (0 for the connection's default).
+    int                         PendingBytesLimit;  ///< Pending bytes limit of each partition (0 for the default).
+
+} natsSubPartitionOptions;
+
 /** \brief Callback used to notify the user of asynchronous connection events.
  *
  * This callback is used for asynchronous events such as disconnected
@@ -581,16 +701,21 @@ nats_PrintLastErrorStack(FILE *file);
  * lazily initialized, that is, no thread is used as long as no subscriber
  * (requiring global message delivery) is created.
  *
- * Each subscriber will be attached to a given worker on the pool so that
- * message delivery order is guaranteed.
+ * Each subscriber is attached to a given worker on the pool, whose thread
+ * delivers its messages first. When a thread is idle, it steals subscribers
+ * with pending messages from busy workers. Messages of a given subscriber are
+ * always delivered in order, by one thread at a time.
  *
- * This call allows you to set the maximum size of the pool.
+ * This call allows you to set the maximum size of the pool. When all threads
+ * are busy and subscribers have pending messages, the pool starts new threads,
+ * up to this size.
  *
- * \note At this time, a pool does not shrink, but the caller will not get
- * an error when calling this function with a size smaller than the current
- * size.
+ * \note The caller will not get an error when calling this function with a
+ * size smaller than the current size, but the maximum size is not reduced.
+ * See #nats_SetMessageDeliveryPoolLimits to have the pool shrink.
  *
  * @see natsOptions_UseGlobalMessageDelivery()
+ * @see nats_SetMessageDeliveryPoolLimits()
  * @see \ref envVariablesGroup
  *
  * @param max the maximum size of the pool.
@@ -598,6 +723,44 @@ nats_PrintLastErrorStack(FILE *file);
 NATS_EXTERN natsStatus
 nats_SetMessageDeliveryPoolSize(int max);
 
+/** \brief Sets the limits of the global message delivery thread pool.
+ *
+ * Same as #nats_SetMessageDeliveryPoolSize, but also lets the pool shrink:
+ * when `idleTimeout` is not `0`, a thread that has been idle for that long
+ * exits, unless the pool has `minSize` threads (or a single thread) left.
+ * The pool grows again, up to `maxSize`, when subscribers have pending
+ * messages while all threads are busy.
+ *
+ * \note The maximum size of the pool is not reduced if `maxSize` is smaller
+ * than the current maximum size.
+ *
+ * @see nats_SetMessageDeliveryPoolSize()
+ *
+ * @param minSize the number of threads that are kept when idle.
+ * @param maxSize the maximum size of the pool.
+ * @param idleTimeout the time, in milliseconds, after which an idle thread
+ * exits, or `0` to keep the threads.
+ */
+NATS_EXTERN natsStatus
+nats_SetMessageDeliveryPoolLimits(int minSize, int maxSize, int64_t idleTimeout);
+
+/** \brief Sets the number of threads of the library's I/O engine.
+ *
+ * Connections created with #natsOptions_UseIOEngine are multiplexed over
+ * the I/O engine's threads, each polling the sockets of the connections
+ * assigned to it. Threads are started as connections are created, up to
+ * this number, and a new connection is assigned to the thread with the
+ * fewest connections. The default is `1`.
+ *
+ * \note Lowering this number does not stop threads already started.
+ *
+ * @see natsOptions_UseIOEngine()
+ *
+ * @param count the maximum number of I/O threads.
+ */
+NATS_EXTERN natsStatus
+nats_SetIOEngineThreads(int count);
+
 /** \brief Release thread-local memory possibly allocated by the library.
  *
  * This needs to be called on user-created threads where NATS calls are
@@ -611,6 +774,49 @@ nats_SetMessageDeliveryPoolSize(int max);
 NATS_EXTERN void
 nats_ReleaseThreadMemory(void);
 
+/** \brief Returns counts related to the deferred destruction of objects.
+ *
+ * Objects such as messages that are destroyed from a library thread (for
+ * instance in a message callback) are not freed right away. Instead, they
+ * are queued in a per-thread batch. When the batch is full, it is handed
+ * off to the library's garbage collector thread. When the thread becomes
+ * idle, it frees the batch itself. Objects destroyed from user threads are
+ * freed directly and are not counted.
+ *
+ * \note You can pass `NULL` to any of the count your are not interested in
+ * getting.
+ *
+ * @param queued the total number of objects that have been queued.
+ * @param handedOff the number of queued objects freed by the garbage
+ * collector thread.
+ * @param freedLocally the number of queued objects freed by the thread
+ * that destroyed them.
+ */
+NATS_EXTERN natsStatus
+nats_GetGCCounts(uint64_t *queued, uint64_t *handedOff, uint64_t *freedLocally);
+
+/** \brief Returns statistics about the library's timers.
+ *
+ * The library uses timers for, among other things, pings, subscriptions
+ * created with #natsConnection_SubscribeTimeout and asynchronous requests.
+ * They are fired by a single library thread.
+ *
+ * The lag is the time between when a timer should have fired and when its
+ * callback was actually invoked. A growing lag indicates that the timer
+ * thread can't keep up, for instance because a callback takes too long.
+ *
+ * \note You can pass `NULL` to any of the value your are not interested in
+ * getting.
+ *
+ * @param count the number of timers currently active.
+ * @param fired the total number of times a timer callback was invoked.
+ * @param totalLag the sum, in milliseconds, of the lag of all the fired
+ * timers. Divide by `fired` to get the average lag.
+ * @param maxLag the maximum lag, in milliseconds.
+ */
+NATS_EXTERN natsStatus
+nats_GetTimerStats(int *count, uint64_t *fired, int64_t *totalLag, int64_t *maxLag);
+
 /** \brief Signs a given text using the provided private key.
  *
  * The key is the encoded string representation of the private key, or seed.
@@ -776,6 +982,76 @@ natsStatistics_GetCounts(const natsStatistics *stats,
                          uint64_t *outMsgs, uint64_t *outBytes,
                          uint64_t *reconnects);
 
+/** \brief Extracts the statistics related to the flusher.
+ *
+ * Gets the counts related to the flushes performed by the connection's
+ * flusher. This can be used to verify the effect of the flush policy.
+ *
+ * \note You can pass `NULL` to any of the count your are not interested in
+ * getting.
+ *
+ * @see natsOptions_SetFlushPolicy()
+ * @see natsConnection_GetStats()
+ *
+ * @param stats the pointer to the #natsStatistics object to get the values from.
+ * @param flushes total number of flushes performed by the flusher.
+ * @param flushedBytes total number of bytes sent by those flushes. Divide by
+ * `flushes` to get the average number of bytes per flush.
+ * @param flushTime total time, in microseconds, between the moment the flusher
+ * was signaled and the moment the data was flushed. Divide by `flushes` to get
+ * the average time-to-flush.
+ * @param maxFlushTime the longest time-to-flush, in microseconds.
+ */
+NATS_EXTERN natsStatus
+natsStatistics_GetFlushCounts(const natsStatistics *stats,
+                              uint64_t *flushes, uint64_t *flushedBytes,
+                              uint64_t *flushTime, uint64_t *maxFlushTime);
+
+/** \brief Extracts the statistics related to the message pool.
+ *
+ * Gets the number of inbound messages that have been allocated from
+ * the connection's message pool (hits) and the number of messages that
+ * required a new memory allocation (misses).
+ *
+ * \note You can pass `NULL` to any of the count your are not interested in
+ * getting.
+ *
+ * @see natsOptions_UseMessagePool()
+ * @see natsConnection_GetStats()
+ *
+ * @param stats the pointer to the #natsStatistics object to get the values from.
+ * @param hits number of messages whose memory was reused from the pool.
+ * @param misses number of messages that needed a new memory allocation.
+ */
+NATS_EXTERN natsStatus
+natsStatistics_GetMsgPoolCounts(const natsStatistics *stats,
+                                uint64_t *hits, uint64_t *misses);
+
+/** \brief Extracts the statistics related to TLS session resumption.
+ *
+ * Gets the number of TLS handshakes that resumed a session from a previous
+ * connection to the same server (hits), which is much cheaper for both the
+ * client and the server, and the number of full handshakes (misses),
+ * including the first connection to each server.
+ *
+ * Sessions are cached per server URL and shared by the connections created
+ * from the same #natsOptions. A cached session is accepted only if the
+ * server still has it, or the keys of its session tickets: a server that
+ * restarted typically requires a full handshake.
+ *
+ * \note You can pass `NULL` to any of the count your are not interested in
+ * getting.
+ *
+ * @see natsConnection_GetStats()
+ *
+ * @param stats the pointer to the #natsStatistics object to get the values from.
+ * @param hits number of handshakes that resumed a cached session.
+ * @param misses number of full handshakes.
+ */
+NATS_EXTERN natsStatus
+natsStatistics_GetTLSSessionCounts(const natsStatistics *stats,
+                                   uint64_t *hits, uint64_t *misses);
+
 /** \brief Destroys the #natsStatistics object.
  *
  * Destroys the statistics object, freeing up memory.
@@ -985,6 +1261,33 @@ natsOptions_SetName(natsOptions *opts, const char *name);
 NATS_EXTERN natsStatus
 natsOptions_SetSecure(natsOptions *opts, bool secure);
 
+/** \brief Offloads TLS record processing to the kernel.
+ *
+ * If set to `true`, the library asks OpenSSL to hand the keys negotiated
+ * during the TLS handshake to the kernel (kTLS), which then encrypts and
+ * decrypts the records. Reads and writes still go through OpenSSL, but
+ * are passed to the socket in plaintext, which avoids the copies and the
+ * userspace crypto, and makes TLS throughput closer to plaintext.
+ *
+ * This requires Linux with the `tls` kernel module, OpenSSL 3 built with
+ * kTLS support, and a cipher supported by the kernel (AES-GCM for
+ * instance). Otherwise, or if the kernel can't offload one direction,
+ * the connection simply uses regular TLS for that direction. Use
+ * #natsConnection_GetKernelTLS to know if offload actually engaged.
+ *
+ * The default is `false`.
+ *
+ * \note Returns #NATS_NOT_PERMITTED when trying to enable it with an
+ * OpenSSL version that does not support kernel TLS.
+ *
+ * @see natsConnection_GetKernelTLS()
+ *
+ * @param opts the pointer to the #natsOptions object.
+ * @param use `true` to try to offload TLS to the kernel, `false` otherwise.
+ */
+NATS_EXTERN natsStatus
+natsOptions_UseKernelTLS(natsOptions *opts, bool use);
+
 /** \brief Loads the trusted CA certificates from a file.
  *
  * Loads the trusted CA certificates from a file.
@@ -1449,6 +1752,31 @@ natsOptions_SetEventLoop(natsOptions *opts,
                          natsEvLoop_WriteAddRemove  writeCb,
                          natsEvLoop_Detach          detachCb);
 
+/** \brief Switch on/off the use of the library's I/O engine.
+ *
+ * Normally, each connection has its own thread reading from the socket.
+ * When this option is set, the connection is instead attached to an event
+ * loop built into the library: a small number of threads (see
+ * #nats_SetIOEngineThreads) poll the sockets of all the connections using
+ * it, and read and write on their behalf. This does not require any
+ * external event library.
+ *
+ * The engine is set as the event loop of these options, so this replaces
+ * any event loop set with #natsOptions_SetEventLoop (and the other way
+ * around).
+ *
+ * \note This is currently only supported on Linux, an error is returned
+ * on other platforms.
+ *
+ * @see nats_SetIOEngineThreads()
+ *
+ * @param opts the pointer to the #natsOptions object.
+ * @param use if `true`, the connection uses the I/O engine, otherwise, it
+ * uses its own thread to read from the socket.
+ */
+NATS_EXTERN natsStatus
+natsOptions_UseIOEngine(natsOptions *opts, bool use);
+
 /** \brief Switch on/off the use of a central message delivery thread pool.
  *
  * Normally, each asynchronous subscriber that is created has its own
@@ -1499,6 +1827,38 @@ natsOptions_UseGlobalMessageDelivery(natsOptions *opts, bool global);
 NATS_EXTERN natsStatus
 natsOptions_IPResolutionOrder(natsOptions *opts, int order);
 
+/** \brief Races connection attempts instead of trying addresses one by one.
+ *
+ * By default, the library tries each address a server host name resolves to
+ * (see #natsOptions_IPResolutionOrder), then each server of the list, one
+ * after the other. An address that does not respond may then delay the
+ * connection by as much as the connect timeout.
+ *
+ * With this option, the library starts a TCP connection attempt to the next
+ * address every `delay` milliseconds, or as soon as the previous attempt
+ * fails, without waiting for the pending attempts to complete. The first
+ * attempt to succeed is used, and the others are abandoned. This is similar
+ * to the "Happy Eyeballs" algorithm (RFC 8305): the attempts alternate
+ * between IPv4 and IPv6 addresses.
+ *
+ * On initial connect, the attempts also race across the first `servers`
+ * servers of the list (in the order they would be tried), alternating
+ * between them. On reconnect, only the addresses of the selected server
+ * race each other.
+ *
+ * \note Only the TCP connection is raced. The TLS handshake, if any, and
+ * the rest of the connection process happen on the winning connection.
+ * If those fail, the library moves to the next server as usual.
+ *
+ * @param opts the pointer to the #natsOptions object.
+ * @param delay the time, in milliseconds, between the start of two
+ * attempts, or `0` to disable racing (the default).
+ * @param servers the number of servers that race on initial connect,
+ * `1` to race only across the addresses of a server.
+ */
+NATS_EXTERN natsStatus
+natsOptions_SetRacingConnect(natsOptions *opts, int64_t delay, int servers);
+
 /** \brief Sets if Publish calls should send data right away.
  *
  * For throughput performance, the client library tries by default to buffer
@@ -1529,6 +1889,166 @@ natsOptions_IPResolutionOrder(natsOptions *opts, int order);
 NATS_EXTERN natsStatus
 natsOptions_SetSendAsap(natsOptions *opts, bool sendAsap);
 
+/** \brief Sets the policy used by the flusher.
+ *
+ * When data is published asynchronously (that is, when the #natsOptions_SetSendAsap
+ * option is not set), the data is buffered and a flusher thread is signaled
+ * to send the data to the server. This option controls how long the flusher
+ * waits to accumulate more data before flushing.
+ *
+ * - #NATS_FLUSH_POLICY_DEFAULT: the flusher waits up to 1 millisecond. The
+ *   `maxBytes` and `maxDelay` parameters are ignored.
+ * - #NATS_FLUSH_POLICY_LATENCY: the flusher flushes right away. The `maxBytes`
+ *   and `maxDelay` parameters are ignored.
+ * - #NATS_FLUSH_POLICY_THROUGHPUT: the flusher waits until at least `maxBytes`
+ *   are buffered, or `maxDelay` microseconds have elapsed since it was signaled.
+ * - #NATS_FLUSH_POLICY_ADAPTIVE: the flusher tracks the recent publish rate.
+ *   If less than two messages are expected to be published within `maxDelay`
+ *   microseconds, it flushes right away, otherwise it behaves as with the
+ *   #NATS_FLUSH_POLICY_THROUGHPUT policy.
+ *
+ * If `maxBytes` is `0`, the size of the buffered data is not considered.
+ * For the throughput and adaptive policies, `maxDelay` must be positive.
+ *
+ * \note The precision of the wait depends on the platform. On Windows,
+ * the delay is rounded up to the next millisecond.
+ *
+ * @see natsStatistics_GetFlushCounts()
+ *
+ * @param opts the pointer to the #natsOptions object.
+ * @param policy the #natsFlushPolicy to use.
+ * @param maxBytes the number of buffered bytes after which the flusher flushes.
+ * @param maxDelay the maximum time, in microseconds, the flusher waits before flushing.
+ */
+NATS_EXTERN natsStatus
+natsOptions_SetFlushPolicy(natsOptions *opts, natsFlushPolicy policy,
+                           int maxBytes, int64_t maxDelay);
+
+/** \brief Enables zero-copy of inbound messages.
+ *
+ * By default, each message received by the library is allocated with
+ * its own copy of the subject, reply and payload. When this option is
+ * enabled, the library reads data from the socket into reference counted
+ * blocks of the size set by #natsOptions_SetIOBufSize, and messages point
+ * directly into those blocks. A block is freed when the last message
+ * referencing it is destroyed.
+ *
+ * Messages that have headers, or that are split across two socket reads,
+ * are still copied.
+ *
+ * \note Since a single message keeps the whole block alive, applications
+ * that hold on to a small number of messages for a long period of time
+ * may see a higher memory usage with this option.
+ *
+ * \note This option has no effect when using an external event loop.
+ *
+ * @param opts the pointer to the #natsOptions object.
+ * @param zeroCopy a boolean indicating if inbound messages should reference
+ * the read buffers instead of being copied.
+ */
+NATS_EXTERN natsStatus
+natsOptions_SetInboundZeroCopy(natsOptions *opts, bool zeroCopy);
+
+/** \brief Allocates inbound messages from a per-connection pool.
+ *
+ * By default, the memory of each message received by the library is
+ * allocated when the message is created and freed when the message is
+ * destroyed. When this option is enabled, messages are allocated from a
+ * pool owned by the connection, with size classes from 256 bytes to 8KB.
+ * When a message is destroyed, its memory is cached by the destroying
+ * thread and returned to the pool in batches, so that in steady state,
+ * receiving messages does not require any memory allocation.
+ *
+ * Larger messages are allocated and freed as usual.
+ *
+ * \note The pool keeps up to 1024 free messages per size class. Memory
+ * cached by a thread is returned when that thread exits or calls
+ * #nats_ReleaseThreadMemory.
+ *
+ * @see natsStatistics_GetMsgPoolCounts()
+ *
+ * @param opts the pointer to the #natsOptions object.
+ * @param useMsgPool a boolean indicating if inbound messages should be
+ * allocated from a pool.
+ */
+NATS_EXTERN natsStatus
+natsOptions_UseMessagePool(natsOptions *opts, bool useMsgPool);
+
+/** \brief Uses a lock-free queue for pending messages of asynchronous subscriptions.
+ *
+ * By default, messages waiting to be delivered to an asynchronous
+ * subscription's callback are kept in a list protected by the
+ * subscription's lock, which both the connection's reader thread and the
+ * subscription's delivery thread need to acquire for each message.
+ *
+ * When this option is enabled, asynchronous subscriptions that have their
+ * own delivery thread use a single-producer/single-consumer ring
+ * instead. The reader thread adds messages without locking, and only
+ * signals the delivery thread when it is waiting for messages.
+ *
+ * The ring starts with room for a few messages and grows as messages
+ * accumulate, up to the pending messages limit at the time the subscription
+ * is created (see #natsOptions_SetMaxPendingMsgs). The number of pending
+ * messages is still bounded by the subscription's limits, which can be
+ * changed with #natsSubscription_SetPendingLimits.
+ *
+ * \note This option has no effect for synchronous subscriptions, or if
+ * the library's delivery pool is used (see #natsOptions_UseGlobalMessageDelivery).
+ *
+ * @param opts the pointer to the #natsOptions object.
+ * @param lockFree a boolean indicating if the lock-free queue should be used.
+ */
+NATS_EXTERN natsStatus
+natsOptions_UseLockFreeDelivery(natsOptions *opts, bool lockFree);
+
+/** \brief Handles responses to requests in the connection's reader thread.
+ *
+ * By default, responses to requests (see #natsConnection_Request and
+ * #natsConnection_RequestAsync) are added to the pending list of the
+ * connection's response subscription. Its delivery thread then finds the
+ * request and wakes up the requestor, or invokes the #natsReplyHandler.
+ *
+ * When this option is enabled, the connection's reader thread does this
+ * directly, which saves a thread handoff per request and reduces latency.
+ *
+ * \warning The #natsReplyHandler of asynchronous requests is then invoked
+ * from the reader thread: no message is read from the connection until the
+ * handler returns, so it must not block, and in particular must not wait
+ * for the reply of another request.
+ *
+ * \note This option has no effect when using old request style (see
+ * #natsOptions_UseOldRequestStyle) with #natsConnection_Request.
+ *
+ * @param opts the pointer to the #natsOptions object.
+ * @param inlineResponses a boolean indicating if responses should be handled
+ * in the reader thread.
+ */
+NATS_EXTERN natsStatus
+natsOptions_UseInlineResponses(natsOptions *opts, bool inlineResponses);
+
+/** \brief Sets the payload size from which publishing can avoid copying the data.
+ *
+ * Payloads of at least `threshold` bytes published with
+ * #natsConnection_PublishZeroCopy are sent directly from the application's
+ * buffer with `MSG_ZEROCOPY`, instead of being copied into the socket's
+ * buffers. The completion of those sends is reported asynchronously by
+ * the kernel. The library collects it when publishing, and polls for it
+ * while sends are pending, every millisecond at first, then backing off up
+ * to every 100 milliseconds when completions are slow to come.
+ *
+ * This is supported on Linux only (kernel 4.14 and above), and not with
+ * TLS or an external event loop. Otherwise, the data is copied.
+ *
+ * The default is `0`, which disables zero copy sends.
+ *
+ * @see natsConnection_PublishZeroCopy()
+ *
+ * @param opts the pointer to the #natsOptions object.
+ * @param threshold the minimum payload size, in bytes, or `0` to disable.
+ */
+NATS_EXTERN natsStatus
+natsOptions_SetZeroCopyThreshold(natsOptions *opts, int threshold);
+
 /** \brief Switches the use of old style requests.
  *
  * Setting `useOldStyle` to `true` forces the request calls to use the original
@@ -2974,6 +3494,27 @@ natsConnection_HasHeaderSupport(natsConnection *nc);
 natsStatus
 natsConnection_GetLocalIPAndPort(natsConnection *nc, char **ip, int *port);
 
+/** \brief Returns if TLS is offloaded to the kernel.
+ *
+ * When the connection was created with #natsOptions_UseKernelTLS, indicates
+ * if the kernel does the encryption of the records sent (`send`) and the
+ * decryption of the records received (`recv`) for the current TLS session.
+ * Both are `false` if the connection does not use TLS or the offload did
+ * not engage. This is checked after each (re)connect.
+ *
+ * @see natsOptions_UseKernelTLS()
+ *
+ * @param nc the pointer of the #natsConnection object.
+ * @param send the memory location where to store if sending is offloaded.
+ * @param recv the memory location where to store if receiving is offloaded.
+ *
+ * @return #NATS_OK on success.
+ * @return #NATS_CONNECTION_DISCONNECTED if disconnected.
+ * @return #NATS_CONNECTION_CLOSED is connection is closed.
+ */
+NATS_EXTERN natsStatus
+natsConnection_GetKernelTLS(natsConnection *nc, bool *send, bool *recv);
+
 /** \brief Closes the connection.
  *
  * Closes the connection to the server. This call will release all blocking
@@ -3041,6 +3582,10 @@ natsConnection_PublishString(natsConnection *nc, const char *subj,
  * Publishes the #natsMsg, which includes the subject, an optional reply and
  * optional data.
  *
+ * Large payloads are not copied into the connection's buffer: the message is
+ * kept until its payload has been sent. It is still safe to destroy the
+ * message as soon as this call returns, it is freed once no longer needed.
+ *
  * @see #natsMsg_Create()
  *
  * @param nc the pointer to the #natsConnection object.
@@ -3085,6 +3630,89 @@ NATS_EXTERN natsStatus
 natsConnection_PublishRequestString(natsConnection *nc, const char *subj,
                                     const char *reply, const char *str);
 
+/** \brief Publishes data on a subject without copying it.
+ *
+ * Same than #natsConnection_Publish, except that, if the size of the data
+ * is at least the threshold set with #natsOptions_SetZeroCopyThreshold,
+ * the data is handed to the operating system without being copied
+ * (`MSG_ZEROCOPY`). The application then must not modify or free the data
+ * until `releaseCb` is invoked.
+ *
+ * The data is copied as usual, and `releaseCb` invoked before this call
+ * returns, when it is below the threshold, when the platform or socket
+ * does not support zero copy sends, with TLS or an external event loop,
+ * while the connection is reconnecting, or if the call fails.
+ *
+ * When the connection is closed, or disconnected, the library waits for up
+ * to 500 milliseconds for the kernel to be done with the sends still
+ * pending, which happens once the server has acknowledged the data. The
+ * socket is then closed, discarding what may not have been sent yet (and
+ * the kernel's references to the data), and the remaining callbacks are
+ * invoked. In that case, the data may not have been received by the server.
+ *
+ * \note Zero copy sends have a cost of their own (pinning the pages and
+ * notifying completion), and are worth it only for large payloads, in
+ * the order of 10KB and above.
+ *
+ * @see natsOptions_SetZeroCopyThreshold()
+ *
+ * @param nc the pointer to the #natsConnection object.
+ * @param subj the subject the data is sent to.
+ * @param data the data to be sent, can be `NULL`.
+ * @param dataLen the length of the data to be sent.
+ * @param releaseCb the callback invoked when the data is no longer referenced.
+ * @param closure a pointer to a user defined object (can be `NULL`) passed
+ * to the callback.
+ */
+NATS_EXTERN natsStatus
+natsConnection_PublishZeroCopy(natsConnection *nc, const char *subj,
+                               const void *data, int dataLen,
+                               natsBufferReleaseHandler releaseCb, void *closure);
+
+/** \brief Publishes an array of messages.
+ *
+ * Publishes the given messages, in order, with a single acquisition of the
+ * connection's lock and a single signal to the flusher. This reduces the
+ * per-message overhead compared to calling #natsConnection_PublishMsg for
+ * each message, which matters mostly for small payloads.
+ *
+ * A failure to publish one message does not prevent the others from being
+ * published. If `errors` is not `NULL`, it must point to an array of at
+ * least `count` elements, and the status of each message will be stored at
+ * the corresponding index.
+ *
+ * @param nc the pointer to the #natsConnection object.
+ * @param msgs the array of pointers to the #natsMsg objects to send.
+ * @param count the number of messages in the array.
+ * @param errors the location where to store the status of each message, can be `NULL`.
+ *
+ * @return #NATS_OK if all messages were published, otherwise the status of
+ * the first message that could not be published.
+ */
+NATS_EXTERN natsStatus
+natsConnection_PublishBatch(natsConnection *nc, natsMsg **msgs, int count,
+                            natsStatus *errors);
+
+/** \brief Publishes an array of data on an array of subjects.
+ *
+ * Similar to #natsConnection_PublishBatch but messages are described by
+ * the subject, data and data length found at the same index in the
+ * respective arrays.
+ *
+ * @see natsConnection_PublishBatch
+ *
+ * @param nc the pointer to the #natsConnection object.
+ * @param subjects the array of subjects the data are sent to.
+ * @param data the array of data to be sent, can be `NULL`.
+ * @param dataLen the array of data lengths, can be `NULL` only if `data` is `NULL`.
+ * @param count the number of elements in the arrays.
+ * @param errors the location where to store the status of each message, can be `NULL`.
+ */
+NATS_EXTERN natsStatus
+natsConnection_PublishBatchData(natsConnection *nc, const char **subjects,
+                                const void **data, const int *dataLen,
+                                int count, natsStatus *errors);
+
 /** \brief Sends a request and waits for a reply.
  *
  * Sends a request payload and delivers the first response message,
@@ -3150,6 +3778,179 @@ NATS_EXTERN natsStatus
 natsConnection_RequestMsg(natsMsg **replyMsg, natsConnection *nc,
                           natsMsg *requestMsg, int64_t timeout);
 
+/** \brief Sends a request and waits for multiple replies.
+ *
+ * Sends the request based on the given `requestMsg` and collects the
+ * replies, for instance from all the instances of a service listening on
+ * the subject without a queue group. This call returns when any of these
+ * occurs:
+ *
+ * - `maxReplies` replies have been received (if `maxReplies` is positive).
+ * - the `timeout` expires.
+ * - `stallTimeout` is positive and no new reply has been received for that
+ * long after the previous one. This allows returning as soon as all the
+ * responders have replied, without knowing how many there are.
+ *
+ * The replies are received through the connection's shared response
+ * subscription, even if #natsOptions_UseOldRequestStyle is set.
+ *
+ * On success, `replies` is set to an array of `count` messages, with
+ * `count` being at least 1. The application needs to destroy each message
+ * with #natsMsg_Destroy and then free the array with `free()`.
+ *
+ * \code{.c}
+ * natsMsg **replies = NULL;
+ * int     count     = 0;
+ * int     i;
+ *
+ * s = natsConnection_RequestMany(&replies, &count, nc, msg, 0, 1000, 50);
+ * if (s == NATS_OK)
+ * {
+ *     for (i=0; i<count; i++)
+ *     {
+ *         // Do something with the reply...
+ *         natsMsg_Destroy(replies[i]);
+ *     }
+ *     free(replies);
+ * }
+ * \endcode
+ *
+ * @param replies the location where to store the pointer to the array of
+ * received #natsMsg replies.
+ * @param count the location where to store the number of replies.
+ * @param nc the pointer to the #natsConnection object.
+ * @param requestMsg the message used for the request.
+ * @param maxReplies the number of replies after which this call returns,
+ * or `0` for no limit.
+ * @param timeout in milliseconds, after which this call returns. Must be
+ * positive. If no reply was received by then, #NATS_TIMEOUT is returned.
+ * @param stallTimeout in milliseconds, the maximum time to wait for the
+ * next reply once one has been received, or `0` to always wait for the
+ * `timeout`.
+ *
+ * @return #NATS_OK if at least one reply was received, #NATS_TIMEOUT if
+ * none was, #NATS_NO_RESPONDERS if the server reported that there was no
+ * responder, or the error that caused the connection to be closed.
+ */
+NATS_EXTERN natsStatus
+natsConnection_RequestMany(natsMsg ***replies, int *count, natsConnection *nc,
+                           natsMsg *requestMsg, int maxReplies, int64_t timeout,
+                           int64_t stallTimeout);
+
+/** \brief Sends a request and invokes a callback with the reply.
+ *
+ * Similar to #natsConnection_Request, but this call does not wait for the
+ * reply. The `cb` callback is invoked once, with the reply or an error
+ * (see #natsReplyHandler), unless the request is cancelled with
+ * #natsRequest_Cancel. This allows a single thread to have any number of
+ * requests in flight.
+ *
+ * Replies are received through the connection's shared response
+ * subscription, even if #natsOptions_UseOldRequestStyle is set.
+ *
+ * If `req` is not `NULL`, it is set to a #natsRequest object that can be
+ * used to cancel the request, and that needs to be destroyed with
+ * #natsRequest_Destroy. If this call returns an error, the callback is
+ * not invoked.
+ *
+ * @param req the location where to store the pointer to the #natsRequest
+ * object, can be `NULL`.
+ * @param nc the pointer to the #natsConnection object.
+ * @param subj the subject the request is sent to.
+ * @param data the data of the request, can be `NULL`.
+ * @param dataLen the length of the data to send.
+ * @param timeout in milliseconds, after which the callback is invoked with
+ * #NATS_TIMEOUT if no reply was received. Must be positive.
+ * @param cb the #natsReplyHandler callback.
+ * @param closure a pointer to an user defined object (can be `NULL`). See
+ * the #natsReplyHandler prototype.
+ */
+NATS_EXTERN natsStatus
+natsConnection_RequestAsync(natsRequest **req, natsConnection *nc, const char *subj,
+                            const void *data, int dataLen, int64_t timeout,
+                            natsReplyHandler cb, void *closure);
+
+/** \brief Sends a request based on the given `requestMsg` and invokes a callback with the reply.
+ *
+ * Similar to #natsConnection_RequestAsync but uses `requestMsg` to extract
+ * subject, headers and payload to send.
+ *
+ * @param req the location where to store the pointer to the #natsRequest
+ * object, can be `NULL`.
+ * @param nc the pointer to the #natsConnection object.
+ * @param requestMsg the message used for the request.
+ * @param timeout in milliseconds, after which the callback is invoked with
+ * #NATS_TIMEOUT if no reply was received. Must be positive.
+ * @param cb the #natsReplyHandler callback.
+ * @param closure a pointer to an user defined object (can be `NULL`). See
+ * the #natsReplyHandler prototype.
+ */
+NATS_EXTERN natsStatus
+natsConnection_RequestMsgAsync(natsRequest **req, natsConnection *nc,
+                               natsMsg *requestMsg, int64_t timeout,
+                               natsReplyHandler cb, void *closure);
+
+/** \brief Sends a request and invokes a callback with each of multiple replies.
+ *
+ * This is the asynchronous version of #natsConnection_RequestMany. The `cb`
+ * callback is invoked with each reply and a `NATS_OK` status, in the order
+ * they are received. When the request is done, for the same reasons that
+ * #natsConnection_RequestMany would return, the callback is invoked one last
+ * time with a `NULL` reply and:
+ *
+ * - `NATS_OK` if at least one reply was received.
+ * - #NATS_TIMEOUT if no reply was received.
+ * - #NATS_NO_RESPONDERS if the server reported that there was no responder.
+ * - #NATS_CONNECTION_CLOSED (or #NATS_CONNECTION_DISCONNECTED, see
+ * #natsOptions_SetFailRequestsOnDisconnect) if the connection was closed.
+ *
+ * No further invocation happens after this one, or after a successful call
+ * to #natsRequest_Cancel (except the one that could be in progress).
+ *
+ * See #natsConnection_RequestAsync regarding the `req` object.
+ *
+ * @param req the location where to store the pointer to the #natsRequest
+ * object, can be `NULL`.
+ * @param nc the pointer to the #natsConnection object.
+ * @param requestMsg the message used for the request.
+ * @param maxReplies the number of replies after which the request is done,
+ * or `0` for no limit.
+ * @param timeout in milliseconds, after which the request is done. Must be
+ * positive.
+ * @param stallTimeout in milliseconds, the maximum time to wait for the
+ * next reply once one has been received, or `0` to always wait for the
+ * `timeout`.
+ * @param cb the #natsReplyHandler callback.
+ * @param closure a pointer to an user defined object (can be `NULL`). See
+ * the #natsReplyHandler prototype.
+ */
+NATS_EXTERN natsStatus
+natsConnection_RequestManyAsync(natsRequest **req, natsConnection *nc,
+                                natsMsg *requestMsg, int maxReplies, int64_t timeout,
+                                int64_t stallTimeout, natsReplyHandler cb,
+                                void *closure);
+
+/** \brief Cancels an asynchronous request.
+ *
+ * If the request has not completed yet, the reply handler will not be
+ * invoked. This call returns #NATS_ILLEGAL_STATE if the request has already
+ * completed, in which case the reply handler has been, or is being, invoked.
+ *
+ * @param req the pointer to the #natsRequest object.
+ */
+NATS_EXTERN natsStatus
+natsRequest_Cancel(natsRequest *req);
+
+/** \brief Destroys the #natsRequest object.
+ *
+ * Releases the application's reference on the request object. This does not
+ * cancel the request, use #natsRequest_Cancel for that.
+ *
+ * @param req the pointer to the #natsRequest object.
+ */
+NATS_EXTERN void
+natsRequest_Destroy(natsRequest *req);
+
 /** @} */ // end of connPubGroup
 
 /** \defgroup connSubGroup Subscribing
@@ -3212,6 +4013,74 @@ natsConnection_SubscribeTimeout(natsSubscription **sub, natsConnection *nc,
                                 const char *subject, int64_t timeout,
                                 natsMsgHandler cb, void *cbClosure);
 
+/** \brief Creates an asynchronous subscription delivering messages in batches.
+ *
+ * Similar to #natsConnection_Subscribe, but the messages are delivered to
+ * the #natsMsgBatchHandler callback in batches of up to `maxBatch` messages.
+ *
+ * When the subscription has its own delivery thread, and fewer than
+ * `maxBatch` messages are pending, the library waits up to `maxWait`
+ * milliseconds for more messages before invoking the callback. When the
+ * subscription uses the library's delivery thread pool (see
+ * #natsOptions_UseGlobalMessageDelivery), `maxWait` is ignored since the
+ * worker is shared with other subscriptions: a batch is then made of the
+ * messages for this subscription that are pending in the worker.
+ *
+ * @param sub the location where to store the pointer to the newly created
+ * #natsSubscription object.
+ * @param nc the pointer to the #natsConnection object.
+ * @param subject the subject this subscription is created for.
+ * @param cb the #natsMsgBatchHandler callback.
+ * @param cbClosure a pointer to an user defined object (can be `NULL`). See
+ * the #natsMsgBatchHandler prototype.
+ * @param maxBatch the maximum number of messages passed to the callback.
+ * @param maxWait the time, in milliseconds, to wait for a batch to fill up
+ * (0 to deliver the pending messages right away).
+ */
+NATS_EXTERN natsStatus
+natsConnection_SubscribeBatch(natsSubscription **sub, natsConnection *nc,
+                              const char *subject, natsMsgBatchHandler cb,
+                              void *cbClosure, int maxBatch, int64_t maxWait);
+
+/** \brief Initializes a partitioned subscription options structure.
+ *
+ * Sets all the fields to their default (zero) value.
+ *
+ * @param opts the pointer to the #natsSubPartitionOptions object.
+ */
+NATS_EXTERN natsStatus
+natsSubPartitionOptions_Init(natsSubPartitionOptions *opts);
+
+/** \brief Creates an asynchronous subscription with parallel, partitioned, delivery.
+ *
+ * Similar to #natsConnection_Subscribe, but messages are dispatched to
+ * `opts->Partitions` delivery threads based on their partition key (see
+ * #natsSubPartitionOptions). The callback is invoked concurrently for
+ * messages of different partitions, but messages with the same key are
+ * delivered in the order they were received.
+ *
+ * Each partition has its own pending limits, which #natsSubscription_SetPendingLimits
+ * sets for all partitions. The subscription's statistics are the sum of
+ * the partitions' statistics, use #natsSubscription_GetPartitionStats to
+ * get those of a given partition.
+ *
+ * \note Such a subscription does not use the library's delivery thread
+ * pool (see #natsOptions_UseGlobalMessageDelivery).
+ *
+ * @param sub the location where to store the pointer to the newly created
+ * #natsSubscription object.
+ * @param nc the pointer to the #natsConnection object.
+ * @param subject the subject this subscription is created for.
+ * @param cb the #natsMsgHandler callback.
+ * @param cbClosure a pointer to an user defined object (can be `NULL`). See
+ * the #natsMsgHandler prototype.
+ * @param opts the pointer to the #natsSubPartitionOptions object.
+ */
+NATS_EXTERN natsStatus
+natsConnection_SubscribePartitioned(natsSubscription **sub, natsConnection *nc,
+                                    const char *subject, natsMsgHandler cb,
+                                    void *cbClosure, const natsSubPartitionOptions *opts);
+
 /** \brief Creates a synchronous subcription.
  *
  * Similar to #natsConnection_Subscribe, but creates a synchronous subscription
@@ -3351,6 +4220,32 @@ NATS_EXTERN natsStatus
 natsSubscription_NextMsg(natsMsg **nextMsg, natsSubscription *sub,
                          int64_t timeout);
 
+/** \brief Returns the available messages.
+ *
+ * Similar to #natsSubscription_NextMsg, but returns up to `max` messages in
+ * a single call. This call blocks up to `timeout` milliseconds for the
+ * first message, and then returns it along with the messages that were
+ * pending in the client, without waiting for more.
+ *
+ * The messages belong to the application, which needs to call
+ * #natsMsg_Destroy for each of them.
+ *
+ * \note If a message past the first one is a "no responders" message (see
+ * #natsSubscription_NextMsg), it is left pending and reported by the next
+ * call.
+ *
+ * @param sub the pointer to the #natsSubscription object.
+ * @param msgs an array of at least `max` entries where to store the
+ * pointers to the messages.
+ * @param max the maximum number of messages to return.
+ * @param count the location where to store the number of messages returned.
+ * @param timeout time, in milliseconds, after which this call will return
+ * #NATS_TIMEOUT if no message is available.
+ */
+NATS_EXTERN natsStatus
+natsSubscription_NextMsgs(natsSubscription *sub, natsMsg **msgs, int max,
+                          int *count, int64_t timeout);
+
 /** \brief Unsubscribes.
  *
  * Removes interest on the subject. Asynchronous subscription may still have
@@ -3538,6 +4433,38 @@ natsSubscription_GetStats(natsSubscription *sub,
                           int64_t *deliveredMsgs,
                           int64_t *droppedMsgs);
 
+/** \brief Get various statistics from a partition of this subscription.
+ *
+ * Same as #natsSubscription_GetStats, but for the given partition of a
+ * subscription created with #natsConnection_SubscribePartitioned.
+ *
+ * \note Any or all of the statistics pointers can be `NULL`.
+ *
+ * @param sub the pointer to the #natsSubscription object.
+ * @param partition the index of the partition, from `0` to the number of
+ * partitions minus one.
+ * @param pendingMsgs if not `NULL`, memory location where to store the
+ * number of pending messages.
+ * @param pendingBytes if not `NULL`, memory location where to store the
+ * total size of pending messages.
+ * @param maxPendingMsgs if not `NULL`, memory location where to store the
+ * maximum number of pending messages seen so far.
+ * @param maxPendingBytes if not `NULL`, memory location where to store the
+ * maximum total size of pending messages seen so far.
+ * @param deliveredMsgs if not `NULL`, memory location where to store the
+ * number of delivered messages.
+ * @param droppedMsgs if not `NULL`, memory location where to store the
+ * number of dropped messages.
+ */
+NATS_EXTERN natsStatus
+natsSubscription_GetPartitionStats(natsSubscription *sub, int partition,
+                                   int     *pendingMsgs,
+                                   int     *pendingBytes,
+                                   int     *maxPendingMsgs,
+                                   int     *maxPendingBytes,
+                                   int64_t *deliveredMsgs,
+                                   int64_t *droppedMsgs);
+
 /** \brief Checks the validity of the subscription.
  *
  * Returns a boolean indicating whether the subscription is still active.
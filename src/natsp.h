@@ -33,6 +33,10 @@
 #define NO_SSL_ERR  "The library was built without SSL support!"
 #endif
 
+#if defined(NATS_HAS_TLS) && defined(SSL_OP_ENABLE_KTLS) && !defined(OPENSSL_NO_KTLS)
+#define NATS_HAS_KTLS
+#endif
+
 #include "err.h"
 #include "nats.h"
 #include "buf.h"
@@ -94,6 +98,9 @@
 #define NATS_REQ_ID_OFFSET  (NATS_INBOX_PRE_LEN + NUID_BUFFER_LEN + 1)
 #define NATS_MAX_REQ_ID_LEN (19) // to display 2^63 number
 
+// Number of stripes, each with its own lock, of the request/response map.
+#define NATS_RESP_MAP_STRIPES   (8)
+
 #define WAIT_FOR_READ       (0)
 #define WAIT_FOR_WRITE      (1)
 #define WAIT_FOR_CONNECT    (2)
@@ -170,6 +177,9 @@ typedef struct __natsSSLCtx
     char        *expectedHostname;
     bool        skipVerify;
 
+    // Sessions to resume, keyed by server "host:port".
+    natsStrHash *sessions;
+
 } natsSSLCtx;
 
 #define natsSSLCtx_getExpectedHostname(ctx) ((ctx)->expectedHostname)
@@ -206,6 +216,7 @@ struct __natsOptions
     bool                    pedantic;
     bool                    allowReconnect;
     bool                    secure;
+    bool                    useKernelTLS;
     int                     ioBufSize;
     int                     maxReconnect;
     int64_t                 reconnectWait;
@@ -253,6 +264,12 @@ struct __natsOptions
 
     int                     orderIP; // possible values: 0,4,6,46,64
 
+    // If racingDelay is positive, connect attempts to the resolved addresses,
+    // and to the first racingServers servers of the pool on initial connect,
+    // are started racingDelay milliseconds apart and race each other.
+    int64_t                 racingDelay;
+    int                     racingServers;
+
     // forces the old method of Requests that utilize
     // a new Inbox and a new Subscription for each request
     bool                    useOldRequestStyle;
@@ -261,6 +278,12 @@ struct __natsOptions
     // not rely on the flusher.
     bool                    sendAsap;
 
+    // Policy used by the flusher to decide when to flush. Delay is
+    // in microseconds.
+    natsFlushPolicy         flushPolicy;
+    int                     flushMaxBytes;
+    int64_t                 flushMaxDelay;
+
     // If set to true, pending requests will fail with NATS_CONNECTION_DISCONNECTED
     // when the library detects a disconnection.
     bool                    failRequestsOnDisconnect;
@@ -302,6 +325,26 @@ struct __natsOptions
 
     // Disable the "no responders" feature.
     bool disableNoResponders;
+
+    // If true, inbound messages reference the memory the data was read
+    // into instead of getting their own copy.
+    bool                    inboundZeroCopy;
+
+    // If true, inbound messages are allocated from a per-connection pool.
+    bool                    useMsgPool;
+
+    // If true, asynchronous subscriptions with their own delivery thread
+    // use a lock-free ring instead of a locked list for pending messages.
+    bool                    lockFreeDelivery;
+
+    // If true, responses to requests are handled by the connection's
+    // reader instead of the response subscription's delivery thread.
+    bool                    inlineResponses;
+
+    // Payloads of at least this size published with
+    // natsConnection_PublishZeroCopy() are sent with MSG_ZEROCOPY.
+    // 0 means disabled.
+    int                     zeroCopyThreshold;
 };
 
 typedef struct __natsMsgList
@@ -313,17 +356,32 @@ typedef struct __natsMsgList
 
 } natsMsgList;
 
+// A worker of the library's message delivery pool. Subscriptions assigned
+// to this worker are protected by its lock and, when they have pending
+// messages, are in its list of ready subscriptions. The worker's thread
+// (it may have none after the pool shrunk) delivers them first, but any
+// idle thread of the pool can steal them.
 typedef struct __natsMsgDlvWorker
 {
-    natsMutex       *lock;
-    natsCondition   *cond;
-    natsThread      *thread;
-    bool            inWait;
-    bool            shutdown;
-    natsMsgList     msgList;
+    natsMutex                   *lock;
+    natsThread                  *thread;
+    struct __natsSubscription   *readyHead;
+    struct __natsSubscription   *readyTail;
 
 } natsMsgDlvWorker;
 
+// Parameters of a subscription created with natsConnection_SubscribeBatch()
+// or natsConnection_SubscribePartitioned(), or of the response subscription.
+typedef struct __natsSubParams
+{
+    natsMsgBatchHandler             batchCb;
+    int                             maxBatch;
+    int64_t                         maxBatchWait;
+    const natsSubPartitionOptions   *partitions;
+    bool                            inlineDlv;
+
+} natsSubParams;
+
 struct __natsSubscription
 {
     natsMutex                   *mu;
@@ -339,10 +397,46 @@ struct __natsSubscription
     // have reached the max number of messages.
     uint64_t                    delivered;
 
+    // Bumped (atomically) when 'max' is changed or the subscription is
+    // closed. The delivery thread checks it between the callbacks of a
+    // batch so that it stops delivering messages it detached before
+    // the change.
+    int32_t volatile            dlvGen;
+
+    // Number and size of the messages of the batch being delivered that
+    // have already been handed to the callback. The delivery thread
+    // updates them atomically, without the lock, and folds them into
+    // 'delivered' and 'msgList' when the batch completes. Use the
+    // natsSub_delivered/pendingMsgs/pendingBytes macros to read the
+    // current values.
+    int32_t volatile            dlvBatchMsgs;
+    int32_t volatile            dlvBatchBytes;
+
     // The list of messages waiting to be delivered to the callback (or
     // returned from NextMsg).
     natsMsgList                 msgList;
 
+    // For library delivery: true while the subscription is in its worker's
+    // ready list or being delivered by a thread of the pool, which ensures
+    // that its messages are delivered in order, by a single thread at a
+    // time. 'libDlvNext' links the ready list.
+    bool                        libDlvQueued;
+    struct __natsSubscription   *libDlvNext;
+
+    // If not NULL, messages waiting to be delivered to the callback are
+    // in this ring instead of msgList.head/tail. The msgList.msgs and
+    // msgList.bytes counters are then updated atomically.
+    struct __natsMsgRing        *ring;
+
+    // For subscriptions created with natsConnection_SubscribePartitioned(),
+    // messages are dispatched to the partitions' delivery threads and are
+    // not pending in msgList.
+    struct __natsSubPartitions  *parts;
+
+    // If true, the connection's reader invokes the callback directly. This
+    // is used for the response subscription (see natsOptions_UseInlineResponses()).
+    bool                        inlineDlv;
+
     // True if msgList.count is over pendingMax
     bool                        slowConsumer;
 
@@ -404,11 +498,24 @@ struct __natsSubscription
     natsMsgHandler              msgCb;
     void                        *msgCbClosure;
 
+    // For subscriptions created with natsConnection_SubscribeBatch(),
+    // messages are passed to this callback (with msgCbClosure) in batches
+    // of up to 'maxBatch' messages, collected in 'batchMsgs'.
+    natsMsgBatchHandler         batchCb;
+    int                         maxBatch;
+    int64_t                     maxBatchWait;
+    natsMsg                     **batchMsgs;
+
     int64_t                     timeout;
     natsTimer                   *timeoutTimer;
     bool                        timedOut;
     bool                        timeoutSuspended;
 
+    // When the last pending message was delivered (library delivery only).
+    // The timeout timer checks it when firing, instead of being reset
+    // after each delivery.
+    int64_t                     lastActivity;
+
     // Pending limits, etc..
     int                         msgsMax;
     int                         bytesMax;
@@ -445,6 +552,10 @@ typedef struct __natsPongList
 
 } natsPongList;
 
+#if defined(NATS_HAS_IO_URING)
+typedef struct __natsSockUring natsSockUring;
+#endif
+
 typedef struct __natsSockCtx
 {
     natsSock        fd;
@@ -455,14 +566,32 @@ typedef struct __natsSockCtx
 
     SSL             *ssl;
 
+    // Set when record encryption (send) or decryption (recv) has been
+    // offloaded to the kernel (see natsOptions_UseKernelTLS).
+    bool            ktlsSend;
+    bool            ktlsRecv;
+
+    // Set when an SSL_read or SSL_write failed with a protocol error, in
+    // which case the session must not be resumed.
+    bool            sslFailed;
+
     // This is true when we are using an external event loop (such as libuv).
     bool            useEventLoop;
 
+#if defined(NATS_HAS_IO_URING)
+    // Set while the connection's read loop reads through io_uring.
+    natsSockUring   *uring;
+
+    // Set when writes are submitted through io_uring.
+    natsSockUring   *wuring;
+#endif
+
     int             orderIP; // possible values: 0,4,6,46,64
 
 } natsSockCtx;
 
-typedef struct __respInfo
+// The asynchronous requests' natsRequest is a respInfo.
+typedef struct __natsRequest
 {
     natsMutex           *mu;
     natsCondition       *cond;
@@ -472,8 +601,77 @@ typedef struct __respInfo
     bool                removed;
     bool                pooled;
 
+    // Set for asynchronous requests, see natsConnection_RequestAsync().
+    natsConnection      *nc;
+    natsReplyHandler    cb;
+    void                *cbClosure;
+    natsTimer           *timer;
+    int                 refs;
+
+    // The request ID, which is the last token of the reply subject.
+    int64_t             reqId;
+
+    // Set for requests collecting more than one reply, see
+    // natsConnection_RequestMany(). Such a request stays in the map until
+    // it is done, and `removed` is set at that time.
+    bool                many;
+    int                 maxReplies;
+    int                 replies;
+    int64_t             deadline;
+    int64_t             stallTimeout;
+    int64_t             lastReply;
+    natsMsgList         msgList;
+
+    // Number of reply handlers being invoked. The final invocation of an
+    // asynchronous request is deferred until they have returned.
+    int                 inCb;
+    bool                donePending;
+    natsStatus          doneSts;
+
 } respInfo;
 
+// A payload sent with MSG_ZEROCOPY, waiting for the kernel to be done
+// with it before the user can be notified.
+typedef struct __natsZeroCopyBuf
+{
+    const void                  *data;
+    int                         dataLen;
+    natsBufferReleaseHandler    cb;
+    void                        *closure;
+    uint32_t                    lastId; // sequence number of the last send
+    struct __natsZeroCopyBuf    *next;
+
+} natsZeroCopyBuf;
+
+// Sequence numbers of zero copy sends reported complete.
+typedef struct __natsZeroCopyRange
+{
+    uint32_t                    from;
+    uint32_t                    to;
+
+} natsZeroCopyRange;
+
+// A payload in the pending output that is sent from the message holding it
+// instead of being copied into the connection's write buffer. It goes after
+// the first 'pos' bytes of that buffer.
+typedef struct __natsOutRef
+{
+    natsMsg                     *msg;   // retained until the payload is sent
+    const char                  *data;  // what is left to send
+    int                         len;
+    int                         pos;
+
+} natsOutRef;
+
+// A stripe of the request/response map, which has its own lock so that
+// routing responses does not need the connection's lock.
+typedef struct __natsRespStripe
+{
+    natsMutex           *mu;
+    natsHash            *map;
+
+} natsRespStripe;
+
 struct __natsConnection
 {
     natsMutex           *mu;
@@ -493,10 +691,19 @@ struct __natsConnection
     natsBuffer          *bw;
     natsBuffer          *scratch;
 
+    // Payloads referenced by the pending output, in order.
+    struct
+    {
+        natsOutRef      *refs;
+        int             count;
+        int             cap;
+        int             bytes;      // left to send for all of them
+    } out;
+
     natsServerInfo      info;
 
     int64_t             ssid;
-    natsHash            *subs;
+    struct __natsSubTable *subs;
     natsMutex           *subsMu;
 
     natsConnStatus      status;
@@ -507,6 +714,8 @@ struct __natsConnection
     char                errStr[256];
 
     natsParser          *ps;
+    struct __natsMsgChunk *readChunk; // only accessed by the read loop
+    struct __natsMsgPool  *msgPool;   // allocations done by the read loop only
     natsTimer           *ptmr;
     int                 pout;
 
@@ -518,6 +727,11 @@ struct __natsConnection
     natsCondition       *flusherCond;
     bool                flusherSignaled;
     bool                flusherStop;
+    int                 flusherWaitBytes;   // if > 0, signal flusher when that many bytes are buffered
+    int64_t             flusherKickTime;    // time (ns) when the flusher was signaled
+    int64_t             flusherRateTime;    // adaptive policy: last rate sample time (ns)
+    uint64_t            flusherRateMsgs;    // adaptive policy: outMsgs at last sample
+    double              flusherRate;        // adaptive policy: average msgs per nanosecond
 
     natsThread          *reconnectThread;
     int                 inReconnect;
@@ -529,17 +743,32 @@ struct __natsConnection
     int64_t             drainTimeout;
     bool                dontSendInPlace;
 
+    // MSG_ZEROCOPY sends
+    struct
+    {
+        bool            enabled;    // current socket accepts zero copy sends
+        uint32_t        nextId;     // sequence number of the next send
+        natsZeroCopyBuf *head;      // waiting for completion, in send order
+        natsZeroCopyBuf *tail;
+        natsZeroCopyBuf *done;      // complete, callbacks to be invoked
+        uint32_t        doneId;     // all sends before this one are complete
+        natsZeroCopyRange *ranges;  // complete past doneId, ordered by 'from'
+        int             rangesCount;
+        int             rangesCap;
+        natsTimer       *tmr;       // polls the socket's error queue
+        int64_t         interval;   // current polling interval
+        bool            polling;
+    } zc;
+
     // Set to true when owned by a Streaming connection,
     // which will prevent user from calling Close and/or Destroy.
     bool                stanOwned;
 
     // New Request style
-    char                respId[NATS_MAX_REQ_ID_LEN+1];
-    int                 respIdPos;
-    int                 respIdVal;
+    int64_t             respId;     // Last request ID
     char                *respSub;   // The wildcard subject
     natsSubscription    *respMux;   // A single response subscription
-    natsStrHash         *respMap;   // Request map for the response msg
+    natsRespStripe      respMap[NATS_RESP_MAP_STRIPES]; // Request map for the response msg, by request ID
     respInfo            **respPool;
     int                 respPoolSize;
     int                 respPoolIdx;
@@ -579,7 +808,15 @@ nats_stopTimer(natsTimer *t);
 int
 nats_getTimersCount(void);
 
-// Returns the number of timers actually in the list. This should be
+// Reserves room in the timers heap for a new timer. Must be called when
+// creating a timer, and nats_removeTimerSlot() when freeing it.
+natsStatus
+nats_addTimerSlot(void);
+
+void
+nats_removeTimerSlot(void);
+
+// Returns the number of timers actually in the heap. This should be
 // equal to nats_getTimersCount() or nats_getTimersCount() - 1 when a
 // timer thread is invoking a timer's callback.
 int
@@ -603,6 +840,12 @@ natsLib_msgDeliveryPostControlMsg(natsSubscription *sub);
 natsStatus
 natsLib_msgDeliveryAssignWorker(natsSubscription *sub);
 
+bool
+natsLib_msgDeliveryReady(natsMsgDlvWorker *worker, natsSubscription *sub);
+
+void
+natsLib_msgDeliveryGrow(void);
+
 bool
 natsLib_isLibHandlingMsgDeliveryByDefault(void);
 
@@ -612,9 +855,19 @@ natsLib_defaultWriteDeadline(void);
 void
 natsLib_getMsgDeliveryPoolInfo(int *maxSize, int *size, int *idx, natsMsgDlvWorker ***workersArray);
 
+void
+natsLib_getMsgDeliveryPoolThreads(int *threads, int *idle);
+
 void
 nats_setNATSThreadKey(void);
 
+// Thread-local cache of messages freed by the current thread (see msgpool.c)
+void*
+nats_getMsgPoolThreadCache(void);
+
+natsStatus
+nats_setMsgPoolThreadCache(void *cache);
+
 //
 // Threads
 //
@@ -672,6 +925,12 @@ natsStatus
 natsCondition_AbsoluteTimedWait(natsCondition *cond, natsMutex *mutex,
                                 int64_t absoluteTime);
 
+// Same than natsCondition_AbsoluteTimedWait() but the absolute time is
+// expressed in nanoseconds (see nats_NowInNanoSeconds()).
+natsStatus
+natsCondition_AbsoluteTimedWaitNano(natsCondition *cond, natsMutex *mutex,
+                                    int64_t absoluteTime);
+
 void
 natsCondition_Signal(natsCondition *cond);
 
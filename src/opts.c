@@ -19,6 +19,7 @@
 #include "opts.h"
 #include "util.h"
 #include "conn.h"
+#include "ioengine.h"
 
 natsStatus
 natsOptions_SetURL(natsOptions *opts, const char* url)
@@ -231,6 +232,18 @@ natsSSLCtx_release(natsSSLCtx *ctx)
 
     if (refs == 0)
     {
+        if (ctx->sessions != NULL)
+        {
+            natsStrHashIter iter;
+            void            *sess = NULL;
+
+            natsStrHashIter_Init(&iter, ctx->sessions);
+            while (natsStrHashIter_Next(&iter, NULL, &sess))
+                SSL_SESSION_free((SSL_SESSION*) sess);
+            natsStrHashIter_Done(&iter);
+
+            natsStrHash_Destroy(ctx->sessions);
+        }
         NATS_FREE(ctx->expectedHostname);
         SSL_CTX_free(ctx->ctx);
         natsMutex_Destroy(ctx->lock);
@@ -291,6 +304,12 @@ _createSSLCtx(natsSSLCtx **newCtx)
 #endif
         SSL_CTX_set_default_verify_paths(ctx->ctx);
 
+        // Sessions are kept by the library, per server, to be resumed
+        // on reconnect (see natsConn_newTLSSession()).
+        SSL_CTX_set_session_cache_mode(ctx->ctx,
+                                       SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+        SSL_CTX_sess_set_new_cb(ctx->ctx, natsConn_newTLSSession);
+
         *newCtx = ctx;
     }
     else if (ctx != NULL)
@@ -363,6 +382,26 @@ natsOptions_SetSecure(natsOptions *opts, bool secure)
     return NATS_UPDATE_ERR_STACK(s);
 }
 
+natsStatus
+natsOptions_UseKernelTLS(natsOptions *opts, bool use)
+{
+    LOCK_AND_CHECK_OPTIONS(opts, 0);
+
+#if !defined(NATS_HAS_KTLS)
+    if (use)
+    {
+        UNLOCK_OPTS(opts);
+        return nats_setError(NATS_NOT_PERMITTED, "%s",
+                             "The library was built with an OpenSSL version that does not support kernel TLS");
+    }
+#endif
+    opts->useKernelTLS = use;
+
+    UNLOCK_OPTS(opts);
+
+    return NATS_OK;
+}
+
 natsStatus
 natsOptions_LoadCATrustedCertificates(natsOptions *opts, const char *fileName)
 {
@@ -688,6 +727,12 @@ natsOptions_SetSecure(natsOptions *opts, bool secure)
     return nats_setError(NATS_ILLEGAL_STATE, "%s", NO_SSL_ERR);
 }
 
+natsStatus
+natsOptions_UseKernelTLS(natsOptions *opts, bool use)
+{
+    return nats_setError(NATS_ILLEGAL_STATE, "%s", NO_SSL_ERR);
+}
+
 natsStatus
 natsOptions_LoadCATrustedCertificates(natsOptions *opts, const char *fileName)
 {
@@ -1010,6 +1055,39 @@ natsOptions_UseGlobalMessageDelivery(natsOptions *opts, bool global)
     return NATS_OK;
 }
 
+natsStatus
+natsOptions_UseIOEngine(natsOptions *opts, bool use)
+{
+    LOCK_AND_CHECK_OPTIONS(opts, 0);
+
+    if (use && !natsIOEngine_Supported())
+    {
+        UNLOCK_OPTS(opts);
+        return nats_setError(NATS_NOT_PERMITTED, "%s",
+                             "The I/O engine is not supported on this platform");
+    }
+
+    // The engine is attached as an event loop. When switching it off,
+    // leave an external event loop that would have been set since.
+    if (use)
+    {
+        opts->evLoop        = natsIOEngine_Loop();
+        opts->evCbs.attach  = natsIOEngine_Attach;
+        opts->evCbs.read    = natsIOEngine_Read;
+        opts->evCbs.write   = natsIOEngine_Write;
+        opts->evCbs.detach  = natsIOEngine_Detach;
+    }
+    else if ((opts->evLoop != NULL) && (opts->evLoop == natsIOEngine_Loop()))
+    {
+        opts->evLoop        = NULL;
+        memset(&(opts->evCbs), 0, sizeof(opts->evCbs));
+    }
+
+    UNLOCK_OPTS(opts);
+
+    return NATS_OK;
+}
+
 natsStatus
 natsOptions_IPResolutionOrder(natsOptions *opts, int order)
 {
@@ -1026,6 +1104,19 @@ natsOptions_IPResolutionOrder(natsOptions *opts, int order)
     return NATS_OK;
 }
 
+natsStatus
+natsOptions_SetRacingConnect(natsOptions *opts, int64_t delay, int servers)
+{
+    LOCK_AND_CHECK_OPTIONS(opts, ((delay < 0) || (servers < 1)));
+
+    opts->racingDelay   = delay;
+    opts->racingServers = servers;
+
+    UNLOCK_OPTS(opts);
+
+    return NATS_OK;
+}
+
 natsStatus
 natsOptions_SetSendAsap(natsOptions *opts, bool sendAsap)
 {
@@ -1036,6 +1127,78 @@ natsOptions_SetSendAsap(natsOptions *opts, bool sendAsap)
     return NATS_OK;
 }
 
+natsStatus
+natsOptions_SetFlushPolicy(natsOptions *opts, natsFlushPolicy policy,
+                           int maxBytes, int64_t maxDelay)
+{
+    bool needDelay = ((policy == NATS_FLUSH_POLICY_THROUGHPUT)
+                      || (policy == NATS_FLUSH_POLICY_ADAPTIVE));
+
+    LOCK_AND_CHECK_OPTIONS(opts,
+                           ((policy < NATS_FLUSH_POLICY_DEFAULT)
+                            || (policy > NATS_FLUSH_POLICY_ADAPTIVE)
+                            || (maxBytes < 0)
+                            || (needDelay && (maxDelay <= 0))));
+
+    opts->flushPolicy   = policy;
+    opts->flushMaxBytes = (needDelay ? maxBytes : 0);
+    opts->flushMaxDelay = (needDelay ? maxDelay : 0);
+
+    UNLOCK_OPTS(opts);
+
+    return NATS_OK;
+}
+
+natsStatus
+natsOptions_SetInboundZeroCopy(natsOptions *opts, bool zeroCopy)
+{
+    LOCK_AND_CHECK_OPTIONS(opts, 0);
+    opts->inboundZeroCopy = zeroCopy;
+    UNLOCK_OPTS(opts);
+
+    return NATS_OK;
+}
+
+natsStatus
+natsOptions_UseLockFreeDelivery(natsOptions *opts, bool lockFree)
+{
+    LOCK_AND_CHECK_OPTIONS(opts, 0);
+    opts->lockFreeDelivery = lockFree;
+    UNLOCK_OPTS(opts);
+
+    return NATS_OK;
+}
+
+natsStatus
+natsOptions_UseInlineResponses(natsOptions *opts, bool inlineResponses)
+{
+    LOCK_AND_CHECK_OPTIONS(opts, 0);
+    opts->inlineResponses = inlineResponses;
+    UNLOCK_OPTS(opts);
+
+    return NATS_OK;
+}
+
+natsStatus
+natsOptions_SetZeroCopyThreshold(natsOptions *opts, int threshold)
+{
+    LOCK_AND_CHECK_OPTIONS(opts, (threshold < 0));
+    opts->zeroCopyThreshold = threshold;
+    UNLOCK_OPTS(opts);
+
+    return NATS_OK;
+}
+
+natsStatus
+natsOptions_UseMessagePool(natsOptions *opts, bool useMsgPool)
+{
+    LOCK_AND_CHECK_OPTIONS(opts, 0);
+    opts->useMsgPool = useMsgPool;
+    UNLOCK_OPTS(opts);
+
+    return NATS_OK;
+}
+
 natsStatus
 natsOptions_SetNoEcho(natsOptions *opts, bool noEcho)
 {
@@ -19,6 +19,144 @@
 #include "util.h"
 #include "mem.h"
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define NATS_PARSER_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define NATS_PARSER_SSE2
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define NATS_PARSER_NEON
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+static __inline int
+_ctz(unsigned int m)
+{
+    unsigned long idx;
+    _BitScanForward(&idx, m);
+    return (int) idx;
+}
+#else
+#define _ctz(m) __builtin_ctz(m)
+#endif
+
+#define _isSep(b) (((b) == ' ') || ((b) == '\t') || ((b) == '\r') || ((b) == '\n'))
+
+// Returns the index of the first '\n' in buf[start:end[, or -1.
+static int
+_findLF(const char *buf, int start, int end)
+{
+    int i = start;
+
+#if defined(NATS_PARSER_AVX2)
+    const __m256i lf = _mm256_set1_epi8('\n');
+
+    for (; i + 32 <= end; i += 32)
+    {
+        __m256i      v = _mm256_loadu_si256((const __m256i*) (buf + i));
+        unsigned int m = (unsigned int) _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, lf));
+
+        if (m != 0)
+            return i + _ctz(m);
+    }
+#elif defined(NATS_PARSER_SSE2)
+    const __m128i lf = _mm_set1_epi8('\n');
+
+    for (; i + 16 <= end; i += 16)
+    {
+        __m128i      v = _mm_loadu_si128((const __m128i*) (buf + i));
+        unsigned int m = (unsigned int) _mm_movemask_epi8(_mm_cmpeq_epi8(v, lf));
+
+        if (m != 0)
+            return i + _ctz(m);
+    }
+#elif defined(NATS_PARSER_NEON)
+    const uint8x16_t lf = vdupq_n_u8('\n');
+
+    for (; i + 16 <= end; i += 16)
+    {
+        uint8x16_t v = vld1q_u8((const uint8_t*) (buf + i));
+
+        // NEON has no movemask: only check if there is a match, and
+        // let the scalar loop below locate it.
+        if (vmaxvq_u8(vceqq_u8(v, lf)) != 0)
+            break;
+    }
+#endif
+    for (; i < end; i++)
+    {
+        if (buf[i] == '\n')
+            return i;
+    }
+    return -1;
+}
+
+// Returns the index of the first separator (space, tab, CR or LF) in
+// buf[start:end[, or 'end' if there is none.
+static int
+_findSep(const char *buf, int start, int end)
+{
+    int i = start;
+
+#if defined(NATS_PARSER_AVX2)
+    const __m256i sp = _mm256_set1_epi8(' ');
+    const __m256i ht = _mm256_set1_epi8('\t');
+    const __m256i cr = _mm256_set1_epi8('\r');
+    const __m256i lf = _mm256_set1_epi8('\n');
+
+    for (; i + 32 <= end; i += 32)
+    {
+        __m256i      v = _mm256_loadu_si256((const __m256i*) (buf + i));
+        __m256i      r = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, sp), _mm256_cmpeq_epi8(v, ht)),
+                                         _mm256_or_si256(_mm256_cmpeq_epi8(v, cr), _mm256_cmpeq_epi8(v, lf)));
+        unsigned int m = (unsigned int) _mm256_movemask_epi8(r);
+
+        if (m != 0)
+            return i + _ctz(m);
+    }
+#elif defined(NATS_PARSER_SSE2)
+    const __m128i sp = _mm_set1_epi8(' ');
+    const __m128i ht = _mm_set1_epi8('\t');
+    const __m128i cr = _mm_set1_epi8('\r');
+    const __m128i lf = _mm_set1_epi8('\n');
+
+    for (; i + 16 <= end; i += 16)
+    {
+        __m128i      v = _mm_loadu_si128((const __m128i*) (buf + i));
+        __m128i      r = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, sp), _mm_cmpeq_epi8(v, ht)),
+                                      _mm_or_si128(_mm_cmpeq_epi8(v, cr), _mm_cmpeq_epi8(v, lf)));
+        unsigned int m = (unsigned int) _mm_movemask_epi8(r);
+
+        if (m != 0)
+            return i + _ctz(m);
+    }
+#elif defined(NATS_PARSER_NEON)
+    const uint8x16_t sp = vdupq_n_u8(' ');
+    const uint8x16_t ht = vdupq_n_u8('\t');
+    const uint8x16_t cr = vdupq_n_u8('\r');
+    const uint8x16_t lf = vdupq_n_u8('\n');
+
+    for (; i + 16 <= end; i += 16)
+    {
+        uint8x16_t v = vld1q_u8((const uint8_t*) (buf + i));
+        uint8x16_t r = vorrq_u8(vorrq_u8(vceqq_u8(v, sp), vceqq_u8(v, ht)),
+                                vorrq_u8(vceqq_u8(v, cr), vceqq_u8(v, lf)));
+
+        if (vmaxvq_u8(r) != 0)
+            break;
+    }
+#endif
+    for (; i < end; i++)
+    {
+        if (_isSep(buf[i]))
+            return i;
+    }
+    return end;
+}
+
 // cloneMsgArg is used when the split buffer scenario has the pubArg in the existing read buffer, but
 // we need to hold onto it into the next read.
 static natsStatus
@@ -111,7 +249,7 @@ _processMsgArgs(natsConnection *nc, char *buf, int bufLen)
     {
         b = buf[i];
 
-        if (((b == ' ') || (b == '\t') || (b == '\r') || (b == '\n')))
+        if (_isSep(b))
         {
             if (start >=0)
             {
@@ -129,6 +267,10 @@ _processMsgArgs(natsConnection *nc, char *buf, int bufLen)
         else if (start < 0)
         {
             start = i;
+
+            // Jump to the end of this argument (minus 1 since the loop
+            // increments the index).
+            i = _findSep(buf, i + 1, bufLen) - 1;
         }
     }
     if ((s == NATS_OK) && (start >= 0))
@@ -244,12 +386,26 @@ natsParser_Parse(natsConnection *nc, char* buf, int bufLen)
                         nc->ps->state  = OP_M;
                         nc->ps->hdr    = -1;
                         nc->ps->ma.hdr = -1;
+                        // Fast path: skip to the arguments if the whole
+                        // operation name is present.
+                        if (!nc->ps->noFastPath && (i + 4 <= bufLen)
+                            && (memcmp(buf + i, "MSG ", 4) == 0))
+                        {
+                            nc->ps->state = OP_MSG_SPC;
+                            i += 3;
+                        }
                         break;
                     case 'H':
                     case 'h':
                         nc->ps->state  = OP_H;
                         nc->ps->hdr    = 0;
                         nc->ps->ma.hdr = 0;
+                        if (!nc->ps->noFastPath && (i + 5 <= bufLen)
+                            && (memcmp(buf + i, "HMSG ", 5) == 0))
+                        {
+                            nc->ps->state = OP_MSG_SPC;
+                            i += 4;
+                        }
                         break;
                     case 'P':
                     case 'p':
@@ -338,6 +494,24 @@ natsParser_Parse(natsConnection *nc, char* buf, int bufLen)
             }
             case MSG_ARG:
             {
+                // Fast path: if the control line is in this buffer, jump
+                // to the end of it, otherwise to the end of the buffer.
+                if (!nc->ps->noFastPath && (nc->ps->argBuf == NULL) && (b != '\n'))
+                {
+                    int lf = _findLF(buf, i, bufLen);
+
+                    if (lf < 0)
+                    {
+                        i = bufLen - 1;
+                        if (buf[i] == '\r')
+                            nc->ps->drop = 1;
+                        break;
+                    }
+                    i = lf;
+                    b = '\n';
+                    if (buf[i-1] == '\r')
+                        nc->ps->drop = 1;
+                }
                 switch (b)
                 {
                     case '\r':
@@ -81,6 +81,7 @@ typedef struct __natsParser
     natsBuffer  *argBuf;
     natsBuffer  msgBufRec;
     natsBuffer  *msgBuf;
+    bool        noFastPath; // used by tests to disable the fast path
     char        scratch[MAX_CONTROL_LINE_SIZE];
 
 } natsParser;
@@ -20,6 +20,7 @@
 #include "msg.h"
 #include "nuid.h"
 #include "mem.h"
+#include "util.h"
 
 static const char *digits = "0123456789";
 
@@ -46,11 +47,17 @@ static const char *digits = "0123456789";
 // string representation of a hdr/msg size. See GETBYTES_SIZE.
 #define BYTES_SIZE_MAX (12)
 
-// _publish is the internal function to publish messages to a nats server.
-// Sends a protocol data message by queueing into the bufio writer
-// and kicking the flusher thread. These writes should be protected.
-natsStatus
-natsConn_publish(natsConnection *nc, natsMsg *msg, bool directFlush)
+// Encodes the PUB/HPUB protocol for the given message and queues it, along
+// with the payload, into the connection's write buffer (or pending buffer
+// if reconnecting). On success, `msgSize` is set to the number of bytes that
+// should be accounted for in the outbound statistics.
+// If `releaseCb` is not NULL, the payload may be sent with zero copy, in
+// which case `queued` is set to true and the callback will be invoked when
+// the kernel is done with the data.
+// Connection lock is held on entry.
+static natsStatus
+_publishLocked(natsConnection *nc, natsMsg *msg, bool reconnecting, int *msgSize,
+               natsBufferReleaseHandler releaseCb, void *closure, bool *queued)
 {
     natsStatus  s               = NATS_OK;
     int         msgHdSize       = 0;
@@ -62,14 +69,10 @@ natsConn_publish(natsConnection *nc, natsMsg *msg, bool directFlush)
     int         hlSize          = 0;
     int         subjLen         = 0;
     int         replyLen        = 0;
-    bool        reconnecting    = false;
     int         ppo             = 1; // pub proto offset
     int         hdrl            = 0;
     int         totalLen        = 0;
 
-    if (nc == NULL)
-        return nats_setDefaultError(NATS_INVALID_ARG);
-
     if ((msg->subject == NULL)
         || ((subjLen = (int) strlen(msg->subject)) == 0))
     {
@@ -78,33 +81,13 @@ natsConn_publish(natsConnection *nc, natsMsg *msg, bool directFlush)
 
     replyLen = ((msg->reply != NULL) ? (int) strlen(msg->reply) : 0);
 
-    natsConn_Lock(nc);
-
-    if (natsConn_isClosed(nc))
-    {
-        natsConn_Unlock(nc);
-
-        return nats_setDefaultError(NATS_CONNECTION_CLOSED);
-    }
-
-    if (natsConn_isDrainingPubs(nc))
-    {
-        natsConn_Unlock(nc);
-
-        return nats_setDefaultError(NATS_DRAINING);
-    }
-
     // We can have headers NULL but hdrLift==true which means we are in special
     // situation where a message was received and is sent back without the user
     // accessing the headers. It should still be considered having headers.
     if ((msg->headers != NULL) || msg->hdrLift)
     {
         if (!nc->info.headers)
-        {
-            natsConn_Unlock(nc);
-
             return nats_setDefaultError(NATS_NO_SERVER_SUPPORT);
-        }
 
         hdrl = natsMsgHeader_encodedLen(msg);
         if (hdrl > 0)
@@ -118,8 +101,6 @@ natsConn_publish(natsConnection *nc, natsMsg *msg, bool directFlush)
 
     if (!nc->initc && ((int64_t) msg->dataLen > nc->info.maxPayload))
     {
-        natsConn_Unlock(nc);
-
         return nats_setError(NATS_MAX_PAYLOAD,
                              "Payload %d greater than maximum allowed: %" PRId64,
                              msg->dataLen, nc->info.maxPayload);
@@ -127,14 +108,11 @@ natsConn_publish(natsConnection *nc, natsMsg *msg, bool directFlush)
 
     // Check if we are reconnecting, and if so check if
     // we have exceeded our reconnect outbound buffer limits.
-    if ((reconnecting = natsConn_isReconnecting(nc)))
+    if (reconnecting)
     {
         // Check if we are over
         if (natsBuf_Len(nc->pending) >= nc->opts->reconnectBufSize)
-        {
-            natsConn_Unlock(nc);
             return nats_setDefaultError(NATS_INSUFFICIENT_BUFFER);
-        }
     }
 
     totalLen += msg->dataLen;
@@ -193,7 +171,18 @@ natsConn_publish(natsConnection *nc, natsMsg *msg, bool directFlush)
         s = natsConn_bufferWrite(nc, natsBuf_Data(nc->scratch)+ppo, msgHdSize);
 
         if (s == NATS_OK)
-            s = natsConn_bufferWrite(nc, msg->data, msg->dataLen);
+        {
+            if ((releaseCb != NULL) && !reconnecting
+                && natsConn_canZeroCopy(nc, msg->dataLen))
+            {
+                s = natsConn_zeroCopyWrite(nc, msg->data, msg->dataLen,
+                                           releaseCb, closure, queued);
+            }
+            else
+            {
+                s = natsConn_bufferWritePayload(nc, msg);
+            }
+        }
 
         if (s == NATS_OK)
             s = natsConn_bufferWrite(nc, _CRLF_, _CRLF_LEN_);
@@ -202,6 +191,50 @@ natsConn_publish(natsConnection *nc, natsMsg *msg, bool directFlush)
             natsBuf_MoveTo(nc->pending, pos);
     }
 
+    if (s == NATS_OK)
+        *msgSize = totalLen;
+
+    return NATS_UPDATE_ERR_STACK(s);
+}
+
+// Checks that the connection is in a state that allows publishing.
+// Connection lock is held on entry.
+static natsStatus
+_checkCanPublish(natsConnection *nc)
+{
+    if (natsConn_isClosed(nc))
+        return nats_setDefaultError(NATS_CONNECTION_CLOSED);
+
+    if (natsConn_isDrainingPubs(nc))
+        return nats_setDefaultError(NATS_DRAINING);
+
+    return NATS_OK;
+}
+
+// _publish is the internal function to publish messages to a nats server.
+// Sends a protocol data message by queueing into the bufio writer
+// and kicking the flusher thread. These writes should be protected.
+static natsStatus
+_publish(natsConnection *nc, natsMsg *msg, bool directFlush,
+         natsBufferReleaseHandler releaseCb, void *closure, bool *queued)
+{
+    natsStatus  s               = NATS_OK;
+    bool        reconnecting    = false;
+    int         totalLen        = 0;
+
+    if (nc == NULL)
+        return nats_setDefaultError(NATS_INVALID_ARG);
+
+    natsConn_Lock(nc);
+
+    s = _checkCanPublish(nc);
+    if (s == NATS_OK)
+    {
+        reconnecting = natsConn_isReconnecting(nc);
+        s = _publishLocked(nc, msg, reconnecting, &totalLen,
+                           releaseCb, closure, queued);
+    }
+
     if ((s == NATS_OK) && !reconnecting)
     {
         if (directFlush)
@@ -221,6 +254,91 @@ natsConn_publish(natsConnection *nc, natsMsg *msg, bool directFlush)
     return NATS_UPDATE_ERR_STACK(s);
 }
 
+natsStatus
+natsConn_publish(natsConnection *nc, natsMsg *msg, bool directFlush)
+{
+    natsStatus s = _publish(nc, msg, directFlush, NULL, NULL, NULL);
+
+    return NATS_UPDATE_ERR_STACK(s);
+}
+
+// Publishes `count` messages under a single acquisition of the connection
+// lock and with a single kick of the flusher. If `errors` is not NULL, the
+// status of each message is stored at the corresponding index.
+static natsStatus
+_publishBatch(natsConnection *nc, natsMsg **msgs, natsMsg *msgArray,
+              int count, natsStatus *errors)
+{
+    natsStatus  s           = NATS_OK;
+    natsStatus  ms          = NATS_OK;
+    natsStatus  firstErr    = NATS_OK;
+    bool        reconnecting= false;
+    int         totalLen    = 0;
+    int         sent        = 0;
+    int64_t     sentBytes   = 0;
+    natsMsg     *msg        = NULL;
+    int         i;
+
+    if ((nc == NULL) || (count < 0) || ((count > 0) && (msgs == NULL) && (msgArray == NULL)))
+        return nats_setDefaultError(NATS_INVALID_ARG);
+
+    if (count == 0)
+        return NATS_OK;
+
+    natsConn_Lock(nc);
+
+    s = _checkCanPublish(nc);
+    if (s != NATS_OK)
+    {
+        natsConn_Unlock(nc);
+
+        if (errors != NULL)
+        {
+            for (i=0; i<count; i++)
+                errors[i] = s;
+        }
+        return NATS_UPDATE_ERR_STACK(s);
+    }
+
+    reconnecting = natsConn_isReconnecting(nc);
+
+    for (i=0; i<count; i++)
+    {
+        msg = (msgs != NULL ? msgs[i] : &(msgArray[i]));
+        if (msg == NULL)
+            ms = nats_setDefaultError(NATS_INVALID_ARG);
+        else
+            ms = _publishLocked(nc, msg, reconnecting, &totalLen, NULL, NULL, NULL);
+
+        if (ms == NATS_OK)
+        {
+            sent++;
+            sentBytes += totalLen;
+        }
+        else if (firstErr == NATS_OK)
+        {
+            firstErr = ms;
+        }
+        if (errors != NULL)
+            errors[i] = ms;
+    }
+
+    if ((sent > 0) && !reconnecting)
+        s = natsConn_flushOrKickFlusher(nc);
+
+    if (s == NATS_OK)
+    {
+        nc->stats.outMsgs  += sent;
+        nc->stats.outBytes += sentBytes;
+
+        s = firstErr;
+    }
+
+    natsConn_Unlock(nc);
+
+    return NATS_UPDATE_ERR_STACK(s);
+}
+
 /*
  * Publishes the data argument to the given subject. The data argument is left
  * untouched and needs to be correctly interpreted on the receiver.
@@ -238,6 +356,34 @@ natsConnection_Publish(natsConnection *nc, const char *subj,
     return NATS_UPDATE_ERR_STACK(s);
 }
 
+/*
+ * Same than natsConnection_Publish(), but large payloads may be sent without
+ * being copied, in which case 'releaseCb' is invoked when the data is no
+ * longer referenced. Otherwise, it is invoked before returning.
+ */
+natsStatus
+natsConnection_PublishZeroCopy(natsConnection *nc, const char *subj,
+                               const void *data, int dataLen,
+                               natsBufferReleaseHandler releaseCb, void *closure)
+{
+    natsStatus  s;
+    natsMsg     msg;
+    bool        queued = false;
+
+    if (releaseCb == NULL)
+        return nats_setDefaultError(NATS_INVALID_ARG);
+
+    natsMsg_init(&msg, subj, NULL, (const char*) data, dataLen);
+    s = _publish(nc, &msg, false, releaseCb, closure, &queued);
+
+    if (!queued)
+        (*releaseCb)(nc, data, dataLen, closure);
+    else
+        natsConn_zeroCopyReleaseDone(nc);
+
+    return NATS_UPDATE_ERR_STACK(s);
+}
+
 /*
  * Convenient function to publish a string. This call is equivalent to:
  *
@@ -324,6 +470,71 @@ natsConnection_PublishRequestString(natsConnection *nc, const char *subj,
     return NATS_UPDATE_ERR_STACK(s);
 }
 
+/*
+ * Publishes the given array of messages. All messages are encoded under
+ * a single acquisition of the connection lock and the flusher is kicked
+ * only once for the whole batch.
+ */
+natsStatus
+natsConnection_PublishBatch(natsConnection *nc, natsMsg **msgs, int count,
+                            natsStatus *errors)
+{
+    natsStatus s;
+
+    if ((count > 0) && (msgs == NULL))
+        return nats_setDefaultError(NATS_INVALID_ARG);
+
+    s = _publishBatch(nc, msgs, NULL, count, errors);
+
+    return NATS_UPDATE_ERR_STACK(s);
+}
+
+/*
+ * Same than natsConnection_PublishBatch() but the messages are described
+ * by arrays of subjects, data and data lengths.
+ */
+natsStatus
+natsConnection_PublishBatchData(natsConnection *nc, const char **subjects,
+                                const void **data, const int *dataLen,
+                                int count, natsStatus *errors)
+{
+    natsStatus  s       = NATS_OK;
+    natsMsg     *msgs   = NULL;
+    natsMsg     local[32];
+    int         i;
+
+    if ((count > 0) && ((subjects == NULL)
+                        || ((data != NULL) && (dataLen == NULL))))
+    {
+        return nats_setDefaultError(NATS_INVALID_ARG);
+    }
+
+    if (count > (int) (sizeof(local)/sizeof(natsMsg)))
+    {
+        msgs = (natsMsg*) NATS_MALLOC(count * sizeof(natsMsg));
+        if (msgs == NULL)
+            return nats_setDefaultError(NATS_NO_MEMORY);
+    }
+    else
+    {
+        msgs = local;
+    }
+
+    for (i=0; i<count; i++)
+    {
+        natsMsg_init(&(msgs[i]), subjects[i], NULL,
+                     (const char*) (data != NULL ? data[i] : NULL),
+                     (data != NULL ? dataLen[i] : 0));
+    }
+
+    s = _publishBatch(nc, NULL, msgs, count, errors);
+
+    if (msgs != local)
+        NATS_FREE(msgs);
+
+    return NATS_UPDATE_ERR_STACK(s);
+}
+
 // Old way of sending a request...
 static natsStatus
 _oldRequestMsg(natsMsg **replyMsg, natsConnection *nc,
@@ -352,40 +563,296 @@ _oldRequestMsg(natsMsg **replyMsg, natsConnection *nc,
 }
 
 static void
-_respHandler(natsConnection *nc, natsSubscription *sub, natsMsg *msg, void *closure)
+_releaseAsyncRequest(respInfo *resp)
 {
-    char        *rt   = NULL;
-    const char  *subj = NULL;
-    respInfo    *resp = NULL;
-    bool        dmsg  = true;
+    natsConnection  *nc = resp->nc;
+    int             refs;
 
-    natsConn_Lock(nc);
-    if (natsConn_isClosed(nc))
+    natsMutex_Lock(resp->mu);
+    refs = --(resp->refs);
+    natsMutex_Unlock(resp->mu);
+
+    if (refs > 0)
+        return;
+
+    natsTimer_Destroy(resp->timer);
+    resp->timer = NULL;
+    natsConn_disposeRespInfo(nc, resp, true);
+    natsConn_release(nc);
+}
+
+// Returns true if the caller is the one completing, or cancelling, the
+// asynchronous request.
+static bool
+_claimAsyncRequest(respInfo *resp)
+{
+    bool claimed = false;
+
+    natsMutex_Lock(resp->mu);
+    if (!resp->removed)
+    {
+        resp->removed = true;
+        claimed = true;
+    }
+    natsMutex_Unlock(resp->mu);
+
+    return claimed;
+}
+
+// Invokes the reply handler of a request claimed by the caller, and releases
+// the reference held while the request was in flight.
+static void
+_completeAsyncRequest(respInfo *resp, natsMsg *msg, natsStatus s)
+{
+    natsTimer_Stop(resp->timer);
+
+    // For servers that support it, we may receive an empty message
+    // with a 503 status header.
+    if ((msg != NULL) && natsMsg_IsNoResponders(msg))
     {
-        natsConn_Unlock(nc);
         natsMsg_Destroy(msg);
-        return;
+        msg = NULL;
+        s   = NATS_NO_RESPONDERS;
+    }
+
+    (*(resp->cb))(resp->nc, msg, s, resp->cbClosure);
+
+    _releaseAsyncRequest(resp);
+}
+
+// Removes the request from the connection's map. Returns false if it was
+// not there (it has been, or is being, completed).
+static bool
+_removeAsyncRequest(respInfo *resp)
+{
+    return (natsConn_removeRespInfo(resp->nc, resp->reqId) != NULL);
+}
+
+static void
+_asyncRequestTimeoutCb(natsTimer *timer, void *closure)
+{
+    respInfo    *resp    = (respInfo*) closure;
+    natsStatus  s        = NATS_TIMEOUT;
+    bool        complete = false;
+
+    _removeAsyncRequest(resp);
+
+    natsMutex_Lock(resp->mu);
+    if (resp->closed)
+        s = resp->closedSts;
+    else if (resp->replies > 0)
+        s = NATS_OK;
+    if (!resp->removed)
+    {
+        resp->removed = true;
+        // If a reply is being delivered, the completion is done once its
+        // handler returns, so that it is always the last invocation.
+        if (resp->inCb > 0)
+        {
+            resp->donePending = true;
+            resp->doneSts     = s;
+        }
+        else
+        {
+            complete = true;
+        }
     }
-    subj = natsMsg_GetSubject(msg);
-    // We look for the reply token by first checking that the message subject
+    natsMutex_Unlock(resp->mu);
+
+    if (complete)
+        _completeAsyncRequest(resp, NULL, s);
+}
+
+// Invokes the reply handler of an asynchronous request collecting more than
+// one reply (if `msg` is not NULL), and then completes the request if it
+// was done in the meantime.
+static void
+_deliverManyReply(respInfo *resp, natsMsg *msg)
+{
+    natsStatus  s        = NATS_OK;
+    bool        complete = false;
+
+    if (msg != NULL)
+        (*(resp->cb))(resp->nc, msg, NATS_OK, resp->cbClosure);
+
+    natsMutex_Lock(resp->mu);
+    resp->inCb--;
+    if (resp->donePending && (resp->inCb == 0))
+    {
+        resp->donePending = false;
+        complete = true;
+        s = resp->doneSts;
+    }
+    natsMutex_Unlock(resp->mu);
+
+    if (complete)
+        _completeAsyncRequest(resp, NULL, s);
+
+    // Release the reference taken by _respHandler.
+    _releaseAsyncRequest(resp);
+}
+
+// Adds the reply to a request collecting more than one. Returns true if the
+// message is now owned by the request.
+// Lock of the request's stripe is held on entry.
+static bool
+_addManyReply(natsConnection *nc, respInfo *resp, natsMsg *msg, bool *deliver)
+{
+    bool    keep = false;
+    bool    done = false;
+    int64_t now  = 0;
+
+    natsMutex_Lock(resp->mu);
+    if (!resp->removed)
+    {
+        // For servers that support it, we may receive an empty message
+        // with a 503 status header, which is the only "reply" then.
+        if (natsMsg_IsNoResponders(msg))
+        {
+            if (resp->replies == 0)
+            {
+                done = true;
+                resp->doneSts = NATS_NO_RESPONDERS;
+            }
+        }
+        else
+        {
+            keep = true;
+            resp->replies++;
+            done = ((resp->maxReplies > 0) && (resp->replies >= resp->maxReplies));
+            resp->doneSts = NATS_OK;
+            if (resp->stallTimeout > 0)
+                resp->lastReply = now = nats_Now();
+        }
+        if (done)
+        {
+            natsHash_Remove(natsConn_respStripe(nc, resp->reqId)->map, resp->reqId);
+            resp->removed = true;
+        }
+        if (resp->cb == NULL)
+        {
+            if (keep)
+            {
+                if (resp->msgList.head == NULL)
+                    resp->msgList.head = msg;
+                else
+                    resp->msgList.tail->next = msg;
+                resp->msgList.tail = msg;
+                resp->msgList.msgs++;
+            }
+            // The requestor needs to recompute its wait on the first reply
+            // when there is a stall timeout, otherwise only when done.
+            if (done || (keep && (resp->stallTimeout > 0) && (resp->replies == 1)))
+                natsCondition_Signal(resp->cond);
+        }
+        else if (keep || done)
+        {
+            // Hold a reference while the handler is invoked, since the
+            // request may be cancelled and destroyed meanwhile.
+            resp->refs++;
+            resp->inCb++;
+            if (done)
+                resp->donePending = true;
+            *deliver = true;
+
+            // Move the timer to the end of the stall timeout, unless
+            // the deadline comes first.
+            if (!done && (resp->stallTimeout > 0))
+            {
+                int64_t wait = resp->deadline - now;
+
+                if (resp->stallTimeout < wait)
+                    wait = resp->stallTimeout;
+                if (wait > 0)
+                    natsTimer_Reset(resp->timer, wait);
+            }
+        }
+    }
+    natsMutex_Unlock(resp->mu);
+
+    return keep;
+}
+
+static void
+_asyncRequestTimerStopCb(natsTimer *timer, void *closure)
+{
+    _releaseAsyncRequest((respInfo*) closure);
+}
+
+static void
+_respHandler(natsConnection *nc, natsSubscription *sub, natsMsg *msg, void *closure)
+{
+    const char  *subj = natsMsg_GetSubject(msg);
+    respInfo    *resp = NULL;
+    respInfo    *async= NULL;
+    int64_t     reqId = 0;
+    int         first = 0;
+    int         last  = NATS_RESP_MAP_STRIPES - 1;
+    bool        dmsg  = true;
+    bool        many  = false;
+    int         i;
+
+    // We look for the request ID by first checking that the message subject
     // prefix matches the subscription's subject (without the last '*').
     // It is possible that it does not due to subject rewrite (JetStream).
+    // If the last token is not a request ID we handed out, consider that
+    // the subject was rewritten too.
     if ((strlen(subj) > NATS_REQ_ID_OFFSET)
         && (memcmp((const void*) sub->subject, (const void*) subj, strlen(sub->subject) - 1) == 0))
     {
-        rt = (char*) (natsMsg_GetSubject(msg) + NATS_REQ_ID_OFFSET);
-        resp = (respInfo*) natsStrHash_Remove(nc->respMap, rt);
+        reqId = nats_ParseInt64(subj + NATS_REQ_ID_OFFSET, (int) strlen(subj + NATS_REQ_ID_OFFSET));
+        if (reqId > 0)
+            first = last = natsConn_respStripeIdx(reqId);
+        else
+            reqId = 0;
     }
-    else if (natsStrHash_Count(nc->respMap) == 1)
+
+    // Only the stripe of this request ID is locked, unless we need to
+    // look at all of them (see below).
+    for (i=first; i<=last; i++)
+        natsMutex_Lock(nc->respMap[i].mu);
+
+    // A request collecting more than one reply is left in the map.
+    if (reqId > 0)
     {
+        resp = (respInfo*) natsHash_Get(nc->respMap[first].map, reqId);
+        if ((resp != NULL) && !resp->many)
+            natsHash_Remove(nc->respMap[first].map, reqId);
+    }
+    else
+    {
+        int count = 0;
+
+        for (i=first; i<=last; i++)
+            count += natsHash_Count(nc->respMap[i].map);
+
         // Only if the subject is completely different, we assume that it
         // could be the server that has rewritten the subject and so if there
         // is a single entry, use that.
-        void *value = NULL;
-        natsStrHash_RemoveSingle(nc->respMap, NULL, &value);
-        resp = (respInfo*) value;
+        for (i=first; (count == 1) && (i<=last); i++)
+        {
+            natsHashIter    iter;
+            void            *value = NULL;
+
+            if (natsHash_Count(nc->respMap[i].map) == 1)
+            {
+                natsHashIter_Init(&iter, nc->respMap[i].map);
+                if (natsHashIter_Next(&iter, NULL, &value))
+                {
+                    resp = (respInfo*) value;
+                    if (!resp->many)
+                        natsHashIter_RemoveCurrent(&iter);
+                }
+                natsHashIter_Done(&iter);
+                break;
+            }
+        }
+    }
+    if ((resp != NULL) && resp->many)
+    {
+        dmsg = !_addManyReply(nc, resp, msg, &many);
     }
-    if (resp != NULL)
+    else if ((resp != NULL) && (resp->cb == NULL))
     {
         natsMutex_Lock(resp->mu);
         // Check for the race where the requestor has already timed-out.
@@ -401,10 +868,26 @@ _respHandler(natsConnection *nc, natsSubscription *sub, natsMsg *msg, void *clos
         }
         natsMutex_Unlock(resp->mu);
     }
-    natsConn_Unlock(nc);
+    else if ((resp != NULL) && _claimAsyncRequest(resp))
+    {
+        async = resp;
+        dmsg  = false;
+    }
+
+    for (i=last; i>=first; i--)
+        natsMutex_Unlock(nc->respMap[i].mu);
 
     if (dmsg)
+    {
         natsMsg_Destroy(msg);
+        msg = NULL;
+    }
+
+    // The reply handler is invoked without holding any lock.
+    if (async != NULL)
+        _completeAsyncRequest(async, msg, NATS_OK);
+    else if (many)
+        _deliverManyReply(resp, msg);
 }
 
 /*
@@ -494,13 +977,8 @@ natsConnection_RequestMsg(natsMsg **replyMsg, natsConnection *nc,
         }
     }
     // Common to success or if we failed to create the sub, send the request...
-    if (needsRemoval)
-    {
-        natsConn_Lock(nc);
-        if (nc->respMap != NULL)
-            natsStrHash_Remove(nc->respMap, respInbox+NATS_REQ_ID_OFFSET);
-        natsConn_Unlock(nc);
-    }
+    if (needsRemoval && (resp != NULL))
+        natsConn_removeRespInfo(nc, resp->reqId);
     natsConn_disposeRespInfo(nc, resp, true);
 
     natsConn_release(nc);
@@ -543,3 +1021,294 @@ natsConnection_Request(natsMsg **replyMsg, natsConnection *nc, const char *subj,
 
     return NATS_UPDATE_ERR_STACK(s);
 }
+
+/*
+ * Sends a request and collects the replies until `maxReplies` are received,
+ * the timeout expires or, if `stallTimeout` is positive, no reply has been
+ * received for that long after the first one.
+ */
+natsStatus
+natsConnection_RequestMany(natsMsg ***replies, int *count, natsConnection *nc,
+                           natsMsg *m, int maxReplies, int64_t timeout,
+                           int64_t stallTimeout)
+{
+    natsStatus          s           = NATS_OK;
+    respInfo            *resp       = NULL;
+    natsMsg             *list       = NULL;
+    natsMsg             *next       = NULL;
+    natsMsg             **msgs      = NULL;
+    bool                needsRemoval= true;
+    int                 n           = 0;
+    int64_t             deadline    = 0;
+    int64_t             now         = 0;
+    int64_t             wait        = 0;
+    int                 i;
+    char                respInbox[NATS_INBOX_PRE_LEN + NUID_BUFFER_LEN + 1 + NATS_MAX_REQ_ID_LEN + 1]; // _INBOX.<nuid>.<reqId>
+
+    if ((replies == NULL) || (count == NULL) || (nc == NULL) || (m == NULL)
+        || (maxReplies < 0) || (timeout <= 0) || (stallTimeout < 0))
+    {
+        return nats_setDefaultError(NATS_INVALID_ARG);
+    }
+
+    *replies = NULL;
+    *count   = 0;
+
+    natsConn_Lock(nc);
+    if (natsConn_isClosed(nc))
+    {
+        natsConn_Unlock(nc);
+        return nats_setDefaultError(NATS_CONNECTION_CLOSED);
+    }
+
+    natsConn_retain(nc);
+
+    if (nc->respMux == NULL)
+        s = natsConn_initResp(nc, _respHandler);
+    if (s == NATS_OK)
+        s = natsConn_addRespInfo(&resp, nc, respInbox, sizeof(respInbox));
+    if (s == NATS_OK)
+    {
+        resp->many          = true;
+        resp->maxReplies    = maxReplies;
+        resp->stallTimeout  = stallTimeout;
+    }
+
+    natsConn_Unlock(nc);
+
+    if (s == NATS_OK)
+    {
+        deadline = nats_Now() + timeout;
+
+        m->reply = (const char*) respInbox;
+        s = natsConn_publish(nc, m, true);
+        m->reply = NULL;
+    }
+    if (s == NATS_OK)
+    {
+        natsMutex_Lock(resp->mu);
+        // `removed` is set by _respHandler when done, or on close.
+        while (!resp->removed)
+        {
+            now  = nats_Now();
+            wait = deadline - now;
+            if ((stallTimeout > 0) && (resp->replies > 0)
+                && (resp->lastReply + stallTimeout - now < wait))
+            {
+                wait = resp->lastReply + stallTimeout - now;
+            }
+            if (wait <= 0)
+                break;
+
+            natsCondition_TimedWait(resp->cond, resp->mu, wait);
+        }
+        if (resp->closed)
+            s = resp->closedSts;
+
+        list = resp->msgList.head;
+        n    = resp->msgList.msgs;
+        memset(&(resp->msgList), 0, sizeof(natsMsgList));
+
+        // No-responders is the only case where we are done without reply.
+        if ((s == NATS_OK) && (n == 0))
+            s = (resp->removed ? NATS_NO_RESPONDERS : NATS_TIMEOUT);
+
+        needsRemoval = !resp->removed;
+        // Signal to _respHandler that we are no longer interested.
+        resp->removed = true;
+        natsMutex_Unlock(resp->mu);
+    }
+    if (s == NATS_OK)
+    {
+        msgs = (natsMsg**) NATS_CALLOC(n, sizeof(natsMsg*));
+        if (msgs == NULL)
+            s = nats_setDefaultError(NATS_NO_MEMORY);
+    }
+    for (i=0; list != NULL; i++)
+    {
+        next       = list->next;
+        list->next = NULL;
+        if (s == NATS_OK)
+            msgs[i] = list;
+        else
+            natsMsg_Destroy(list);
+        list = next;
+    }
+    if (s == NATS_OK)
+    {
+        *replies = msgs;
+        *count   = n;
+    }
+
+    if (needsRemoval && (resp != NULL))
+        natsConn_removeRespInfo(nc, resp->reqId);
+    natsConn_disposeRespInfo(nc, resp, true);
+
+    natsConn_release(nc);
+
+    return NATS_UPDATE_ERR_STACK(s);
+}
+
+// Sends a request and invokes the reply handler with the reply (or the
+// replies if `many` is true), or an error, without blocking the calling
+// thread.
+static natsStatus
+_requestMsgAsync(natsRequest **req, natsConnection *nc, natsMsg *m,
+                 bool many, int maxReplies, int64_t timeout, int64_t stallTimeout,
+                 natsReplyHandler cb, void *closure)
+{
+    natsStatus          s           = NATS_OK;
+    respInfo            *resp       = NULL;
+    char                respInbox[NATS_INBOX_PRE_LEN + NUID_BUFFER_LEN + 1 + NATS_MAX_REQ_ID_LEN + 1]; // _INBOX.<nuid>.<reqId>
+
+    if ((nc == NULL) || (m == NULL) || (cb == NULL) || (timeout <= 0)
+        || (maxReplies < 0) || (stallTimeout < 0))
+    {
+        return nats_setDefaultError(NATS_INVALID_ARG);
+    }
+
+    natsConn_Lock(nc);
+    if (natsConn_isClosed(nc))
+    {
+        natsConn_Unlock(nc);
+        return nats_setDefaultError(NATS_CONNECTION_CLOSED);
+    }
+
+    if (nc->respMux == NULL)
+        s = natsConn_initResp(nc, _respHandler);
+    if (s == NATS_OK)
+        s = natsConn_addRespInfo(&resp, nc, respInbox, sizeof(respInbox));
+    if (s == NATS_OK)
+    {
+        // One reference while in flight, one for the timer and one for
+        // the user, if the request object is returned.
+        resp->refs      = ((req != NULL) ? 3 : 2);
+        resp->nc        = nc;
+        resp->cb        = cb;
+        resp->cbClosure = closure;
+        if (many)
+        {
+            resp->many          = true;
+            resp->maxReplies    = maxReplies;
+            resp->deadline      = nats_Now() + timeout;
+            resp->stallTimeout  = stallTimeout;
+        }
+
+        natsConn_retain(nc);
+
+        s = natsTimer_Create(&(resp->timer), _asyncRequestTimeoutCb,
+                             _asyncRequestTimerStopCb, timeout, (void*) resp);
+        if (s != NATS_OK)
+        {
+            natsConn_removeRespInfo(nc, resp->reqId);
+            resp->cb  = NULL;
+            resp->nc  = NULL;
+            natsConn_disposeRespInfo(nc, resp, false);
+            natsConn_release(nc);
+            resp = NULL;
+        }
+    }
+
+    natsConn_Unlock(nc);
+
+    if (s != NATS_OK)
+        return NATS_UPDATE_ERR_STACK(s);
+
+    m->reply = (const char*) respInbox;
+    s = natsConn_publish(nc, m, true);
+    m->reply = NULL;
+    if ((s != NATS_OK) && _removeAsyncRequest(resp) && _claimAsyncRequest(resp))
+    {
+        // The handler will not be invoked, drop the in-flight and user
+        // references (the timer's one is released when stopped).
+        natsTimer_Stop(resp->timer);
+        _releaseAsyncRequest(resp);
+        if (req != NULL)
+            _releaseAsyncRequest(resp);
+
+        return NATS_UPDATE_ERR_STACK(s);
+    }
+
+    // From now on, the handler will be invoked, even if the publish failed
+    // because the connection was closed in the meantime.
+    if (req != NULL)
+        *req = resp;
+
+    if (s != NATS_OK)
+        nats_clearLastError();
+
+    return NATS_OK;
+}
+
+/*
+ * Sends a request and invokes the reply handler with the first reply, or
+ * an error, without blocking the calling thread.
+ */
+natsStatus
+natsConnection_RequestMsgAsync(natsRequest **req, natsConnection *nc,
+                               natsMsg *m, int64_t timeout,
+                               natsReplyHandler cb, void *closure)
+{
+    natsStatus s;
+
+    s = _requestMsgAsync(req, nc, m, false, 0, timeout, 0, cb, closure);
+
+    return NATS_UPDATE_ERR_STACK(s);
+}
+
+natsStatus
+natsConnection_RequestAsync(natsRequest **req, natsConnection *nc, const char *subj,
+                            const void *data, int dataLen, int64_t timeout,
+                            natsReplyHandler cb, void *closure)
+{
+    natsStatus s;
+    natsMsg    msg;
+
+    natsMsg_init(&msg, subj, NULL, (const char*) data, dataLen);
+    s = natsConnection_RequestMsgAsync(req, nc, &msg, timeout, cb, closure);
+
+    return NATS_UPDATE_ERR_STACK(s);
+}
+
+/*
+ * Sends a request and invokes the reply handler with each reply, and then
+ * once more without a reply when done, without blocking the calling thread.
+ */
+natsStatus
+natsConnection_RequestManyAsync(natsRequest **req, natsConnection *nc,
+                                natsMsg *m, int maxReplies, int64_t timeout,
+                                int64_t stallTimeout, natsReplyHandler cb,
+                                void *closure)
+{
+    natsStatus s;
+
+    s = _requestMsgAsync(req, nc, m, true, maxReplies, timeout, stallTimeout, cb, closure);
+
+    return NATS_UPDATE_ERR_STACK(s);
+}
+
+natsStatus
+natsRequest_Cancel(natsRequest *req)
+{
+    if (req == NULL)
+        return nats_setDefaultError(NATS_INVALID_ARG);
+
+    _removeAsyncRequest(req);
+
+    if (!_claimAsyncRequest(req))
+        return nats_setError(NATS_ILLEGAL_STATE, "%s", "Request already completed");
+
+    natsTimer_Stop(req->timer);
+    _releaseAsyncRequest(req);
+
+    return NATS_OK;
+}
+
+void
+natsRequest_Destroy(natsRequest *req)
+{
+    if (req == NULL)
+        return;
+
+    _releaseAsyncRequest(req);
+}
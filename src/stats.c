@@ -55,6 +55,56 @@ natsStatistics_GetCounts(const natsStatistics *stats,
     return NATS_OK;
 }
 
+natsStatus
+natsStatistics_GetFlushCounts(const natsStatistics *stats,
+                              uint64_t *flushes, uint64_t *flushedBytes,
+                              uint64_t *flushTime, uint64_t *maxFlushTime)
+{
+    if (stats == NULL)
+        return nats_setDefaultError(NATS_INVALID_ARG);
+
+    if (flushes != NULL)
+        *flushes = stats->flushes;
+    if (flushedBytes != NULL)
+        *flushedBytes = stats->flushedBytes;
+    if (flushTime != NULL)
+        *flushTime = stats->flushTime;
+    if (maxFlushTime != NULL)
+        *maxFlushTime = stats->maxFlushTime;
+
+    return NATS_OK;
+}
+
+natsStatus
+natsStatistics_GetMsgPoolCounts(const natsStatistics *stats,
+                                uint64_t *hits, uint64_t *misses)
+{
+    if (stats == NULL)
+        return nats_setDefaultError(NATS_INVALID_ARG);
+
+    if (hits != NULL)
+        *hits = stats->msgPoolHits;
+    if (misses != NULL)
+        *misses = stats->msgPoolMisses;
+
+    return NATS_OK;
+}
+
+natsStatus
+natsStatistics_GetTLSSessionCounts(const natsStatistics *stats,
+                                   uint64_t *hits, uint64_t *misses)
+{
+    if (stats == NULL)
+        return nats_setDefaultError(NATS_INVALID_ARG);
+
+    if (hits != NULL)
+        *hits = stats->tlsSessionHits;
+    if (misses != NULL)
+        *misses = stats->tlsSessionMisses;
+
+    return NATS_OK;
+}
+
 void
 natsStatistics_Destroy(natsStatistics *stats)
 {
@@ -27,6 +27,20 @@ struct __natsStatistics
     uint64_t    outBytes;
     uint64_t    reconnects;
 
+    // Flusher statistics, times are in microseconds.
+    uint64_t    flushes;
+    uint64_t    flushedBytes;
+    uint64_t    flushTime;
+    uint64_t    maxFlushTime;
+
+    // Message pool statistics.
+    uint64_t    msgPoolHits;
+    uint64_t    msgPoolMisses;
+
+    // TLS handshakes that resumed a cached session, and full handshakes.
+    uint64_t    tlsSessionHits;
+    uint64_t    tlsSessionMisses;
+
 };
 
 #endif /* STATS_H_ */
@@ -21,6 +21,8 @@
 #include "sub.h"
 #include "msg.h"
 #include "util.h"
+#include "msgring.h"
+#include "subpart.h"
 
 #ifdef DEV_MODE
 
@@ -58,6 +60,9 @@ _freeSubscription(natsSubscription *sub)
         sub->msgList.head = m->next;
         natsMsg_Destroy(m);
     }
+    natsMsgRing_Destroy(sub->ring);
+    natsSubParts_Destroy(sub->parts);
+    NATS_FREE(sub->batchMsgs);
 
     NATS_FREE(sub->subject);
     NATS_FREE(sub->queue);
@@ -135,6 +140,184 @@ natsSub_setDrainCompleteState(natsSubscription *sub)
     natsSub_Unlock(sub);
 }
 
+// In ring mode, messages put back by _reattachMsgs() are in the list and
+// precede the ones still in the ring.
+#define _peekMsg(s) (((s)->msgList.head == NULL) && ((s)->ring != NULL) ? natsMsgRing_Peek((s)->ring) : (s)->msgList.head)
+
+// True if a batch subscription has enough pending messages for a full batch
+// (or to reach the max). Subscription lock held on entry.
+#define _batchFull(s)   ((natsSub_pendingMsgs(s) >= (s)->maxBatch) \
+                         || (((s)->max > 0) && (((s)->delivered >= (s)->max) \
+                             || ((uint64_t) natsSub_pendingMsgs(s) >= (s)->max - (s)->delivered))))
+
+// Removes up to `limit` messages from the pending list (or ring) of the
+// subscription and returns them linked through their `next` field. The
+// pending counters are updated as the messages are delivered.
+// Subscription lock held on entry.
+static natsMsg*
+_detachMsgs(natsSubscription *sub, int limit)
+{
+    natsMsg *head   = NULL;
+    natsMsg *tail   = NULL;
+    natsMsg *msg    = NULL;
+    int     n       = 0;
+
+    while ((n < limit) && ((msg = _peekMsg(sub)) != NULL))
+    {
+        if (sub->msgList.head == msg)
+        {
+            sub->msgList.head = msg->next;
+            if (sub->msgList.tail == msg)
+                sub->msgList.tail = NULL;
+        }
+        else
+        {
+            natsMsgRing_Pop(sub->ring);
+        }
+
+        msg->next = NULL;
+        if (tail == NULL)
+            head = msg;
+        else
+            tail->next = msg;
+        tail = msg;
+        n++;
+    }
+    return head;
+}
+
+// Puts back, in front of the pending list, the messages of a batch that
+// were not delivered. Subscription lock held on entry.
+static void
+_reattachMsgs(natsSubscription *sub, natsMsg *batch)
+{
+    natsMsg *last = batch;
+
+    while (last->next != NULL)
+        last = last->next;
+
+    last->next = sub->msgList.head;
+    sub->msgList.head = batch;
+    if (sub->msgList.tail == NULL)
+        sub->msgList.tail = last;
+}
+
+// Invokes the callback for the messages in `batch` (linked through their
+// `next` field) that the caller detached from the subscription's pending
+// messages. `base` and `max` are the delivered count and max captured
+// when the batch was detached. Delivery stops when the max is reached,
+// in which case `rmSub` is set to true, or as soon as the max has been
+// changed or the subscription closed (possibly from the callback). The
+// number of messages consumed is stored in `done` and the messages that
+// were not delivered are returned.
+natsMsg*
+natsSub_deliverBatch(natsSubscription *sub, natsMsgHandler mcb, void *mcbClosure,
+                     natsMsg *batch, uint64_t base, uint64_t max, int32_t gen,
+                     int *done, bool *rmSub)
+{
+    natsConnection  *nc = sub->conn;
+    natsMsg         *msg;
+    uint64_t        delivered;
+    int             n = 0;
+    int             i;
+
+    *rmSub = false;
+
+    // Batch subscriptions: the caller detached at most 'maxBatch' messages,
+    // and never past the max (unless the max was already reached, in which
+    // case there is a single message that is discarded).
+    if ((sub->batchCb != NULL) && (batch != NULL))
+    {
+        int bytes = 0;
+
+        while ((msg = batch) != NULL)
+        {
+            batch = msg->next;
+            msg->next = NULL;
+
+            sub->batchMsgs[n++] = msg;
+            bytes += msg->dataLen;
+        }
+        nats_atomicAdd(&(sub->dlvBatchMsgs), n);
+        nats_atomicAdd(&(sub->dlvBatchBytes), bytes);
+
+        if ((max == 0) || (base + (uint64_t) n <= max))
+        {
+            (*(sub->batchCb))(nc, sub, sub->batchMsgs, n, mcbClosure);
+        }
+        else
+        {
+            for (i=0; i<n; i++)
+                natsMsg_Destroy(sub->batchMsgs[i]);
+        }
+        *rmSub = ((max > 0) && (base + (uint64_t) n >= max));
+        *done  = n;
+
+        return NULL;
+    }
+
+    while ((msg = batch) != NULL)
+    {
+        batch = msg->next;
+        msg->next = NULL;
+
+        delivered = base + (uint64_t) (++n);
+
+        nats_atomicIncr(&(sub->dlvBatchMsgs));
+        nats_atomicAdd(&(sub->dlvBatchBytes), msg->dataLen);
+
+        if ((max == 0) || (delivered <= max))
+        {
+           (*mcb)(nc, sub, msg, mcbClosure);
+        }
+        else
+        {
+            // We need to destroy the message since the user can't do it
+            natsMsg_Destroy(msg);
+        }
+
+        // Don't do 'else' because we need to remove when we have hit
+        // the max (after the callback returns).
+        if ((max > 0) && (delivered >= max))
+        {
+            *rmSub = true;
+            break;
+        }
+        if (nats_atomicGet(&(sub->dlvGen)) != gen)
+            break;
+    }
+    *done = n;
+
+    return batch;
+}
+
+// Folds the counters of the messages handed to the callback during the
+// last batch into the subscription's delivered count and pending counters.
+// Subscription lock (or delivery worker lock) held on entry.
+void
+natsSub_endBatch(natsSubscription *sub, int done)
+{
+    int bytes;
+
+    if (done == 0)
+        return;
+
+    bytes = nats_atomicGet(&(sub->dlvBatchBytes));
+    sub->delivered += done;
+    if (sub->ring != NULL)
+    {
+        nats_atomicAdd(&(sub->msgList.msgs), -done);
+        nats_atomicAdd(&(sub->msgList.bytes), -bytes);
+    }
+    else
+    {
+        sub->msgList.msgs  -= done;
+        sub->msgList.bytes -= bytes;
+    }
+    nats_atomicAdd(&(sub->dlvBatchMsgs), -done);
+    nats_atomicAdd(&(sub->dlvBatchBytes), -bytes);
+}
+
 // _deliverMsgs is used to deliver messages to asynchronous subscribers.
 void
 natsSub_deliverMsgs(void *arg)
@@ -143,9 +326,13 @@ natsSub_deliverMsgs(void *arg)
     natsConnection      *nc         = sub->conn;
     natsMsgHandler      mcb         = sub->msgCb;
     void                *mcbClosure = sub->msgCbClosure;
-    uint64_t            delivered;
+    uint64_t            base;
     uint64_t            max;
     natsMsg             *msg;
+    natsMsg             *batch;
+    int                 limit;
+    int                 done;
+    int32_t             gen;
     int64_t             timeout;
     natsStatus          s = NATS_OK;
     bool                draining = false;
@@ -166,14 +353,35 @@ natsSub_deliverMsgs(void *arg)
         natsSub_Lock(sub);
 
         s = NATS_OK;
-        while (((msg = sub->msgList.head) == NULL) && !(sub->closed) && !(sub->draining) && (s != NATS_TIMEOUT))
+        while (((msg = _peekMsg(sub)) == NULL) && !(sub->closed) && !(sub->draining) && (s != NATS_TIMEOUT))
         {
+            // Before going idle, free what the callback may have deferred.
+            if (natsGC_hasThreadBatch())
+            {
+                natsSub_Unlock(sub);
+                natsGC_freeThreadBatch();
+                natsSub_Lock(sub);
+                continue;
+            }
+            if (sub->ring != NULL)
+            {
+                // Let the reader know that it needs to signal us, then
+                // check again in case a message was added in between.
+                nats_atomicIncr(&(sub->ring->parked));
+                if (!natsMsgRing_IsEmpty(sub->ring))
+                {
+                    nats_atomicDecr(&(sub->ring->parked));
+                    continue;
+                }
+            }
             sub->inWait++;
             if (timeout != 0)
                 s = natsCondition_TimedWait(sub->cond, sub->mu, timeout);
             else
                 natsCondition_Wait(sub->cond, sub->mu);
             sub->inWait--;
+            if (sub->ring != NULL)
+                nats_atomicDecr(&(sub->ring->parked));
         }
 
         if (sub->closed)
@@ -198,41 +406,58 @@ natsSub_deliverMsgs(void *arg)
             continue;
         }
 
-        delivered = ++(sub->delivered);
-
-        sub->msgList.head = msg->next;
+        // Give a chance for the batch of a batch subscription to fill up.
+        if ((sub->maxBatchWait > 0) && !draining && !_batchFull(sub))
+        {
+            int64_t target = nats_setTargetTime(sub->maxBatchWait);
 
-        if (sub->msgList.tail == msg)
-            sub->msgList.tail = NULL;
+            s = NATS_OK;
+            while (!(sub->closed) && !(sub->draining) && !_batchFull(sub) && (s != NATS_TIMEOUT))
+            {
+                if (sub->ring != NULL)
+                    nats_atomicIncr(&(sub->ring->parked));
+                sub->inWait++;
+                if (!_batchFull(sub))
+                    s = natsCondition_AbsoluteTimedWait(sub->cond, sub->mu, target);
+                sub->inWait--;
+                if (sub->ring != NULL)
+                    nats_atomicDecr(&(sub->ring->parked));
+            }
+            if (sub->closed)
+            {
+                natsSub_Unlock(sub);
+                continue;
+            }
+        }
 
-        sub->msgList.msgs--;
-        sub->msgList.bytes -= msg->dataLen;
+        // Detach a batch of messages, never past the max so that the
+        // auto-unsubscribe limit is honored exactly.
+        max   = sub->max;
+        base  = sub->delivered;
+        limit = natsSub_dlvBatchSize(sub);
+        if (max > 0)
+        {
+            if (base >= max)
+                limit = 1;
+            else if ((max - base) < (uint64_t) limit)
+                limit = (int) (max - base);
+        }
+        batch = _detachMsgs(sub, limit);
+        gen   = sub->dlvGen;
 
-        msg->next = NULL;
+        natsSub_Unlock(sub);
 
-        // Capture this under lock.
-        max = sub->max;
+        batch = natsSub_deliverBatch(sub, mcb, mcbClosure, batch, base, max, gen, &done, &rmSub);
 
+        natsSub_Lock(sub);
+        natsSub_endBatch(sub, done);
+        if (batch != NULL)
+            _reattachMsgs(sub, batch);
         natsSub_Unlock(sub);
 
-        if ((max == 0) || (delivered <= max))
-        {
-           (*mcb)(nc, sub, msg, mcbClosure);
-        }
-        else
-        {
-            // We need to destroy the message since the user can't do it
-            natsMsg_Destroy(msg);
-        }
-
-        // Don't do 'else' because we need to remove when we have hit
-        // the max (after the callback returns).
-        if ((max > 0) && (delivered >= max))
-        {
-            // If we have hit the max for delivered msgs, remove sub.
-            rmSub = true;
+        // If we have hit the max for delivered msgs, remove sub.
+        if (rmSub)
             break;
-        }
     }
 
     natsSub_Lock(sub);
@@ -256,6 +481,7 @@ natsSub_setMax(natsSubscription *sub, uint64_t max)
     natsSub_Lock(sub);
     SUB_DLV_WORKER_LOCK(sub);
     sub->max = max;
+    nats_atomicIncr(&(sub->dlvGen));
     SUB_DLV_WORKER_UNLOCK(sub);
     natsSub_Unlock(sub);
 }
@@ -292,6 +518,7 @@ natsSub_close(natsSubscription *sub, bool connectionClosed)
     {
         sub->closed = true;
         sub->connClosed = connectionClosed;
+        nats_atomicIncr(&(sub->dlvGen));
 
         if (sub->libDlvWorker != NULL)
         {
@@ -306,7 +533,12 @@ natsSub_close(natsSubscription *sub, bool connectionClosed)
             natsLib_msgDeliveryPostControlMsg(sub);
         }
         else
+        {
+            if (sub->parts != NULL)
+                natsSubParts_Close(sub->parts, false);
+
             natsCondition_Broadcast(sub->cond);
+        }
     }
 
     SUB_DLV_WORKER_UNLOCK(sub);
@@ -317,7 +549,8 @@ natsSub_close(natsSubscription *sub, bool connectionClosed)
 static void
 _asyncTimeoutCb(natsTimer *timer, void* closure)
 {
-    natsSubscription *sub = (natsSubscription*) closure;
+    natsSubscription    *sub = (natsSubscription*) closure;
+    int64_t             remaining;
 
     // Should not happen, but in case
     if (sub->libDlvWorker == NULL)
@@ -325,20 +558,37 @@ _asyncTimeoutCb(natsTimer *timer, void* closure)
 
     SUB_DLV_WORKER_LOCK(sub);
 
-    // If the subscription is closed, or if we are prevented from posting
-    // a "timeout" control message, do nothing.
-    if (!sub->closed && !sub->timedOut && !sub->timeoutSuspended)
+    // If the subscription is closed, or if a "timeout" control message has
+    // already been posted, do nothing.
+    if (!sub->closed && !sub->timedOut)
     {
-        // Prevent from scheduling another control message while we are not
-        // done with previous one.
-        sub->timedOut = true;
+        // The timer is not reset when messages are delivered. If some are
+        // being delivered (we are prevented from posting the control
+        // message), check again in a full timeout. Otherwise, if messages
+        // were delivered since the timer was armed, fire at the deadline
+        // computed from the last delivery.
+        if (sub->timeoutSuspended)
+            remaining = sub->timeout;
+        else
+            remaining = sub->lastActivity + sub->timeout - nats_Now();
 
-        // Set the timer to a very high value, it will be reset from the
-        // worker thread.
-        natsTimer_Reset(sub->timeoutTimer, 60*60*1000);
+        if (remaining > 0)
+        {
+            natsTimer_Reset(sub->timeoutTimer, remaining);
+        }
+        else
+        {
+            // Prevent from scheduling another control message while we are not
+            // done with previous one.
+            sub->timedOut = true;
 
-        // Post a control message to the worker thread.
-        natsLib_msgDeliveryPostControlMsg(sub);
+            // Set the timer to a very high value, it will be reset from the
+            // worker thread.
+            natsTimer_Reset(sub->timeoutTimer, 60*60*1000);
+
+            // Post a control message to the worker thread.
+            natsLib_msgDeliveryPostControlMsg(sub);
+        }
     }
 
     SUB_DLV_WORKER_UNLOCK(sub);
@@ -355,7 +605,7 @@ _asyncTimeoutStopCb(natsTimer *timer, void* closure)
 natsStatus
 natsSub_create(natsSubscription **newSub, natsConnection *nc, const char *subj,
                const char *queueGroup, int64_t timeout, natsMsgHandler cb, void *cbClosure,
-               bool preventUseOfLibDlvPool)
+               bool preventUseOfLibDlvPool, natsSubParams *params)
 {
     natsStatus          s = NATS_OK;
     natsSubscription    *sub = NULL;
@@ -395,22 +645,55 @@ natsSub_create(natsSubscription **newSub, natsConnection *nc, const char *subj,
         if (sub->queue == NULL)
             s = nats_setDefaultError(NATS_NO_MEMORY);
     }
+    if ((s == NATS_OK) && (params != NULL) && (params->batchCb != NULL))
+    {
+        sub->batchCb        = params->batchCb;
+        sub->maxBatch       = params->maxBatch;
+        sub->maxBatchWait   = params->maxBatchWait;
+
+        sub->batchMsgs = (natsMsg**) NATS_CALLOC(sub->maxBatch, sizeof(natsMsg*));
+        if (sub->batchMsgs == NULL)
+            s = nats_setDefaultError(NATS_NO_MEMORY);
+    }
+    if ((s == NATS_OK) && (params != NULL))
+        sub->inlineDlv = params->inlineDlv;
+    if ((s == NATS_OK) && (params != NULL) && (params->partitions != NULL))
+    {
+        if (params->partitions->PendingMsgsLimit != 0)
+            sub->msgsLimit = params->partitions->PendingMsgsLimit;
+        if (params->partitions->PendingBytesLimit != 0)
+            sub->bytesLimit = params->partitions->PendingBytesLimit;
+
+        s = natsSubParts_Create(&(sub->parts), sub, params->partitions);
+    }
     if (s == NATS_OK)
         s = natsCondition_Create(&(sub->cond));
-    if ((s == NATS_OK) && (cb != NULL))
+    if ((s == NATS_OK) && (sub->parts != NULL))
+    {
+        // Messages are delivered by the partitions' own threads.
+        s = natsSubParts_Start(sub->parts);
+        if (s != NATS_OK)
+            natsSubParts_Close(sub->parts, false);
+    }
+    else if ((s == NATS_OK) && (cb != NULL))
     {
         if (!(nc->opts->libMsgDelivery) || preventUseOfLibDlvPool)
         {
-            // Let's not rely on the created thread acquiring the lock that
-            // would make it safe to retain only on success.
-            _retain(sub);
+            if (nc->opts->lockFreeDelivery)
+                s = natsMsgRing_Create(&(sub->ring), sub->msgsLimit);
+            if (s == NATS_OK)
+            {
+                // Let's not rely on the created thread acquiring the lock that
+                // would make it safe to retain only on success.
+                _retain(sub);
 
-            // If we have an async callback, start up a sub specific
-            // thread to deliver the messages.
-            s = natsThread_Create(&(sub->deliverMsgsThread), natsSub_deliverMsgs,
-                                  (void*) sub);
-            if (s != NATS_OK)
-                _release(sub);
+                // If we have an async callback, start up a sub specific
+                // thread to deliver the messages.
+                s = natsThread_Create(&(sub->deliverMsgsThread), natsSub_deliverMsgs,
+                                      (void*) sub);
+                if (s != NATS_OK)
+                    _release(sub);
+            }
         }
         else
         {
@@ -419,6 +702,7 @@ natsSub_create(natsSubscription **newSub, natsConnection *nc, const char *subj,
             if ((s == NATS_OK) && (timeout > 0))
             {
                 _retain(sub);
+                sub->lastActivity = nats_Now();
                 s = natsTimer_Create(&sub->timeoutTimer, _asyncTimeoutCb,
                                      _asyncTimeoutStopCb, timeout, (void*) sub);
                 if (s != NATS_OK)
@@ -457,6 +741,75 @@ natsConnection_Subscribe(natsSubscription **sub, natsConnection *nc, const char
     return NATS_UPDATE_ERR_STACK(s);
 }
 
+// Message handler of batch subscriptions, used when a message needs to be
+// delivered on its own.
+static void
+_batchOfOneMsgCb(natsConnection *nc, natsSubscription *sub, natsMsg *msg, void *closure)
+{
+    (*(sub->batchCb))(nc, sub, &msg, 1, closure);
+}
+
+/*
+ * Similar to natsConnection_Subscribe() except that messages are delivered
+ * to the natsMsgBatchHandler in batches of up to `maxBatch` messages.
+ */
+natsStatus
+natsConnection_SubscribeBatch(natsSubscription **sub, natsConnection *nc, const char *subject,
+                              natsMsgBatchHandler cb, void *cbClosure, int maxBatch, int64_t maxWait)
+{
+    natsStatus      s;
+    natsSubParams   params;
+
+    if ((cb == NULL) || (maxBatch <= 0) || (maxWait < 0))
+        return nats_setDefaultError(NATS_INVALID_ARG);
+
+    memset(&params, 0, sizeof(params));
+    params.batchCb      = cb;
+    params.maxBatch     = maxBatch;
+    params.maxBatchWait = maxWait;
+
+    s = natsConn_subscribeWithParams(sub, nc, subject, _batchOfOneMsgCb, cbClosure, &params);
+
+    return NATS_UPDATE_ERR_STACK(s);
+}
+
+natsStatus
+natsSubPartitionOptions_Init(natsSubPartitionOptions *opts)
+{
+    if (opts == NULL)
+        return nats_setDefaultError(NATS_INVALID_ARG);
+
+    memset(opts, 0, sizeof(natsSubPartitionOptions));
+    return NATS_OK;
+}
+
+/*
+ * Similar to natsConnection_Subscribe() except that messages are dispatched
+ * to `opts->Partitions` threads based on a key, so that messages with the
+ * same key are delivered in order, but others are processed in parallel.
+ */
+natsStatus
+natsConnection_SubscribePartitioned(natsSubscription **sub, natsConnection *nc, const char *subject,
+                                    natsMsgHandler cb, void *cbClosure,
+                                    const natsSubPartitionOptions *opts)
+{
+    natsStatus      s;
+    natsSubParams   params;
+
+    if ((cb == NULL) || (opts == NULL) || (opts->Partitions <= 0)
+        || (opts->SubjectToken < 0))
+    {
+        return nats_setDefaultError(NATS_INVALID_ARG);
+    }
+
+    memset(&params, 0, sizeof(params));
+    params.partitions = opts;
+
+    s = natsConn_subscribeWithParams(sub, nc, subject, cb, cbClosure, &params);
+
+    return NATS_UPDATE_ERR_STACK(s);
+}
+
 /*
  * Similar to natsConnection_Subscribe() except that a timeout is given.
  * If the subscription has not receive any message for the given timeout,
@@ -579,17 +932,15 @@ natsSubscription_NoDeliveryDelay(natsSubscription *sub)
  * one is available. A timeout can be used to return when no message has been
  * delivered.
  */
-natsStatus
-natsSubscription_NextMsg(natsMsg **nextMsg, natsSubscription *sub, int64_t timeout)
+static natsStatus
+_nextMsgs(natsSubscription *sub, natsMsg **msgs, int max, int *count, int64_t timeout)
 {
     natsStatus      s    = NATS_OK;
     natsConnection  *nc  = NULL;
     natsMsg         *msg = NULL;
     bool            removeSub = false;
     int64_t         target    = 0;
-
-    if ((sub == NULL) || (nextMsg == NULL))
-        return nats_setDefaultError(NATS_INVALID_ARG);
+    int             n         = 0;
 
     natsSub_Lock(sub);
 
@@ -667,23 +1018,49 @@ natsSubscription_NextMsg(natsMsg **nextMsg, natsSubscription *sub, int64_t timeo
         }
         else
         {
-            sub->msgList.head = msg->next;
-
-            if (sub->msgList.tail == msg)
-                sub->msgList.tail = NULL;
-
-            sub->msgList.msgs--;
-            sub->msgList.bytes -= msg->dataLen;
-
-            msg->next = NULL;
-
-            sub->delivered++;
-            if (sub->max > 0)
+            while ((s == NATS_OK) && !removeSub && (n < max)
+                   && ((msg = sub->msgList.head) != NULL))
             {
-                if (sub->delivered > sub->max)
-                    s = nats_setDefaultError(NATS_MAX_DELIVERED_MSGS);
-                else if (sub->delivered == sub->max)
-                    removeSub = true;
+                // Past the first message, leave a "no responders" message,
+                // or a message past the max, for the next call to report.
+                if ((n > 0)
+                    && (natsMsg_IsNoResponders(msg)
+                        || ((sub->max > 0) && (sub->delivered >= sub->max))))
+                {
+                    break;
+                }
+
+                sub->msgList.head = msg->next;
+
+                if (sub->msgList.tail == msg)
+                    sub->msgList.tail = NULL;
+
+                sub->msgList.msgs--;
+                sub->msgList.bytes -= msg->dataLen;
+
+                msg->next = NULL;
+
+                sub->delivered++;
+                if (sub->max > 0)
+                {
+                    if (sub->delivered > sub->max)
+                        s = nats_setDefaultError(NATS_MAX_DELIVERED_MSGS);
+                    else if (sub->delivered == sub->max)
+                        removeSub = true;
+                }
+                if (s != NATS_OK)
+                {
+                    natsMsg_Destroy(msg);
+                }
+                else if (natsMsg_IsNoResponders(msg))
+                {
+                    natsMsg_Destroy(msg);
+                    s = NATS_NO_RESPONDERS;
+                }
+                else
+                {
+                    msgs[n++] = msg;
+                }
             }
 
             if (sub->draining && (sub->msgList.msgs == 0))
@@ -695,13 +1072,7 @@ natsSubscription_NextMsg(natsMsg **nextMsg, natsSubscription *sub, int64_t timeo
             _retain(sub);
         }
     }
-    if ((s == NATS_OK) && natsMsg_IsNoResponders(msg))
-    {
-        natsMsg_Destroy(msg);
-        s = NATS_NO_RESPONDERS;
-    }
-    else if (s == NATS_OK)
-        *nextMsg = msg;
+    *count = n;
 
     natsSub_Unlock(sub);
 
@@ -714,6 +1085,35 @@ natsSubscription_NextMsg(natsMsg **nextMsg, natsSubscription *sub, int64_t timeo
     return NATS_UPDATE_ERR_STACK(s);
 }
 
+natsStatus
+natsSubscription_NextMsg(natsMsg **nextMsg, natsSubscription *sub, int64_t timeout)
+{
+    natsStatus  s;
+    int         count = 0;
+
+    if ((sub == NULL) || (nextMsg == NULL))
+        return nats_setDefaultError(NATS_INVALID_ARG);
+
+    s = _nextMsgs(sub, nextMsg, 1, &count, timeout);
+
+    return NATS_UPDATE_ERR_STACK(s);
+}
+
+natsStatus
+natsSubscription_NextMsgs(natsSubscription *sub, natsMsg **msgs, int max, int *count, int64_t timeout)
+{
+    natsStatus s;
+
+    if ((sub == NULL) || (msgs == NULL) || (max <= 0) || (count == NULL))
+        return nats_setDefaultError(NATS_INVALID_ARG);
+
+    *count = 0;
+
+    s = _nextMsgs(sub, msgs, max, count, timeout);
+
+    return NATS_UPDATE_ERR_STACK(s);
+}
+
 static natsStatus
 _unsubscribe(natsSubscription *sub, int max, bool drainMode, int64_t timeout)
 {
@@ -784,7 +1184,12 @@ natsSub_drain(natsSubscription *sub)
         natsLib_msgDeliveryPostControlMsg(sub);
     }
     else
+    {
+        if (sub->parts != NULL)
+            natsSubParts_Close(sub->parts, true);
+
         natsCondition_Broadcast(sub->cond);
+    }
     SUB_DLV_WORKER_UNLOCK(sub);
     natsSub_Unlock(sub);
 }
@@ -1024,13 +1429,20 @@ natsSubscription_GetPending(natsSubscription *sub, int *msgs, int *bytes)
         return nats_setDefaultError(NATS_INVALID_SUBSCRIPTION);
     }
 
+    if (sub->parts != NULL)
+    {
+        natsSubParts_GetStats(sub->parts, -1, msgs, bytes, NULL, NULL, NULL, NULL);
+        natsSub_Unlock(sub);
+        return NATS_OK;
+    }
+
     SUB_DLV_WORKER_LOCK(sub);
 
     if (msgs != NULL)
-        *msgs = sub->msgList.msgs;
+        *msgs = natsSub_pendingMsgs(sub);
 
     if (bytes != NULL)
-        *bytes = sub->msgList.bytes;
+        *bytes = natsSub_pendingBytes(sub);
 
     SUB_DLV_WORKER_UNLOCK(sub);
 
@@ -1062,6 +1474,9 @@ natsSubscription_SetPendingLimits(natsSubscription *sub, int msgLimit, int bytes
     sub->msgsLimit = msgLimit;
     sub->bytesLimit = bytesLimit;
 
+    if (sub->parts != NULL)
+        natsSubParts_SetPendingLimits(sub->parts, msgLimit, bytesLimit);
+
     SUB_DLV_WORKER_UNLOCK(sub);
 
     natsSub_Unlock(sub);
@@ -1114,7 +1529,14 @@ natsSubscription_GetDelivered(natsSubscription *sub, int64_t *msgs)
 
     SUB_DLV_WORKER_LOCK(sub);
 
-    *msgs = (int64_t) sub->delivered;
+    *msgs = (int64_t) natsSub_delivered(sub);
+    if (sub->parts != NULL)
+    {
+        uint64_t delivered = 0;
+
+        natsSubParts_GetStats(sub->parts, -1, NULL, NULL, NULL, NULL, &delivered, NULL);
+        *msgs = (int64_t) delivered;
+    }
 
     SUB_DLV_WORKER_UNLOCK(sub);
 
@@ -1140,6 +1562,8 @@ natsSubscription_GetDropped(natsSubscription *sub, int64_t *msgs)
     SUB_DLV_WORKER_LOCK(sub);
 
     *msgs = sub->dropped;
+    if (sub->parts != NULL)
+        natsSubParts_GetStats(sub->parts, -1, NULL, NULL, NULL, NULL, NULL, msgs);
 
     SUB_DLV_WORKER_UNLOCK(sub);
 
@@ -1170,6 +1594,9 @@ natsSubscription_GetMaxPending(natsSubscription *sub, int *msgs, int *bytes)
     if (bytes != NULL)
         *bytes = sub->bytesMax;
 
+    if (sub->parts != NULL)
+        natsSubParts_GetStats(sub->parts, -1, NULL, NULL, msgs, bytes, NULL, NULL);
+
     SUB_DLV_WORKER_UNLOCK(sub);
 
     natsSub_Unlock(sub);
@@ -1196,6 +1623,9 @@ natsSubscription_ClearMaxPending(natsSubscription *sub)
     sub->msgsMax = 0;
     sub->bytesMax = 0;
 
+    if (sub->parts != NULL)
+        natsSubParts_ClearMaxPending(sub->parts);
+
     SUB_DLV_WORKER_UNLOCK(sub);
 
     natsSub_Unlock(sub);
@@ -1226,10 +1656,10 @@ natsSubscription_GetStats(natsSubscription *sub,
     SUB_DLV_WORKER_LOCK(sub);
 
     if (pendingMsgs != NULL)
-        *pendingMsgs = sub->msgList.msgs;
+        *pendingMsgs = natsSub_pendingMsgs(sub);
 
     if (pendingBytes != NULL)
-        *pendingBytes = sub->msgList.bytes;
+        *pendingBytes = natsSub_pendingBytes(sub);
 
     if (maxPendingMsgs != NULL)
         *maxPendingMsgs = sub->msgsMax;
@@ -1238,11 +1668,21 @@ natsSubscription_GetStats(natsSubscription *sub,
         *maxPendingBytes = sub->bytesMax;
 
     if (deliveredMsgs != NULL)
-        *deliveredMsgs = (int) sub->delivered;
+        *deliveredMsgs = (int) natsSub_delivered(sub);
 
     if (droppedMsgs != NULL)
         *droppedMsgs = sub->dropped;
 
+    if (sub->parts != NULL)
+    {
+        uint64_t delivered = 0;
+
+        natsSubParts_GetStats(sub->parts, -1, pendingMsgs, pendingBytes,
+                              maxPendingMsgs, maxPendingBytes, &delivered, droppedMsgs);
+        if (deliveredMsgs != NULL)
+            *deliveredMsgs = (int64_t) delivered;
+    }
+
     SUB_DLV_WORKER_UNLOCK(sub);
 
     natsSub_Unlock(sub);
@@ -1250,6 +1690,49 @@ natsSubscription_GetStats(natsSubscription *sub,
     return NATS_OK;
 }
 
+natsStatus
+natsSubscription_GetPartitionStats(natsSubscription *sub, int partition,
+        int     *pendingMsgs,
+        int     *pendingBytes,
+        int     *maxPendingMsgs,
+        int     *maxPendingBytes,
+        int64_t *deliveredMsgs,
+        int64_t *droppedMsgs)
+{
+    uint64_t delivered = 0;
+
+    if (sub == NULL)
+        return nats_setDefaultError(NATS_INVALID_ARG);
+
+    natsSub_Lock(sub);
+
+    if (sub->closed)
+    {
+        natsSub_Unlock(sub);
+        return nats_setDefaultError(NATS_INVALID_SUBSCRIPTION);
+    }
+    if (sub->parts == NULL)
+    {
+        natsSub_Unlock(sub);
+        return nats_setError(NATS_INVALID_ARG, "%s", "Subscription is not partitioned");
+    }
+    if ((partition < 0) || (partition >= sub->parts->count))
+    {
+        natsSub_Unlock(sub);
+        return nats_setError(NATS_INVALID_ARG, "Invalid partition %d, subscription has %d",
+                             partition, sub->parts->count);
+    }
+
+    natsSubParts_GetStats(sub->parts, partition, pendingMsgs, pendingBytes,
+                          maxPendingMsgs, maxPendingBytes, &delivered, droppedMsgs);
+    if (deliveredMsgs != NULL)
+        *deliveredMsgs = (int64_t) delivered;
+
+    natsSub_Unlock(sub);
+
+    return NATS_OK;
+}
+
 /*
  * Returns a boolean indicating whether the subscription is still active.
  * This will return false if the subscription has already been closed,
@@ -35,6 +35,18 @@ void natsSub_Unlock(natsSubscription *sub);
 #define natsSub_drainStarted(s)     (((s)->drainState & SUB_DRAIN_STARTED) != 0)
 #define natsSub_drainComplete(s)    (((s)->drainState & SUB_DRAIN_COMPLETE) != 0)
 
+// Maximum number of messages the delivery threads detach from the
+// pending list in a single critical section.
+#define NATS_SUB_DLV_BATCH_SIZE     (64)
+
+#define natsSub_dlvBatchSize(s)     ((s)->batchCb != NULL ? (s)->maxBatch : NATS_SUB_DLV_BATCH_SIZE)
+
+// Messages detached by the delivery thread stay accounted as pending (and
+// not delivered) until they are handed to the callback.
+#define natsSub_delivered(s)    ((s)->delivered + (uint64_t) nats_atomicGet(&((s)->dlvBatchMsgs)))
+#define natsSub_pendingMsgs(s)  ((s)->msgList.msgs - nats_atomicGet(&((s)->dlvBatchMsgs)))
+#define natsSub_pendingBytes(s) ((s)->msgList.bytes - nats_atomicGet(&((s)->dlvBatchBytes)))
+
 extern bool testDrainAutoUnsubRace;
 
 void
@@ -46,7 +58,15 @@ natsSub_release(natsSubscription *sub);
 natsStatus
 natsSub_create(natsSubscription **newSub, natsConnection *nc, const char *subj,
                const char *queueGroup, int64_t timeout, natsMsgHandler cb, void *cbClosure,
-               bool noLibDlvPool);
+               bool noLibDlvPool, natsSubParams *params);
+
+natsMsg*
+natsSub_deliverBatch(natsSubscription *sub, natsMsgHandler mcb, void *mcbClosure,
+                     natsMsg *batch, uint64_t base, uint64_t max, int32_t gen,
+                     int *done, bool *rmSub);
+
+void
+natsSub_endBatch(natsSubscription *sub, int done);
 
 void
 natsSub_setMax(natsSubscription *sub, uint64_t max);
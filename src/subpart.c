@@ -0,0 +1,458 @@
+// Copyright 2015-2021 The NATS Authors
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "natsp.h"
+
+#include <string.h>
+
+#include "mem.h"
+#include "conn.h"
+#include "sub.h"
+#include "msg.h"
+#include "hash.h"
+#include "util.h"
+#include "gc.h"
+#include "subpart.h"
+
+natsStatus
+natsSubParts_Create(natsSubPartitions **newParts, natsSubscription *sub,
+                    const natsSubPartitionOptions *opts)
+{
+    natsStatus          s       = NATS_OK;
+    natsSubPartitions   *parts  = NULL;
+    natsSubPartition    *p      = NULL;
+    int                 i;
+
+    parts = (natsSubPartitions*) NATS_CALLOC(1, sizeof(natsSubPartitions)
+                                                + opts->Partitions * sizeof(natsSubPartition));
+    if (parts == NULL)
+        return nats_setDefaultError(NATS_NO_MEMORY);
+
+    parts->sub          = sub;
+    parts->keyCb        = opts->KeyCb;
+    parts->keyCbClosure = opts->KeyCbClosure;
+    parts->token        = opts->SubjectToken;
+
+    if (!nats_IsStringEmpty(opts->Header))
+    {
+        parts->header = NATS_STRDUP(opts->Header);
+        if (parts->header == NULL)
+            s = nats_setDefaultError(NATS_NO_MEMORY);
+    }
+    for (i=0; (s == NATS_OK) && (i<opts->Partitions); i++)
+    {
+        p = &(parts->list[i]);
+
+        p->parts      = parts;
+        p->msgsLimit  = (opts->PendingMsgsLimit != 0 ? opts->PendingMsgsLimit : sub->msgsLimit);
+        p->bytesLimit = (opts->PendingBytesLimit != 0 ? opts->PendingBytesLimit : sub->bytesLimit);
+
+        s = natsMutex_Create(&(p->mu));
+        if (s == NATS_OK)
+            s = natsCondition_Create(&(p->cond));
+        if (s == NATS_OK)
+            parts->count++;
+        else
+            natsMutex_Destroy(p->mu);
+    }
+
+    if (s == NATS_OK)
+        *newParts = parts;
+    else
+        natsSubParts_Destroy(parts);
+
+    return NATS_UPDATE_ERR_STACK(s);
+}
+
+static void
+_deliverPartitionMsgs(void *arg)
+{
+    natsSubPartition    *p          = (natsSubPartition*) arg;
+    natsSubPartitions   *parts      = p->parts;
+    natsSubscription    *sub        = parts->sub;
+    natsConnection      *nc         = sub->conn;
+    natsMsgHandler      mcb         = sub->msgCb;
+    void                *mcbClosure = sub->msgCbClosure;
+    natsOnCompleteCB    onCompleteCB        = NULL;
+    void                *onCompleteCBClosure= NULL;
+    natsMsg             *msg        = NULL;
+    uint64_t            max;
+    uint64_t            n;
+    bool                dlv         = false;
+    bool                draining    = false;
+    bool                rmSub       = false;
+
+    // This just serves as a barrier for the creation of this thread.
+    natsConn_Lock(nc);
+    natsConn_Unlock(nc);
+
+    natsMutex_Lock(p->mu);
+
+    while (true)
+    {
+        while (((msg = p->msgList.head) == NULL) && !(parts->closed) && !(parts->draining))
+        {
+            // Before going idle, free what the callback may have deferred.
+            if (natsGC_hasThreadBatch())
+            {
+                natsMutex_Unlock(p->mu);
+                natsGC_freeThreadBatch();
+                natsMutex_Lock(p->mu);
+                continue;
+            }
+            p->inWait = true;
+            natsCondition_Wait(p->cond, p->mu);
+            p->inWait = false;
+        }
+
+        // When draining, exit once there is no pending message left.
+        if (parts->closed || (msg == NULL))
+        {
+            draining = (!parts->closed && parts->draining);
+            break;
+        }
+
+        p->msgList.head = msg->next;
+        if (p->msgList.tail == msg)
+            p->msgList.tail = NULL;
+        msg->next = NULL;
+
+        p->msgList.msgs--;
+        p->msgList.bytes -= msg->dataLen;
+
+        // This is set under the subscription's lock, but reading it without
+        // the lock is fine: the new max applies to the next messages.
+        max = sub->max;
+        n   = (uint64_t) nats_atomicIncr(&(parts->dispatched));
+
+        // As for other subscriptions, a message handed to the callback is
+        // accounted as delivered.
+        dlv = ((max == 0) || (n <= max));
+        if (dlv)
+            p->delivered++;
+
+        natsMutex_Unlock(p->mu);
+
+        if (dlv)
+        {
+            (*mcb)(nc, sub, msg, mcbClosure);
+        }
+        else
+        {
+            // We need to destroy the message since the user can't do it
+            natsMsg_Destroy(msg);
+        }
+
+        // If we have hit the max for delivered msgs, remove sub. This
+        // will close the subscription, and all partitions.
+        if ((max > 0) && (n >= max))
+            natsConn_removeSubscription(nc, sub);
+
+        natsMutex_Lock(p->mu);
+    }
+
+    natsMutex_Unlock(p->mu);
+
+    // The last delivery thread completes the subscription.
+    if (nats_atomicDecr(&(parts->running)) == 0)
+    {
+        natsSub_Lock(sub);
+        onCompleteCB        = sub->onCompleteCB;
+        onCompleteCBClosure = sub->onCompleteCBClosure;
+        natsSub_Unlock(sub);
+
+        natsSub_setDrainCompleteState(sub);
+
+        rmSub = draining;
+    }
+
+    if (rmSub)
+        natsConn_removeSubscription(nc, sub);
+
+    if (onCompleteCB != NULL)
+        (*onCompleteCB)(onCompleteCBClosure);
+
+    natsSub_release(sub);
+}
+
+natsStatus
+natsSubParts_Start(natsSubPartitions *parts)
+{
+    natsStatus          s = NATS_OK;
+    natsSubPartition    *p;
+    int                 i;
+
+    for (i=0; (s == NATS_OK) && (i<parts->count); i++)
+    {
+        p = &(parts->list[i]);
+
+        // Let's not rely on the created thread acquiring the lock that
+        // would make it safe to retain only on success.
+        natsSub_retain(parts->sub);
+        nats_atomicIncr(&(parts->running));
+
+        s = natsThread_Create(&(p->thread), _deliverPartitionMsgs, (void*) p);
+        if (s != NATS_OK)
+        {
+            nats_atomicDecr(&(parts->running));
+            natsSub_release(parts->sub);
+        }
+    }
+    return NATS_UPDATE_ERR_STACK(s);
+}
+
+// Returns the subject token at the 1-based index 'token', or an empty
+// string if the subject does not have that many tokens.
+static const char*
+_subjectToken(const char *subject, int token, int *len)
+{
+    const char  *start = subject;
+    const char  *end   = NULL;
+    int         i;
+
+    for (i=1; i<token; i++)
+    {
+        if ((start = strchr(start, '.')) == NULL)
+        {
+            *len = 0;
+            return "";
+        }
+        start++;
+    }
+    end  = strchr(start, '.');
+    *len = (end == NULL ? (int) strlen(start) : (int) (end - start));
+
+    return start;
+}
+
+static uint32_t
+_partitionKey(natsSubPartitions *parts, natsMsg *msg)
+{
+    const char  *key = NULL;
+    int         len  = 0;
+    natsStatus  s;
+
+    if (parts->keyCb != NULL)
+        return (*(parts->keyCb))(msg, parts->keyCbClosure);
+
+    if (parts->header != NULL)
+    {
+        s = natsMsgHeader_Get(msg, parts->header, &key);
+        if (s == NATS_OK)
+            len = (int) strlen(key);
+        else if (s != NATS_NOT_FOUND)
+            nats_clearLastError();
+    }
+    else if (parts->token > 0)
+    {
+        key = _subjectToken(msg->subject, parts->token, &len);
+    }
+    else
+    {
+        key = msg->subject;
+        len = (int) strlen(key);
+    }
+    if (len == 0)
+        return 0;
+
+    return natsStrHash_Hash(key, len);
+}
+
+bool
+natsSubParts_Push(natsSubPartitions *parts, natsMsg *msg)
+{
+    natsSubPartition    *p  = &(parts->list[_partitionKey(parts, msg) % (uint32_t) parts->count]);
+    int                 dl  = msg->dataLen;
+    bool                sc  = false;
+
+    natsMutex_Lock(p->mu);
+
+    if (parts->closed)
+    {
+        natsMutex_Unlock(p->mu);
+        natsMsg_Destroy(msg);
+        return false;
+    }
+
+    p->msgList.msgs++;
+    p->msgList.bytes += dl;
+
+    if (((p->msgsLimit > 0) && (p->msgList.msgs > p->msgsLimit))
+        || ((p->bytesLimit > 0) && (p->msgList.bytes > p->bytesLimit)))
+    {
+        natsMsg_Destroy(msg);
+
+        p->dropped++;
+
+        sc = !p->slowConsumer;
+        p->slowConsumer = true;
+
+        // Undo stats from above.
+        p->msgList.msgs--;
+        p->msgList.bytes -= dl;
+    }
+    else
+    {
+        if (p->msgList.msgs > p->msgsMax)
+            p->msgsMax = p->msgList.msgs;
+
+        if (p->msgList.bytes > p->bytesMax)
+            p->bytesMax = p->msgList.bytes;
+
+        p->slowConsumer = false;
+
+        if (p->msgList.head == NULL)
+            p->msgList.head = msg;
+
+        if (p->msgList.tail != NULL)
+            p->msgList.tail->next = msg;
+
+        p->msgList.tail = msg;
+
+        if (p->inWait)
+            natsCondition_Signal(p->cond);
+    }
+
+    natsMutex_Unlock(p->mu);
+
+    return sc;
+}
+
+void
+natsSubParts_Close(natsSubPartitions *parts, bool drain)
+{
+    natsSubPartition    *p;
+    int                 i;
+
+    for (i=0; i<parts->count; i++)
+        natsMutex_Lock(parts->list[i].mu);
+
+    if (drain)
+        parts->draining = true;
+    else
+        parts->closed = true;
+
+    for (i=parts->count-1; i>=0; i--)
+    {
+        p = &(parts->list[i]);
+        natsCondition_Signal(p->cond);
+        natsMutex_Unlock(p->mu);
+    }
+}
+
+void
+natsSubParts_SetPendingLimits(natsSubPartitions *parts, int msgsLimit, int bytesLimit)
+{
+    natsSubPartition    *p;
+    int                 i;
+
+    for (i=0; i<parts->count; i++)
+    {
+        p = &(parts->list[i]);
+        natsMutex_Lock(p->mu);
+        p->msgsLimit  = msgsLimit;
+        p->bytesLimit = bytesLimit;
+        natsMutex_Unlock(p->mu);
+    }
+}
+
+void
+natsSubParts_ClearMaxPending(natsSubPartitions *parts)
+{
+    natsSubPartition    *p;
+    int                 i;
+
+    for (i=0; i<parts->count; i++)
+    {
+        p = &(parts->list[i]);
+        natsMutex_Lock(p->mu);
+        p->msgsMax  = 0;
+        p->bytesMax = 0;
+        natsMutex_Unlock(p->mu);
+    }
+}
+
+void
+natsSubParts_GetStats(natsSubPartitions *parts, int idx,
+                      int *pendingMsgs, int *pendingBytes,
+                      int *maxPendingMsgs, int *maxPendingBytes,
+                      uint64_t *delivered, int64_t *dropped)
+{
+    natsSubPartition    *p;
+    int                 first   = (idx < 0 ? 0 : idx);
+    int                 last    = (idx < 0 ? parts->count - 1 : idx);
+    int                 pm      = 0;
+    int                 pb      = 0;
+    int                 mpm     = 0;
+    int                 mpb     = 0;
+    uint64_t            dlv     = 0;
+    int64_t             drp     = 0;
+    int                 i;
+
+    for (i=first; i<=last; i++)
+    {
+        p = &(parts->list[i]);
+        natsMutex_Lock(p->mu);
+        pm  += p->msgList.msgs;
+        pb  += p->msgList.bytes;
+        mpm += p->msgsMax;
+        mpb += p->bytesMax;
+        dlv += p->delivered;
+        drp += p->dropped;
+        natsMutex_Unlock(p->mu);
+    }
+
+    if (pendingMsgs != NULL)
+        *pendingMsgs = pm;
+    if (pendingBytes != NULL)
+        *pendingBytes = pb;
+    if (maxPendingMsgs != NULL)
+        *maxPendingMsgs = mpm;
+    if (maxPendingBytes != NULL)
+        *maxPendingBytes = mpb;
+    if (delivered != NULL)
+        *delivered = dlv;
+    if (dropped != NULL)
+        *dropped = drp;
+}
+
+void
+natsSubParts_Destroy(natsSubPartitions *parts)
+{
+    natsSubPartition    *p;
+    natsMsg             *m;
+    int                 i;
+
+    if (parts == NULL)
+        return;
+
+    for (i=0; i<parts->count; i++)
+    {
+        p = &(parts->list[i]);
+
+        while ((m = p->msgList.head) != NULL)
+        {
+            p->msgList.head = m->next;
+            natsMsg_Destroy(m);
+        }
+        if (p->thread != NULL)
+        {
+            natsThread_Detach(p->thread);
+            natsThread_Destroy(p->thread);
+        }
+        natsCondition_Destroy(p->cond);
+        natsMutex_Destroy(p->mu);
+    }
+    NATS_FREE(parts->header);
+    NATS_FREE(parts);
+}
@@ -0,0 +1,106 @@
+// Copyright 2015-2021 The NATS Authors
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SUBPART_H_
+#define SUBPART_H_
+
+#include "natsp.h"
+
+struct __natsSubPartitions;
+
+// A partition of a subscription created with natsConnection_SubscribePartitioned():
+// its pending messages, limits and statistics, and the thread delivering them.
+typedef struct __natsSubPartition
+{
+    natsMutex                   *mu;
+    natsCondition               *cond;
+    natsThread                  *thread;
+    struct __natsSubPartitions  *parts;
+
+    natsMsgList                 msgList;
+    bool                        inWait;
+    bool                        slowConsumer;
+
+    int                         msgsLimit;
+    int                         bytesLimit;
+    int                         msgsMax;
+    int                         bytesMax;
+    uint64_t                    delivered;
+    int64_t                     dropped;
+
+} natsSubPartition;
+
+typedef struct __natsSubPartitions
+{
+    natsSubscription            *sub;
+
+    // How the partition key is computed (see natsSubPartitionOptions).
+    natsMsgPartitionKeyHandler  keyCb;
+    void                        *keyCbClosure;
+    char                        *header;
+    int                         token;
+
+    // Set with the lock of every partition held.
+    bool                        closed;
+    bool                        draining;
+
+    // Messages handed to the callback by all partitions, so that the
+    // subscription's max is honored exactly.
+    int32_t volatile            dispatched;
+
+    // Number of delivery threads still running.
+    int32_t volatile            running;
+
+    int                         count;
+    natsSubPartition            list[];
+
+} natsSubPartitions;
+
+natsStatus
+natsSubParts_Create(natsSubPartitions **newParts, natsSubscription *sub,
+                    const natsSubPartitionOptions *opts);
+
+// Starts the delivery threads, each holding a reference on the subscription.
+// On failure, natsSubParts_Close() must be invoked for the threads already
+// started to exit.
+natsStatus
+natsSubParts_Start(natsSubPartitions *parts);
+
+// Adds the message to its partition. Returns true if the partition becomes
+// a slow consumer.
+bool
+natsSubParts_Push(natsSubPartitions *parts, natsMsg *msg);
+
+// Causes the delivery threads to exit, right away when closing or once
+// their partition has no pending message when draining.
+void
+natsSubParts_Close(natsSubPartitions *parts, bool drain);
+
+void
+natsSubParts_SetPendingLimits(natsSubPartitions *parts, int msgsLimit, int bytesLimit);
+
+void
+natsSubParts_ClearMaxPending(natsSubPartitions *parts);
+
+// Statistics of the given partition, or the sum of those of all partitions
+// if 'idx' is negative. Any of the pointers can be NULL.
+void
+natsSubParts_GetStats(natsSubPartitions *parts, int idx,
+                      int *pendingMsgs, int *pendingBytes,
+                      int *maxPendingMsgs, int *maxPendingBytes,
+                      uint64_t *delivered, int64_t *dropped);
+
+void
+natsSubParts_Destroy(natsSubPartitions *parts);
+
+#endif /* SUBPART_H_ */
@@ -0,0 +1,346 @@
+// Copyright 2015-2021 The NATS Authors
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "natsp.h"
+
+#include <limits.h>
+
+#include "mem.h"
+#include "sub.h"
+#include "subtable.h"
+
+#define _chunkOf(sid)   ((sid) >> NATS_SUBTABLE_CHUNK_SHIFT)
+#define _slotOf(sid)    ((int) ((sid) & NATS_SUBTABLE_CHUNK_MASK))
+
+#define _MIN_DIR_CAP    (16)
+
+// True if the reader is not in a read section. Since this is a full barrier,
+// a reader entering its read section after this call will see the changes
+// made before it.
+#define _readerOutside(t)   ((nats_atomicGet(&((t)->readEpoch)) & 1) == 0)
+
+natsStatus
+natsSubTable_Create(natsSubTable **newTable)
+{
+    natsSubTable *t = NULL;
+
+    t = (natsSubTable*) NATS_CALLOC(1, sizeof(natsSubTable));
+    if (t == NULL)
+        return nats_setDefaultError(NATS_NO_MEMORY);
+
+    t->lastChunk = -1;
+
+    *newTable = t;
+
+    return NATS_OK;
+}
+
+static void
+_free(void *ptr, bool isSub)
+{
+    if (isSub)
+        natsSub_release((natsSubscription*) ptr);
+    else
+        NATS_FREE(ptr);
+}
+
+// Makes sure that there is room to retire 'count' more items, so that
+// retiring can't fail once the table has been modified.
+static natsStatus
+_reserveRetired(natsSubTable *t, int count)
+{
+    natsSubRetired  *retired;
+    int             need    = t->retiredCount + count;
+    int             newCap;
+
+    if (need <= t->retiredCap)
+        return NATS_OK;
+
+    newCap = (t->retiredCap == 0 ? 8 : 2 * t->retiredCap);
+    while (newCap < need)
+        newCap *= 2;
+
+    retired = (natsSubRetired*) NATS_REALLOC(t->retired, newCap * sizeof(natsSubRetired));
+    if (retired == NULL)
+        return nats_setDefaultError(NATS_NO_MEMORY);
+
+    t->retired    = retired;
+    t->retiredCap = newCap;
+
+    return NATS_OK;
+}
+
+// Frees the memory, or releases the subscription, right away if the reader
+// can't be referencing it. Otherwise, keep it until natsSubTable_Reclaim().
+// There must be room reserved with _reserveRetired().
+static void
+_retire(natsSubTable *t, void *ptr, bool isSub)
+{
+    natsSubRetired  *r;
+    int32_t         epoch = nats_atomicGet(&(t->readEpoch));
+
+    if ((epoch & 1) == 0)
+    {
+        _free(ptr, isSub);
+        return;
+    }
+    r = &(t->retired[t->retiredCount]);
+    r->ptr   = ptr;
+    r->isSub = isSub;
+    r->epoch = epoch;
+    nats_atomicIncr(&(t->retiredCount));
+}
+
+void
+natsSubTable_Reclaim(natsSubTable *t)
+{
+    natsSubRetired  *r;
+    int32_t         epoch = nats_atomicGet(&(t->readEpoch));
+    int             n     = t->retiredCount;
+    int             kept  = 0;
+    int             i;
+
+    for (i=0; i<n; i++)
+    {
+        r = &(t->retired[i]);
+
+        // The reader is either outside of a read section or past the one
+        // it was in when the item was retired.
+        if (((epoch & 1) == 0) || (r->epoch != epoch))
+            _free(r->ptr, r->isSub);
+        else
+            t->retired[kept++] = *r;
+    }
+    nats_atomicAdd(&(t->retiredCount), kept - n);
+}
+
+// Replaces the directory with one that covers the live chunks and 'cn'.
+static natsStatus
+_growDir(natsSubTable *t, int64_t cn)
+{
+    natsSubDir  *old    = t->dir;
+    natsSubDir  *d      = NULL;
+    int64_t     first   = cn;
+    int64_t     last    = cn;
+    int64_t     need;
+    int         cap     = _MIN_DIR_CAP;
+    int         i;
+
+    if (old != NULL)
+    {
+        for (i=0; i<old->cap; i++)
+        {
+            if (old->chunks[i] == NULL)
+                continue;
+
+            if (old->first + i < first)
+                first = old->first + i;
+            if (old->first + i > last)
+                last = old->first + i;
+        }
+    }
+
+    // Leave room for the sids that will be handed out next.
+    need = 2 * (last - first + 1);
+    if (need > (INT_MAX / 2))
+        return nats_setError(NATS_NO_MEMORY, "sid range too large: %" PRId64, last - first + 1);
+    while (cap < need)
+        cap *= 2;
+
+    d = (natsSubDir*) NATS_CALLOC(1, sizeof(natsSubDir) + (size_t) cap * sizeof(natsSubChunk*));
+    if (d == NULL)
+        return nats_setDefaultError(NATS_NO_MEMORY);
+
+    d->first = first;
+    d->cap   = cap;
+    if (old != NULL)
+    {
+        for (i=0; i<old->cap; i++)
+        {
+            if (old->chunks[i] != NULL)
+                d->chunks[old->first + i - first] = old->chunks[i];
+        }
+    }
+
+    nats_memoryBarrier();
+    t->dir = d;
+
+    if (old != NULL)
+        _retire(t, (void*) old, false);
+
+    return NATS_OK;
+}
+
+natsStatus
+natsSubTable_Set(natsSubTable *t, natsSubscription *sub)
+{
+    natsStatus      s   = NATS_OK;
+    natsSubDir      *d  = t->dir;
+    natsSubChunk    *c  = NULL;
+    int64_t         cn  = _chunkOf(sub->sid);
+    int             slot= _slotOf(sub->sid);
+
+    if (sub->sid <= 0)
+        return nats_setDefaultError(NATS_INVALID_ARG);
+
+    // Removing a subscription retires it and possibly its chunk, and this
+    // may retire the directory. Reserve room for all of it now, since the
+    // removal can't fail nor release what the reader may be using.
+    s = _reserveRetired(t, 2 * (t->count + 1) + 1);
+    if (s != NATS_OK)
+        return NATS_UPDATE_ERR_STACK(s);
+
+    if ((d == NULL) || (cn < d->first) || (cn >= d->first + d->cap))
+    {
+        s = _growDir(t, cn);
+        if (s != NATS_OK)
+            return NATS_UPDATE_ERR_STACK(s);
+
+        d = t->dir;
+    }
+
+    c = d->chunks[cn - d->first];
+    if (c == NULL)
+    {
+        c = (natsSubChunk*) NATS_CALLOC(1, sizeof(natsSubChunk));
+        if (c == NULL)
+            return nats_setDefaultError(NATS_NO_MEMORY);
+
+        nats_memoryBarrier();
+        d->chunks[cn - d->first] = c;
+    }
+    if (c->slots[slot] != NULL)
+        return nats_setError(NATS_ILLEGAL_STATE, "sid %" PRId64 " already in use", sub->sid);
+
+    // The subscription needs to be fully initialized before the reader can see it.
+    nats_memoryBarrier();
+    c->slots[slot] = sub;
+    c->used++;
+    t->count++;
+
+    if (cn > t->lastChunk)
+        t->lastChunk = cn;
+
+    return NATS_OK;
+}
+
+natsSubscription*
+natsSubTable_Get(natsSubTable *t, int64_t sid)
+{
+    natsSubDir      *d  = t->dir;
+    natsSubChunk    *c  = NULL;
+    int64_t         cn  = _chunkOf(sid);
+
+    if ((d == NULL) || (cn < d->first) || (cn >= d->first + d->cap))
+        return NULL;
+
+    c = d->chunks[cn - d->first];
+    if (c == NULL)
+        return NULL;
+
+    return c->slots[_slotOf(sid)];
+}
+
+natsSubscription*
+natsSubTable_Remove(natsSubTable *t, int64_t sid, bool *release)
+{
+    natsSubDir          *d  = t->dir;
+    natsSubChunk        *c  = NULL;
+    natsSubscription    *sub= NULL;
+    int64_t             cn  = _chunkOf(sid);
+
+    *release = false;
+
+    if ((d == NULL) || (cn < d->first) || (cn >= d->first + d->cap))
+        return NULL;
+
+    c = d->chunks[cn - d->first];
+    if ((c == NULL) || ((sub = c->slots[_slotOf(sid)]) == NULL))
+        return NULL;
+
+    c->slots[_slotOf(sid)] = NULL;
+    c->used--;
+    t->count--;
+
+    // Drop empty chunks, except the one new sids are taken from. There is
+    // room to retire the chunk and the subscription (see Set()).
+    if ((c->used == 0) && (cn != t->lastChunk))
+    {
+        d->chunks[cn - d->first] = NULL;
+        _retire(t, (void*) c, false);
+    }
+
+    // Let the caller release the subscription if the reader can't be using it.
+    if (_readerOutside(t))
+        *release = true;
+    else
+        _retire(t, (void*) sub, true);
+
+    return sub;
+}
+
+void
+natsSubTable_Destroy(natsSubTable *t)
+{
+    natsSubDir  *d;
+    int         i;
+
+    if (t == NULL)
+        return;
+
+    for (i=0; i<t->retiredCount; i++)
+        _free(t->retired[i].ptr, t->retired[i].isSub);
+    NATS_FREE(t->retired);
+
+    if ((d = t->dir) != NULL)
+    {
+        for (i=0; i<d->cap; i++)
+            NATS_FREE(d->chunks[i]);
+        NATS_FREE(d);
+    }
+
+    NATS_FREE(t);
+}
+
+void
+natsSubTableIter_Init(natsSubTableIter *iter, natsSubTable *t)
+{
+    iter->table = t;
+    iter->chunk = 0;
+    iter->slot  = 0;
+}
+
+natsSubscription*
+natsSubTableIter_Next(natsSubTableIter *iter)
+{
+    natsSubDir          *d  = iter->table->dir;
+    natsSubChunk        *c  = NULL;
+    natsSubscription    *sub= NULL;
+
+    while ((d != NULL) && (iter->chunk < d->cap))
+    {
+        // Re-read the chunk each time, it may have been dropped after
+        // its last subscription was removed.
+        if ((c = d->chunks[iter->chunk]) != NULL)
+        {
+            while (iter->slot < NATS_SUBTABLE_CHUNK_SIZE)
+            {
+                if ((sub = c->slots[iter->slot++]) != NULL)
+                    return sub;
+            }
+        }
+        iter->chunk++;
+        iter->slot = 0;
+    }
+    return NULL;
+}
@@ -0,0 +1,126 @@
+// Copyright 2015-2021 The NATS Authors
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SUBTABLE_H_
+#define SUBTABLE_H_
+
+#include "natsp.h"
+
+#define NATS_SUBTABLE_CHUNK_SHIFT   (8)
+#define NATS_SUBTABLE_CHUNK_SIZE    (1 << NATS_SUBTABLE_CHUNK_SHIFT)
+#define NATS_SUBTABLE_CHUNK_MASK    (NATS_SUBTABLE_CHUNK_SIZE - 1)
+
+// Subscriptions for NATS_SUBTABLE_CHUNK_SIZE consecutive sids.
+typedef struct __natsSubChunk
+{
+    natsSubscription * volatile slots[NATS_SUBTABLE_CHUNK_SIZE];
+    int                         used;
+
+} natsSubChunk;
+
+// Chunks for the sids from (first << NATS_SUBTABLE_CHUNK_SHIFT) up to
+// ((first + cap) << NATS_SUBTABLE_CHUNK_SHIFT) - 1.
+typedef struct __natsSubDir
+{
+    int64_t                     first;
+    int                         cap;
+    natsSubChunk * volatile     chunks[];
+
+} natsSubDir;
+
+typedef struct __natsSubRetired
+{
+    void                        *ptr;
+    bool                        isSub;
+    int32_t                     epoch;
+
+} natsSubRetired;
+
+// Table of subscriptions indexed by sid. Since sids are handed out
+// sequentially, this is a directory of fixed size chunks that covers the
+// range between the lowest and highest live sids.
+//
+// Modifications need to be serialized by the caller (the connection's
+// subsMu), but the connection's reader can look up a subscription without
+// any lock, between natsSubTable_ReadBegin() and natsSubTable_ReadEnd().
+// Memory (and the table's reference on removed subscriptions) that the
+// reader may still be using is retired and reclaimed once the reader is
+// past its read section.
+typedef struct __natsSubTable
+{
+    natsSubDir * volatile       dir;
+    int                         count;
+    int64_t                     lastChunk;
+
+    // Incremented when the reader enters and exits a read section, so it
+    // is odd while the reader may hold pointers obtained from the table.
+    int32_t volatile            readEpoch;
+
+    natsSubRetired              *retired;
+    int32_t volatile            retiredCount;
+    int                         retiredCap;
+
+} natsSubTable;
+
+typedef struct __natsSubTableIter
+{
+    natsSubTable                *table;
+    int                         chunk;
+    int                         slot;
+
+} natsSubTableIter;
+
+natsStatus
+natsSubTable_Create(natsSubTable **newTable);
+
+#define natsSubTable_Count(t)   ((t)->count)
+
+// Adds the subscription, using its sid as the key.
+natsStatus
+natsSubTable_Set(natsSubTable *t, natsSubscription *sub);
+
+natsSubscription*
+natsSubTable_Get(natsSubTable *t, int64_t sid);
+
+// Removes and returns the subscription for this sid, or NULL if not found.
+// If 'release' is set to false, the reader may still be using it: the
+// table then keeps the reference and will release it when it is safe.
+natsSubscription*
+natsSubTable_Remove(natsSubTable *t, int64_t sid, bool *release);
+
+// Frees the retired memory, and releases the retired subscriptions, that
+// the reader no longer references.
+void
+natsSubTable_Reclaim(natsSubTable *t);
+
+#define natsSubTable_ReadBegin(t)   ((void) nats_atomicIncr(&((t)->readEpoch)))
+
+// Returns true if natsSubTable_Reclaim() should be invoked.
+#define natsSubTable_ReadEnd(t)     ((void) nats_atomicIncr(&((t)->readEpoch)), \
+                                     (nats_atomicGet(&((t)->retiredCount)) > 0))
+
+// Frees the table and releases the retired subscriptions. Subscriptions
+// still in the table are not released. There must not be any reader at
+// this point.
+void
+natsSubTable_Destroy(natsSubTable *t);
+
+void
+natsSubTableIter_Init(natsSubTableIter *iter, natsSubTable *t);
+
+// Returns the next subscription, or NULL when done. The current
+// subscription can be removed from the table while iterating.
+natsSubscription*
+natsSubTableIter_Next(natsSubTableIter *iter);
+
+#endif /* SUBTABLE_H_ */
@@ -21,6 +21,7 @@ _freeTimer(natsTimer *t)
     if (t == NULL)
         return;
 
+    nats_removeTimerSlot();
     natsMutex_Destroy(t->mu);
     NATS_FREE(t);
 }
@@ -54,6 +55,15 @@ natsTimer_Create(natsTimer **timer, natsTimerCb timerCb, natsTimerStopCb stopCb,
     t->cb      = timerCb;
     t->stopCb  = stopCb;
     t->closure = closure;
+    t->heapIdx = -1;
+
+    // Make sure that the timer will fit in the library's timers heap.
+    s = nats_addTimerSlot();
+    if (s != NATS_OK)
+    {
+        NATS_FREE(t);
+        return NATS_UPDATE_ERR_STACK(s);
+    }
 
     s = natsMutex_Create(&(t->mu));
     if (s == NATS_OK)
@@ -30,8 +30,10 @@ typedef void (*natsTimerStopCb)(struct __natsTimer *timer, void* closure);
 
 typedef struct __natsTimer
 {
-    struct __natsTimer  *prev;
-    struct __natsTimer  *next;
+    // Position in the library's timers heap, and insertion order used
+    // for timers firing at the same time.
+    int                 heapIdx;
+    uint64_t            seq;
 
     natsMutex           *mu;
     int                 refs;
@@ -89,6 +89,29 @@ natsCondition_AbsoluteTimedWait(natsCondition *cond, natsMutex *mutex, int64_t a
     return _timedWait(cond, mutex, true, absoluteTime);
 }
 
+natsStatus
+natsCondition_AbsoluteTimedWaitNano(natsCondition *cond, natsMutex *mutex, int64_t absoluteTime)
+{
+    int     r;
+    struct  timespec ts;
+
+    if (absoluteTime <= 0)
+        return NATS_TIMEOUT;
+
+    ts.tv_sec  = absoluteTime / 1000000000L;
+    ts.tv_nsec = absoluteTime % 1000000000L;
+
+    r = pthread_cond_timedwait(cond, mutex, &ts);
+
+    if (r == 0)
+        return NATS_OK;
+
+    if (r == ETIMEDOUT)
+        return NATS_TIMEOUT;
+
+    return nats_setError(NATS_SYS_ERROR, "pthread_cond_timedwait error: %d", errno);
+}
+
 void
 natsCondition_Signal(natsCondition *cond)
 {
@@ -15,6 +15,13 @@
 #include "../mem.h"
 #include "../comsock.h"
 
+#include <sys/uio.h>
+
+#if defined(__linux__) && defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY)
+#include <linux/errqueue.h>
+#define NATS_HAS_ZEROCOPY
+#endif
+
 void
 natsSys_Init(void)
 {
@@ -60,6 +67,66 @@ natsSock_WaitReady(int waitMode, natsSockCtx *ctx)
     return NATS_OK;
 }
 
+natsStatus
+natsSock_WaitConnects(natsSock *fds, bool *done, int count, int timeout)
+{
+    struct pollfd   pfds[NATS_SOCK_MAX_RACING];
+    int             res;
+    int             i;
+
+    if (count > NATS_SOCK_MAX_RACING)
+        count = NATS_SOCK_MAX_RACING;
+
+    for (i=0; i<count; i++)
+    {
+        // poll() ignores negative descriptors, which is what we want
+        // for the attempts that are not (or no longer) pending.
+        pfds[i].fd      = fds[i];
+        pfds[i].events  = POLLOUT;
+        pfds[i].revents = 0;
+        done[i]         = false;
+    }
+
+    res = poll(pfds, (nfds_t) count, timeout);
+    if (res == NATS_SOCK_ERROR)
+        return nats_setError(NATS_IO_ERROR, "poll error: %d", NATS_SOCK_GET_ERROR);
+    else if (res == 0)
+        return nats_setDefaultError(NATS_TIMEOUT);
+
+    for (i=0; i<count; i++)
+        done[i] = (pfds[i].revents != 0);
+
+    return NATS_OK;
+}
+
+int
+natsSock_SendV(natsSock fd, natsSockVec *vecs, int count)
+{
+    struct iovec    iov[NATS_SOCK_MAX_VECS];
+    struct msghdr   mh;
+    int             flags = 0;
+    int             i;
+
+    if (count > NATS_SOCK_MAX_VECS)
+        count = NATS_SOCK_MAX_VECS;
+
+    for (i=0; i<count; i++)
+    {
+        iov[i].iov_base = (void*) vecs[i].data;
+        iov[i].iov_len  = (size_t) vecs[i].len;
+    }
+
+    memset(&mh, 0, sizeof(mh));
+    mh.msg_iov    = iov;
+    mh.msg_iovlen = count;
+
+#ifdef MSG_NOSIGNAL
+    flags = MSG_NOSIGNAL;
+#endif
+
+    return (int) sendmsg(fd, &mh, flags);
+}
+
 natsStatus
 natsSock_SetBlocking(natsSock fd, bool blocking)
 {
@@ -103,3 +170,66 @@ natsSock_Flush(natsSock fd)
 
     return NATS_OK;
 }
+
+bool
+natsSock_EnableZeroCopy(natsSock fd)
+{
+#if defined(NATS_HAS_ZEROCOPY)
+    int one = 1;
+
+    return (setsockopt(fd, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) == 0);
+#else
+    return false;
+#endif
+}
+
+int
+natsSock_SendZeroCopy(natsSock fd, const char *data, int len)
+{
+#if defined(NATS_HAS_ZEROCOPY)
+    return (int) send(fd, data, (size_t) len, MSG_ZEROCOPY | MSG_NOSIGNAL);
+#else
+    errno = EOPNOTSUPP;
+    return NATS_SOCK_ERROR;
+#endif
+}
+
+bool
+natsSock_ReadZeroCopyDone(natsSock fd, uint32_t *from, uint32_t *to)
+{
+#if defined(NATS_HAS_ZEROCOPY)
+    struct sock_extended_err    *ee;
+    struct cmsghdr              *cm;
+    struct msghdr               mh;
+    char                        control[128];
+
+    for (;;)
+    {
+        memset(&mh, 0, sizeof(mh));
+        mh.msg_control    = control;
+        mh.msg_controllen = sizeof(control);
+
+        if (recvmsg(fd, &mh, MSG_ERRQUEUE | MSG_DONTWAIT) == NATS_SOCK_ERROR)
+            break;
+
+        for (cm = CMSG_FIRSTHDR(&mh); cm != NULL; cm = CMSG_NXTHDR(&mh, cm))
+        {
+            if (!(((cm->cmsg_level == IPPROTO_IP) && (cm->cmsg_type == IP_RECVERR))
+                  || ((cm->cmsg_level == IPPROTO_IPV6) && (cm->cmsg_type == IPV6_RECVERR))))
+            {
+                continue;
+            }
+            ee = (struct sock_extended_err*) CMSG_DATA(cm);
+            if ((ee->ee_errno != 0) || (ee->ee_origin != SO_EE_ORIGIN_ZEROCOPY))
+                continue;
+
+            // Sends [ee_info, ee_data] are complete. Ranges may be
+            // reported in any order.
+            *from = ee->ee_info;
+            *to   = ee->ee_data;
+            return true;
+        }
+    }
+#endif
+    return false;
+}
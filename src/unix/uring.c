@@ -0,0 +1,625 @@
+// Copyright 2021 The NATS Authors
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+// http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "../natsp.h"
+
+#if defined(NATS_HAS_IO_URING)
+
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+#include "../mem.h"
+#include "../comsock.h"
+
+// Multishot receives and provided buffer rings need kernel headers
+// from 6.0, otherwise reads always use the regular path.
+#if defined(IORING_RECV_MULTISHOT)
+#define _URING_SUPPORTED
+#endif
+
+#if defined(_URING_SUPPORTED)
+
+#define _RING_ENTRIES   (4)
+// Must be a power of 2.
+#define _BUF_COUNT      (8)
+#define _BUF_GROUP      (0)
+
+#define _RECV_DATA      (1)
+#define _CANCEL_DATA    (2)
+#define _SEND_DATA      (3)
+#define _TIMEOUT_DATA   (4)
+
+// A ring is used either by the connection's read loop thread only, or to
+// write, under the connection's lock.
+struct __natsSockUring
+{
+    int                 fd;
+    natsSock            sock;
+
+    void                *sqPtr;
+    size_t              sqSize;
+    void                *cqPtr;
+    size_t              cqSize;
+    struct io_uring_sqe *sqes;
+    size_t              sqesSize;
+    unsigned            sqEntries;
+    unsigned            *sqHead;
+    unsigned            *sqTail;
+    unsigned            *sqMask;
+    unsigned            *sqArray;
+    unsigned            *cqHead;
+    unsigned            *cqTail;
+    unsigned            *cqMask;
+    struct io_uring_cqe *cqes;
+    unsigned            toSubmit;
+
+    // Provided buffers: the kernel picks one for each completion of the
+    // multishot receive, which is given back once fully consumed. The
+    // ring's tail overlaps the 'resv' field of its first entry.
+    struct io_uring_buf *br;
+    size_t              brSize;
+    char                *bufs;
+    int                 bufSize;
+    uint16_t            brTail;
+
+    bool                armed;
+    bool                received;
+    bool                sent;
+
+    // Buffer being consumed.
+    int                 curBid;
+    int                 curOff;
+    int                 curLen;
+};
+
+static void
+_freeRing(natsSockUring *r)
+{
+    if (r->sqes != NULL)
+        munmap(r->sqes, r->sqesSize);
+    if ((r->cqPtr != NULL) && (r->cqPtr != r->sqPtr))
+        munmap(r->cqPtr, r->cqSize);
+    if (r->sqPtr != NULL)
+        munmap(r->sqPtr, r->sqSize);
+    if (r->fd >= 0)
+        close(r->fd);
+    if (r->br != NULL)
+        munmap(r->br, r->brSize);
+    NATS_FREE(r->bufs);
+    NATS_FREE(r);
+}
+
+static void*
+_mapRing(int fd, size_t size, off_t offset)
+{
+    void *ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, offset);
+
+    return (ptr == MAP_FAILED ? NULL : ptr);
+}
+
+static struct io_uring_sqe*
+_getSqe(natsSockUring *r)
+{
+    struct io_uring_sqe *sqe;
+    unsigned            tail = *(r->sqTail);
+    unsigned            idx;
+
+    if (tail - __atomic_load_n(r->sqHead, __ATOMIC_ACQUIRE) >= r->sqEntries)
+        return NULL;
+
+    idx = tail & *(r->sqMask);
+    sqe = &(r->sqes[idx]);
+    memset(sqe, 0, sizeof(struct io_uring_sqe));
+    r->sqArray[idx] = idx;
+
+    __atomic_store_n(r->sqTail, tail + 1, __ATOMIC_RELEASE);
+    r->toSubmit++;
+
+    return sqe;
+}
+
+// Submits the pending entries and waits for 'minComplete' completions.
+static int
+_enter(natsSockUring *r, unsigned minComplete)
+{
+    unsigned    flags = (minComplete > 0 ? IORING_ENTER_GETEVENTS : 0);
+    int         ret;
+
+    do
+    {
+        ret = (int) syscall(__NR_io_uring_enter, r->fd, r->toSubmit, minComplete, flags, NULL, 0);
+    }
+    while ((ret < 0) && (errno == EINTR));
+
+    if (ret > 0)
+        r->toSubmit -= ((unsigned) ret > r->toSubmit ? r->toSubmit : (unsigned) ret);
+
+    return ret;
+}
+
+static bool
+_nextCqe(natsSockUring *r, struct io_uring_cqe *cqe)
+{
+    unsigned head = *(r->cqHead);
+
+    if (head == __atomic_load_n(r->cqTail, __ATOMIC_ACQUIRE))
+        return false;
+
+    *cqe = r->cqes[head & *(r->cqMask)];
+    __atomic_store_n(r->cqHead, head + 1, __ATOMIC_RELEASE);
+
+    return true;
+}
+
+static void
+_provideBuffer(natsSockUring *r, int bid)
+{
+    struct io_uring_buf *b = &(r->br[r->brTail & (_BUF_COUNT - 1)]);
+
+    // Do not overwrite 'resv', which is the tail for the first entry.
+    b->addr = (uint64_t) (uintptr_t) (r->bufs + ((size_t) bid * r->bufSize));
+    b->len  = (uint32_t) r->bufSize;
+    b->bid  = (uint16_t) bid;
+
+    r->brTail++;
+    __atomic_store_n(&(r->br[0].resv), r->brTail, __ATOMIC_RELEASE);
+}
+
+static bool
+_armRecv(natsSockUring *r)
+{
+    struct io_uring_sqe *sqe = _getSqe(r);
+
+    if (sqe == NULL)
+        return false;
+
+    sqe->opcode     = IORING_OP_RECV;
+    sqe->fd         = r->sock;
+    sqe->ioprio     = IORING_RECV_MULTISHOT;
+    sqe->flags      = IOSQE_BUFFER_SELECT;
+    sqe->buf_group  = _BUF_GROUP;
+    sqe->user_data  = _RECV_DATA;
+
+    r->armed = true;
+
+    return true;
+}
+
+// Sets up a ring of 'entries' entries and maps its queues.
+static natsSockUring*
+_createRing(unsigned entries, unsigned *features)
+{
+    natsSockUring           *r = NULL;
+    struct io_uring_params  p;
+
+    r = (natsSockUring*) NATS_CALLOC(1, sizeof(natsSockUring));
+    if (r == NULL)
+        return NULL;
+
+    memset(&p, 0, sizeof(p));
+    r->fd = (int) syscall(__NR_io_uring_setup, entries, &p);
+    if (r->fd < 0)
+    {
+        // Not supported or disabled: use the regular path.
+        NATS_FREE(r);
+        return NULL;
+    }
+
+    r->sqEntries = p.sq_entries;
+    r->sqSize    = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    r->cqSize    = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP)
+    {
+        if (r->cqSize > r->sqSize)
+            r->sqSize = r->cqSize;
+        r->cqSize = r->sqSize;
+    }
+    r->sqPtr = _mapRing(r->fd, r->sqSize, IORING_OFF_SQ_RING);
+    if (r->sqPtr != NULL)
+    {
+        if (p.features & IORING_FEAT_SINGLE_MMAP)
+            r->cqPtr = r->sqPtr;
+        else
+            r->cqPtr = _mapRing(r->fd, r->cqSize, IORING_OFF_CQ_RING);
+    }
+    if (r->cqPtr != NULL)
+    {
+        r->sqesSize = p.sq_entries * sizeof(struct io_uring_sqe);
+        r->sqes     = (struct io_uring_sqe*) _mapRing(r->fd, r->sqesSize, IORING_OFF_SQES);
+    }
+    if (r->sqes == NULL)
+    {
+        _freeRing(r);
+        return NULL;
+    }
+
+    r->sqHead  = (unsigned*) ((char*) r->sqPtr + p.sq_off.head);
+    r->sqTail  = (unsigned*) ((char*) r->sqPtr + p.sq_off.tail);
+    r->sqMask  = (unsigned*) ((char*) r->sqPtr + p.sq_off.ring_mask);
+    r->sqArray = (unsigned*) ((char*) r->sqPtr + p.sq_off.array);
+    r->cqHead  = (unsigned*) ((char*) r->cqPtr + p.cq_off.head);
+    r->cqTail  = (unsigned*) ((char*) r->cqPtr + p.cq_off.tail);
+    r->cqMask  = (unsigned*) ((char*) r->cqPtr + p.cq_off.ring_mask);
+    r->cqes    = (struct io_uring_cqe*) ((char*) r->cqPtr + p.cq_off.cqes);
+
+    if (features != NULL)
+        *features = p.features;
+
+    return r;
+}
+
+bool
+natsSock_UringStart(natsSockCtx *ctx, int bufSize)
+{
+    natsSockUring           *r = NULL;
+    struct io_uring_buf_reg reg;
+    int                     i;
+
+    if ((ctx->ssl != NULL) || ctx->useEventLoop || (ctx->uring != NULL))
+        return false;
+
+    r = _createRing(_RING_ENTRIES, NULL);
+    if (r == NULL)
+        return false;
+
+    r->sock    = ctx->fd;
+    r->bufSize = bufSize;
+
+    r->bufs   = NATS_MALLOC((size_t) _BUF_COUNT * bufSize);
+    r->brSize = _BUF_COUNT * sizeof(struct io_uring_buf);
+    r->br     = (struct io_uring_buf*) mmap(NULL, r->brSize, PROT_READ | PROT_WRITE,
+                                            MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+    if (r->br == MAP_FAILED)
+        r->br = NULL;
+    if ((r->bufs == NULL) || (r->br == NULL))
+    {
+        _freeRing(r);
+        return false;
+    }
+
+    // Provided buffer rings require a 5.19 kernel.
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr    = (uint64_t) (uintptr_t) r->br;
+    reg.ring_entries = _BUF_COUNT;
+    reg.bgid         = _BUF_GROUP;
+    if (syscall(__NR_io_uring_register, r->fd, IORING_REGISTER_PBUF_RING, &reg, 1) != 0)
+    {
+        _freeRing(r);
+        return false;
+    }
+    for (i=0; i<_BUF_COUNT; i++)
+        _provideBuffer(r, i);
+
+    r->curBid = -1;
+    ctx->uring = r;
+
+    return true;
+}
+
+void
+natsSock_UringStop(natsSockCtx *ctx)
+{
+    natsSockUring       *r = ctx->uring;
+    struct io_uring_cqe cqe;
+    struct io_uring_sqe *sqe;
+
+    if (r == NULL)
+        return;
+
+    ctx->uring = NULL;
+
+    // The kernel may still write into the buffers until the receive is
+    // terminated, so cancel it and wait for its final completion.
+    if (r->armed && ((sqe = _getSqe(r)) != NULL))
+    {
+        sqe->opcode    = IORING_OP_ASYNC_CANCEL;
+        sqe->addr      = _RECV_DATA;
+        sqe->user_data = _CANCEL_DATA;
+
+        while (r->armed)
+        {
+            if (!_nextCqe(r, &cqe))
+            {
+                if (_enter(r, 1) < 0)
+                    break;
+                continue;
+            }
+            if ((cqe.user_data == _RECV_DATA) && !(cqe.flags & IORING_CQE_F_MORE))
+                r->armed = false;
+        }
+    }
+
+    _freeRing(r);
+}
+
+natsStatus
+natsSock_UringRead(natsSockCtx *ctx, char *buffer, size_t maxBufferSize, int *n)
+{
+    natsSockUring       *r = ctx->uring;
+    struct io_uring_cqe cqe;
+    int                 len;
+
+    while (true)
+    {
+        // Copy what is left from the last completion first.
+        if (r->curBid >= 0)
+        {
+            len = r->curLen - r->curOff;
+            if ((size_t) len > maxBufferSize)
+                len = (int) maxBufferSize;
+
+            memcpy(buffer, r->bufs + ((size_t) r->curBid * r->bufSize) + r->curOff, len);
+            r->curOff += len;
+            if (r->curOff == r->curLen)
+            {
+                _provideBuffer(r, r->curBid);
+                r->curBid = -1;
+            }
+            if (n != NULL)
+                *n = len;
+
+            return NATS_OK;
+        }
+
+        // The receive terminates when it runs out of buffers (they are
+        // given back as they are consumed), post it again.
+        if (!r->armed && !_armRecv(r))
+            return nats_setError(NATS_IO_ERROR, "%s", "io_uring submission queue full");
+
+        if (!_nextCqe(r, &cqe))
+        {
+            if (_enter(r, 1) < 0)
+                return nats_setError(NATS_IO_ERROR, "io_uring_enter error: %d", errno);
+
+            continue;
+        }
+        if (cqe.user_data != _RECV_DATA)
+            continue;
+
+        if (!(cqe.flags & IORING_CQE_F_MORE))
+            r->armed = false;
+
+        if (cqe.res > 0)
+        {
+            r->received = true;
+            r->curBid   = (int) (cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+            r->curOff   = 0;
+            r->curLen   = cqe.res;
+        }
+        else if (cqe.res == 0)
+        {
+            return nats_setDefaultError(NATS_CONNECTION_CLOSED);
+        }
+        else if (cqe.res != -ENOBUFS)
+        {
+            // Kernels before 6.0 reject multishot receives. Nothing has
+            // been read yet, so drop the ring and let the caller do a
+            // regular read.
+            if (!r->received && (cqe.res == -EINVAL))
+            {
+                natsSock_UringStop(ctx);
+                if (n != NULL)
+                    *n = 0;
+
+                return NATS_OK;
+            }
+            return nats_setError(NATS_IO_ERROR, "recv error: %d", -cqe.res);
+        }
+    }
+}
+
+bool
+natsSock_UringStartWrites(natsSockCtx *ctx)
+{
+    natsSockUring   *r       = NULL;
+    unsigned        features = 0;
+
+    if ((ctx->ssl != NULL) || ctx->useEventLoop || (ctx->wuring != NULL))
+        return false;
+
+    r = _createRing(_RING_ENTRIES, &features);
+    if (r == NULL)
+        return false;
+
+    // Before 5.7, a send that can't complete right away is handed to a
+    // kernel worker thread instead of waiting for the socket to become
+    // writable, so keep the regular path.
+    if (!(features & IORING_FEAT_FAST_POLL))
+    {
+        _freeRing(r);
+        return false;
+    }
+
+    ctx->wuring = r;
+
+    return true;
+}
+
+void
+natsSock_UringStopWrites(natsSockCtx *ctx)
+{
+    natsSockUring *r = ctx->wuring;
+
+    if (r == NULL)
+        return;
+
+    // Writes wait for their completions, so nothing is in flight.
+    ctx->wuring = NULL;
+    _freeRing(r);
+}
+
+natsStatus
+natsSock_UringWriteV(natsSockCtx *ctx, natsSockVec *vecs, int count, int *n)
+{
+    natsSockUring               *r = ctx->wuring;
+    struct iovec                iov[NATS_SOCK_MAX_VECS];
+    struct msghdr               msg;
+    struct __kernel_timespec    ts;
+    struct io_uring_sqe         *sqe;
+    struct io_uring_cqe         cqe;
+    natsStatus                  s;
+    int                         pending;
+    int                         res;
+    bool                        timedOut;
+    int                         i;
+
+    if (count > NATS_SOCK_MAX_VECS)
+        count = NATS_SOCK_MAX_VECS;
+
+    for (i=0; i<count; i++)
+    {
+        iov[i].iov_base = (void*) vecs[i].data;
+        iov[i].iov_len  = (size_t) vecs[i].len;
+    }
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov    = iov;
+    msg.msg_iovlen = (size_t) count;
+
+    while (true)
+    {
+        // All previous completions have been reaped, so there is room
+        // for both entries.
+        sqe = _getSqe(r);
+        sqe->opcode    = IORING_OP_SENDMSG;
+        sqe->fd        = ctx->fd;
+        sqe->addr      = (uint64_t) (uintptr_t) &msg;
+        sqe->len       = 1;
+        sqe->msg_flags = MSG_NOSIGNAL;
+        sqe->user_data = _SEND_DATA;
+        pending        = 1;
+
+        // If the socket is full, the kernel waits for it to be writable,
+        // so bound that wait by the write deadline.
+        if (ctx->writeDeadline.active)
+        {
+            int timeout = natsDeadline_GetTimeout(&(ctx->writeDeadline));
+
+            ts.tv_sec  = timeout / 1000;
+            ts.tv_nsec = (long long) (timeout % 1000) * 1000000;
+
+            sqe->flags |= IOSQE_IO_LINK;
+
+            sqe = _getSqe(r);
+            sqe->opcode    = IORING_OP_LINK_TIMEOUT;
+            sqe->addr      = (uint64_t) (uintptr_t) &ts;
+            sqe->len       = 1;
+            sqe->user_data = _TIMEOUT_DATA;
+            pending++;
+        }
+
+        res      = 0;
+        timedOut = false;
+        while (pending > 0)
+        {
+            if (!_nextCqe(r, &cqe))
+            {
+                if (_enter(r, 1) < 0)
+                {
+                    res = errno;
+
+                    // Don't leave entries that point to this stack frame.
+                    natsSock_UringStopWrites(ctx);
+
+                    return nats_setError(NATS_IO_ERROR, "io_uring_enter error: %d", res);
+                }
+                continue;
+            }
+            pending--;
+
+            if (cqe.user_data == _SEND_DATA)
+                res = cqe.res;
+            else if (cqe.res == -ETIME)
+                timedOut = true;
+        }
+
+        if (res > 0)
+        {
+            r->sent = true;
+            if (n != NULL)
+                *n = res;
+
+            return NATS_OK;
+        }
+        else if (res == 0)
+        {
+            return nats_setDefaultError(NATS_CONNECTION_CLOSED);
+        }
+        else if (timedOut && (res == -ECANCELED))
+        {
+            return nats_setDefaultError(NATS_TIMEOUT);
+        }
+        else if (res == -EAGAIN)
+        {
+            s = natsSock_WaitReady(WAIT_FOR_WRITE, ctx);
+            if (s != NATS_OK)
+                return NATS_UPDATE_ERR_STACK(s);
+
+            continue;
+        }
+        else if (!r->sent && ((res == -EINVAL) || (res == -EOPNOTSUPP)))
+        {
+            // The kernel does not support this operation. Nothing has
+            // been written yet, so drop the ring and let the caller do
+            // a regular write.
+            natsSock_UringStopWrites(ctx);
+            if (n != NULL)
+                *n = 0;
+
+            return NATS_OK;
+        }
+
+        return nats_setError(NATS_IO_ERROR, "send error: %d", -res);
+    }
+}
+
+#else
+
+bool
+natsSock_UringStart(natsSockCtx *ctx, int bufSize)
+{
+    return false;
+}
+
+void
+natsSock_UringStop(natsSockCtx *ctx)
+{
+}
+
+natsStatus
+natsSock_UringRead(natsSockCtx *ctx, char *buffer, size_t maxBufferSize, int *n)
+{
+    return nats_setDefaultError(NATS_ILLEGAL_STATE);
+}
+
+bool
+natsSock_UringStartWrites(natsSockCtx *ctx)
+{
+    return false;
+}
+
+void
+natsSock_UringStopWrites(natsSockCtx *ctx)
+{
+}
+
+natsStatus
+natsSock_UringWriteV(natsSockCtx *ctx, natsSockVec *vecs, int count, int *n)
+{
+    return nats_setDefaultError(NATS_ILLEGAL_STATE);
+}
+
+#endif // _URING_SUPPORTED
+
+#endif // NATS_HAS_IO_URING
@@ -90,6 +90,75 @@ natsSock_WaitReady(int waitMode, natsSockCtx *ctx)
     return NATS_OK;
 }
 
+natsStatus
+natsSock_WaitConnects(natsSock *fds, bool *done, int count, int timeout)
+{
+    struct timeval  timeout_tv= {0};
+    struct timeval  *tv       = NULL;
+    fd_set          fdSet;
+    fd_set          errSet;
+    int             res;
+    int             i;
+
+    FD_ZERO(&fdSet);
+    FD_ZERO(&errSet);
+
+    for (i=0; i<count; i++)
+    {
+        done[i] = false;
+        if (fds[i] == NATS_SOCK_INVALID)
+            continue;
+
+        FD_SET(fds[i], &fdSet);
+        FD_SET(fds[i], &errSet);
+    }
+
+    if (timeout != -1)
+    {
+        timeout_tv.tv_sec = (long) timeout / 1000;
+        timeout_tv.tv_usec = (timeout % 1000) * 1000;
+        tv = &timeout_tv;
+    }
+
+    // A failed non-blocking connect is reported in the exception set.
+    res = select(0, NULL, &fdSet, &errSet, tv);
+    if (res == NATS_SOCK_ERROR)
+        return nats_setError(NATS_IO_ERROR, "select error: %d", NATS_SOCK_GET_ERROR);
+
+    if (res == 0)
+        return nats_setDefaultError(NATS_TIMEOUT);
+
+    for (i=0; i<count; i++)
+    {
+        if (fds[i] != NATS_SOCK_INVALID)
+            done[i] = (FD_ISSET(fds[i], &fdSet) || FD_ISSET(fds[i], &errSet));
+    }
+
+    return NATS_OK;
+}
+
+int
+natsSock_SendV(natsSock fd, natsSockVec *vecs, int count)
+{
+    WSABUF  bufs[NATS_SOCK_MAX_VECS];
+    DWORD   sent = 0;
+    int     i;
+
+    if (count > NATS_SOCK_MAX_VECS)
+        count = NATS_SOCK_MAX_VECS;
+
+    for (i=0; i<count; i++)
+    {
+        bufs[i].buf = (char*) vecs[i].data;
+        bufs[i].len = (ULONG) vecs[i].len;
+    }
+
+    if (WSASend(fd, bufs, (DWORD) count, &sent, 0, NULL, NULL) == SOCKET_ERROR)
+        return NATS_SOCK_ERROR;
+
+    return (int) sent;
+}
+
 natsStatus
 natsSock_SetBlocking(natsSock fd, bool blocking)
 {
@@ -150,3 +219,21 @@ natsSock_Flush(natsSock fd)
 
     return NATS_OK;
 }
+
+bool
+natsSock_EnableZeroCopy(natsSock fd)
+{
+    return false;
+}
+
+int
+natsSock_SendZeroCopy(natsSock fd, const char *data, int len)
+{
+    return NATS_SOCK_ERROR;
+}
+
+bool
+natsSock_ReadZeroCopyDone(natsSock fd, uint32_t *from, uint32_t *to)
+{
+    return false;
+}
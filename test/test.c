@@ -23,6 +23,7 @@
 #include "opts.h"
 #include "../src/util.h"
 #include "hash.h"
+#include "subtable.h"
 #include "conn.h"
 #include "sub.h"
 #include "msg.h"
@@ -31,6 +32,7 @@
 #include "crypto.h"
 #include "nkeys.h"
 #include "parser.h"
+#include "msgring.h"
 #if defined(NATS_HAS_STREAMING)
 #include "stan/conn.h"
 #include "stan/pub.h"
@@ -1145,6 +1147,23 @@ stopTimerCb(natsTimer *timer, void *arg)
 static void
 _dummyTimerCB(natsTimer *timer, void *arg) {}
 
+static void
+_orderedTimerCb(natsTimer *timer, void *arg)
+{
+    struct threadArg *tArg = (struct threadArg*) arg;
+
+    natsMutex_Lock(tArg->m);
+    // Timers need to fire in the order of their interval.
+    if (timer->interval < tArg->results[0])
+        tArg->status = NATS_ERR;
+    tArg->results[0] = (int) timer->interval;
+    tArg->timerFired++;
+    natsCondition_Signal(tArg->c);
+    natsMutex_Unlock(tArg->m);
+
+    natsTimer_Stop(timer);
+}
+
 static void
 _timerStopCB(natsTimer *timer, void *arg)
 {
@@ -1165,6 +1184,11 @@ test_natsTimer(void)
     natsTimer           *t = NULL;
     struct threadArg    tArg;
     int                 refs;
+    int                 count    = 0;
+    uint64_t            fired    = 0;
+    int64_t             totalLag = 0;
+    int64_t             maxLag   = 0;
+    int                 i;
 
     test("Setup test: ");
     s = _createDefaultThreadArgsForCbTests(&tArg);
@@ -1370,6 +1394,38 @@ test_natsTimer(void)
     testCond(refs == 1);
     natsTimer_Release(t);
 
+    tArg.timerFired = 0;
+    tArg.results[0] = 0;
+    tArg.status     = NATS_OK;
+    test("Many timers fire in order: ");
+    for (i=0; (s == NATS_OK) && (i<200); i++)
+    {
+        natsTimer *ot = NULL;
+
+        // Intervals are a permutation of 20, 25, ..., 1015
+        s = natsTimer_Create(&ot, _orderedTimerCb, _timerStopCB,
+                             20 + 5 * ((i * 37) % 200), &tArg);
+    }
+    natsMutex_Lock(tArg.m);
+    while ((s != NATS_TIMEOUT) && (tArg.timerFired != 200))
+        s = natsCondition_TimedWait(tArg.c, tArg.m, 5000);
+    IFOK(s, tArg.status);
+    natsMutex_Unlock(tArg.m);
+    testCond(s == NATS_OK);
+
+    test("Timer stats: ");
+    s = nats_GetTimerStats(&count, &fired, &totalLag, &maxLag);
+    testCond((s == NATS_OK)
+             && (count == 0)
+             && (fired >= 200)
+             && (totalLag >= 0)
+             && (maxLag >= 0)
+             && (maxLag <= totalLag));
+
+    test("Timer stats with NULL: ");
+    s = nats_GetTimerStats(NULL, NULL, NULL, NULL);
+    testCond(s == NATS_OK);
+
     _destroyDefaultThreadArgs(&tArg);
 
     // Create a timer that will not be stopped here to exercise
@@ -2430,6 +2486,137 @@ test_natsStrHash(void)
     natsStrHash_Destroy(hash);
 }
 
+static void
+test_natsSubTable(void)
+{
+    natsStatus          s;
+    natsSubTable        *t    = NULL;
+    natsSubscription    *subs = NULL;
+    natsSubscription    *sub  = NULL;
+    natsSubscription    far;
+    natsSubTableIter    iter;
+    bool                release = false;
+    bool                ok      = true;
+    int                 i;
+
+    subs = (natsSubscription*) calloc(1000, sizeof(natsSubscription));
+    if (subs == NULL)
+        FAIL("Unable to setup test");
+    for (i=0; i<1000; i++)
+        subs[i].sid = (int64_t) (i+1);
+    memset(&far, 0, sizeof(far));
+    far.sid = 100000;
+
+    test("Create: ");
+    s = natsSubTable_Create(&t);
+    testCond((s == NATS_OK) && (t != NULL) && (natsSubTable_Count(t) == 0));
+
+    test("Get from empty table: ");
+    testCond(natsSubTable_Get(t, 1) == NULL);
+
+    test("Set: ");
+    for (i=0; (s == NATS_OK) && (i<1000); i++)
+        s = natsSubTable_Set(t, &(subs[i]));
+    testCond((s == NATS_OK) && (natsSubTable_Count(t) == 1000));
+
+    test("Room reserved to retire all subscriptions: ");
+    testCond(t->retiredCap >= t->retiredCount + 2 * natsSubTable_Count(t));
+
+    test("Set existing sid fails: ");
+    s = natsSubTable_Set(t, &(subs[10]));
+    testCond((s == NATS_ILLEGAL_STATE) && (natsSubTable_Count(t) == 1000));
+    nats_clearLastError();
+
+    test("Get: ");
+    for (i=0; ok && (i<1000); i++)
+        ok = (natsSubTable_Get(t, (int64_t) (i+1)) == &(subs[i]));
+    testCond(ok
+             && (natsSubTable_Get(t, 0) == NULL)
+             && (natsSubTable_Get(t, 1001) == NULL)
+             && (natsSubTable_Get(t, -1) == NULL));
+
+    test("Iterate in sid order: ");
+    i = 0;
+    natsSubTableIter_Init(&iter, t);
+    while (ok && ((sub = natsSubTableIter_Next(&iter)) != NULL))
+        ok = (sub == &(subs[i++]));
+    testCond(ok && (i == 1000));
+
+    test("Remove: ");
+    for (i=0; ok && (i<900); i++)
+    {
+        ok = ((natsSubTable_Remove(t, (int64_t) (i+1), &release) == &(subs[i])) && release);
+        if (ok)
+            ok = (natsSubTable_Get(t, (int64_t) (i+1)) == NULL);
+    }
+    testCond(ok
+             && (natsSubTable_Count(t) == 100)
+             && (natsSubTable_Remove(t, 1, &release) == NULL)
+             && !release);
+
+    test("Empty chunks are dropped: ");
+    testCond((t->dir->chunks[0] == NULL) && (t->dir->chunks[3] != NULL));
+
+    test("Directory only covers live sids: ");
+    s = natsSubTable_Set(t, &far);
+    testCond((s == NATS_OK)
+             && (natsSubTable_Get(t, 100000) == &far)
+             && (natsSubTable_Get(t, 1000) == &(subs[999]))
+             && (t->dir->first == (901 >> NATS_SUBTABLE_CHUNK_SHIFT)));
+
+    test("Remove during iteration: ");
+    i = 0;
+    natsSubTableIter_Init(&iter, t);
+    while (ok && ((sub = natsSubTableIter_Next(&iter)) != NULL))
+    {
+        if (sub == &far)
+            continue;
+        ok = ((natsSubTable_Remove(t, sub->sid, &release) == sub) && release);
+        i++;
+    }
+    testCond(ok && (i == 100) && (natsSubTable_Count(t) == 1));
+
+    test("Subscription removed during a read section is retired: ");
+    s = natsMutex_Create(&(far.mu));
+    far.refs = 2;
+    natsSubTable_ReadBegin(t);
+    sub = natsSubTable_Remove(t, 100000, &release);
+    testCond((s == NATS_OK) && (sub == &far) && !release && (t->retiredCount > 0) && (far.refs == 2));
+
+    test("Released after the read section: ");
+    ok = natsSubTable_ReadEnd(t);
+    if (ok)
+        natsSubTable_Reclaim(t);
+    testCond(ok && (t->retiredCount == 0) && (far.refs == 1) && (natsSubTable_Count(t) == 0));
+
+    test("All removed during a read section are retired: ");
+    for (i=0; (s == NATS_OK) && (i<1000); i++)
+    {
+        s = natsMutex_Create(&(subs[i].mu));
+        subs[i].sid  = (int64_t) (200000 + i);
+        subs[i].refs = 2;
+        IFOK(s, natsSubTable_Set(t, &(subs[i])));
+    }
+    natsSubTable_ReadBegin(t);
+    for (i=0; ok && (i<1000); i++)
+        ok = ((natsSubTable_Remove(t, subs[i].sid, &release) == &(subs[i])) && !release);
+    testCond((s == NATS_OK) && ok && (t->retiredCount >= 1000) && (subs[999].refs == 2));
+
+    test("And released after the read section: ");
+    ok = natsSubTable_ReadEnd(t);
+    if (ok)
+        natsSubTable_Reclaim(t);
+    for (i=0; ok && (i<1000); i++)
+        ok = (subs[i].refs == 1);
+    testCond(ok && (t->retiredCount == 0));
+
+    natsSubTable_Destroy(t);
+    for (i=0; i<1000; i++)
+        natsMutex_Destroy(subs[i].mu);
+    natsMutex_Destroy(far.mu);
+    free(subs);
+}
+
 static const char*
 _dummyTokenHandler(void *closure)
 {
@@ -2644,6 +2831,25 @@ test_natsOptions(void)
     testCond((s == NATS_ILLEGAL_STATE) && (opts->secure == false));
 #endif
 
+    test("Set UseKernelTLS: ");
+    s = natsOptions_UseKernelTLS(opts, true);
+#if defined(NATS_HAS_KTLS)
+    testCond((s == NATS_OK) && (opts->useKernelTLS == true));
+#elif defined(NATS_HAS_TLS)
+    testCond((s == NATS_NOT_PERMITTED) && (opts->useKernelTLS == false));
+#else
+    testCond((s == NATS_ILLEGAL_STATE) && (opts->useKernelTLS == false));
+#endif
+    nats_clearLastError();
+
+    test("Remove UseKernelTLS: ");
+    s = natsOptions_UseKernelTLS(opts, false);
+#if defined(NATS_HAS_TLS)
+    testCond((s == NATS_OK) && (opts->useKernelTLS == false));
+#else
+    testCond((s == NATS_ILLEGAL_STATE) && (opts->useKernelTLS == false));
+#endif
+
     test("Set Pedantic: ");
     s = natsOptions_SetPedantic(opts, true);
     testCond((s == NATS_OK) && (opts->pedantic == true));
@@ -2806,6 +3012,21 @@ test_natsOptions(void)
         s = natsOptions_IPResolutionOrder(opts, 64);
     testCond((s == NATS_OK) && (opts->orderIP == 64));
 
+    test("Set RacingConnect (invalid args): ");
+    s = natsOptions_SetRacingConnect(opts, -1, 1);
+    if (s != NATS_OK)
+        s = natsOptions_SetRacingConnect(opts, 50, 0);
+    testCond(s == NATS_INVALID_ARG);
+    nats_clearLastError();
+
+    test("Set RacingConnect: ");
+    s = natsOptions_SetRacingConnect(opts, 50, 3);
+    testCond((s == NATS_OK) && (opts->racingDelay == 50) && (opts->racingServers == 3));
+
+    test("Remove RacingConnect: ");
+    s = natsOptions_SetRacingConnect(opts, 0, 1);
+    testCond((s == NATS_OK) && (opts->racingDelay == 0) && (opts->racingServers == 1));
+
     test("Set UseOldRequestStyle: ");
     s = natsOptions_UseOldRequestStyle(opts, true);
     testCond((s == NATS_OK) && (opts->useOldRequestStyle == true));
@@ -2822,6 +3043,94 @@ test_natsOptions(void)
     s = natsOptions_SetSendAsap(opts, false);
     testCond((s == NATS_OK) && (opts->sendAsap == false));
 
+    test("Set FlushPolicy (bad policy): ");
+    s = natsOptions_SetFlushPolicy(opts, (natsFlushPolicy) 100, 0, 0);
+    testCond(s == NATS_INVALID_ARG);
+    nats_clearLastError();
+
+    test("Set FlushPolicy (negative bytes): ");
+    s = natsOptions_SetFlushPolicy(opts, NATS_FLUSH_POLICY_THROUGHPUT, -1, 100);
+    testCond(s == NATS_INVALID_ARG);
+    nats_clearLastError();
+
+    test("Set FlushPolicy (throughput requires delay): ");
+    s = natsOptions_SetFlushPolicy(opts, NATS_FLUSH_POLICY_THROUGHPUT, 1024, 0);
+    testCond(s == NATS_INVALID_ARG);
+    nats_clearLastError();
+
+    test("Set FlushPolicy (throughput): ");
+    s = natsOptions_SetFlushPolicy(opts, NATS_FLUSH_POLICY_THROUGHPUT, 1024, 200);
+    testCond((s == NATS_OK)
+                && (opts->flushPolicy == NATS_FLUSH_POLICY_THROUGHPUT)
+                && (opts->flushMaxBytes == 1024)
+                && (opts->flushMaxDelay == 200));
+
+    test("Set FlushPolicy (latency ignores params): ");
+    s = natsOptions_SetFlushPolicy(opts, NATS_FLUSH_POLICY_LATENCY, 1024, 200);
+    testCond((s == NATS_OK)
+                && (opts->flushPolicy == NATS_FLUSH_POLICY_LATENCY)
+                && (opts->flushMaxBytes == 0)
+                && (opts->flushMaxDelay == 0));
+
+    test("Set InboundZeroCopy: ");
+    s = natsOptions_SetInboundZeroCopy(opts, true);
+    testCond((s == NATS_OK) && (opts->inboundZeroCopy == true));
+
+    test("Remove InboundZeroCopy: ");
+    s = natsOptions_SetInboundZeroCopy(opts, false);
+    testCond((s == NATS_OK) && (opts->inboundZeroCopy == false));
+
+    test("Set UseMessagePool: ");
+    s = natsOptions_UseMessagePool(opts, true);
+    testCond((s == NATS_OK) && (opts->useMsgPool == true));
+
+    test("Remove UseMessagePool: ");
+    s = natsOptions_UseMessagePool(opts, false);
+    testCond((s == NATS_OK) && (opts->useMsgPool == false));
+
+    test("Set UseLockFreeDelivery: ");
+    s = natsOptions_UseLockFreeDelivery(opts, true);
+    testCond((s == NATS_OK) && (opts->lockFreeDelivery == true));
+
+    test("Remove UseLockFreeDelivery: ");
+    s = natsOptions_UseLockFreeDelivery(opts, false);
+    testCond((s == NATS_OK) && (opts->lockFreeDelivery == false));
+
+    test("Set UseInlineResponses: ");
+    s = natsOptions_UseInlineResponses(opts, true);
+    testCond((s == NATS_OK) && (opts->inlineResponses == true));
+
+    test("Remove UseInlineResponses: ");
+    s = natsOptions_UseInlineResponses(opts, false);
+    testCond((s == NATS_OK) && (opts->inlineResponses == false));
+
+    test("Set ZeroCopyThreshold (invalid): ");
+    s = natsOptions_SetZeroCopyThreshold(opts, -1);
+    testCond(s == NATS_INVALID_ARG);
+    nats_clearLastError();
+
+    test("Set ZeroCopyThreshold: ");
+    s = natsOptions_SetZeroCopyThreshold(opts, 32*1024);
+    testCond((s == NATS_OK) && (opts->zeroCopyThreshold == 32*1024));
+
+    test("Remove ZeroCopyThreshold: ");
+    s = natsOptions_SetZeroCopyThreshold(opts, 0);
+    testCond((s == NATS_OK) && (opts->zeroCopyThreshold == 0));
+
+#if defined(__linux__)
+    test("Set UseIOEngine: ");
+    s = natsOptions_UseIOEngine(opts, true);
+    testCond((s == NATS_OK) && (opts->evLoop != NULL) && (opts->evCbs.attach != NULL));
+
+    test("Remove UseIOEngine: ");
+    s = natsOptions_UseIOEngine(opts, false);
+    testCond((s == NATS_OK) && (opts->evLoop == NULL) && (opts->evCbs.attach == NULL));
+#endif
+
+    test("Set FlushPolicy (default): ");
+    s = natsOptions_SetFlushPolicy(opts, NATS_FLUSH_POLICY_DEFAULT, 0, 0);
+    testCond((s == NATS_OK) && (opts->flushPolicy == NATS_FLUSH_POLICY_DEFAULT));
+
     test("Set UserCreds: ");
     s = natsOptions_SetUserCredentialsCallbacks(opts, _dummyUserJWTCb, (void*) 1, _dummySigCb, (void*) 2);
     testCond((s == NATS_OK)
@@ -6004,6 +6313,157 @@ test_ParserSplitMsg(void)
     natsConnection_Destroy(nc);
 }
 
+static void
+test_ParserFastPath(void)
+{
+    natsConnection  *nc = NULL;
+    natsOptions     *opts = NULL;
+    natsStatus      s;
+    char            *buf = NULL;
+    const char      *frames[2] = {"MSG foo.bar.baz 1 _INBOX.abcdefghijklmnop 16\r\n0123456789abcdef\r\n",
+                                  "HMSG foo.bar.baz 1 18 34\r\nNATS/1.0\r\nk: v\r\n\r\n0123456789abcdef\r\n"};
+    int             count = 1000;
+    int             iter  = 5;
+    int             bufLen = 0;
+    int             mode, i, j;
+
+    s = natsOptions_Create(&opts);
+    IFOK(s, natsConn_create(&nc, opts));
+    IFOK(s, natsParser_Create(&(nc->ps)));
+    if (s == NATS_OK)
+    {
+        buf = (char*) malloc(count * 64);
+        if (buf == NULL)
+            s = NATS_NO_MEMORY;
+    }
+    if (s != NATS_OK)
+        FAIL("Unable to setup test");
+
+    for (i=0; i<count; i++)
+    {
+        int l = (int) strlen(frames[i % 2]);
+
+        memcpy(buf + bufLen, frames[i % 2], l);
+        bufLen += l;
+    }
+
+    for (mode=0; mode<2; mode++)
+    {
+        nc->ps->noFastPath = (mode == 1);
+
+        if (mode == 0)
+        {
+            test("Parse with fast path: ");
+        }
+        else
+        {
+            test("Parse with state machine only: ");
+        }
+
+        nc->stats.inMsgs = 0;
+        for (j=0; (s == NATS_OK) && (j<iter); j++)
+            s = natsParser_Parse(nc, buf, bufLen);
+
+        testCond((s == NATS_OK)
+                 && (nc->ps->state == OP_START)
+                 && (nc->stats.inMsgs == (uint64_t) (count * iter)));
+    }
+
+    free(buf);
+    natsConnection_Destroy(nc);
+}
+
+// Fills a new buffer with 'count' copies of 'frame'.
+static char*
+_createParserStream(const char *frame, int count, int *bufLen)
+{
+    char    *buf = NULL;
+    int     l    = (int) strlen(frame);
+    int     i;
+
+    buf = (char*) malloc(count * l);
+    if (buf == NULL)
+        return NULL;
+
+    for (i=0; i<count; i++)
+        memcpy(buf + i * l, frame, l);
+
+    *bufLen = count * l;
+
+    return buf;
+}
+
+// Parses the same stream of MSG, then HMSG, frames with and without the
+// parser's fast path, and reports the best time per message of a few runs.
+static void
+bench_Parser(void)
+{
+    natsConnection  *nc = NULL;
+    natsOptions     *opts = NULL;
+    natsStatus      s;
+    char            *buf = NULL;
+    const char      *names[2]  = {"MSG", "HMSG"};
+    const char      *frames[2] = {"MSG foo.bar.baz 1 _INBOX.abcdefghijklmnop 16\r\n0123456789abcdef\r\n",
+                                  "HMSG foo.bar.baz 1 18 34\r\nNATS/1.0\r\nk: v\r\n\r\n0123456789abcdef\r\n"};
+    int             count = 10000;
+    int             iter  = 100;
+    int             bufLen = 0;
+    int64_t         best[2];
+    int             f, mode, run, j;
+
+    s = natsOptions_Create(&opts);
+    IFOK(s, natsConn_create(&nc, opts));
+    IFOK(s, natsParser_Create(&(nc->ps)));
+    if (s != NATS_OK)
+        FAIL("Unable to setup benchmark");
+
+    for (f=0; (s == NATS_OK) && (f<2); f++)
+    {
+        buf = _createParserStream(frames[f], count, &bufLen);
+        if (buf == NULL)
+            FAIL("Unable to setup benchmark");
+
+        for (mode=0; (s == NATS_OK) && (mode<2); mode++)
+        {
+            nc->ps->noFastPath = (mode == 1);
+            best[mode] = 0;
+
+            for (run=0; (s == NATS_OK) && (run<5); run++)
+            {
+                int64_t start;
+                int64_t dur;
+
+                nc->stats.inMsgs = 0;
+                start = nats_NowInNanoSeconds();
+                for (j=0; (s == NATS_OK) && (j<iter); j++)
+                    s = natsParser_Parse(nc, buf, bufLen);
+                dur = nats_NowInNanoSeconds() - start;
+
+                if ((s == NATS_OK)
+                    && ((nc->ps->state != OP_START)
+                        || (nc->stats.inMsgs != (uint64_t) (count * iter))))
+                {
+                    s = NATS_ERR;
+                }
+                if ((best[mode] == 0) || (dur < best[mode]))
+                    best[mode] = dur;
+            }
+        }
+        free(buf);
+
+        if (s == NATS_OK)
+            printf("%-4s fast path: %6.1f ns/msg, state machine: %6.1f ns/msg\n",
+                   names[f],
+                   (double) best[0] / (count * iter),
+                   (double) best[1] / (count * iter));
+    }
+
+    natsConnection_Destroy(nc);
+
+    if (s != NATS_OK)
+        FAIL("Parsing failed");
+}
+
 #define RECREATE_PARSER \
     natsParser_Destroy(nc->ps); \
     s = natsParser_Create(&(nc->ps)); \
@@ -6969,77 +7429,258 @@ test_LibMsgDelivery(void)
 }
 
 static void
-test_DefaultConnection(void)
+_blockingMsgHandler(natsConnection *nc, natsSubscription *sub, natsMsg *msg,
+                    void *closure)
 {
-    natsStatus          s;
-    natsConnection      *nc       = NULL;
-    natsPid             serverPid = NATS_INVALID_PID;
-    natsOptions         *opts     = NULL;
+    struct threadArg *arg = (struct threadArg*) closure;
 
-    s = natsOptions_Create(&opts);
-    IFOK(s, natsOptions_SetTimeout(opts, 500));
-    if (s != NATS_OK)
-        FAIL("Unable to setup test");
+    natsMutex_Lock(arg->m);
+    arg->current = true;
+    natsCondition_Broadcast(arg->c);
+    while (!arg->done)
+        natsCondition_Wait(arg->c, arg->m);
+    arg->done    = false;
+    arg->current = false;
+    natsCondition_Broadcast(arg->c);
+    natsMutex_Unlock(arg->m);
 
-    test("Check connection fails without running server: ");
-#ifndef _WIN32
-    s = natsConnection_ConnectTo(&nc, NATS_DEFAULT_URL);
-    if (s != NATS_OK)
-#endif
-        s = natsConnection_Connect(&nc, opts);
-    testCond(s == NATS_NO_SERVER);
+    natsMsg_Destroy(msg);
+}
 
-    serverPid = _startServer("nats://127.0.0.1:4222", NULL, true);
-    CHECK_SERVER_STARTED(serverPid);
+static void
+_orderedMsgHandler(natsConnection *nc, natsSubscription *sub, natsMsg *msg,
+                   void *closure)
+{
+    struct threadArg *arg = (struct threadArg*) closure;
 
-    test("Test default connection: ");
-    s = natsConnection_ConnectTo(&nc, NATS_DEFAULT_URL);
-    testCond(s == NATS_OK);
+    natsMutex_Lock(arg->m);
+    // Messages of a subscription must be delivered in order, one at a time.
+    if ((arg->attached++ != 0) || (atoi(natsMsg_GetData(msg)) != arg->sum))
+        arg->status = NATS_ERR;
+    natsMutex_Unlock(arg->m);
 
-    natsConnection_Destroy(nc);
-    natsOptions_Destroy(opts);
+    nats_Sleep(0);
 
-    _stopServer(serverPid);
+    natsMutex_Lock(arg->m);
+    arg->attached--;
+    arg->sum++;
+    arg->msgReceived = true;
+    natsCondition_Broadcast(arg->c);
+    natsMutex_Unlock(arg->m);
+
+    natsMsg_Destroy(msg);
 }
 
 static void
-test_SimplifiedURLs(void)
+test_LibMsgDeliveryWorkStealing(void)
 {
-    natsStatus          s         = NATS_OK;
-    natsConnection      *nc       = NULL;
+    natsStatus          s;
     natsPid             serverPid = NATS_INVALID_PID;
-#if defined(NATS_HAS_TLS)
     natsOptions         *opts     = NULL;
-#endif
-    const char          *urls[] = {
-        "nats://127.0.0.1:4222",
-        "nats://127.0.0.1:",
-        "nats://127.0.0.1",
-        "127.0.0.1:",
-        "127.0.0.1"
-    };
-    int                 urlsCount = sizeof(urls) / sizeof(char *);
+    natsConnection      *nc       = NULL;
+    natsSubscription    *s1       = NULL;
+    natsSubscription    *s2       = NULL;
+    natsSubscription    *s3       = NULL;
+    int                 threads   = 0;
+    int                 idle      = 0;
     int                 i;
+    char                data[16];
+    struct threadArg    block;
+    struct threadArg    ordered;
+    struct threadArg    other;
 
-    serverPid = _startServer("nats://127.0.0.1:4222", NULL, true);
-    CHECK_SERVER_STARTED(serverPid);
+    // First, close the library and re-open, to reset things
+    nats_Close();
 
-    test("Test simplified URLs to non TLS server: ");
-    for (i=0; ((s == NATS_OK) && (i<urlsCount)); i++)
-    {
-        s = natsConnection_ConnectTo(&nc, urls[i]);
-        if (s == NATS_OK)
-        {
-            natsConnection_Destroy(nc);
-            nc = NULL;
-        }
-    }
-    testCond(s == NATS_OK);
+    nats_Sleep(100);
 
-    _stopServer(serverPid);
-    serverPid = NATS_INVALID_PID;
+    nats_Open(-1);
 
-#if defined(NATS_HAS_TLS)
+    s = _createDefaultThreadArgsForCbTests(&block);
+    IFOK(s, _createDefaultThreadArgsForCbTests(&ordered));
+    IFOK(s, _createDefaultThreadArgsForCbTests(&other));
+    if (s != NATS_OK)
+        FAIL("Unable to setup test");
+
+    test("Check limits: ");
+    s = nats_SetMessageDeliveryPoolLimits(2, 1, 0);
+    if (s == NATS_INVALID_ARG)
+        s = nats_SetMessageDeliveryPoolLimits(0, 0, 0);
+    if (s == NATS_INVALID_ARG)
+        s = nats_SetMessageDeliveryPoolLimits(1, 2, -1);
+    testCond(s == NATS_INVALID_ARG);
+    nats_clearLastError();
+
+    test("Set limits: ");
+    s = nats_SetMessageDeliveryPoolLimits(1, 2, 100);
+    testCond(s == NATS_OK);
+
+    serverPid = _startServer("nats://127.0.0.1:4222", NULL, true);
+    CHECK_SERVER_STARTED(serverPid);
+
+    // The 1st and 3rd subscriptions are assigned to the 1st worker.
+    test("Connect and subscribe: ");
+    s = natsOptions_Create(&opts);
+    IFOK(s, natsOptions_UseGlobalMessageDelivery(opts, true));
+    IFOK(s, natsConnection_Connect(&nc, opts));
+    IFOK(s, natsConnection_Subscribe(&s1, nc, "foo", _blockingMsgHandler, &block));
+    IFOK(s, natsConnection_Subscribe(&s2, nc, "baz", _orderedMsgHandler, &other));
+    IFOK(s, natsConnection_Subscribe(&s3, nc, "bar", _orderedMsgHandler, &ordered));
+    testCond((s == NATS_OK)
+             && (s1->libDlvWorker == s3->libDlvWorker)
+             && (s2->libDlvWorker != s1->libDlvWorker));
+
+    test("Block 1st worker: ");
+    s = natsConnection_PublishString(nc, "foo", "block");
+    natsMutex_Lock(block.m);
+    while ((s != NATS_TIMEOUT) && !block.current)
+        s = natsCondition_TimedWait(block.c, block.m, 2000);
+    natsMutex_Unlock(block.m);
+    testCond(s == NATS_OK);
+
+    test("Messages stolen and delivered in order: ");
+    for (i=0; (s == NATS_OK) && (i<1000); i++)
+    {
+        snprintf(data, sizeof(data), "%d", i);
+        s = natsConnection_PublishString(nc, "bar", data);
+    }
+    natsMutex_Lock(ordered.m);
+    while ((s != NATS_TIMEOUT) && (ordered.sum != 1000))
+        s = natsCondition_TimedWait(ordered.c, ordered.m, 5000);
+    IFOK(s, ordered.status);
+    natsMutex_Unlock(ordered.m);
+    natsMutex_Lock(block.m);
+    if ((s == NATS_OK) && !block.current)
+        s = NATS_ERR;
+    block.done = true;
+    natsCondition_Broadcast(block.c);
+    while ((s != NATS_TIMEOUT) && block.current)
+        s = natsCondition_TimedWait(block.c, block.m, 2000);
+    natsMutex_Unlock(block.m);
+    testCond(s == NATS_OK);
+
+    test("Pool shrinks when idle: ");
+    for (i=0; i<50; i++)
+    {
+        natsLib_getMsgDeliveryPoolThreads(&threads, &idle);
+        if (threads == 1)
+            break;
+        nats_Sleep(100);
+    }
+    testCond((threads == 1) && (idle == 1));
+
+    test("Pool grows when all threads are busy: ");
+    s = natsConnection_PublishString(nc, "foo", "block");
+    natsMutex_Lock(block.m);
+    while ((s != NATS_TIMEOUT) && !block.current)
+        s = natsCondition_TimedWait(block.c, block.m, 2000);
+    natsMutex_Unlock(block.m);
+    IFOK(s, natsConnection_PublishString(nc, "baz", "0"));
+    natsMutex_Lock(other.m);
+    while ((s != NATS_TIMEOUT) && !other.msgReceived)
+        s = natsCondition_TimedWait(other.c, other.m, 2000);
+    IFOK(s, other.status);
+    natsMutex_Unlock(other.m);
+    natsLib_getMsgDeliveryPoolThreads(&threads, &idle);
+    natsMutex_Lock(block.m);
+    block.done = true;
+    natsCondition_Broadcast(block.c);
+    while (block.current)
+        natsCondition_Wait(block.c, block.m);
+    natsMutex_Unlock(block.m);
+    testCond((s == NATS_OK) && (threads == 2));
+
+    natsSubscription_Destroy(s3);
+    natsSubscription_Destroy(s2);
+    natsSubscription_Destroy(s1);
+    natsConnection_Destroy(nc);
+    natsOptions_Destroy(opts);
+    _stopServer(serverPid);
+
+    _destroyDefaultThreadArgs(&other);
+    _destroyDefaultThreadArgs(&ordered);
+    _destroyDefaultThreadArgs(&block);
+
+    // Close the library and re-open, to reset things
+    nats_Close();
+
+    nats_Sleep(100);
+
+    nats_Open(-1);
+}
+
+static void
+test_DefaultConnection(void)
+{
+    natsStatus          s;
+    natsConnection      *nc       = NULL;
+    natsPid             serverPid = NATS_INVALID_PID;
+    natsOptions         *opts     = NULL;
+
+    s = natsOptions_Create(&opts);
+    IFOK(s, natsOptions_SetTimeout(opts, 500));
+    if (s != NATS_OK)
+        FAIL("Unable to setup test");
+
+    test("Check connection fails without running server: ");
+#ifndef _WIN32
+    s = natsConnection_ConnectTo(&nc, NATS_DEFAULT_URL);
+    if (s != NATS_OK)
+#endif
+        s = natsConnection_Connect(&nc, opts);
+    testCond(s == NATS_NO_SERVER);
+
+    serverPid = _startServer("nats://127.0.0.1:4222", NULL, true);
+    CHECK_SERVER_STARTED(serverPid);
+
+    test("Test default connection: ");
+    s = natsConnection_ConnectTo(&nc, NATS_DEFAULT_URL);
+    testCond(s == NATS_OK);
+
+    natsConnection_Destroy(nc);
+    natsOptions_Destroy(opts);
+
+    _stopServer(serverPid);
+}
+
+static void
+test_SimplifiedURLs(void)
+{
+    natsStatus          s         = NATS_OK;
+    natsConnection      *nc       = NULL;
+    natsPid             serverPid = NATS_INVALID_PID;
+#if defined(NATS_HAS_TLS)
+    natsOptions         *opts     = NULL;
+#endif
+    const char          *urls[] = {
+        "nats://127.0.0.1:4222",
+        "nats://127.0.0.1:",
+        "nats://127.0.0.1",
+        "127.0.0.1:",
+        "127.0.0.1"
+    };
+    int                 urlsCount = sizeof(urls) / sizeof(char *);
+    int                 i;
+
+    serverPid = _startServer("nats://127.0.0.1:4222", NULL, true);
+    CHECK_SERVER_STARTED(serverPid);
+
+    test("Test simplified URLs to non TLS server: ");
+    for (i=0; ((s == NATS_OK) && (i<urlsCount)); i++)
+    {
+        s = natsConnection_ConnectTo(&nc, urls[i]);
+        if (s == NATS_OK)
+        {
+            natsConnection_Destroy(nc);
+            nc = NULL;
+        }
+    }
+    testCond(s == NATS_OK);
+
+    _stopServer(serverPid);
+    serverPid = NATS_INVALID_PID;
+
+#if defined(NATS_HAS_TLS)
     serverPid = _startServer("nats://127.0.0.1:4222", "-c tls_default_port.conf -DV", true);
     CHECK_SERVER_STARTED(serverPid);
 
@@ -7221,6 +7862,69 @@ test_IPResolutionOrder(void)
     natsOptions_Destroy(opts);
 }
 
+static void
+test_RacingConnect(void)
+{
+    natsStatus          s;
+    natsConnection      *nc       = NULL;
+    natsPid             serverPid = NATS_INVALID_PID;
+    natsOptions         *opts     = NULL;
+    char                buf[256];
+    int64_t             start     = 0;
+    const char          *servers[] = {"nats://10.255.255.1:4222", "nats://127.0.0.1:4222"};
+    const char          *refused[] = {"nats://127.0.0.1:4223", "nats://127.0.0.1:4224"};
+
+    s = natsOptions_Create(&opts);
+    IFOK(s, natsOptions_SetURL(opts, "nats://localhost:4222"));
+    IFOK(s, natsOptions_SetRacingConnect(opts, 50, 1));
+    if (s != NATS_OK)
+        FAIL("Unable to setup test");
+
+    serverPid = _startServer("nats://127.0.0.1:4222", "-a 127.0.0.1 -p 4222", true);
+    CHECK_SERVER_STARTED(serverPid);
+
+    test("Race across addresses: ");
+    s = natsConnection_Connect(&nc, opts);
+    testCond(s == NATS_OK);
+    natsConnection_Destroy(nc);
+    nc = NULL;
+
+    test("Race across servers: ");
+    // The first server is not reachable, and may not even respond. Without
+    // racing, this could take the whole connect timeout.
+    s = natsOptions_SetURL(opts, NULL);
+    IFOK(s, natsOptions_SetServers(opts, servers, 2));
+    IFOK(s, natsOptions_SetNoRandomize(opts, true));
+    IFOK(s, natsOptions_SetTimeout(opts, 10000));
+    IFOK(s, natsOptions_SetRacingConnect(opts, 50, 2));
+    if (s == NATS_OK)
+    {
+        start = nats_Now();
+        s = natsConnection_Connect(&nc, opts);
+    }
+    IFOK(s, natsConnection_GetConnectedUrl(nc, buf, sizeof(buf)));
+    testCond((s == NATS_OK)
+             && (strcmp(buf, "nats://127.0.0.1:4222") == 0)
+             && ((nats_Now() - start) < 5000));
+
+    test("Can publish: ");
+    s = natsConnection_PublishString(nc, "foo", "bar");
+    IFOK(s, natsConnection_Flush(nc));
+    testCond(s == NATS_OK);
+    natsConnection_Destroy(nc);
+    nc = NULL;
+
+    test("All servers fail: ");
+    s = natsOptions_SetServers(opts, refused, 2);
+    IFOK(s, natsConnection_Connect(&nc, opts));
+    testCond((s == NATS_NO_SERVER) && (nc == NULL));
+    nats_clearLastError();
+
+    natsOptions_Destroy(opts);
+
+    _stopServer(serverPid);
+}
+
 static void
 test_UseDefaultURLIfNoServerSpecified(void)
 {
@@ -9768,450 +10472,2323 @@ test_PublishMsg(void)
 }
 
 static void
-test_InvalidSubsArgs(void)
+test_PublishBatch(void)
 {
     natsStatus          s;
-    natsConnection      *nc = NULL;
-    natsSubscription    *sub = NULL;
+    natsConnection      *nc       = NULL;
+    natsSubscription    *sub      = NULL;
+    natsMsg             *msg      = NULL;
+    natsMsg             *msgs[3]  = {NULL, NULL, NULL};
+    natsStatus          errors[3];
+    const char          *subjs[3] = {"foo", "foo", "bar"};
+    const void          *data[3]  = {"1", "2", "3"};
+    int                 lens[3]   = {1, 1, 1};
+    uint64_t            outMsgs   = 0;
+    natsStatistics      *stats    = NULL;
     natsPid             serverPid = NATS_INVALID_PID;
+    int                 i;
 
     serverPid = _startServer("nats://127.0.0.1:4222", NULL, true);
     CHECK_SERVER_STARTED(serverPid);
 
     s = natsConnection_ConnectTo(&nc, NATS_DEFAULT_URL);
+    IFOK(s, natsConnection_SubscribeSync(&sub, nc, "foo"));
+    IFOK(s, natsConnection_Flush(nc));
+    IFOK(s, natsStatistics_Create(&stats));
     if (s != NATS_OK)
-        FAIL("Unable to setup test");
-
-    // ASYNC Subscription
+        FAIL("Unable to setup test")
 
-    test("Test async subscriber, invalid connection: ")
-    s = natsConnection_Subscribe(&sub, NULL, "foo", _recvTestString, NULL);
-    testCond(s != NATS_OK);
+    test("Invalid args: ")
+    s = natsConnection_PublishBatch(NULL, msgs, 1, NULL);
+    if (s == NATS_INVALID_ARG)
+        s = natsConnection_PublishBatch(nc, NULL, 1, NULL);
+    if (s == NATS_INVALID_ARG)
+        s = natsConnection_PublishBatch(nc, msgs, -1, NULL);
+    if (s == NATS_INVALID_ARG)
+        s = natsConnection_PublishBatchData(nc, NULL, data, lens, 1, NULL);
+    if (s == NATS_INVALID_ARG)
+        s = natsConnection_PublishBatchData(nc, subjs, data, NULL, 1, NULL);
+    testCond(s == NATS_INVALID_ARG);
+    nats_clearLastError();
 
-    test("Test async subscriber, invalid subject: ")
-    s = natsConnection_Subscribe(&sub, nc, NULL, _recvTestString, NULL);
-    testCond(s != NATS_OK);
+    test("Empty batch is ok: ")
+    s = natsConnection_PublishBatch(nc, NULL, 0, NULL);
+    testCond(s == NATS_OK);
 
-    test("Test async subscriber, invalid subject (empty string): ")
-    s = natsConnection_Subscribe(&sub, nc, "", _recvTestString, NULL);
-    testCond(s != NATS_OK);
+    test("Create messages: ")
+    s = natsMsg_Create(&(msgs[0]), "foo", NULL, "a", 1);
+    IFOK(s, natsMsg_Create(&(msgs[2]), "foo", "reply", "c", 1));
+    testCond(s == NATS_OK);
 
-    test("Test async subscriber, invalid cb: ")
-    s = natsConnection_Subscribe(&sub, nc, "foo", NULL, NULL);
-    testCond(s != NATS_OK);
+    test("Partial failure reported per message: ")
+    s = natsConnection_PublishBatch(nc, msgs, 3, errors);
+    testCond((s == NATS_INVALID_ARG)
+                && (errors[0] == NATS_OK)
+                && (errors[1] == NATS_INVALID_ARG)
+                && (errors[2] == NATS_OK));
+    nats_clearLastError();
 
-    test("Test async queue subscriber, invalid connection: ")
-    s = natsConnection_QueueSubscribe(&sub, NULL, "foo", "group", _recvTestString, NULL);
-    testCond(s != NATS_OK);
+    test("Valid messages received in order: ")
+    s = natsSubscription_NextMsg(&msg, sub, 1000);
+    if ((s == NATS_OK)
+        && ((strncmp(natsMsg_GetData(msg), "a", 1) != 0)
+            || (natsMsg_GetReply(msg) != NULL)))
+    {
+        s = NATS_ERR;
+    }
+    natsMsg_Destroy(msg);
+    msg = NULL;
+    IFOK(s, natsSubscription_NextMsg(&msg, sub, 1000));
+    if ((s == NATS_OK)
+        && ((strncmp(natsMsg_GetData(msg), "c", 1) != 0)
+            || (strcmp(natsMsg_GetReply(msg), "reply") != 0)))
+    {
+        s = NATS_ERR;
+    }
+    natsMsg_Destroy(msg);
+    msg = NULL;
+    testCond(s == NATS_OK);
 
-    // Async Subscription Timeout
+    test("Stats updated for sent messages only: ")
+    s = natsConnection_GetStats(nc, stats);
+    IFOK(s, natsStatistics_GetCounts(stats, NULL, NULL, &outMsgs, NULL, NULL));
+    testCond((s == NATS_OK) && (outMsgs == 2));
 
-    test("Test async subscriber timeout, invalid connection: ")
-    s = natsConnection_SubscribeTimeout(&sub, NULL, "foo", 100, _recvTestString, NULL);
-    testCond(s != NATS_OK);
+    test("Publish batch data: ")
+    s = natsConnection_PublishBatchData(nc, subjs, data, lens, 3, errors);
+    testCond((s == NATS_OK)
+                && (errors[0] == NATS_OK)
+                && (errors[1] == NATS_OK)
+                && (errors[2] == NATS_OK));
 
-    test("Test async subscriber timeout, invalid subject: ")
-    s = natsConnection_SubscribeTimeout(&sub, nc, NULL, 100, _recvTestString, NULL);
-    testCond(s != NATS_OK);
+    test("Received on subscribed subject: ")
+    for (i=0; (s == NATS_OK) && (i<2); i++)
+    {
+        s = natsSubscription_NextMsg(&msg, sub, 1000);
+        if ((s == NATS_OK)
+            && (strncmp(natsMsg_GetData(msg), (const char*) data[i], 1) != 0))
+        {
+            s = NATS_ERR;
+        }
+        natsMsg_Destroy(msg);
+        msg = NULL;
+    }
+    IFOK(s, natsConnection_Flush(nc));
+    if (s == NATS_OK)
+    {
+        s = natsSubscription_NextMsg(&msg, sub, 100);
+        if (s == NATS_TIMEOUT)
+            s = NATS_OK;
+        else
+            s = NATS_ERR;
+    }
+    testCond(s == NATS_OK);
+    nats_clearLastError();
 
-    test("Test async subscriber timeout, invalid subject (empty string): ")
-    s = natsConnection_SubscribeTimeout(&sub, nc, "", 100, _recvTestString, NULL);
-    testCond(s != NATS_OK);
+    test("Batch on closed connection fails for all: ")
+    natsConnection_Close(nc);
+    s = natsConnection_PublishBatch(nc, msgs, 3, errors);
+    testCond((s == NATS_CONNECTION_CLOSED)
+                && (errors[0] == NATS_CONNECTION_CLOSED)
+                && (errors[1] == NATS_CONNECTION_CLOSED)
+                && (errors[2] == NATS_CONNECTION_CLOSED));
+    nats_clearLastError();
 
-    test("Test async subscriber timeout, invalid cb: ")
-    s = natsConnection_SubscribeTimeout(&sub, nc, "foo", 100, NULL, NULL);
-    testCond(s != NATS_OK);
+    for (i=0; i<3; i++)
+        natsMsg_Destroy(msgs[i]);
+    natsStatistics_Destroy(stats);
+    natsSubscription_Destroy(sub);
+    natsConnection_Destroy(nc);
 
-    test("Test async subscriber timeout, invalid timeout (<0): ")
-    s = natsConnection_SubscribeTimeout(&sub, nc, "foo", -100, _recvTestString, NULL);
-    testCond(s != NATS_OK);
-
-    test("Test async subscriber timeout, invalid timeout (0): ")
-    s = natsConnection_SubscribeTimeout(&sub, nc, "foo", 0, _recvTestString, NULL);
-    testCond(s != NATS_OK);
+    _stopServer(serverPid);
+}
 
-    // ASYNC Queue Subscription
+// Checks that 'count' pairs of small and large messages are received,
+// in order and intact.
+static natsStatus
+_checkSmallLargeMsgs(natsSubscription *sub, const char *large, int largeSize, int count)
+{
+    natsStatus  s   = NATS_OK;
+    natsMsg     *msg = NULL;
+    int         i;
 
-    test("Test async queue subscriber timeout, invalid connection: ")
-    s = natsConnection_QueueSubscribe(&sub, NULL, "foo", "group", _recvTestString, NULL);
-    testCond(s != NATS_OK);
+    for (i=0; (s == NATS_OK) && (i<2*count); i++)
+    {
+        s = natsSubscription_NextMsg(&msg, sub, 5000);
+        if (s == NATS_OK)
+        {
+            if ((i % 2) == 0)
+            {
+                if ((natsMsg_GetDataLength(msg) != 5)
+                    || (strncmp(natsMsg_GetData(msg), "small", 5) != 0))
+                {
+                    s = NATS_ERR;
+                }
+            }
+            else if ((natsMsg_GetDataLength(msg) != largeSize)
+                     || (memcmp(natsMsg_GetData(msg), large, largeSize) != 0))
+            {
+                s = NATS_ERR;
+            }
+        }
+        natsMsg_Destroy(msg);
+        msg = NULL;
+    }
+    return s;
+}
 
-    test("Test async queue subscriber, invalid subject: ")
-    s = natsConnection_QueueSubscribe(&sub, nc, NULL, "group", _recvTestString, NULL);
-    testCond(s != NATS_OK);
+// Publishes 'count' pairs of small and large messages, the large ones with
+// natsConnection_PublishMsg(), destroying them right away. With the
+// connection's lock held, checks that the payloads are referenced by the
+// pending output, not copied.
+static natsStatus
+_publishSmallLargeMsgs(natsConnection *nc, const char *large, int largeSize, int count)
+{
+    natsStatus  s   = NATS_OK;
+    natsMsg     *msg = NULL;
+    int         i;
 
-    test("Test async queue subscriber, invalid subject (empty string): ")
-    s = natsConnection_QueueSubscribe(&sub, nc, "", "group", _recvTestString, NULL);
-    testCond(s != NATS_OK);
+    natsConn_Lock(nc);
+    for (i=0; (s == NATS_OK) && (i<count); i++)
+    {
+        s = natsConnection_PublishString(nc, "foo", "small");
+        IFOK(s, natsMsg_Create(&msg, "foo", NULL, large, largeSize));
+        IFOK(s, natsConnection_PublishMsg(nc, msg));
+        natsMsg_Destroy(msg);
+        msg = NULL;
+    }
+    if ((s == NATS_OK)
+        && ((nc->out.count != count)
+            || (nc->out.bytes != count * largeSize)
+            || (natsBuf_Len(nc->bw) >= largeSize)
+            || (natsConnection_Buffered(nc) != natsBuf_Len(nc->bw) + count * largeSize)))
+    {
+        s = NATS_ERR;
+    }
+    natsConn_Unlock(nc);
 
-    test("Test async queue subscriber, invalid group name: ")
-    s = natsConnection_QueueSubscribe(&sub, nc, "foo", NULL, _recvTestString, NULL);
-    testCond(s != NATS_OK);
+    return s;
+}
 
-    test("Test async queue subscriber, invalid group name (empty): ")
-    s = natsConnection_QueueSubscribe(&sub, nc, "foo", "", _recvTestString, NULL);
-    testCond(s != NATS_OK);
+static void
+test_PublishLargeAfterBufferedData(void)
+{
+    natsStatus          s;
+    natsConnection      *nc       = NULL;
+    natsSubscription    *sub      = NULL;
+    char                *large    = NULL;
+    int                 largeSize = 256*1024;
+    natsPid             serverPid = NATS_INVALID_PID;
+    int                 i;
 
-    test("Test async queue subscriber, invalid cb: ")
-    s = natsConnection_QueueSubscribe(&sub, nc, "foo", "group", NULL, NULL);
-    testCond(s != NATS_OK);
+    large = (char*) malloc(largeSize);
+    if (large == NULL)
+        FAIL("Unable to setup test");
+    for (i=0; i<largeSize; i++)
+        large[i] = 'a' + (i % 26);
 
-    // ASYNC Queue Subscription Timeout
+    serverPid = _startServer("nats://127.0.0.1:4222", NULL, true);
+    CHECK_SERVER_STARTED(serverPid);
 
-    test("Test async queue subscriber timeout, invalid connection: ")
-    s = natsConnection_QueueSubscribeTimeout(&sub, NULL, "foo", "group", 100, _recvTestString, NULL);
-    testCond(s != NATS_OK);
+    s = natsConnection_ConnectTo(&nc, NATS_DEFAULT_URL);
+    IFOK(s, natsConnection_SubscribeSync(&sub, nc, "foo"));
+    IFOK(s, natsConnection_Flush(nc));
+    if (s != NATS_OK)
+        FAIL("Unable to setup test");
 
-    test("Test async queue subscriber timeout, invalid subject: ")
-    s = natsConnection_QueueSubscribeTimeout(&sub, nc, NULL, "group", 100, _recvTestString, NULL);
-    testCond(s != NATS_OK);
+    test("Publish small then large messages: ")
+    for (i=0; (s == NATS_OK) && (i<10); i++)
+    {
+        s = natsConnection_PublishString(nc, "foo", "small");
+        IFOK(s, natsConnection_Publish(nc, "foo", large, largeSize));
+    }
+    IFOK(s, natsConnection_Flush(nc));
+    testCond(s == NATS_OK);
 
-    test("Test async queue subscriber timeout, invalid subject (empty string): ")
-    s = natsConnection_QueueSubscribeTimeout(&sub, nc, "", "group", 100, _recvTestString, NULL);
-    testCond(s != NATS_OK);
+    test("Messages received in order and intact: ")
+    s = _checkSmallLargeMsgs(sub, large, largeSize, 10);
+    testCond(s == NATS_OK);
 
-    test("Test async queue subscriber timeout, invalid group name: ")
-    s = natsConnection_QueueSubscribeTimeout(&sub, nc, "foo", NULL, 100, _recvTestString, NULL);
-    testCond(s != NATS_OK);
+    test("Large payloads of messages are referenced: ");
+    s = _publishSmallLargeMsgs(nc, large, largeSize, 10);
+    testCond(s == NATS_OK);
 
-    test("Test async queue subscriber timeout, invalid group name (empty): ")
-    s = natsConnection_QueueSubscribeTimeout(&sub, nc, "foo", "", 100, _recvTestString, NULL);
-    testCond(s != NATS_OK);
+    test("Sent by the flusher: ");
+    s = natsConnection_Flush(nc);
+    natsConn_Lock(nc);
+    testCond((s == NATS_OK) && (nc->out.count == 0) && (nc->out.bytes == 0));
+    natsConn_Unlock(nc);
 
-    test("Test async queue subscriber timeout, invalid cb: ")
-    s = natsConnection_QueueSubscribeTimeout(&sub, nc, "foo", "group", 100, NULL, NULL);
-    testCond(s != NATS_OK);
+    test("Messages received in order and intact: ")
+    s = _checkSmallLargeMsgs(sub, large, largeSize, 10);
+    testCond(s == NATS_OK);
 
-    test("Test async queue subscriber timeout, invalid timeout (<0): ")
-    s = natsConnection_QueueSubscribeTimeout(&sub, nc, "foo", "group", -100, _recvTestString, NULL);
-    testCond(s != NATS_OK);
+    test("Referenced payloads released on close: ");
+    s = _publishSmallLargeMsgs(nc, large, largeSize, 3);
+    natsConnection_Close(nc);
+    natsConn_Lock(nc);
+    testCond((s == NATS_OK) && (nc->out.count == 0) && (nc->out.bytes == 0));
+    natsConn_Unlock(nc);
 
-    test("Test async queue subscriber timeout, invalid timeout (0): ")
-    s = natsConnection_QueueSubscribeTimeout(&sub, nc, "foo", "group", 0, _recvTestString, NULL);
-    testCond(s != NATS_OK);
+    natsSubscription_Destroy(sub);
+    natsConnection_Destroy(nc);
+    free(large);
 
-    // SYNC Subscription
+    _stopServer(serverPid);
+}
 
-    test("Test sync subscriber, invalid connection: ")
-    s = natsConnection_SubscribeSync(&sub, NULL, "foo");
-    testCond(s != NATS_OK);
+static void
+test_InboundZeroCopy(void)
+{
+    natsStatus          s;
+    natsConnection      *nc       = NULL;
+    natsOptions         *opts     = NULL;
+    natsSubscription    *sub      = NULL;
+    natsMsg             *msgs[4]  = {NULL, NULL, NULL, NULL};
+    natsMsg             *hmsg     = NULL;
+    const char          *val      = NULL;
+    char                *large    = NULL;
+    int                 largeSize = 100;
+    natsPid             serverPid = NATS_INVALID_PID;
+    int                 i;
 
-    test("Test sync subscriber, invalid subject: ")
-    s = natsConnection_SubscribeSync(&sub, nc, NULL);
-    testCond(s != NATS_OK);
+    s = natsOptions_Create(&opts);
+    // Use a small buffer so that some messages are split across reads.
+    IFOK(s, natsOptions_SetIOBufSize(opts, 64));
+    IFOK(s, natsOptions_SetInboundZeroCopy(opts, true));
+    if (s == NATS_OK)
+    {
+        large = (char*) malloc(largeSize);
+        if (large == NULL)
+            s = NATS_NO_MEMORY;
+    }
+    if (s != NATS_OK)
+        FAIL("Unable to setup test");
 
-    test("Test sync subscriber, invalid subject (empty string): ")
-    s = natsConnection_SubscribeSync(&sub, nc, "");
-    testCond(s != NATS_OK);
+    for (i=0; i<largeSize; i++)
+        large[i] = 'a' + (i % 26);
 
-    // SYNC Queue Subscription
+    serverPid = _startServer("nats://127.0.0.1:4222", NULL, true);
+    CHECK_SERVER_STARTED(serverPid);
 
-    test("Test sync queue subscriber, invalid connection: ")
-    s = natsConnection_QueueSubscribeSync(&sub, NULL, "foo", "group");
-    testCond(s != NATS_OK);
+    test("Connect and subscribe: ");
+    s = natsConnection_Connect(&nc, opts);
+    IFOK(s, natsConnection_SubscribeSync(&sub, nc, "foo"));
+    IFOK(s, natsConnection_Flush(nc));
+    testCond(s == NATS_OK);
 
-    test("Test sync queue subscriber, invalid subject: ")
-    s = natsConnection_QueueSubscribeSync(&sub, nc, NULL, "group");
-    testCond(s != NATS_OK);
+    test("Publish: ");
+    s = natsConnection_PublishString(nc, "foo", "hello");
+    IFOK(s, natsConnection_PublishRequestString(nc, "foo", "bar", "world"));
+    IFOK(s, natsConnection_Publish(nc, "foo", large, largeSize));
+    IFOK(s, natsConnection_Publish(nc, "foo", NULL, 0));
+    if (s == NATS_OK)
+    {
+        s = natsMsg_Create(&hmsg, "foo", NULL, "with headers", 12);
+        IFOK(s, natsMsgHeader_Set(hmsg, "k", "v"));
+        IFOK(s, natsConnection_PublishMsg(nc, hmsg));
+        natsMsg_Destroy(hmsg);
+        hmsg = NULL;
+    }
+    IFOK(s, natsConnection_Flush(nc));
+    testCond(s == NATS_OK);
 
-    test("Test sync queue subscriber, invalid subject (empty string): ")
-    s = natsConnection_QueueSubscribeSync(&sub, nc, "", "group");
-    testCond(s != NATS_OK);
+    test("Receive messages: ");
+    for (i=0; (s == NATS_OK) && (i<4); i++)
+        s = natsSubscription_NextMsg(&(msgs[i]), sub, 2000);
+    IFOK(s, natsSubscription_NextMsg(&hmsg, sub, 2000));
+    testCond(s == NATS_OK);
 
-    test("Test sync queue subscriber, invalid group name: ")
-    s = natsConnection_QueueSubscribeSync(&sub, nc, "foo", NULL);
-    testCond(s != NATS_OK);
+    // Close the connection before checking the messages, to make sure
+    // that they do not depend on the connection's read buffer.
+    natsSubscription_Destroy(sub);
+    natsConnection_Destroy(nc);
 
-    test("Test sync queue subscriber, invalid group name (empty): ")
-    s = natsConnection_QueueSubscribeSync(&sub, nc, "foo", "");
-    testCond(s != NATS_OK);
+    test("Check content: ");
+    testCond((strcmp(natsMsg_GetSubject(msgs[0]), "foo") == 0)
+                && (natsMsg_GetReply(msgs[0]) == NULL)
+                && (natsMsg_GetDataLength(msgs[0]) == 5)
+                && (strcmp(natsMsg_GetData(msgs[0]), "hello") == 0)
+                && (strcmp(natsMsg_GetSubject(msgs[1]), "foo") == 0)
+                && (strcmp(natsMsg_GetReply(msgs[1]), "bar") == 0)
+                && (strcmp(natsMsg_GetData(msgs[1]), "world") == 0)
+                && (natsMsg_GetDataLength(msgs[2]) == largeSize)
+                && (memcmp(natsMsg_GetData(msgs[2]), large, largeSize) == 0)
+                && (natsMsg_GetData(msgs[2])[largeSize] == '\0')
+                && (natsMsg_GetDataLength(msgs[3]) == 0)
+                && (natsMsg_GetData(msgs[3])[0] == '\0'));
+
+    test("Check message with headers: ");
+    s = natsMsgHeader_Get(hmsg, "k", &val);
+    testCond((s == NATS_OK)
+                && (val != NULL)
+                && (strcmp(val, "v") == 0)
+                && (strcmp(natsMsg_GetData(hmsg), "with headers") == 0));
 
-    natsConnection_Destroy(nc);
+    for (i=0; i<4; i++)
+        natsMsg_Destroy(msgs[i]);
+    natsMsg_Destroy(hmsg);
+    natsOptions_Destroy(opts);
+    free(large);
 
     _stopServer(serverPid);
 }
 
 static void
-test_AsyncSubscribe(void)
+test_MessagePool(void)
 {
     natsStatus          s;
     natsConnection      *nc       = NULL;
+    natsOptions         *opts     = NULL;
     natsSubscription    *sub      = NULL;
+    natsMsg             *msg      = NULL;
+    natsStatistics      *stats    = NULL;
+    char                *large    = NULL;
+    int                 largeSize = 10000;
+    uint64_t            hits      = 0;
+    uint64_t            misses    = 0;
     natsPid             serverPid = NATS_INVALID_PID;
-    struct threadArg    arg;
-
-    s = _createDefaultThreadArgsForCbTests(&arg);
-    if ( s != NATS_OK)
-        FAIL("Unable to setup test!");
+    int                 i;
 
-    arg.string = "Hello World";
-    arg.status = NATS_OK;
-    arg.control= 1;
+    s = natsOptions_Create(&opts);
+    IFOK(s, natsOptions_UseMessagePool(opts, true));
+    IFOK(s, natsStatistics_Create(&stats));
+    if (s == NATS_OK)
+    {
+        large = (char*) calloc(1, largeSize);
+        if (large == NULL)
+            s = NATS_NO_MEMORY;
+    }
+    if (s != NATS_OK)
+        FAIL("Unable to setup test");
 
     serverPid = _startServer("nats://127.0.0.1:4222", NULL, true);
     CHECK_SERVER_STARTED(serverPid);
 
-    test("Test async subscriber: ")
-    s = natsConnection_ConnectTo(&nc, NATS_DEFAULT_URL);
-    IFOK(s, natsConnection_Subscribe(&sub, nc, "foo", _recvTestString,
-                                     (void*) &arg));
-    IFOK(s, natsConnection_PublishString(nc, "foo", arg.string));
+    test("Connect and subscribe: ");
+    s = natsConnection_Connect(&nc, opts);
+    IFOK(s, natsConnection_SubscribeSync(&sub, nc, "foo"));
+    IFOK(s, natsConnection_Flush(nc));
+    testCond(s == NATS_OK);
 
-    natsMutex_Lock(arg.m);
-    while ((s != NATS_TIMEOUT) && !arg.msgReceived)
-        s = natsCondition_TimedWait(arg.c, arg.m, 1500);
-    natsMutex_Unlock(arg.m);
+    test("Receive messages: ");
+    for (i=0; (s == NATS_OK) && (i<10); i++)
+        s = natsConnection_PublishString(nc, "foo", "hello");
+    IFOK(s, natsConnection_Publish(nc, "foo", large, largeSize));
+    for (i=0; (s == NATS_OK) && (i<11); i++)
+    {
+        s = natsSubscription_NextMsg(&msg, sub, 2000);
+        natsMsg_Destroy(msg);
+        msg = NULL;
+    }
+    testCond(s == NATS_OK);
 
-    IFOK(s, arg.status);
+    test("Check counts: ");
+    s = natsConnection_GetStats(nc, stats);
+    IFOK(s, natsStatistics_GetMsgPoolCounts(stats, &hits, &misses));
+    testCond((s == NATS_OK) && (hits == 0) && (misses == 10));
+
+    // Messages are cached by this thread, return them to the pool.
+    nats_ReleaseThreadMemory();
+
+    test("Receive more messages: ");
+    for (i=0; (s == NATS_OK) && (i<10); i++)
+        s = natsConnection_PublishString(nc, "foo", "world");
+    for (i=0; (s == NATS_OK) && (i<10); i++)
+    {
+        s = natsSubscription_NextMsg(&msg, sub, 2000);
+        if ((s == NATS_OK) && (strcmp(natsMsg_GetData(msg), "world") != 0))
+            s = NATS_ERR;
+        natsMsg_Destroy(msg);
+        msg = NULL;
+    }
     testCond(s == NATS_OK);
 
+    test("Messages were reused: ");
+    s = natsConnection_GetStats(nc, stats);
+    IFOK(s, natsStatistics_GetMsgPoolCounts(stats, &hits, &misses));
+    testCond((s == NATS_OK) && (hits == 10) && (misses == 10));
+
+    test("Message can outlive connection: ");
+    s = natsConnection_PublishString(nc, "foo", "last");
+    IFOK(s, natsSubscription_NextMsg(&msg, sub, 2000));
     natsSubscription_Destroy(sub);
     natsConnection_Destroy(nc);
+    testCond((s == NATS_OK) && (strcmp(natsMsg_GetData(msg), "last") == 0));
+    natsMsg_Destroy(msg);
 
-    _destroyDefaultThreadArgs(&arg);
+    test("Check invalid args: ");
+    s = natsStatistics_GetMsgPoolCounts(NULL, &hits, &misses);
+    testCond(s == NATS_INVALID_ARG);
+    nats_clearLastError();
+
+    natsStatistics_Destroy(stats);
+    natsOptions_Destroy(opts);
+    free(large);
 
     _stopServer(serverPid);
 }
 
-typedef struct __asyncTimeoutInfo
+static void
+test_GCCounts(void)
 {
-    struct threadArg    *arg;
-    int64_t             timeout;
-    int64_t             timeAfterFirstMsg;
-    int64_t             timeSecondMsg;
-    int64_t             timeFirstTimeout;
-    int64_t             timeSecondTimeout;
+    natsStatus          s;
+    natsConnection      *nc       = NULL;
+    natsSubscription    *sub      = NULL;
+    natsMsg             *msg      = NULL;
+    uint64_t            queued    = 0;
+    uint64_t            handedOff = 0;
+    uint64_t            local     = 0;
+    uint64_t            q         = 0;
+    uint64_t            h         = 0;
+    uint64_t            l         = 0;
+    int64_t             delivered = 0;
+    natsPid             serverPid = NATS_INVALID_PID;
+    int                 i;
 
-} _asyncTimeoutInfo;
+    serverPid = _startServer("nats://127.0.0.1:4222", NULL, true);
+    CHECK_SERVER_STARTED(serverPid);
+
+    test("Get initial counts: ");
+    s = nats_GetGCCounts(&queued, &handedOff, &local);
+    testCond(s == NATS_OK);
+
+    test("Destroy from user thread is not deferred: ");
+    s = natsMsg_Create(&msg, "foo", NULL, "hello", 5);
+    natsMsg_Destroy(msg);
+    IFOK(s, nats_GetGCCounts(&q, NULL, NULL));
+    testCond((s == NATS_OK) && (q == queued));
+
+    test("Connect and subscribe: ");
+    s = natsConnection_ConnectTo(&nc, NATS_DEFAULT_URL);
+    IFOK(s, natsConnection_Subscribe(&sub, nc, "foo", _dummyMsgHandler, NULL));
+    IFOK(s, natsConnection_Flush(nc));
+    testCond(s == NATS_OK);
+
+    test("Destroy from callbacks: ");
+    for (i=0; (s == NATS_OK) && (i<1000); i++)
+        s = natsConnection_PublishString(nc, "foo", "hello");
+    IFOK(s, natsConnection_Flush(nc));
+    for (i=0; (s == NATS_OK) && (delivered != 1000) && (i<100); i++)
+    {
+        nats_Sleep(50);
+        s = natsSubscription_GetDelivered(sub, &delivered);
+    }
+    testCond((s == NATS_OK) && (delivered == 1000));
+
+    test("All deferred messages are freed: ");
+    for (i=0; (s == NATS_OK) && (i<100); i++)
+    {
+        s = nats_GetGCCounts(&q, &h, &l);
+        if ((s == NATS_OK) && (q - queued >= 1000)
+                && ((q - queued) == (h - handedOff) + (l - local)))
+        {
+            break;
+        }
+        nats_Sleep(50);
+    }
+    testCond((s == NATS_OK) && (q - queued >= 1000)
+                && ((q - queued) == (h - handedOff) + (l - local)));
+
+    natsSubscription_Destroy(sub);
+    natsConnection_Destroy(nc);
+
+    _stopServer(serverPid);
+}
 
 static void
-_asyncTimeoutCb(natsConnection *nc, natsSubscription *sub, natsMsg *msg, void *closure)
+_lockFreeMsgCB(natsConnection *nc, natsSubscription *sub, natsMsg *msg, void *closure)
 {
-   _asyncTimeoutInfo *ai = (_asyncTimeoutInfo*) closure;
+    struct threadArg    *arg = (struct threadArg*) closure;
+    char                expected[16];
 
-   natsMutex_Lock(ai->arg->m);
-   if (msg != NULL)
-   {
-       ai->arg->sum++;
-       switch (ai->arg->sum)
-       {
-           case 1:
-           {
-               // Release lock for sleep...
-               natsMutex_Unlock(ai->arg->m);
+    natsMutex_Lock(arg->m);
+    snprintf(expected, sizeof(expected), "%d", arg->results[0]);
+    if (strcmp(natsMsg_GetData(msg), expected) != 0)
+        arg->status = NATS_ERR;
+    arg->results[0]++;
+    arg->msgReceived = true;
+    natsCondition_Broadcast(arg->c);
+    // Block the first message until told otherwise.
+    while ((arg->control == 1) && !arg->closed)
+        natsCondition_Wait(arg->c, arg->m);
+    natsMutex_Unlock(arg->m);
 
-               // Sleep for 1.5x the timeout value
-               nats_Sleep(ai->timeout+ai->timeout/2);
+    natsMsg_Destroy(msg);
+}
 
-               natsMutex_Lock(ai->arg->m);
-               ai->timeAfterFirstMsg = nats_Now();
-               break;
-           }
-           case 2: ai->timeSecondMsg = nats_Now(); break;
-           case 3:
-           {
-               ai->arg->done = true;
-               natsSubscription_Destroy(sub);
-               natsCondition_Signal(ai->arg->c);
-               break;
-           }
-           default:
-           {
-               ai->arg->status = NATS_ERR;
-               break;
-           }
-       }
-       natsMsg_Destroy(msg);
-   }
-   else
-   {
-       ai->arg->timerFired++;
-       switch (ai->arg->timerFired)
-       {
-           case 1:
-           {
-               ai->timeFirstTimeout = nats_Now();
-               // Notify the main thread to send the second message
-               // after waiting 1/2 of the timeout period.
-               natsCondition_Signal(ai->arg->c);
-               break;
-           }
-           case 2:
-           {
-               ai->timeSecondTimeout = nats_Now();
-               // Signal that we timed-out for the 2nd time.
-               ai->arg->timerStopped = 1;
-               natsCondition_Signal(ai->arg->c);
-               break;
-           }
-           default:
-           {
-               ai->arg->status = NATS_ERR;
-               break;
-           }
-       }
-    }
-    natsMutex_Unlock(ai->arg->m);
+static void
+_lockFreeErrCB(natsConnection *nc, natsSubscription *sub, natsStatus err, void *closure)
+{
+    struct threadArg *arg = (struct threadArg*) closure;
+
+    natsMutex_Lock(arg->m);
+    if (err == NATS_SLOW_CONSUMER)
+        arg->results[1]++;
+    natsCondition_Broadcast(arg->c);
+    natsMutex_Unlock(arg->m);
 }
 
 static void
-test_AsyncSubscribeTimeout(void)
+test_LockFreeDelivery(void)
 {
     natsStatus          s;
     natsConnection      *nc       = NULL;
+    natsOptions         *opts     = NULL;
     natsSubscription    *sub      = NULL;
     natsPid             serverPid = NATS_INVALID_PID;
-    natsOptions         *opts     = NULL;
+    int                 msgs      = 0;
+    int64_t             dropped   = 0;
+    char                data[16];
     struct threadArg    arg;
-    bool                useLibDlv = false;
     int                 i;
-    char                testText[128];
-    int64_t             timeout   = 100;
-    _asyncTimeoutInfo   ai;
 
-    for (i=0; i<4; i++)
+    s = _createDefaultThreadArgsForCbTests(&arg);
+    IFOK(s, natsOptions_Create(&opts));
+    IFOK(s, natsOptions_UseLockFreeDelivery(opts, true));
+    IFOK(s, natsOptions_SetMaxPendingMsgs(opts, 1000));
+    IFOK(s, natsOptions_SetErrorHandler(opts, _lockFreeErrCB, (void*) &arg));
+    if (s != NATS_OK)
+        FAIL("Unable to setup test");
+
+    serverPid = _startServer("nats://127.0.0.1:4222", NULL, true);
+    CHECK_SERVER_STARTED(serverPid);
+
+    test("Connect and subscribe: ");
+    s = natsConnection_Connect(&nc, opts);
+    IFOK(s, natsConnection_Subscribe(&sub, nc, "foo", _lockFreeMsgCB, (void*) &arg));
+    IFOK(s, natsConnection_Flush(nc));
+    testCond((s == NATS_OK) && (sub->ring != NULL));
+
+    test("Messages received in order: ");
+    for (i=0; (s == NATS_OK) && (i<1000); i++)
     {
-        memset(&ai, 0, sizeof(_asyncTimeoutInfo));
-        memset(&arg, 0, sizeof(struct threadArg));
+        snprintf(data, sizeof(data), "%d", i);
+        s = natsConnection_PublishString(nc, "foo", data);
+    }
+    IFOK(s, natsConnection_Flush(nc));
+    natsMutex_Lock(arg.m);
+    while ((s != NATS_TIMEOUT) && (arg.results[0] != 1000))
+        s = natsCondition_TimedWait(arg.c, arg.m, 2000);
+    IFOK(s, arg.status);
+    natsMutex_Unlock(arg.m);
+    IFOK(s, natsSubscription_GetDropped(sub, &dropped));
+    IFOK(s, natsSubscription_GetPending(sub, &msgs, NULL));
+    testCond((s == NATS_OK) && (dropped == 0) && (msgs == 0));
+
+    natsSubscription_Destroy(sub);
+    sub = NULL;
+
+    test("Subscribe with low limits: ");
+    natsMutex_Lock(arg.m);
+    arg.results[0]  = 0;
+    arg.control     = 1;
+    arg.msgReceived = false;
+    natsMutex_Unlock(arg.m);
+    s = natsConnection_Subscribe(&sub, nc, "bar", _lockFreeMsgCB, (void*) &arg);
+    IFOK(s, natsSubscription_SetPendingLimits(sub, 10, -1));
+    IFOK(s, natsConnection_Flush(nc));
+    testCond(s == NATS_OK);
+
+    test("Block callback: ");
+    s = natsConnection_PublishString(nc, "bar", "0");
+    natsMutex_Lock(arg.m);
+    while ((s != NATS_TIMEOUT) && !arg.msgReceived)
+        s = natsCondition_TimedWait(arg.c, arg.m, 2000);
+    natsMutex_Unlock(arg.m);
+    testCond(s == NATS_OK);
+
+    test("Slow consumer reported: ");
+    for (i=1; (s == NATS_OK) && (i<51); i++)
+    {
+        snprintf(data, sizeof(data), "%d", i);
+        s = natsConnection_PublishString(nc, "bar", data);
+    }
+    IFOK(s, natsConnection_Flush(nc));
+    natsMutex_Lock(arg.m);
+    while ((s != NATS_TIMEOUT) && (arg.results[1] != 1))
+        s = natsCondition_TimedWait(arg.c, arg.m, 2000);
+    natsMutex_Unlock(arg.m);
+    testCond(s == NATS_OK);
+
+    test("Check pending and dropped: ");
+    s = natsSubscription_GetDropped(sub, &dropped);
+    IFOK(s, natsSubscription_GetPending(sub, &msgs, NULL));
+    testCond((s == NATS_OK) && (dropped == 40) && (msgs == 10));
+
+    test("Pending messages delivered: ");
+    natsMutex_Lock(arg.m);
+    arg.closed = true;
+    natsCondition_Broadcast(arg.c);
+    while ((s != NATS_TIMEOUT) && (arg.results[0] != 11))
+        s = natsCondition_TimedWait(arg.c, arg.m, 2000);
+    natsMutex_Unlock(arg.m);
+    testCond(s == NATS_OK);
+
+    natsSubscription_Destroy(sub);
+    sub = NULL;
+
+    test("Ring starts small: ");
+    natsMutex_Lock(arg.m);
+    arg.results[0]  = 0;
+    arg.control     = 1;
+    arg.closed      = false;
+    arg.msgReceived = false;
+    natsMutex_Unlock(arg.m);
+    s = natsConnection_Subscribe(&sub, nc, "grow", _lockFreeMsgCB, (void*) &arg);
+    IFOK(s, natsConnection_Flush(nc));
+    testCond((s == NATS_OK) && (sub->ring->head == sub->ring->tail)
+                && (sub->ring->tail->mask + 1 < 1000));
+
+    test("Ring grows while callback is blocked: ");
+    for (i=0; (s == NATS_OK) && (i<500); i++)
+    {
+        snprintf(data, sizeof(data), "%d", i);
+        s = natsConnection_PublishString(nc, "grow", data);
+    }
+    IFOK(s, natsConnection_Flush(nc));
+    for (i=0; (s == NATS_OK) && (i<100); i++)
+    {
+        s = natsSubscription_GetPending(sub, &msgs, NULL);
+        if ((s == NATS_OK) && (msgs == 499))
+            break;
+        nats_Sleep(20);
+    }
+    IFOK(s, natsSubscription_GetDropped(sub, &dropped));
+    natsSub_Lock(sub);
+    testCond((s == NATS_OK) && (msgs == 499) && (dropped == 0)
+                && (sub->ring->head != sub->ring->tail)
+                && (sub->ring->tail->mask + 1 >= 256));
+    natsSub_Unlock(sub);
+
+    test("Max pending recorded: ");
+    s = natsSubscription_GetMaxPending(sub, &msgs, NULL);
+    testCond((s == NATS_OK) && (msgs == 499));
+
+    test("Grown ring drained in order: ");
+    natsMutex_Lock(arg.m);
+    arg.closed = true;
+    natsCondition_Broadcast(arg.c);
+    while ((s != NATS_TIMEOUT) && (arg.results[0] != 500))
+        s = natsCondition_TimedWait(arg.c, arg.m, 2000);
+    IFOK(s, arg.status);
+    natsMutex_Unlock(arg.m);
+    IFOK(s, natsSubscription_GetPending(sub, &msgs, NULL));
+    testCond((s == NATS_OK) && (msgs == 0));
+
+    natsSubscription_Destroy(sub);
+    sub = NULL;
+
+    test("Auto-unsubscribe: ");
+    natsMutex_Lock(arg.m);
+    arg.results[0] = 0;
+    arg.control    = 0;
+    arg.status     = NATS_OK;
+    natsMutex_Unlock(arg.m);
+    s = natsConnection_Subscribe(&sub, nc, "baz", _lockFreeMsgCB, (void*) &arg);
+    IFOK(s, natsSubscription_AutoUnsubscribe(sub, 5));
+    for (i=0; (s == NATS_OK) && (i<10); i++)
+    {
+        snprintf(data, sizeof(data), "%d", i);
+        s = natsConnection_PublishString(nc, "baz", data);
+    }
+    IFOK(s, natsConnection_Flush(nc));
+    for (i=0; (s == NATS_OK) && natsSubscription_IsValid(sub) && (i<100); i++)
+        nats_Sleep(20);
+    natsMutex_Lock(arg.m);
+    IFOK(s, arg.status);
+    testCond((s == NATS_OK) && (arg.results[0] == 5) && !natsSubscription_IsValid(sub));
+    natsMutex_Unlock(arg.m);
+
+    natsSubscription_Destroy(sub);
+    natsConnection_Destroy(nc);
+    natsOptions_Destroy(opts);
+
+    _destroyDefaultThreadArgs(&arg);
+
+    _stopServer(serverPid);
+}
+
+static void
+_batchDlvMsgCB(natsConnection *nc, natsSubscription *sub, natsMsg *msg, void *closure)
+{
+    struct threadArg    *arg = (struct threadArg*) closure;
+    char                expected[16];
+    int                 count;
+
+    natsMutex_Lock(arg->m);
+    snprintf(expected, sizeof(expected), "%d", arg->results[0]);
+    if (strcmp(natsMsg_GetData(msg), expected) != 0)
+        arg->status = NATS_ERR;
+    count = ++(arg->results[0]);
+    arg->msgReceived = true;
+    natsCondition_Broadcast(arg->c);
+    // Block the first message until all others are pending.
+    while ((arg->control == 1) && !arg->closed)
+        natsCondition_Wait(arg->c, arg->m);
+    natsMutex_Unlock(arg->m);
+
+    // Set the max while the rest of the batch is already detached.
+    if ((count == 10) && (natsSubscription_AutoUnsubscribe(sub, 100) != NATS_OK))
+    {
+        natsMutex_Lock(arg->m);
+        arg->status = NATS_ERR;
+        natsMutex_Unlock(arg->m);
+    }
+
+    natsMsg_Destroy(msg);
+}
+
+static void
+test_BatchDelivery(void)
+{
+    natsStatus          s;
+    natsConnection      *nc       = NULL;
+    natsOptions         *opts     = NULL;
+    natsSubscription    *sub      = NULL;
+    natsPid             serverPid = NATS_INVALID_PID;
+    char                data[16];
+    char                name[64];
+    struct threadArg    arg;
+    int                 mode;
+    int                 i;
+
+    serverPid = _startServer("nats://127.0.0.1:4222", NULL, true);
+    CHECK_SERVER_STARTED(serverPid);
+
+    // Own thread with a list, own thread with a ring, library pool.
+    for (mode=0; mode<3; mode++)
+    {
+        s = _createDefaultThreadArgsForCbTests(&arg);
+        IFOK(s, natsOptions_Create(&opts));
+        IFOK(s, natsOptions_UseLockFreeDelivery(opts, (mode == 1)));
+        IFOK(s, natsOptions_UseGlobalMessageDelivery(opts, (mode == 2)));
+        if (s != NATS_OK)
+            FAIL("Unable to setup test");
+
+        snprintf(name, sizeof(name), "Mode %d - block first message: ", mode);
+        test(name);
+        arg.control = 1;
+        s = natsConnection_Connect(&nc, opts);
+        IFOK(s, natsConnection_Subscribe(&sub, nc, "foo", _batchDlvMsgCB, (void*) &arg));
+        IFOK(s, natsConnection_Flush(nc));
+        IFOK(s, natsConnection_PublishString(nc, "foo", "0"));
+        natsMutex_Lock(arg.m);
+        while ((s != NATS_TIMEOUT) && !arg.msgReceived)
+            s = natsCondition_TimedWait(arg.c, arg.m, 2000);
+        natsMutex_Unlock(arg.m);
+        testCond(s == NATS_OK);
+
+        snprintf(name, sizeof(name), "Mode %d - queue pending messages: ", mode);
+        test(name);
+        for (i=1; (s == NATS_OK) && (i<300); i++)
+        {
+            snprintf(data, sizeof(data), "%d", i);
+            s = natsConnection_PublishString(nc, "foo", data);
+        }
+        IFOK(s, natsConnection_Flush(nc));
+        for (i=0; (s == NATS_OK) && (i<100); i++)
+        {
+            int pending = 0;
+
+            s = natsSubscription_GetPending(sub, &pending, NULL);
+            if ((s != NATS_OK) || (pending == 299))
+                break;
+            nats_Sleep(20);
+        }
+        testCond((s == NATS_OK) && (i < 100));
+
+        snprintf(name, sizeof(name), "Mode %d - max set from callback is exact: ", mode);
+        test(name);
+        natsMutex_Lock(arg.m);
+        arg.closed = true;
+        natsCondition_Broadcast(arg.c);
+        natsMutex_Unlock(arg.m);
+        for (i=0; (s == NATS_OK) && natsSubscription_IsValid(sub) && (i<100); i++)
+            nats_Sleep(20);
+        // Give a chance to deliver more than expected if it were to happen.
+        nats_Sleep(100);
+        natsMutex_Lock(arg.m);
+        IFOK(s, arg.status);
+        testCond((s == NATS_OK)
+                 && (arg.results[0] == 100)
+                 && (sub->delivered == 100)
+                 && !natsSubscription_IsValid(sub));
+        natsMutex_Unlock(arg.m);
+
+        natsSubscription_Destroy(sub);
+        sub = NULL;
+        natsConnection_Destroy(nc);
+        nc = NULL;
+        natsOptions_Destroy(opts);
+        opts = NULL;
+
+        _destroyDefaultThreadArgs(&arg);
+    }
+
+    _stopServer(serverPid);
+}
+
+static void
+_batchSubMsgsCB(natsConnection *nc, natsSubscription *sub, natsMsg **msgs, int count, void *closure)
+{
+    struct threadArg    *arg = (struct threadArg*) closure;
+    char                expected[16];
+    int                 i;
+
+    natsMutex_Lock(arg->m);
+    for (i=0; i<count; i++)
+    {
+        snprintf(expected, sizeof(expected), "%d", arg->results[0]);
+        if (strcmp(natsMsg_GetData(msgs[i]), expected) != 0)
+            arg->status = NATS_ERR;
+        arg->results[0]++;
+        natsMsg_Destroy(msgs[i]);
+    }
+    arg->results[1]++;
+    if (count > arg->results[2])
+        arg->results[2] = count;
+    natsCondition_Broadcast(arg->c);
+    natsMutex_Unlock(arg->m);
+}
+
+static void
+test_SubscribeBatch(void)
+{
+    natsStatus          s;
+    natsConnection      *nc       = NULL;
+    natsOptions         *opts     = NULL;
+    natsSubscription    *sub      = NULL;
+    natsPid             serverPid = NATS_INVALID_PID;
+    natsMsg             *msgs[4];
+    char                data[16];
+    char                name[64];
+    struct threadArg    arg;
+    int                 count     = 0;
+    int                 mode;
+    int                 i;
+
+    serverPid = _startServer("nats://127.0.0.1:4222", NULL, true);
+    CHECK_SERVER_STARTED(serverPid);
+
+    // Own thread with a list, own thread with a ring, library pool.
+    for (mode=0; mode<3; mode++)
+    {
+        s = _createDefaultThreadArgsForCbTests(&arg);
+        IFOK(s, natsOptions_Create(&opts));
+        IFOK(s, natsOptions_UseLockFreeDelivery(opts, (mode == 1)));
+        IFOK(s, natsOptions_UseGlobalMessageDelivery(opts, (mode == 2)));
+        IFOK(s, natsConnection_Connect(&nc, opts));
+        if (s != NATS_OK)
+            FAIL("Unable to setup test");
+
+        if (mode == 0)
+        {
+            test("Invalid args: ");
+            s = natsConnection_SubscribeBatch(&sub, nc, "foo", NULL, NULL, 10, 0);
+            if (s == NATS_INVALID_ARG)
+                s = natsConnection_SubscribeBatch(&sub, nc, "foo", _batchSubMsgsCB, NULL, 0, 0);
+            if (s == NATS_INVALID_ARG)
+                s = natsConnection_SubscribeBatch(&sub, nc, "foo", _batchSubMsgsCB, NULL, 10, -1);
+            testCond((s == NATS_INVALID_ARG) && (sub == NULL));
+            nats_clearLastError();
+        }
+
+        snprintf(name, sizeof(name), "Mode %d - messages delivered in batches: ", mode);
+        test(name);
+        s = natsConnection_SubscribeBatch(&sub, nc, "foo", _batchSubMsgsCB, (void*) &arg, 10, 500);
+        IFOK(s, natsConnection_Flush(nc));
+        for (i=0; (s == NATS_OK) && (i<25); i++)
+        {
+            snprintf(data, sizeof(data), "%d", i);
+            s = natsConnection_PublishString(nc, "foo", data);
+        }
+        IFOK(s, natsConnection_Flush(nc));
+        natsMutex_Lock(arg.m);
+        while ((s != NATS_TIMEOUT) && (arg.results[0] != 25))
+            s = natsCondition_TimedWait(arg.c, arg.m, 2000);
+        IFOK(s, arg.status);
+        testCond((s == NATS_OK)
+                 && (arg.results[2] <= 10)
+                 // With its own thread, the subscription waits for batches to fill up.
+                 && ((mode == 2) || (arg.results[1] == 3)));
+        natsMutex_Unlock(arg.m);
+
+        snprintf(name, sizeof(name), "Mode %d - auto-unsubscribe: ", mode);
+        test(name);
+        natsMutex_Lock(arg.m);
+        arg.results[0] = 0;
+        natsMutex_Unlock(arg.m);
+        s = natsSubscription_AutoUnsubscribe(sub, 40);
+        for (i=0; (s == NATS_OK) && (i<25); i++)
+        {
+            snprintf(data, sizeof(data), "%d", i);
+            s = natsConnection_PublishString(nc, "foo", data);
+        }
+        IFOK(s, natsConnection_Flush(nc));
+        for (i=0; (s == NATS_OK) && natsSubscription_IsValid(sub) && (i<100); i++)
+            nats_Sleep(20);
+        natsMutex_Lock(arg.m);
+        IFOK(s, arg.status);
+        testCond((s == NATS_OK) && (arg.results[0] == 15) && !natsSubscription_IsValid(sub));
+        natsMutex_Unlock(arg.m);
+
+        natsSubscription_Destroy(sub);
+        sub = NULL;
+        natsConnection_Destroy(nc);
+        nc = NULL;
+        natsOptions_Destroy(opts);
+        opts = NULL;
+
+        _destroyDefaultThreadArgs(&arg);
+    }
+
+    s = natsConnection_ConnectTo(&nc, NATS_DEFAULT_URL);
+    IFOK(s, natsConnection_SubscribeSync(&sub, nc, "foo"));
+    if (s != NATS_OK)
+        FAIL("Unable to setup test");
+
+    test("NextMsgs invalid args: ");
+    s = natsSubscription_NextMsgs(NULL, msgs, 4, &count, 0);
+    if (s == NATS_INVALID_ARG)
+        s = natsSubscription_NextMsgs(sub, NULL, 4, &count, 0);
+    if (s == NATS_INVALID_ARG)
+        s = natsSubscription_NextMsgs(sub, msgs, 0, &count, 0);
+    if (s == NATS_INVALID_ARG)
+        s = natsSubscription_NextMsgs(sub, msgs, 4, NULL, 0);
+    testCond(s == NATS_INVALID_ARG);
+    nats_clearLastError();
+
+    test("NextMsgs times out: ");
+    s = natsSubscription_NextMsgs(sub, msgs, 4, &count, 50);
+    testCond((s == NATS_TIMEOUT) && (count == 0));
+    nats_clearLastError();
+
+    test("NextMsgs returns pending messages: ");
+    s = NATS_OK;
+    for (i=0; (s == NATS_OK) && (i<10); i++)
+    {
+        snprintf(data, sizeof(data), "%d", i);
+        s = natsConnection_PublishString(nc, "foo", data);
+    }
+    IFOK(s, natsConnection_Flush(nc));
+    for (i=0; (s == NATS_OK) && (i<100); i++)
+    {
+        int pending = 0;
+
+        s = natsSubscription_GetPending(sub, &pending, NULL);
+        if ((s != NATS_OK) || (pending == 10))
+            break;
+        nats_Sleep(20);
+    }
+    for (i=0; (s == NATS_OK) && (i<10); )
+    {
+        int j;
+
+        s = natsSubscription_NextMsgs(sub, msgs, 4, &count, 1000);
+        if ((s == NATS_OK) && (count != ((i < 8) ? 4 : 2)))
+            s = NATS_ERR;
+        for (j=0; (s == NATS_OK) && (j<count); j++, i++)
+        {
+            snprintf(data, sizeof(data), "%d", i);
+            if (strcmp(natsMsg_GetData(msgs[j]), data) != 0)
+                s = NATS_ERR;
+        }
+        for (j=0; j<count; j++)
+            natsMsg_Destroy(msgs[j]);
+    }
+    testCond((s == NATS_OK) && (i == 10));
+
+    test("NextMsgs honors auto-unsubscribe: ");
+    s = natsSubscription_AutoUnsubscribe(sub, 13);
+    for (i=0; (s == NATS_OK) && (i<10); i++)
+        s = natsConnection_PublishString(nc, "foo", "x");
+    IFOK(s, natsConnection_Flush(nc));
+    IFOK(s, natsSubscription_NextMsgs(sub, msgs, 4, &count, 1000));
+    for (i=0; i<count; i++)
+        natsMsg_Destroy(msgs[i]);
+    testCond((s == NATS_OK) && (count == 3) && !natsSubscription_IsValid(sub));
+
+    natsSubscription_Destroy(sub);
+    natsConnection_Destroy(nc);
+
+    _stopServer(serverPid);
+}
+
+static void
+_partitionedMsgHandler(natsConnection *nc, natsSubscription *sub, natsMsg *msg, void *closure)
+{
+    struct threadArg    *arg = (struct threadArg*) closure;
+    const char          *subj = natsMsg_GetSubject(msg);
+    int                 key   = 0;
+    int                 seq   = atoi(natsMsg_GetData(msg));
+    int64_t             sleep = 0;
+
+    // Subjects are "part.<key>" or "part.<key>.<anything>".
+    if (strlen(subj) > 5)
+        key = atoi(subj + 5);
+
+    natsMutex_Lock(arg->m);
+    if ((key < 0) || (key >= 10) || (seq != arg->results[key]))
+        arg->status = NATS_ERR;
+    else
+        arg->results[key]++;
+    arg->sum++;
+    if (++(arg->attached) > arg->detached)
+        arg->detached = arg->attached;
+    natsCondition_Broadcast(arg->c);
+    sleep = arg->timerFired;
+    while (arg->control == 1)
+        natsCondition_Wait(arg->c, arg->m);
+    natsMutex_Unlock(arg->m);
+
+    if (sleep > 0)
+        nats_Sleep(sleep);
+
+    natsMutex_Lock(arg->m);
+    arg->attached--;
+    natsCondition_Broadcast(arg->c);
+    natsMutex_Unlock(arg->m);
+
+    natsMsg_Destroy(msg);
+}
+
+static uint32_t
+_partitionKeyCb(natsMsg *msg, void *closure)
+{
+    return (uint32_t) atoi(natsMsg_GetSubject(msg) + 5);
+}
+
+static natsStatus
+_waitForPartitionedMsgs(struct threadArg *arg, int total)
+{
+    natsStatus s = NATS_OK;
+
+    natsMutex_Lock(arg->m);
+    while ((s != NATS_TIMEOUT) && ((arg->sum != total) || (arg->attached > 0)))
+        s = natsCondition_TimedWait(arg->c, arg->m, 2000);
+    IFOK(s, arg->status);
+    natsMutex_Unlock(arg->m);
+
+    return s;
+}
+
+static void
+test_SubscribePartitioned(void)
+{
+    natsStatus              s;
+    natsConnection          *nc       = NULL;
+    natsSubscription        *sub      = NULL;
+    natsSubscription        *sub2     = NULL;
+    natsMsg                 *msg      = NULL;
+    natsPid                 serverPid = NATS_INVALID_PID;
+    natsSubPartitionOptions po;
+    char                    subj[64];
+    char                    data[16];
+    struct threadArg        arg;
+    int64_t                 delivered = 0;
+    int64_t                 dropped   = 0;
+    int64_t                 total     = 0;
+    int                     pending   = 0;
+    int                     used      = 0;
+    int                     i, j;
+
+    s = _createDefaultThreadArgsForCbTests(&arg);
+    if (s != NATS_OK)
+        FAIL("Unable to setup test");
+
+    serverPid = _startServer("nats://127.0.0.1:4222", NULL, true);
+    CHECK_SERVER_STARTED(serverPid);
+
+    s = natsConnection_ConnectTo(&nc, NATS_DEFAULT_URL);
+    if (s != NATS_OK)
+        FAIL("Unable to setup test");
+
+    test("Invalid args: ");
+    s = natsSubPartitionOptions_Init(NULL);
+    if (s == NATS_INVALID_ARG)
+    {
+        natsSubPartitionOptions_Init(&po);
+        s = natsConnection_SubscribePartitioned(&sub, nc, "part.>", _partitionedMsgHandler, &arg, &po);
+    }
+    if (s == NATS_INVALID_ARG)
+    {
+        po.Partitions = 4;
+        s = natsConnection_SubscribePartitioned(&sub, nc, "part.>", NULL, &arg, &po);
+    }
+    if (s == NATS_INVALID_ARG)
+        s = natsConnection_SubscribePartitioned(&sub, nc, "part.>", _partitionedMsgHandler, &arg, NULL);
+    if (s == NATS_INVALID_ARG)
+    {
+        po.SubjectToken = -1;
+        s = natsConnection_SubscribePartitioned(&sub, nc, "part.>", _partitionedMsgHandler, &arg, &po);
+    }
+    testCond((s == NATS_INVALID_ARG) && (sub == NULL));
+    nats_clearLastError();
+
+    test("Ordered per subject token: ");
+    natsSubPartitionOptions_Init(&po);
+    po.Partitions   = 4;
+    po.SubjectToken = 2;
+    s = natsConnection_SubscribePartitioned(&sub, nc, "part.>", _partitionedMsgHandler, &arg, &po);
+    IFOK(s, natsConnection_Flush(nc));
+    for (i=0; (s == NATS_OK) && (i<100); i++)
+    {
+        for (j=0; (s == NATS_OK) && (j<8); j++)
+        {
+            snprintf(subj, sizeof(subj), "part.%d.x", j);
+            snprintf(data, sizeof(data), "%d", i);
+            s = natsConnection_PublishString(nc, subj, data);
+        }
+    }
+    IFOK(s, natsConnection_Flush(nc));
+    IFOK(s, _waitForPartitionedMsgs(&arg, 800));
+    testCond(s == NATS_OK);
+
+    test("Stats are the sum of partitions' stats: ");
+    s = natsSubscription_GetStats(sub, &pending, NULL, NULL, NULL, &delivered, &dropped);
+    for (i=0; (s == NATS_OK) && (i<4); i++)
+    {
+        int64_t pd = 0;
+
+        s = natsSubscription_GetPartitionStats(sub, i, NULL, NULL, NULL, NULL, &pd, NULL);
+        total += pd;
+    }
+    testCond((s == NATS_OK) && (pending == 0) && (dropped == 0)
+             && (delivered == 800) && (total == 800));
+
+    test("Invalid partition: ");
+    s = natsSubscription_GetPartitionStats(sub, 4, NULL, NULL, NULL, NULL, NULL, NULL);
+    if (s == NATS_INVALID_ARG)
+        s = natsSubscription_GetPartitionStats(sub, -1, NULL, NULL, NULL, NULL, NULL, NULL);
+    if (s == NATS_INVALID_ARG)
+    {
+        s = natsConnection_SubscribeSync(&sub2, nc, "foo");
+        IFOK(s, natsSubscription_GetPartitionStats(sub2, 0, NULL, NULL, NULL, NULL, NULL, NULL));
+    }
+    testCond(s == NATS_INVALID_ARG);
+    nats_clearLastError();
+    natsSubscription_Destroy(sub2);
+    sub2 = NULL;
+
+    natsSubscription_Destroy(sub);
+    sub = NULL;
+
+    test("Partitions are delivered in parallel: ");
+    natsMutex_Lock(arg.m);
+    memset(arg.results, 0, sizeof(arg.results));
+    arg.sum        = 0;
+    arg.detached   = 0;
+    arg.timerFired = 100;
+    natsMutex_Unlock(arg.m);
+    natsSubPartitionOptions_Init(&po);
+    po.Partitions = 4;
+    po.KeyCb      = _partitionKeyCb;
+    s = natsConnection_SubscribePartitioned(&sub, nc, "part.*", _partitionedMsgHandler, &arg, &po);
+    IFOK(s, natsConnection_Flush(nc));
+    for (i=0; (s == NATS_OK) && (i<4); i++)
+    {
+        snprintf(subj, sizeof(subj), "part.%d", i);
+        s = natsConnection_PublishString(nc, subj, "0");
+    }
+    IFOK(s, natsConnection_Flush(nc));
+    IFOK(s, _waitForPartitionedMsgs(&arg, 4));
+    natsMutex_Lock(arg.m);
+    testCond((s == NATS_OK) && (arg.detached > 1));
+    natsMutex_Unlock(arg.m);
+
+    test("Key callback selects the partition: ");
+    for (i=0; (s == NATS_OK) && (i<4); i++)
+    {
+        int64_t pd = 0;
+
+        s = natsSubscription_GetPartitionStats(sub, i, NULL, NULL, NULL, NULL, &pd, NULL);
+        if ((s == NATS_OK) && (pd != 1))
+            s = NATS_ERR;
+    }
+    testCond(s == NATS_OK);
+
+    test("Partition pending limits: ");
+    natsMutex_Lock(arg.m);
+    arg.timerFired = 0;
+    arg.control    = 1;
+    natsMutex_Unlock(arg.m);
+    s = natsSubscription_SetPendingLimits(sub, 2, 1024*1024);
+    // Wait for the first message to block the callback.
+    IFOK(s, natsConnection_PublishString(nc, "part.0", "1"));
+    IFOK(s, natsConnection_Flush(nc));
+    natsMutex_Lock(arg.m);
+    while ((s != NATS_TIMEOUT) && (arg.attached != 1))
+        s = natsCondition_TimedWait(arg.c, arg.m, 2000);
+    natsMutex_Unlock(arg.m);
+    for (i=1; (s == NATS_OK) && (i<10); i++)
+    {
+        snprintf(data, sizeof(data), "%d", i+1);
+        s = natsConnection_PublishString(nc, "part.0", data);
+    }
+    IFOK(s, natsConnection_PublishString(nc, "part.1", "1"));
+    IFOK(s, natsConnection_Flush(nc));
+    for (i=0; (s == NATS_OK) && (i<100); i++)
+    {
+        s = natsSubscription_GetPartitionStats(sub, 0, &pending, NULL, NULL, NULL, NULL, &dropped);
+        if ((s != NATS_OK) || ((pending == 2) && (dropped == 7)))
+            break;
+        nats_Sleep(20);
+    }
+    IFOK(s, natsSubscription_GetDropped(sub, &total));
+    testCond((s == NATS_OK) && (pending == 2) && (dropped == 7) && (total == 7));
+    natsMutex_Lock(arg.m);
+    arg.control = 0;
+    natsCondition_Broadcast(arg.c);
+    natsMutex_Unlock(arg.m);
+    nats_clearLastError();
+
+    test("Messages not dropped are delivered: ");
+    s = _waitForPartitionedMsgs(&arg, 8);
+    testCond(s == NATS_OK);
+
+    natsSubscription_Destroy(sub);
+    sub = NULL;
+
+    test("Key from header: ");
+    natsMutex_Lock(arg.m);
+    memset(arg.results, 0, sizeof(arg.results));
+    arg.status = NATS_OK;
+    arg.sum    = 0;
+    natsMutex_Unlock(arg.m);
+    natsSubPartitionOptions_Init(&po);
+    po.Partitions = 4;
+    po.Header     = "Key";
+    s = natsConnection_SubscribePartitioned(&sub, nc, "part.*", _partitionedMsgHandler, &arg, &po);
+    IFOK(s, natsConnection_Flush(nc));
+    for (i=0; (s == NATS_OK) && (i<20); i++)
+    {
+        snprintf(subj, sizeof(subj), "part.%d", i%4);
+        snprintf(data, sizeof(data), "%d", i/4);
+        s = natsMsg_Create(&msg, subj, NULL, data, (int) strlen(data));
+        IFOK(s, natsMsgHeader_Set(msg, "Key", "same"));
+        IFOK(s, natsConnection_PublishMsg(nc, msg));
+        natsMsg_Destroy(msg);
+        msg = NULL;
+    }
+    IFOK(s, natsConnection_Flush(nc));
+    IFOK(s, _waitForPartitionedMsgs(&arg, 20));
+    for (i=0; (s == NATS_OK) && (i<4); i++)
+    {
+        int64_t pd = 0;
+
+        s = natsSubscription_GetPartitionStats(sub, i, NULL, NULL, NULL, NULL, &pd, NULL);
+        if ((s == NATS_OK) && (pd > 0))
+            used++;
+    }
+    testCond((s == NATS_OK) && (used == 1));
+
+    test("Auto-unsubscribe: ");
+    natsMutex_Lock(arg.m);
+    memset(arg.results, 0, sizeof(arg.results));
+    arg.sum = 0;
+    natsMutex_Unlock(arg.m);
+    s = natsSubscription_AutoUnsubscribe(sub, 30);
+    for (i=0; (s == NATS_OK) && (i<40); i++)
+    {
+        snprintf(subj, sizeof(subj), "part.%d", i%4);
+        snprintf(data, sizeof(data), "%d", i/4);
+        s = natsConnection_PublishString(nc, subj, data);
+    }
+    IFOK(s, natsConnection_Flush(nc));
+    for (i=0; (s == NATS_OK) && natsSubscription_IsValid(sub) && (i<100); i++)
+        nats_Sleep(20);
+    nats_Sleep(100);
+    natsMutex_Lock(arg.m);
+    IFOK(s, arg.status);
+    testCond((s == NATS_OK) && (arg.sum == 10) && !natsSubscription_IsValid(sub));
+    natsMutex_Unlock(arg.m);
+
+    natsSubscription_Destroy(sub);
+    sub = NULL;
+
+    test("Drain: ");
+    natsMutex_Lock(arg.m);
+    memset(arg.results, 0, sizeof(arg.results));
+    arg.sum        = 0;
+    arg.timerFired = 10;
+    natsMutex_Unlock(arg.m);
+    natsSubPartitionOptions_Init(&po);
+    po.Partitions = 3;
+    s = natsConnection_SubscribePartitioned(&sub, nc, "part.*", _partitionedMsgHandler, &arg, &po);
+    IFOK(s, natsConnection_Flush(nc));
+    for (i=0; (s == NATS_OK) && (i<30); i++)
+    {
+        snprintf(subj, sizeof(subj), "part.%d", i%3);
+        snprintf(data, sizeof(data), "%d", i/3);
+        s = natsConnection_PublishString(nc, subj, data);
+    }
+    IFOK(s, natsConnection_Flush(nc));
+    IFOK(s, natsSubscription_Drain(sub));
+    IFOK(s, natsSubscription_WaitForDrainCompletion(sub, 5000));
+    natsMutex_Lock(arg.m);
+    IFOK(s, arg.status);
+    testCond((s == NATS_OK) && (arg.sum == 30));
+    natsMutex_Unlock(arg.m);
+
+    natsSubscription_Destroy(sub);
+    natsConnection_Destroy(nc);
+
+    _destroyDefaultThreadArgs(&arg);
+
+    _stopServer(serverPid);
+}
+
+static void
+test_InvalidSubsArgs(void)
+{
+    natsStatus          s;
+    natsConnection      *nc = NULL;
+    natsSubscription    *sub = NULL;
+    natsPid             serverPid = NATS_INVALID_PID;
+
+    serverPid = _startServer("nats://127.0.0.1:4222", NULL, true);
+    CHECK_SERVER_STARTED(serverPid);
+
+    s = natsConnection_ConnectTo(&nc, NATS_DEFAULT_URL);
+    if (s != NATS_OK)
+        FAIL("Unable to setup test");
+
+    // ASYNC Subscription
+
+    test("Test async subscriber, invalid connection: ")
+    s = natsConnection_Subscribe(&sub, NULL, "foo", _recvTestString, NULL);
+    testCond(s != NATS_OK);
+
+    test("Test async subscriber, invalid subject: ")
+    s = natsConnection_Subscribe(&sub, nc, NULL, _recvTestString, NULL);
+    testCond(s != NATS_OK);
+
+    test("Test async subscriber, invalid subject (empty string): ")
+    s = natsConnection_Subscribe(&sub, nc, "", _recvTestString, NULL);
+    testCond(s != NATS_OK);
+
+    test("Test async subscriber, invalid cb: ")
+    s = natsConnection_Subscribe(&sub, nc, "foo", NULL, NULL);
+    testCond(s != NATS_OK);
+
+    test("Test async queue subscriber, invalid connection: ")
+    s = natsConnection_QueueSubscribe(&sub, NULL, "foo", "group", _recvTestString, NULL);
+    testCond(s != NATS_OK);
+
+    // Async Subscription Timeout
+
+    test("Test async subscriber timeout, invalid connection: ")
+    s = natsConnection_SubscribeTimeout(&sub, NULL, "foo", 100, _recvTestString, NULL);
+    testCond(s != NATS_OK);
+
+    test("Test async subscriber timeout, invalid subject: ")
+    s = natsConnection_SubscribeTimeout(&sub, nc, NULL, 100, _recvTestString, NULL);
+    testCond(s != NATS_OK);
+
+    test("Test async subscriber timeout, invalid subject (empty string): ")
+    s = natsConnection_SubscribeTimeout(&sub, nc, "", 100, _recvTestString, NULL);
+    testCond(s != NATS_OK);
+
+    test("Test async subscriber timeout, invalid cb: ")
+    s = natsConnection_SubscribeTimeout(&sub, nc, "foo", 100, NULL, NULL);
+    testCond(s != NATS_OK);
+
+    test("Test async subscriber timeout, invalid timeout (<0): ")
+    s = natsConnection_SubscribeTimeout(&sub, nc, "foo", -100, _recvTestString, NULL);
+    testCond(s != NATS_OK);
+
+    test("Test async subscriber timeout, invalid timeout (0): ")
+    s = natsConnection_SubscribeTimeout(&sub, nc, "foo", 0, _recvTestString, NULL);
+    testCond(s != NATS_OK);
+
+    // ASYNC Queue Subscription
+
+    test("Test async queue subscriber timeout, invalid connection: ")
+    s = natsConnection_QueueSubscribe(&sub, NULL, "foo", "group", _recvTestString, NULL);
+    testCond(s != NATS_OK);
+
+    test("Test async queue subscriber, invalid subject: ")
+    s = natsConnection_QueueSubscribe(&sub, nc, NULL, "group", _recvTestString, NULL);
+    testCond(s != NATS_OK);
+
+    test("Test async queue subscriber, invalid subject (empty string): ")
+    s = natsConnection_QueueSubscribe(&sub, nc, "", "group", _recvTestString, NULL);
+    testCond(s != NATS_OK);
+
+    test("Test async queue subscriber, invalid group name: ")
+    s = natsConnection_QueueSubscribe(&sub, nc, "foo", NULL, _recvTestString, NULL);
+    testCond(s != NATS_OK);
+
+    test("Test async queue subscriber, invalid group name (empty): ")
+    s = natsConnection_QueueSubscribe(&sub, nc, "foo", "", _recvTestString, NULL);
+    testCond(s != NATS_OK);
+
+    test("Test async queue subscriber, invalid cb: ")
+    s = natsConnection_QueueSubscribe(&sub, nc, "foo", "group", NULL, NULL);
+    testCond(s != NATS_OK);
+
+    // ASYNC Queue Subscription Timeout
+
+    test("Test async queue subscriber timeout, invalid connection: ")
+    s = natsConnection_QueueSubscribeTimeout(&sub, NULL, "foo", "group", 100, _recvTestString, NULL);
+    testCond(s != NATS_OK);
+
+    test("Test async queue subscriber timeout, invalid subject: ")
+    s = natsConnection_QueueSubscribeTimeout(&sub, nc, NULL, "group", 100, _recvTestString, NULL);
+    testCond(s != NATS_OK);
+
+    test("Test async queue subscriber timeout, invalid subject (empty string): ")
+    s = natsConnection_QueueSubscribeTimeout(&sub, nc, "", "group", 100, _recvTestString, NULL);
+    testCond(s != NATS_OK);
+
+    test("Test async queue subscriber timeout, invalid group name: ")
+    s = natsConnection_QueueSubscribeTimeout(&sub, nc, "foo", NULL, 100, _recvTestString, NULL);
+    testCond(s != NATS_OK);
+
+    test("Test async queue subscriber timeout, invalid group name (empty): ")
+    s = natsConnection_QueueSubscribeTimeout(&sub, nc, "foo", "", 100, _recvTestString, NULL);
+    testCond(s != NATS_OK);
+
+    test("Test async queue subscriber timeout, invalid cb: ")
+    s = natsConnection_QueueSubscribeTimeout(&sub, nc, "foo", "group", 100, NULL, NULL);
+    testCond(s != NATS_OK);
+
+    test("Test async queue subscriber timeout, invalid timeout (<0): ")
+    s = natsConnection_QueueSubscribeTimeout(&sub, nc, "foo", "group", -100, _recvTestString, NULL);
+    testCond(s != NATS_OK);
+
+    test("Test async queue subscriber timeout, invalid timeout (0): ")
+    s = natsConnection_QueueSubscribeTimeout(&sub, nc, "foo", "group", 0, _recvTestString, NULL);
+    testCond(s != NATS_OK);
+
+    // SYNC Subscription
+
+    test("Test sync subscriber, invalid connection: ")
+    s = natsConnection_SubscribeSync(&sub, NULL, "foo");
+    testCond(s != NATS_OK);
+
+    test("Test sync subscriber, invalid subject: ")
+    s = natsConnection_SubscribeSync(&sub, nc, NULL);
+    testCond(s != NATS_OK);
+
+    test("Test sync subscriber, invalid subject (empty string): ")
+    s = natsConnection_SubscribeSync(&sub, nc, "");
+    testCond(s != NATS_OK);
+
+    // SYNC Queue Subscription
+
+    test("Test sync queue subscriber, invalid connection: ")
+    s = natsConnection_QueueSubscribeSync(&sub, NULL, "foo", "group");
+    testCond(s != NATS_OK);
+
+    test("Test sync queue subscriber, invalid subject: ")
+    s = natsConnection_QueueSubscribeSync(&sub, nc, NULL, "group");
+    testCond(s != NATS_OK);
+
+    test("Test sync queue subscriber, invalid subject (empty string): ")
+    s = natsConnection_QueueSubscribeSync(&sub, nc, "", "group");
+    testCond(s != NATS_OK);
+
+    test("Test sync queue subscriber, invalid group name: ")
+    s = natsConnection_QueueSubscribeSync(&sub, nc, "foo", NULL);
+    testCond(s != NATS_OK);
+
+    test("Test sync queue subscriber, invalid group name (empty): ")
+    s = natsConnection_QueueSubscribeSync(&sub, nc, "foo", "");
+    testCond(s != NATS_OK);
+
+    natsConnection_Destroy(nc);
+
+    _stopServer(serverPid);
+}
+
+static void
+test_AsyncSubscribe(void)
+{
+    natsStatus          s;
+    natsConnection      *nc       = NULL;
+    natsSubscription    *sub      = NULL;
+    natsPid             serverPid = NATS_INVALID_PID;
+    struct threadArg    arg;
+
+    s = _createDefaultThreadArgsForCbTests(&arg);
+    if ( s != NATS_OK)
+        FAIL("Unable to setup test!");
+
+    arg.string = "Hello World";
+    arg.status = NATS_OK;
+    arg.control= 1;
+
+    serverPid = _startServer("nats://127.0.0.1:4222", NULL, true);
+    CHECK_SERVER_STARTED(serverPid);
+
+    test("Test async subscriber: ")
+    s = natsConnection_ConnectTo(&nc, NATS_DEFAULT_URL);
+    IFOK(s, natsConnection_Subscribe(&sub, nc, "foo", _recvTestString,
+                                     (void*) &arg));
+    IFOK(s, natsConnection_PublishString(nc, "foo", arg.string));
+
+    natsMutex_Lock(arg.m);
+    while ((s != NATS_TIMEOUT) && !arg.msgReceived)
+        s = natsCondition_TimedWait(arg.c, arg.m, 1500);
+    natsMutex_Unlock(arg.m);
+
+    IFOK(s, arg.status);
+    testCond(s == NATS_OK);
+
+    natsSubscription_Destroy(sub);
+    natsConnection_Destroy(nc);
+
+    _destroyDefaultThreadArgs(&arg);
+
+    _stopServer(serverPid);
+}
+
+typedef struct __asyncTimeoutInfo
+{
+    struct threadArg    *arg;
+    int64_t             timeout;
+    int64_t             timeAfterFirstMsg;
+    int64_t             timeSecondMsg;
+    int64_t             timeFirstTimeout;
+    int64_t             timeSecondTimeout;
+
+} _asyncTimeoutInfo;
+
+static void
+_asyncTimeoutCb(natsConnection *nc, natsSubscription *sub, natsMsg *msg, void *closure)
+{
+   _asyncTimeoutInfo *ai = (_asyncTimeoutInfo*) closure;
+
+   natsMutex_Lock(ai->arg->m);
+   if (msg != NULL)
+   {
+       ai->arg->sum++;
+       switch (ai->arg->sum)
+       {
+           case 1:
+           {
+               // Release lock for sleep...
+               natsMutex_Unlock(ai->arg->m);
+
+               // Sleep for 1.5x the timeout value
+               nats_Sleep(ai->timeout+ai->timeout/2);
+
+               natsMutex_Lock(ai->arg->m);
+               ai->timeAfterFirstMsg = nats_Now();
+               break;
+           }
+           case 2: ai->timeSecondMsg = nats_Now(); break;
+           case 3:
+           {
+               ai->arg->done = true;
+               natsSubscription_Destroy(sub);
+               natsCondition_Signal(ai->arg->c);
+               break;
+           }
+           default:
+           {
+               ai->arg->status = NATS_ERR;
+               break;
+           }
+       }
+       natsMsg_Destroy(msg);
+   }
+   else
+   {
+       ai->arg->timerFired++;
+       switch (ai->arg->timerFired)
+       {
+           case 1:
+           {
+               ai->timeFirstTimeout = nats_Now();
+               // Notify the main thread to send the second message
+               // after waiting 1/2 of the timeout period.
+               natsCondition_Signal(ai->arg->c);
+               break;
+           }
+           case 2:
+           {
+               ai->timeSecondTimeout = nats_Now();
+               // Signal that we timed-out for the 2nd time.
+               ai->arg->timerStopped = 1;
+               natsCondition_Signal(ai->arg->c);
+               break;
+           }
+           default:
+           {
+               ai->arg->status = NATS_ERR;
+               break;
+           }
+       }
+    }
+    natsMutex_Unlock(ai->arg->m);
+}
+
+static void
+test_AsyncSubscribeTimeout(void)
+{
+    natsStatus          s;
+    natsConnection      *nc       = NULL;
+    natsSubscription    *sub      = NULL;
+    natsPid             serverPid = NATS_INVALID_PID;
+    natsOptions         *opts     = NULL;
+    struct threadArg    arg;
+    bool                useLibDlv = false;
+    int                 i;
+    char                testText[128];
+    int64_t             timeout   = 100;
+    _asyncTimeoutInfo   ai;
+
+    for (i=0; i<4; i++)
+    {
+        memset(&ai, 0, sizeof(_asyncTimeoutInfo));
+        memset(&arg, 0, sizeof(struct threadArg));
+
+        s = natsOptions_Create(&opts);
+        IFOK(s, natsOptions_UseGlobalMessageDelivery(opts, useLibDlv));
+        IFOK(s, _createDefaultThreadArgsForCbTests(&arg));
+        if ( s != NATS_OK)
+            FAIL("Unable to setup test!");
+
+        ai.arg = &arg;
+        ai.timeout = timeout;
+        arg.status = NATS_OK;
+
+        serverPid = _startServer("nats://127.0.0.1:4222", NULL, true);
+        CHECK_SERVER_STARTED(serverPid);
+
+        snprintf(testText, sizeof(testText), "Test async %ssubscriber timeout%s: ",
+                 ((i == 1 || i == 3) ? "queue " : ""),
+                 (i > 1 ? " (lib msg delivery)" : ""));
+        test(testText);
+        s = natsConnection_Connect(&nc, opts);
+        if (s == NATS_OK)
+        {
+            if (i == 0 || i == 2)
+                s = natsConnection_SubscribeTimeout(&sub, nc, "foo", timeout,
+                                                    _asyncTimeoutCb, (void*) &ai);
+            else
+                s = natsConnection_QueueSubscribeTimeout(&sub, nc, "foo", "group",
+                                                         timeout, _asyncTimeoutCb, (void*) &ai);
+        }
+        IFOK(s, natsConnection_PublishString(nc, "foo", "msg1"));
+
+        // Wait to be notified that sub timed-out 2 times
+        natsMutex_Lock(arg.m);
+        while ((s != NATS_TIMEOUT) && (arg.timerFired != 1))
+            s = natsCondition_TimedWait(arg.c, arg.m, 5000);
+        natsMutex_Unlock(arg.m);
+
+        // Wait half the timeout
+        nats_Sleep(timeout/2);
+
+        // Send the second message. This should reset the timeout timer.
+        IFOK(s, natsConnection_PublishString(nc, "foo", "msg2"));
+        IFOK(s, natsConnection_Flush(nc));
+
+        // Wait for 2nd timeout
+        natsMutex_Lock(arg.m);
+        while ((s != NATS_TIMEOUT) && (arg.timerStopped == 0))
+            s = natsCondition_TimedWait(arg.c, arg.m, 5000);
+        natsMutex_Unlock(arg.m);
+
+        // Send two more messages, only one should be received since the
+        // subscription will be unsubscribed/closed when receiving the
+        // first.
+        IFOK(s, natsConnection_PublishString(nc, "foo", "msg3"));
+        IFOK(s, natsConnection_PublishString(nc, "foo", "msg4"));
+        IFOK(s, natsConnection_Flush(nc));
+
+        // Wait for end of test
+        natsMutex_Lock(arg.m);
+        while ((s != NATS_TIMEOUT) && !arg.done)
+            s = natsCondition_TimedWait(arg.c, arg.m, 5000);
+        natsMutex_Unlock(arg.m);
+
+        // Wait more than the timeout time to see if extra timeout callbacks
+        // incorrectly fire
+        nats_Sleep(timeout+timeout/2);
+
+        // Check for success
+        natsMutex_Lock(arg.m);
+        testCond((s == NATS_OK) && (arg.status == NATS_OK)
+                    && (arg.sum == 3) && (arg.timerFired == 2)
+                    && (ai.timeFirstTimeout >= ai.timeAfterFirstMsg + timeout - 50)
+                    && (ai.timeFirstTimeout <= ai.timeAfterFirstMsg + timeout + 50)
+                    && (ai.timeSecondTimeout >= ai.timeSecondMsg + timeout - 50)
+                    && (ai.timeSecondTimeout <= ai.timeSecondMsg + timeout + 50))
+        natsMutex_Unlock(arg.m);
+
+        natsConnection_Destroy(nc);
+        natsOptions_Destroy(opts);
+
+        _destroyDefaultThreadArgs(&arg);
+
+        _stopServer(serverPid);
+
+        if (i >= 1)
+            useLibDlv = true;
+    }
+}
+
+static void
+_timeoutWithTrafficCb(natsConnection *nc, natsSubscription *sub, natsMsg *msg, void *closure)
+{
+    struct threadArg *arg = (struct threadArg*) closure;
+
+    natsMutex_Lock(arg->m);
+    if (msg != NULL)
+        arg->sum++;
+    else
+        arg->timerFired++;
+    natsCondition_Broadcast(arg->c);
+    natsMutex_Unlock(arg->m);
+
+    natsMsg_Destroy(msg);
+}
+
+static void
+test_AsyncSubscribeTimeoutWithTraffic(void)
+{
+    natsStatus          s;
+    natsConnection      *nc       = NULL;
+    natsSubscription    *sub      = NULL;
+    natsOptions         *opts     = NULL;
+    natsPid             serverPid = NATS_INVALID_PID;
+    int64_t             timeout   = 100;
+    int64_t             start     = 0;
+    int64_t             dur       = 0;
+    int                 fired     = 0;
+    struct threadArg    arg;
+    int                 i;
+
+    s = _createDefaultThreadArgsForCbTests(&arg);
+    IFOK(s, natsOptions_Create(&opts));
+    IFOK(s, natsOptions_UseGlobalMessageDelivery(opts, true));
+    if (s != NATS_OK)
+        FAIL("Unable to setup test!");
+
+    serverPid = _startServer("nats://127.0.0.1:4222", NULL, true);
+    CHECK_SERVER_STARTED(serverPid);
+
+    s = natsConnection_Connect(&nc, opts);
+    IFOK(s, natsConnection_SubscribeTimeout(&sub, nc, "foo", timeout,
+                                            _timeoutWithTrafficCb, (void*) &arg));
+    IFOK(s, natsConnection_Flush(nc));
+    if (s != NATS_OK)
+        FAIL("Unable to setup test!");
+
+    test("No timeout while messages flow: ");
+    for (i=0; (s == NATS_OK) && (i<25); i++)
+    {
+        s = natsConnection_PublishString(nc, "foo", "msg");
+        IFOK(s, natsConnection_Flush(nc));
+        nats_Sleep(timeout/5);
+    }
+    natsMutex_Lock(arg.m);
+    while ((s != NATS_TIMEOUT) && (arg.sum != 25))
+        s = natsCondition_TimedWait(arg.c, arg.m, 5000);
+    fired = arg.timerFired;
+    natsMutex_Unlock(arg.m);
+    testCond((s == NATS_OK) && (fired == 0));
+
+    test("Timeout after messages stop: ");
+    start = nats_Now();
+    natsMutex_Lock(arg.m);
+    while ((s != NATS_TIMEOUT) && (arg.timerFired != 1))
+        s = natsCondition_TimedWait(arg.c, arg.m, 5000);
+    natsMutex_Unlock(arg.m);
+    dur = nats_Now() - start;
+    testCond((s == NATS_OK) && (dur >= timeout - (timeout/5) - 10) && (dur <= timeout + 50));
+
+    test("Timeout fires again: ");
+    natsMutex_Lock(arg.m);
+    while ((s != NATS_TIMEOUT) && (arg.timerFired != 2))
+        s = natsCondition_TimedWait(arg.c, arg.m, 5000);
+    natsMutex_Unlock(arg.m);
+    testCond(s == NATS_OK);
+
+    natsSubscription_Destroy(sub);
+    natsConnection_Destroy(nc);
+    natsOptions_Destroy(opts);
+
+    _destroyDefaultThreadArgs(&arg);
+
+    _stopServer(serverPid);
+}
+
+static void
+test_SyncSubscribe(void)
+{
+    natsStatus          s;
+    natsConnection      *nc       = NULL;
+    natsSubscription    *sub      = NULL;
+    natsMsg             *msg      = NULL;
+    natsPid             serverPid = NATS_INVALID_PID;
+    const char          *string   = "Hello World";
+
+    serverPid = _startServer("nats://127.0.0.1:4222", NULL, true);
+    CHECK_SERVER_STARTED(serverPid);
+
+    test("Test sync subscriber: ")
+    s = natsConnection_ConnectTo(&nc, NATS_DEFAULT_URL);
+    IFOK(s, natsConnection_SubscribeSync(&sub, nc, "foo"));
+    IFOK(s, natsConnection_PublishString(nc, "foo", string));
+    IFOK(s, natsSubscription_NextMsg(&msg, sub, 1000));
+    testCond((s == NATS_OK)
+             && (msg != NULL)
+             && (strncmp(string, natsMsg_GetData(msg), natsMsg_GetDataLength(msg)) == 0));
+
+    natsMsg_Destroy(msg);
+    natsSubscription_Destroy(sub);
+    natsConnection_Destroy(nc);
+
+    _stopServer(serverPid);
+}
+
+static void
+test_PubSubWithReply(void)
+{
+    natsStatus          s;
+    natsConnection      *nc       = NULL;
+    natsSubscription    *sub      = NULL;
+    natsMsg             *msg      = NULL;
+    natsPid             serverPid = NATS_INVALID_PID;
+    const char          *string   = "Hello World";
+
+    serverPid = _startServer("nats://127.0.0.1:4222", NULL, true);
+    CHECK_SERVER_STARTED(serverPid);
+
+    test("Test PubSub with reply: ")
+    s = natsConnection_ConnectTo(&nc, NATS_DEFAULT_URL);
+    IFOK(s, natsConnection_SubscribeSync(&sub, nc, "foo"));
+    IFOK(s, natsConnection_PublishRequestString(nc, "foo", "bar", string));
+    IFOK(s, natsSubscription_NextMsg(&msg, sub, 1000));
+    testCond((s == NATS_OK)
+             && (msg != NULL)
+             && (strncmp(string, natsMsg_GetData(msg), natsMsg_GetDataLength(msg)) == 0)
+             && (strncmp(natsMsg_GetReply(msg), "bar", 3) == 0));
+
+    natsMsg_Destroy(msg);
+    natsSubscription_Destroy(sub);
+    natsConnection_Destroy(nc);
+
+    _stopServer(serverPid);
+}
+
+static void
+test_NoResponders(void)
+{
+    natsStatus          s;
+    natsConnection      *nc       = NULL;
+    natsSubscription    *sub      = NULL;
+    natsMsg             *msg      = NULL;
+    natsOptions         *opts     = NULL;
+    natsPid             serverPid = NATS_INVALID_PID;
+    const char          *string   = "Hello World";
+    struct threadArg    arg;
+
+    if (!serverVersionAtLeast(2,2,0))
+    {
+        char txt[200];
+
+        snprintf(txt, sizeof(txt), "Skipping since requires server version of at least 2.2.0, got %s: ", serverVersion);
+        test(txt);
+        testCond(true);
+        return;
+    }
+
+    s = _createDefaultThreadArgsForCbTests(&arg);
+    if ( s != NATS_OK)
+        FAIL("Unable to setup test!");
+
+    serverPid = _startServer("nats://127.0.0.1:4222", NULL, true);
+    CHECK_SERVER_STARTED(serverPid);
+
+    test("No responders on NextMsg: ");
+    s = natsConnection_ConnectTo(&nc, NATS_DEFAULT_URL);
+    IFOK(s, natsConnection_SubscribeSync(&sub, nc, "foo"));
+    IFOK(s, natsConnection_PublishRequestString(nc, "bar", "foo", string));
+    IFOK(s, natsSubscription_NextMsg(&msg, sub, 1000));
+    testCond(NATS_NO_RESPONDERS);
+
+    natsMsg_Destroy(msg);
+    natsSubscription_Destroy(sub);
+    sub = NULL;
+
+    arg.status  = NATS_ERR;
+    arg.control = 10;
+
+    test("No responders in callback: ");
+    s = natsConnection_Subscribe(&sub, nc, "bar", _recvTestString, (void*)&arg);
+    IFOK(s, natsConnection_PublishRequestString(nc, "foo", "bar", string));
+    if (s == NATS_OK)
+    {
+        natsMutex_Lock(arg.m);
+        while ((s != NATS_TIMEOUT) && !arg.msgReceived)
+            s = natsCondition_TimedWait(arg.c, arg.m, 2000);
+        if (s == NATS_OK)
+            s = arg.status;
+        natsMutex_Unlock(arg.m);
+    }
+    testCond(s == NATS_OK);
+
+    natsSubscription_Destroy(sub);
+    sub = NULL;
+    natsConnection_Destroy(nc);
+    nc = NULL;
+
+    test("Disable no responders: ");
+    s = natsOptions_Create(&opts);
+    IFOK(s, natsOptions_DisableNoResponders(opts, true));
+    IFOK(s, natsConnection_Connect(&nc, opts));
+    IFOK(s, natsConnection_RequestString(&msg, nc, "foo", string, 500));
+    testCond((s == NATS_TIMEOUT) && (msg == NULL));
+
+    natsConnection_Destroy(nc);
+    natsOptions_Destroy(opts);
+    _destroyDefaultThreadArgs(&arg);
+
+    _stopServer(serverPid);
+}
+
+struct flushArg
+{
+    natsConnection      *nc;
+    natsStatus          s;
+    int                 count;
+    int64_t             timeout;
+    int64_t             initialSleep;
+    int64_t             loopSleep;
+};
+
+static void
+_doFlush(void *arg)
+{
+    struct flushArg     *p = (struct flushArg*) arg;
+    int                 i;
+
+    nats_Sleep(p->initialSleep);
+
+    for (i = 0; (p->s == NATS_OK) && (i < p->count); i++)
+    {
+        p->s = natsConnection_FlushTimeout(p->nc, p->timeout);
+        if ((p->s == NATS_OK) && (p->loopSleep > 0))
+            nats_Sleep(p->loopSleep);
+    }
+}
+
+static void
+test_Flush(void)
+{
+    natsStatus          s;
+    natsOptions         *opts     = NULL;
+    natsConnection      *nc       = NULL;
+    natsPid             serverPid = NATS_INVALID_PID;
+    const char          *string   = "Hello World";
+    natsThread          *threads[3] = { NULL, NULL, NULL };
+    struct flushArg     args[3];
+    int64_t             start = 0;
+    int64_t             elapsed = 0;
+
+    s = natsOptions_Create(&opts);
+    IFOK(s, natsOptions_SetURL(opts, "nats://127.0.0.1:4222"));
+    IFOK(s, natsOptions_SetReconnectWait(opts, 100));
+    IFOK(s, natsOptions_SetReconnectJitter(opts, 0, 0));
+    IFOK(s, natsOptions_SetPingInterval(opts, 100));
+
+    if (s != NATS_OK)
+        FAIL("Unable to setup test");
+
+    serverPid = _startServer("nats://127.0.0.1:4222", NULL, true);
+    CHECK_SERVER_STARTED(serverPid);
+
+    test("Test Flush empties buffer: ")
+    s = natsConnection_Connect(&nc, opts);
+    for (int i=0; (s == NATS_OK) && (i < 1000); i++)
+        s = natsConnection_PublishString(nc, "flush", string);
+    IFOK(s, natsConnection_Flush(nc));
+    testCond((s == NATS_OK)
+             && natsConnection_Buffered(nc) == 0);
+
+    test("Check parallel Flush: ")
+    for (int i=0; (s == NATS_OK) && (i < 3); i++)
+    {
+        args[i].nc           = nc;
+        args[i].s            = NATS_OK;
+        args[i].timeout      = 5000;
+#ifdef _WIN32
+        args[i].count        = 100;
+#else
+        args[i].count        = 1000;
+#endif
+        args[i].initialSleep = 500;
+        args[i].loopSleep    = 1;
+        s = natsThread_Create(&(threads[i]), _doFlush, (void*) &(args[i]));
+    }
+
+    for (int i=0; (s == NATS_OK) && (i < 10000); i++)
+        s = natsConnection_PublishString(nc, "flush", "Hello world");
+
+    for (int i=0; (i < 3); i++)
+    {
+        if (threads[i] == NULL)
+            continue;
+
+        natsThread_Join(threads[i]);
+        natsThread_Destroy(threads[i]);
+
+        if (args[i].s != NATS_OK)
+            s = args[i].s;
+    }
+    testCond(s == NATS_OK);
+
+    natsConnection_Destroy(nc);
+    nc = NULL;
+
+    test("Check Flush while in doReconnect: ")
+    s = natsOptions_SetReconnectWait(opts, 3000);
+    IFOK(s, natsOptions_SetReconnectJitter(opts, 0, 0));
+    IFOK(s, natsConnection_Connect(&nc, opts));
+    if (s == NATS_OK)
+    {
+        // Capture the moment we connected
+        start = nats_Now();
+
+        // Stop the server
+        _stopServer(serverPid);
+        serverPid = NATS_INVALID_PID;
+
+        // We can restart right away, since the client library will wait 3 sec
+        // before reconnecting.
+        serverPid = _startServer("nats://127.0.0.1:4222", NULL, true);
+        CHECK_SERVER_STARTED(serverPid);
+
+        // Attempt to Flush. This should wait for the reconnect to occur, then
+        // proceed.
+        for (int i=0; (s == NATS_OK) && (i < 3); i++)
+        {
+            args[i].nc           = nc;
+            args[i].s            = NATS_OK;
+            args[i].timeout      = 5000;
+            args[i].count        = 1;
+            args[i].initialSleep = 1000;
+            args[i].loopSleep    = 0;
+            s = natsThread_Create(&(threads[i]), _doFlush, (void*) &(args[i]));
+        }
+    }
+    for (int i=0; (i < 3); i++)
+    {
+        if (threads[i] == NULL)
+            continue;
+
+        natsThread_Join(threads[i]);
+        natsThread_Destroy(threads[i]);
+
+        if ((s == NATS_OK) && (args[i].s != NATS_OK))
+        {
+            s = args[i].s;
+            printf("t=%d s=%d\n", i, s);
+        }
+    }
+    if (s == NATS_OK)
+        elapsed = (nats_Now() - start);
+
+    testCond((s == NATS_OK) && (elapsed >= 2500) && (elapsed <= 3200));
+
+    natsOptions_Destroy(opts);
+    natsConnection_Destroy(nc);
+
+    _stopServer(serverPid);
+}
+
+static void
+test_ConnCloseDoesFlush(void)
+{
+    natsStatus          s    = NATS_OK;
+    natsPid             pid  = NATS_INVALID_PID;
+    natsConnection      *nc1 = NULL;
+    natsConnection      *nc2 = NULL;
+    natsSubscription    *sub = NULL;
+    int                 tc   = 100000;
+    int                 i, iter;
+
+    pid = _startServer("nats://127.0.0.1:4222", NULL, true);
+    CHECK_SERVER_STARTED(pid);
+
+    if (valgrind)
+        tc = 1000;
+
+    test("Connection close flushes: ");
+    for (iter=0; (s == NATS_OK) && (iter<10); iter++)
+    {
+        s = natsConnection_ConnectTo(&nc1, NATS_DEFAULT_URL);
+        IFOK(s, natsConnection_SubscribeSync(&sub, nc1, "foo"));
+        IFOK(s, natsSubscription_SetPendingLimits(sub, -1, -1));
+        IFOK(s, natsConnection_Flush(nc1));
+
+        IFOK(s, natsConnection_ConnectTo(&nc2, NATS_DEFAULT_URL));
+
+        for (i=0; (s == NATS_OK) && (i<tc); i++)
+            s = natsConnection_PublishString(nc2, "foo", "hello");
+        if (s == NATS_OK)
+            natsConnection_Close(nc2);
+
+        for (i=0; (s == NATS_OK) && (i<tc); i++)
+        {
+            natsMsg *msg = NULL;
+            s = natsSubscription_NextMsg(&msg, sub, 1000);
+            natsMsg_Destroy(msg);
+        }
+
+        natsConnection_Destroy(nc2);
+        nc2 = NULL;
+        natsSubscription_Destroy(sub);
+        sub = NULL;
+        natsConnection_Destroy(nc1);
+        nc1 = NULL;
+    }
+    testCond(s == NATS_OK);
 
-        s = natsOptions_Create(&opts);
-        IFOK(s, natsOptions_UseGlobalMessageDelivery(opts, useLibDlv));
-        IFOK(s, _createDefaultThreadArgsForCbTests(&arg));
-        if ( s != NATS_OK)
-            FAIL("Unable to setup test!");
+    _stopServer(pid);
+}
 
-        ai.arg = &arg;
-        ai.timeout = timeout;
-        arg.status = NATS_OK;
+static void
+test_QueueSubscriber(void)
+{
+    natsStatus          s;
+    natsConnection      *nc       = NULL;
+    natsSubscription    *s1       = NULL;
+    natsSubscription    *s2       = NULL;
+    natsMsg             *msg      = NULL;
+    uint64_t            r1        = 0;
+    uint64_t            r2        = 0;
+    float               v         = 1000.0 * 0.15;
+    int64_t             d1;
+    int64_t             d2;
+    natsPid             serverPid = NATS_INVALID_PID;
+    const char          *string   = "Hello World";
 
-        serverPid = _startServer("nats://127.0.0.1:4222", NULL, true);
-        CHECK_SERVER_STARTED(serverPid);
+    serverPid = _startServer("nats://127.0.0.1:4222", NULL, true);
+    CHECK_SERVER_STARTED(serverPid);
 
-        snprintf(testText, sizeof(testText), "Test async %ssubscriber timeout%s: ",
-                 ((i == 1 || i == 3) ? "queue " : ""),
-                 (i > 1 ? " (lib msg delivery)" : ""));
-        test(testText);
-        s = natsConnection_Connect(&nc, opts);
-        if (s == NATS_OK)
-        {
-            if (i == 0 || i == 2)
-                s = natsConnection_SubscribeTimeout(&sub, nc, "foo", timeout,
-                                                    _asyncTimeoutCb, (void*) &ai);
-            else
-                s = natsConnection_QueueSubscribeTimeout(&sub, nc, "foo", "group",
-                                                         timeout, _asyncTimeoutCb, (void*) &ai);
-        }
-        IFOK(s, natsConnection_PublishString(nc, "foo", "msg1"));
+    test("Test QueueSubscriber receive correct amount: ");
+    s = natsConnection_ConnectTo(&nc, NATS_DEFAULT_URL);
+    IFOK(s, natsConnection_QueueSubscribeSync(&s1, nc, "foo", "bar"));
+    IFOK(s, natsConnection_QueueSubscribeSync(&s2, nc, "foo", "bar"));
+    IFOK(s, natsConnection_PublishString(nc, "foo", string));
+    IFOK(s, natsConnection_Flush(nc));
+    IFOK(s, natsSubscription_QueuedMsgs(s1, &r1));
+    IFOK(s, natsSubscription_QueuedMsgs(s2, &r2));
+    testCond((s == NATS_OK)
+             && (r1 + r2 == 1));
 
-        // Wait to be notified that sub timed-out 2 times
-        natsMutex_Lock(arg.m);
-        while ((s != NATS_TIMEOUT) && (arg.timerFired != 1))
-            s = natsCondition_TimedWait(arg.c, arg.m, 5000);
-        natsMutex_Unlock(arg.m);
+    (void)natsSubscription_NextMsg(&msg, s1, 0);
+    natsMsg_Destroy(msg);
+    msg = NULL;
 
-        // Wait half the timeout
-        nats_Sleep(timeout/2);
+    (void)natsSubscription_NextMsg(&msg, s2, 0);
+    natsMsg_Destroy(msg);
+    msg = NULL;
 
-        // Send the second message. This should reset the timeout timer.
-        IFOK(s, natsConnection_PublishString(nc, "foo", "msg2"));
-        IFOK(s, natsConnection_Flush(nc));
+    test("Test correct amount when more messages are sent: ");
+    for (int i=0; (s == NATS_OK) && (i<1000); i++)
+        s = natsConnection_PublishString(nc, "foo", string);
 
-        // Wait for 2nd timeout
-        natsMutex_Lock(arg.m);
-        while ((s != NATS_TIMEOUT) && (arg.timerStopped == 0))
-            s = natsCondition_TimedWait(arg.c, arg.m, 5000);
-        natsMutex_Unlock(arg.m);
+    IFOK(s, natsConnection_Flush(nc));
 
-        // Send two more messages, only one should be received since the
-        // subscription will be unsubscribed/closed when receiving the
-        // first.
-        IFOK(s, natsConnection_PublishString(nc, "foo", "msg3"));
-        IFOK(s, natsConnection_PublishString(nc, "foo", "msg4"));
-        IFOK(s, natsConnection_Flush(nc));
+    r1 = r2 = 0;
 
-        // Wait for end of test
-        natsMutex_Lock(arg.m);
-        while ((s != NATS_TIMEOUT) && !arg.done)
-            s = natsCondition_TimedWait(arg.c, arg.m, 5000);
-        natsMutex_Unlock(arg.m);
+    IFOK(s, natsSubscription_QueuedMsgs(s1, &r1));
+    IFOK(s, natsSubscription_QueuedMsgs(s2, &r2));
 
-        // Wait more than the timeout time to see if extra timeout callbacks
-        // incorrectly fire
-        nats_Sleep(timeout+timeout/2);
+    testCond((s == NATS_OK) && (r1 + r2 == 1000));
 
-        // Check for success
-        natsMutex_Lock(arg.m);
-        testCond((s == NATS_OK) && (arg.status == NATS_OK)
-                    && (arg.sum == 3) && (arg.timerFired == 2)
-                    && (ai.timeFirstTimeout >= ai.timeAfterFirstMsg + timeout - 50)
-                    && (ai.timeFirstTimeout <= ai.timeAfterFirstMsg + timeout + 50)
-                    && (ai.timeSecondTimeout >= ai.timeSecondMsg + timeout - 50)
-                    && (ai.timeSecondTimeout <= ai.timeSecondMsg + timeout + 50))
-        natsMutex_Unlock(arg.m);
+    test("Variance acceptable: ");
+    d1 = 500 - r1;
+    if (d1 < 0)
+        d1 *= -1;
 
-        natsConnection_Destroy(nc);
-        natsOptions_Destroy(opts);
+    d2 = 500 - r1;
+    if (d2 < 0)
+        d2 *= -1;
 
-        _destroyDefaultThreadArgs(&arg);
+    testCond((d1 <= v) && (d2 <= v));
 
-        _stopServer(serverPid);
+    natsSubscription_Destroy(s1);
+    natsSubscription_Destroy(s2);
+    natsConnection_Destroy(nc);
 
-        if (i >= 1)
-            useLibDlv = true;
-    }
+    _stopServer(serverPid);
 }
 
 static void
-test_SyncSubscribe(void)
+test_ReplyArg(void)
 {
     natsStatus          s;
     natsConnection      *nc       = NULL;
     natsSubscription    *sub      = NULL;
-    natsMsg             *msg      = NULL;
     natsPid             serverPid = NATS_INVALID_PID;
-    const char          *string   = "Hello World";
+    struct threadArg    arg;
+
+    s = _createDefaultThreadArgsForCbTests(&arg);
+    if ( s != NATS_OK)
+        FAIL("Unable to setup test!");
+
+    arg.string = "bar";
+    arg.status = NATS_OK;
+    arg.control= 2;
 
     serverPid = _startServer("nats://127.0.0.1:4222", NULL, true);
     CHECK_SERVER_STARTED(serverPid);
 
-    test("Test sync subscriber: ")
+    test("Test for correct Reply arg in callback: ")
     s = natsConnection_ConnectTo(&nc, NATS_DEFAULT_URL);
-    IFOK(s, natsConnection_SubscribeSync(&sub, nc, "foo"));
-    IFOK(s, natsConnection_PublishString(nc, "foo", string));
-    IFOK(s, natsSubscription_NextMsg(&msg, sub, 1000));
-    testCond((s == NATS_OK)
-             && (msg != NULL)
-             && (strncmp(string, natsMsg_GetData(msg), natsMsg_GetDataLength(msg)) == 0));
+    IFOK(s, natsConnection_Subscribe(&sub, nc, "foo", _recvTestString,
+                                     (void*) &arg));
+    IFOK(s, natsConnection_PublishRequestString(nc, "foo", "bar", "hello"));
+
+    natsMutex_Lock(arg.m);
+    while ((s != NATS_TIMEOUT) && !arg.msgReceived)
+        s = natsCondition_TimedWait(arg.c, arg.m, 1500);
+    natsMutex_Unlock(arg.m);
+
+    IFOK(s, arg.status);
+
+    testCond(s == NATS_OK);
 
-    natsMsg_Destroy(msg);
     natsSubscription_Destroy(sub);
     natsConnection_Destroy(nc);
 
+    _destroyDefaultThreadArgs(&arg);
+
     _stopServer(serverPid);
 }
 
 static void
-test_PubSubWithReply(void)
+test_SyncReplyArg(void)
 {
     natsStatus          s;
     natsConnection      *nc       = NULL;
     natsSubscription    *sub      = NULL;
     natsMsg             *msg      = NULL;
     natsPid             serverPid = NATS_INVALID_PID;
-    const char          *string   = "Hello World";
 
     serverPid = _startServer("nats://127.0.0.1:4222", NULL, true);
     CHECK_SERVER_STARTED(serverPid);
 
-    test("Test PubSub with reply: ")
+    test("Test for correct Reply arg in msg: ")
     s = natsConnection_ConnectTo(&nc, NATS_DEFAULT_URL);
     IFOK(s, natsConnection_SubscribeSync(&sub, nc, "foo"));
-    IFOK(s, natsConnection_PublishRequestString(nc, "foo", "bar", string));
+    IFOK(s, natsConnection_PublishRequestString(nc, "foo", "bar", "hello"));
     IFOK(s, natsSubscription_NextMsg(&msg, sub, 1000));
+
     testCond((s == NATS_OK)
              && (msg != NULL)
-             && (strncmp(string, natsMsg_GetData(msg), natsMsg_GetDataLength(msg)) == 0)
-             && (strncmp(natsMsg_GetReply(msg), "bar", 3) == 0));
+             && (natsMsg_GetReply(msg) != NULL)
+             && (strcmp("bar", natsMsg_GetReply(msg)) == 0));
 
     natsMsg_Destroy(msg);
     natsSubscription_Destroy(sub);
@@ -10221,357 +12798,318 @@ test_PubSubWithReply(void)
 }
 
 static void
-test_NoResponders(void)
+test_Unsubscribe(void)
 {
     natsStatus          s;
     natsConnection      *nc       = NULL;
     natsSubscription    *sub      = NULL;
-    natsMsg             *msg      = NULL;
-    natsOptions         *opts     = NULL;
     natsPid             serverPid = NATS_INVALID_PID;
-    const char          *string   = "Hello World";
     struct threadArg    arg;
 
-    if (!serverVersionAtLeast(2,2,0))
-    {
-        char txt[200];
-
-        snprintf(txt, sizeof(txt), "Skipping since requires server version of at least 2.2.0, got %s: ", serverVersion);
-        test(txt);
-        testCond(true);
-        return;
-    }
-
     s = _createDefaultThreadArgsForCbTests(&arg);
     if ( s != NATS_OK)
         FAIL("Unable to setup test!");
 
+    arg.string = "bar";
+    arg.status = NATS_OK;
+    arg.control= 3;
+    arg.sum    = 0;
+
     serverPid = _startServer("nats://127.0.0.1:4222", NULL, true);
     CHECK_SERVER_STARTED(serverPid);
 
-    test("No responders on NextMsg: ");
+    test("Connect and create sub: ")
     s = natsConnection_ConnectTo(&nc, NATS_DEFAULT_URL);
-    IFOK(s, natsConnection_SubscribeSync(&sub, nc, "foo"));
-    IFOK(s, natsConnection_PublishRequestString(nc, "bar", "foo", string));
-    IFOK(s, natsSubscription_NextMsg(&msg, sub, 1000));
-    testCond(NATS_NO_RESPONDERS);
-
-    natsMsg_Destroy(msg);
-    natsSubscription_Destroy(sub);
-    sub = NULL;
+    IFOK(s, natsConnection_Subscribe(&sub, nc, "foo", _recvTestString, (void*) &arg));
+    testCond(s == NATS_OK);
 
-    arg.status  = NATS_ERR;
-    arg.control = 10;
+    test("Send messages and flush: ");
+    for (int i=0; (s == NATS_OK) && (i<20); i++)
+        s = natsConnection_PublishString(nc, "foo", "hello");
+    IFOK(s, natsConnection_Flush(nc));
+    testCond(s == NATS_OK);
 
-    test("No responders in callback: ");
-    s = natsConnection_Subscribe(&sub, nc, "bar", _recvTestString, (void*)&arg);
-    IFOK(s, natsConnection_PublishRequestString(nc, "foo", "bar", string));
-    if (s == NATS_OK)
-    {
-        natsMutex_Lock(arg.m);
-        while ((s != NATS_TIMEOUT) && !arg.msgReceived)
-            s = natsCondition_TimedWait(arg.c, arg.m, 2000);
-        if (s == NATS_OK)
-            s = arg.status;
-        natsMutex_Unlock(arg.m);
-    }
+    test("Unsubscribe from callback: ");
+    natsMutex_Lock(arg.m);
+    while ((s != NATS_TIMEOUT) && !arg.msgReceived)
+        s = natsCondition_TimedWait(arg.c, arg.m, 2000);
+    natsMutex_Unlock(arg.m);
+    IFOK(s, arg.status);
     testCond(s == NATS_OK);
 
+    test("No more callback: ");
+    nats_Sleep(250);
+    natsMutex_Lock(arg.m);
+    testCond((s == NATS_OK) && (arg.sum == 10));
+    natsMutex_Unlock(arg.m);
+
     natsSubscription_Destroy(sub);
     sub = NULL;
-    natsConnection_Destroy(nc);
-    nc = NULL;
 
-    test("Disable no responders: ");
-    s = natsOptions_Create(&opts);
-    IFOK(s, natsOptions_DisableNoResponders(opts, true));
-    IFOK(s, natsConnection_Connect(&nc, opts));
-    IFOK(s, natsConnection_RequestString(&msg, nc, "foo", string, 500));
-    testCond((s == NATS_TIMEOUT) && (msg == NULL));
+    test("Create new sub: ");
+    s = natsConnection_Subscribe(&sub, nc, "foo", _recvTestString, (void*) &arg);
+    testCond(s == NATS_OK);
 
+    test("Unsubscribe after connection close: ");
     natsConnection_Destroy(nc);
-    natsOptions_Destroy(opts);
+    s = natsSubscription_Unsubscribe(sub);
+    testCond(s == NATS_CONNECTION_CLOSED);
+
+    natsSubscription_Destroy(sub);
     _destroyDefaultThreadArgs(&arg);
 
     _stopServer(serverPid);
 }
 
-struct flushArg
+static void
+test_DoubleUnsubscribe(void)
 {
-    natsConnection      *nc;
     natsStatus          s;
-    int                 count;
-    int64_t             timeout;
-    int64_t             initialSleep;
-    int64_t             loopSleep;
-};
+    natsConnection      *nc       = NULL;
+    natsSubscription    *sub      = NULL;
+    natsPid             serverPid = NATS_INVALID_PID;
 
-static void
-_doFlush(void *arg)
-{
-    struct flushArg     *p = (struct flushArg*) arg;
-    int                 i;
+    serverPid = _startServer("nats://127.0.0.1:4222", NULL, true);
+    CHECK_SERVER_STARTED(serverPid);
 
-    nats_Sleep(p->initialSleep);
+    test("Connect and create subscription: ");
+    s = natsConnection_ConnectTo(&nc, NATS_DEFAULT_URL);
+    IFOK(s, natsConnection_SubscribeSync(&sub, nc, "foo"));
+    testCond(s == NATS_OK);
 
-    for (i = 0; (p->s == NATS_OK) && (i < p->count); i++)
-    {
-        p->s = natsConnection_FlushTimeout(p->nc, p->timeout);
-        if ((p->s == NATS_OK) && (p->loopSleep > 0))
-            nats_Sleep(p->loopSleep);
-    }
+    test("Unsubscribe: ");
+    s = natsSubscription_Unsubscribe(sub);
+    testCond(s == NATS_OK);
+
+    test("Double Unsubscribe: ");
+    s = natsSubscription_Unsubscribe(sub);
+    testCond(s == NATS_INVALID_SUBSCRIPTION);
+
+    natsSubscription_Destroy(sub);
+    natsConnection_Destroy(nc);
+
+    _stopServer(serverPid);
 }
 
 static void
-test_Flush(void)
+test_SubRemovedWhileProcessingMsg(void)
 {
     natsStatus          s;
-    natsOptions         *opts     = NULL;
     natsConnection      *nc       = NULL;
+    natsOptions         *opts     = NULL;
+    natsSubscription    *sub      = NULL;
     natsPid             serverPid = NATS_INVALID_PID;
-    const char          *string   = "Hello World";
-    natsThread          *threads[3] = { NULL, NULL, NULL };
-    struct flushArg     args[3];
-    int64_t             start = 0;
-    int64_t             elapsed = 0;
-
-    s = natsOptions_Create(&opts);
-    IFOK(s, natsOptions_SetURL(opts, "nats://127.0.0.1:4222"));
-    IFOK(s, natsOptions_SetReconnectWait(opts, 100));
-    IFOK(s, natsOptions_SetReconnectJitter(opts, 0, 0));
-    IFOK(s, natsOptions_SetPingInterval(opts, 100));
-
-    if (s != NATS_OK)
-        FAIL("Unable to setup test");
 
     serverPid = _startServer("nats://127.0.0.1:4222", NULL, true);
     CHECK_SERVER_STARTED(serverPid);
 
-    test("Test Flush empties buffer: ")
-    s = natsConnection_Connect(&nc, opts);
-    for (int i=0; (s == NATS_OK) && (i < 1000); i++)
-        s = natsConnection_PublishString(nc, "flush", string);
-    IFOK(s, natsConnection_Flush(nc));
-    testCond((s == NATS_OK)
-             && natsConnection_Buffered(nc) == 0);
-
-    test("Check parallel Flush: ")
-    for (int i=0; (s == NATS_OK) && (i < 3); i++)
-    {
-        args[i].nc           = nc;
-        args[i].s            = NATS_OK;
-        args[i].timeout      = 5000;
-#ifdef _WIN32
-        args[i].count        = 100;
-#else
-        args[i].count        = 1000;
-#endif
-        args[i].initialSleep = 500;
-        args[i].loopSleep    = 1;
-        s = natsThread_Create(&(threads[i]), _doFlush, (void*) &(args[i]));
-    }
-
-    for (int i=0; (s == NATS_OK) && (i < 10000); i++)
-        s = natsConnection_PublishString(nc, "flush", "Hello world");
+    test("Connect and create sub: ")
+    s = natsConnection_ConnectTo(&nc, NATS_DEFAULT_URL);
+    IFOK(s, natsConnection_SubscribeSync(&sub, nc, "foo"));
+    testCond(s == NATS_OK);
 
-    for (int i=0; (i < 3); i++)
-    {
-        if (threads[i] == NULL)
-            continue;
+    // Lock the sub so that we can remove while the connection
+    // readLoop is trying to push to the sub.
+    natsSub_Lock(sub);
 
-        natsThread_Join(threads[i]);
-        natsThread_Destroy(threads[i]);
+    test("Send message: ");
+    s = natsConnection_PublishString(nc, "foo", "hello");
+    testCond(s == NATS_OK);
 
-        if (args[i].s != NATS_OK)
-            s = args[i].s;
-    }
+    test("Close sub: ");
+    natsSub_Unlock(sub);
+    natsSub_close(sub, false);
     testCond(s == NATS_OK);
 
+    test("Check msg not given: ");
+    natsSub_Lock(sub);
+    testCond(sub->msgList.msgs == 0);
+    natsSub_Unlock(sub);
+
+    natsSubscription_Destroy(sub);
+    sub = NULL;
     natsConnection_Destroy(nc);
     nc = NULL;
 
-    test("Check Flush while in doReconnect: ")
-    s = natsOptions_SetReconnectWait(opts, 3000);
-    IFOK(s, natsOptions_SetReconnectJitter(opts, 0, 0));
-    IFOK(s, natsConnection_Connect(&nc, opts));
-    if (s == NATS_OK)
-    {
-        // Capture the moment we connected
-        start = nats_Now();
-
-        // Stop the server
-        _stopServer(serverPid);
-        serverPid = NATS_INVALID_PID;
-
-        // We can restart right away, since the client library will wait 3 sec
-        // before reconnecting.
-        serverPid = _startServer("nats://127.0.0.1:4222", NULL, true);
-        CHECK_SERVER_STARTED(serverPid);
+    // Repeat with global message delivery option.
+    test("Set global delivery option: ");
+    s = natsOptions_Create(&opts);
+    IFOK(s, natsOptions_UseGlobalMessageDelivery(opts, true));
+    testCond(s == NATS_OK);
 
-        // Attempt to Flush. This should wait for the reconnect to occur, then
-        // proceed.
-        for (int i=0; (s == NATS_OK) && (i < 3); i++)
-        {
-            args[i].nc           = nc;
-            args[i].s            = NATS_OK;
-            args[i].timeout      = 5000;
-            args[i].count        = 1;
-            args[i].initialSleep = 1000;
-            args[i].loopSleep    = 0;
-            s = natsThread_Create(&(threads[i]), _doFlush, (void*) &(args[i]));
-        }
-    }
-    for (int i=0; (i < 3); i++)
-    {
-        if (threads[i] == NULL)
-            continue;
+    test("Connect and create sub: ");
+    s = natsConnection_Connect(&nc, opts);
+    IFOK(s, natsConnection_Subscribe(&sub, nc, "foo", _dummyMsgHandler, NULL));
+    testCond(s == NATS_OK);
 
-        natsThread_Join(threads[i]);
-        natsThread_Destroy(threads[i]);
+    natsSub_Lock(sub);
+    natsMutex_Lock(sub->libDlvWorker->lock);
+    test("Send message: ");
+    s = natsConnection_PublishString(nc, "foo", "hello");
+    testCond(s == NATS_OK);
 
-        if ((s == NATS_OK) && (args[i].s != NATS_OK))
-        {
-            s = args[i].s;
-            printf("t=%d s=%d\n", i, s);
-        }
-    }
-    if (s == NATS_OK)
-        elapsed = (nats_Now() - start);
+    test("Close sub: ");
+    natsMutex_Unlock(sub->libDlvWorker->lock);
+    natsSub_Unlock(sub);
+    natsSub_close(sub, false);
+    testCond(s == NATS_OK);
 
-    testCond((s == NATS_OK) && (elapsed >= 2500) && (elapsed <= 3200));
+    test("Check msg not given: ");
+    natsSub_Lock(sub);
+    natsMutex_Lock(sub->libDlvWorker->lock);
+    testCond(sub->msgList.msgs == 0);
+    natsMutex_Unlock(sub->libDlvWorker->lock);
+    natsSub_Unlock(sub);
 
-    natsOptions_Destroy(opts);
+    natsSubscription_Destroy(sub);
     natsConnection_Destroy(nc);
+    natsOptions_Destroy(opts);
 
     _stopServer(serverPid);
 }
 
 static void
-test_ConnCloseDoesFlush(void)
+test_RequestTimeout(void)
 {
-    natsStatus          s    = NATS_OK;
-    natsPid             pid  = NATS_INVALID_PID;
-    natsConnection      *nc1 = NULL;
-    natsConnection      *nc2 = NULL;
-    natsSubscription    *sub = NULL;
-    int                 tc   = 100000;
-    int                 i, iter;
-
-    pid = _startServer("nats://127.0.0.1:4222", NULL, true);
-    CHECK_SERVER_STARTED(pid);
-
-    if (valgrind)
-        tc = 1000;
-
-    test("Connection close flushes: ");
-    for (iter=0; (s == NATS_OK) && (iter<10); iter++)
-    {
-        s = natsConnection_ConnectTo(&nc1, NATS_DEFAULT_URL);
-        IFOK(s, natsConnection_SubscribeSync(&sub, nc1, "foo"));
-        IFOK(s, natsSubscription_SetPendingLimits(sub, -1, -1));
-        IFOK(s, natsConnection_Flush(nc1));
-
-        IFOK(s, natsConnection_ConnectTo(&nc2, NATS_DEFAULT_URL));
+    natsStatus          s;
+    natsConnection      *nc       = NULL;
+    natsMsg             *msg      = NULL;
+    natsPid             serverPid = NATS_INVALID_PID;
 
-        for (i=0; (s == NATS_OK) && (i<tc); i++)
-            s = natsConnection_PublishString(nc2, "foo", "hello");
-        if (s == NATS_OK)
-            natsConnection_Close(nc2);
+    serverPid = _startServer("nats://127.0.0.1:4222", NULL, true);
+    CHECK_SERVER_STARTED(serverPid);
 
-        for (i=0; (s == NATS_OK) && (i<tc); i++)
-        {
-            natsMsg *msg = NULL;
-            s = natsSubscription_NextMsg(&msg, sub, 1000);
-            natsMsg_Destroy(msg);
-        }
+    test("Test Request should timeout: ")
+    s = natsConnection_ConnectTo(&nc, NATS_DEFAULT_URL);
+    IFOK(s, natsConnection_RequestString(&msg, nc, "foo", "bar", 500));
+    testCond(serverVersionAtLeast(2, 2, 0) ? (s == NATS_NO_RESPONDERS) : (s == NATS_TIMEOUT));
 
-        natsConnection_Destroy(nc2);
-        nc2 = NULL;
-        natsSubscription_Destroy(sub);
-        sub = NULL;
-        natsConnection_Destroy(nc1);
-        nc1 = NULL;
-    }
-    testCond(s == NATS_OK);
+    natsConnection_Destroy(nc);
 
-    _stopServer(pid);
+    _stopServer(serverPid);
 }
 
 static void
-test_QueueSubscriber(void)
+test_Request(void)
 {
     natsStatus          s;
     natsConnection      *nc       = NULL;
-    natsSubscription    *s1       = NULL;
-    natsSubscription    *s2       = NULL;
+    natsSubscription    *sub      = NULL;
     natsMsg             *msg      = NULL;
-    uint64_t            r1        = 0;
-    uint64_t            r2        = 0;
-    float               v         = 1000.0 * 0.15;
-    int64_t             d1;
-    int64_t             d2;
+    natsMsg             *req      = NULL;
     natsPid             serverPid = NATS_INVALID_PID;
-    const char          *string   = "Hello World";
+    struct threadArg    arg;
+    int                 i;
+
+    s = _createDefaultThreadArgsForCbTests(&arg);
+    if ( s != NATS_OK)
+        FAIL("Unable to setup test!");
+
+    arg.string = "I will help you";
+    arg.status = NATS_OK;
+    arg.control= 4;
 
     serverPid = _startServer("nats://127.0.0.1:4222", NULL, true);
     CHECK_SERVER_STARTED(serverPid);
 
-    test("Test QueueSubscriber receive correct amount: ");
+    test("Connect and subscribe: ");
     s = natsConnection_ConnectTo(&nc, NATS_DEFAULT_URL);
-    IFOK(s, natsConnection_QueueSubscribeSync(&s1, nc, "foo", "bar"));
-    IFOK(s, natsConnection_QueueSubscribeSync(&s2, nc, "foo", "bar"));
-    IFOK(s, natsConnection_PublishString(nc, "foo", string));
-    IFOK(s, natsConnection_Flush(nc));
-    IFOK(s, natsSubscription_QueuedMsgs(s1, &r1));
-    IFOK(s, natsSubscription_QueuedMsgs(s2, &r2));
-    testCond((s == NATS_OK)
-             && (r1 + r2 == 1));
+    IFOK(s, natsConnection_Subscribe(&sub, nc, "foo", _recvTestString, (void*) &arg));
+    testCond(s == NATS_OK);
 
-    (void)natsSubscription_NextMsg(&msg, s1, 0);
-    natsMsg_Destroy(msg);
-    msg = NULL;
+    test("Test Request: ")
+    s = natsConnection_RequestString(&msg, nc, "foo", "help", 500);
+
+    natsMutex_Lock(arg.m);
+    while ((s != NATS_TIMEOUT) && !arg.msgReceived)
+        s = natsCondition_TimedWait(arg.c, arg.m, 2000);
+    IFOK(s, arg.status);
+    natsMutex_Unlock(arg.m);
+
+    testCond((s == NATS_OK)
+             && (msg != NULL)
+             && (strncmp(arg.string,
+                         natsMsg_GetData(msg),
+                         natsMsg_GetDataLength(msg)) == 0));
 
-    (void)natsSubscription_NextMsg(&msg, s2, 0);
     natsMsg_Destroy(msg);
     msg = NULL;
 
-    test("Test correct amount when more messages are sent: ");
-    for (int i=0; (s == NATS_OK) && (i<1000); i++)
-        s = natsConnection_PublishString(nc, "foo", string);
+    test("Create req message: ");
+    s = natsMsg_Create(&req, "foo", NULL, "help", 4);
+    testCond(s == NATS_OK);
 
-    IFOK(s, natsConnection_Flush(nc));
+    test("Test RequestMsg: ");
+    s = natsConnection_RequestMsg(&msg, nc, req, 500);
 
-    r1 = r2 = 0;
+    natsMutex_Lock(arg.m);
+    while ((s != NATS_TIMEOUT) && !arg.msgReceived)
+        s = natsCondition_TimedWait(arg.c, arg.m, 2000);
+    IFOK(s, arg.status);
+    natsMutex_Unlock(arg.m);
 
-    IFOK(s, natsSubscription_QueuedMsgs(s1, &r1));
-    IFOK(s, natsSubscription_QueuedMsgs(s2, &r2));
+    testCond((s == NATS_OK)
+             && (msg != NULL)
+             && (strncmp(arg.string,
+                         natsMsg_GetData(msg),
+                         natsMsg_GetDataLength(msg)) == 0));
 
-    testCond((s == NATS_OK) && (r1 + r2 == 1000));
+    natsMsg_Destroy(msg);
+    msg = NULL;
+    natsMsg_Destroy(req);
+    req = NULL;
 
-    test("Variance acceptable: ");
-    d1 = 500 - r1;
-    if (d1 < 0)
-        d1 *= -1;
+    natsMutex_Lock(arg.m);
+    arg.control = 11;
+    natsMutex_Unlock(arg.m);
 
-    d2 = 500 - r1;
-    if (d2 < 0)
-        d2 *= -1;
+    test("Race on timeout: ");
+    for (i=0; (s == NATS_OK) && (i<100); i++)
+    {
+        s = natsConnection_Request(&msg, nc, "foo", "help!", 5, 1);
+        // Make sure that we get either OK with msg != NULL
+        // or TIMEOUT but with msg == NULL
+        if (s == NATS_OK)
+        {
+            if (msg == NULL)
+                s = NATS_ERR;
+            else
+            {
+                natsMsg_Destroy(msg);
+                msg = NULL;
+            }
+        }
+        else if ((s == NATS_TIMEOUT) && (msg == NULL))
+        {
+            s = NATS_OK;
+            nats_clearLastError();
+        }
+        // else if timeout and msg != NULL, that is a bug!
+    }
+    testCond(s == NATS_OK);
 
-    testCond((d1 <= v) && (d2 <= v));
+    // Ensure the last callback returns to avoid accessing data that has been freed.
+    natsMutex_Lock(arg.m);
+    s = NATS_OK;
+    while ((s != NATS_TIMEOUT) && (arg.sum != 100))
+        natsCondition_TimedWait(arg.c, arg.m, 2000);
+    natsMutex_Unlock(arg.m);
 
-    natsSubscription_Destroy(s1);
-    natsSubscription_Destroy(s2);
+    natsSubscription_Destroy(sub);
     natsConnection_Destroy(nc);
 
+    _destroyDefaultThreadArgs(&arg);
+
     _stopServer(serverPid);
 }
 
 static void
-test_ReplyArg(void)
+test_RequestNoBody(void)
 {
     natsStatus          s;
     natsConnection      *nc       = NULL;
     natsSubscription    *sub      = NULL;
+    natsMsg             *msg      = NULL;
     natsPid             serverPid = NATS_INVALID_PID;
     struct threadArg    arg;
 
@@ -10579,28 +13117,38 @@ test_ReplyArg(void)
     if ( s != NATS_OK)
         FAIL("Unable to setup test!");
 
-    arg.string = "bar";
+    arg.string = "I will help you";
     arg.status = NATS_OK;
-    arg.control= 2;
+    arg.control= 4;
 
     serverPid = _startServer("nats://127.0.0.1:4222", NULL, true);
     CHECK_SERVER_STARTED(serverPid);
 
-    test("Test for correct Reply arg in callback: ")
+    test("Connect and subscribe: ");
     s = natsConnection_ConnectTo(&nc, NATS_DEFAULT_URL);
-    IFOK(s, natsConnection_Subscribe(&sub, nc, "foo", _recvTestString,
-                                     (void*) &arg));
-    IFOK(s, natsConnection_PublishRequestString(nc, "foo", "bar", "hello"));
+    IFOK(s, natsConnection_Subscribe(&sub, nc, "foo", _recvTestString, (void*) &arg));
+    testCond(s == NATS_OK);
+
+    test("Test Request with no body content: ")
+    s = natsConnection_RequestString(&msg, nc, "foo", NULL, 500);
 
     natsMutex_Lock(arg.m);
-    while ((s != NATS_TIMEOUT) && !arg.msgReceived)
-        s = natsCondition_TimedWait(arg.c, arg.m, 1500);
+    while ((s != NATS_TIMEOUT)
+           && !arg.msgReceived)
+    {
+        s = natsCondition_TimedWait(arg.c, arg.m, 2000);
+    }
     natsMutex_Unlock(arg.m);
 
     IFOK(s, arg.status);
 
-    testCond(s == NATS_OK);
+    testCond((s == NATS_OK)
+             && (msg != NULL)
+             && (strncmp(arg.string,
+                         natsMsg_GetData(msg),
+                         natsMsg_GetDataLength(msg)) == 0));
 
+    natsMsg_Destroy(msg);
     natsSubscription_Destroy(sub);
     natsConnection_Destroy(nc);
 
@@ -10610,41 +13158,125 @@ test_ReplyArg(void)
 }
 
 static void
-test_SyncReplyArg(void)
+_serverForMuxWithMappedSubject(void *closure)
+{
+    natsStatus          s = NATS_OK;
+    natsSock            sock = NATS_SOCK_INVALID;
+    struct threadArg    *arg = (struct threadArg*) closure;
+    natsSockCtx         ctx;
+
+    memset(&ctx, 0, sizeof(natsSockCtx));
+
+    s = _startMockupServer(&sock, "127.0.0.1", "4222");
+    natsMutex_Lock(arg->m);
+    arg->status = s;
+    natsCondition_Signal(arg->c);
+    natsMutex_Unlock(arg->m);
+
+    if (((ctx.fd = accept(sock, NULL, NULL)) == NATS_SOCK_INVALID)
+            || (natsSock_SetCommonTcpOptions(ctx.fd) != NATS_OK))
+    {
+        s = NATS_SYS_ERROR;
+    }
+    if (s == NATS_OK)
+    {
+        char info[1024];
+
+        snprintf(info, sizeof(info), "%s", "INFO {\"server_id\":\"22\",\"version\":\"latest\",\"go\":\"latest\",\"port\":4222,\"max_payload\":1048576}\r\n");
+
+        // Send INFO.
+        s = natsSock_WriteFully(&ctx, info, (int) strlen(info));
+    }
+    if (s == NATS_OK)
+    {
+        char buffer[1024];
+
+        memset(buffer, 0, sizeof(buffer));
+
+        // Read connect and ping commands sent from the client
+        s = natsSock_ReadLine(&ctx, buffer, sizeof(buffer));
+        IFOK(s, natsSock_ReadLine(&ctx, buffer, sizeof(buffer)));
+
+        // Send PONG
+        IFOK(s, natsSock_WriteFully(&ctx, _PONG_PROTO_, _PONG_PROTO_LEN_));
+
+        // Now wait for the SUB proto and the Request
+        IFOK(s, natsSock_ReadLine(&ctx, buffer, sizeof(buffer)));
+        IFOK(s, natsSock_ReadLine(&ctx, buffer, sizeof(buffer)));
+
+        // Send the reply on a different subject
+        IFOK(s, natsSock_WriteFully(&ctx, "MSG bar 1 2\r\nok\r\n", 17));
+        if (s == NATS_OK)
+        {
+            // Wait for client to tell us it is done
+            natsMutex_Lock(arg->m);
+            while ((s != NATS_TIMEOUT) && !(arg->done))
+                s = natsCondition_TimedWait(arg->c, arg->m, 10000);
+            natsMutex_Unlock(arg->m);
+        }
+        natsSock_Close(ctx.fd);
+    }
+    natsSock_Close(sock);
+}
+
+static void
+test_RequestMuxWithMappedSubject(void)
 {
     natsStatus          s;
-    natsConnection      *nc       = NULL;
-    natsSubscription    *sub      = NULL;
-    natsMsg             *msg      = NULL;
-    natsPid             serverPid = NATS_INVALID_PID;
+    natsConnection      *nc  = NULL;
+    natsMsg             *msg = NULL;
+    natsThread          *t   = NULL;
+    struct threadArg    arg;
 
-    serverPid = _startServer("nats://127.0.0.1:4222", NULL, true);
-    CHECK_SERVER_STARTED(serverPid);
+    s = _createDefaultThreadArgsForCbTests(&arg);
+    if ( s != NATS_OK)
+        FAIL("Unable to setup test!");
 
-    test("Test for correct Reply arg in msg: ")
+    test("Start server: ");
+    arg.status = NATS_ERR;
+    s = natsThread_Create(&t, _serverForMuxWithMappedSubject, (void*) &arg);
+    if (s == NATS_OK)
+    {
+        // Wait for server to be ready
+        natsMutex_Lock(arg.m);
+        while ((s != NATS_TIMEOUT) && (arg.status != NATS_OK))
+            s = natsCondition_TimedWait(arg.c, arg.m, 2000);
+        s = arg.status;
+        natsMutex_Unlock(arg.m);
+    }
+    testCond(s == NATS_OK);
+
+    test("Connect: ");
     s = natsConnection_ConnectTo(&nc, NATS_DEFAULT_URL);
-    IFOK(s, natsConnection_SubscribeSync(&sub, nc, "foo"));
-    IFOK(s, natsConnection_PublishRequestString(nc, "foo", "bar", "hello"));
-    IFOK(s, natsSubscription_NextMsg(&msg, sub, 1000));
+    testCond(s == NATS_OK);
 
-    testCond((s == NATS_OK)
-             && (msg != NULL)
-             && (natsMsg_GetReply(msg) != NULL)
-             && (strcmp("bar", natsMsg_GetReply(msg)) == 0));
+    test("Request: ");
+    s = natsConnection_RequestString(&msg, nc, "foo", "help", 1000);
+    testCond(s == NATS_OK);
 
     natsMsg_Destroy(msg);
-    natsSubscription_Destroy(sub);
     natsConnection_Destroy(nc);
 
-    _stopServer(serverPid);
+    // Notify mock server we are done
+    natsMutex_Lock(arg.m);
+    arg.done = true;
+    natsCondition_Signal(arg.c);
+    natsMutex_Unlock(arg.m);
+
+    natsThread_Join(t);
+    natsThread_Destroy(t);
+
+    _destroyDefaultThreadArgs(&arg);
 }
 
 static void
-test_Unsubscribe(void)
+test_OldRequest(void)
 {
     natsStatus          s;
     natsConnection      *nc       = NULL;
+    natsOptions         *opts     = NULL;
     natsSubscription    *sub      = NULL;
+    natsMsg             *msg      = NULL;
     natsPid             serverPid = NATS_INVALID_PID;
     struct threadArg    arg;
 
@@ -10652,293 +13284,330 @@ test_Unsubscribe(void)
     if ( s != NATS_OK)
         FAIL("Unable to setup test!");
 
-    arg.string = "bar";
+    arg.string = "I will help you";
     arg.status = NATS_OK;
-    arg.control= 3;
-    arg.sum    = 0;
+    arg.control= 4;
 
     serverPid = _startServer("nats://127.0.0.1:4222", NULL, true);
     CHECK_SERVER_STARTED(serverPid);
 
-    test("Connect and create sub: ")
-    s = natsConnection_ConnectTo(&nc, NATS_DEFAULT_URL);
+    test("Setup: ");
+    s = natsOptions_Create(&opts);
+    IFOK(s, natsOptions_UseOldRequestStyle(opts, true));
+    IFOK(s, natsConnection_Connect(&nc, opts));
     IFOK(s, natsConnection_Subscribe(&sub, nc, "foo", _recvTestString, (void*) &arg));
     testCond(s == NATS_OK);
 
-    test("Send messages and flush: ");
-    for (int i=0; (s == NATS_OK) && (i<20); i++)
-        s = natsConnection_PublishString(nc, "foo", "hello");
-    IFOK(s, natsConnection_Flush(nc));
-    testCond(s == NATS_OK);
+    test("Test Old Request Style: ")
+    s = natsConnection_RequestString(&msg, nc, "foo", "help", 500);
 
-    test("Unsubscribe from callback: ");
     natsMutex_Lock(arg.m);
-    while ((s != NATS_TIMEOUT) && !arg.msgReceived)
+    while ((s != NATS_TIMEOUT)
+           && !arg.msgReceived)
+    {
         s = natsCondition_TimedWait(arg.c, arg.m, 2000);
+    }
     natsMutex_Unlock(arg.m);
+
     IFOK(s, arg.status);
-    testCond(s == NATS_OK);
 
-    test("No more callback: ");
-    nats_Sleep(250);
-    natsMutex_Lock(arg.m);
-    testCond((s == NATS_OK) && (arg.sum == 10));
-    natsMutex_Unlock(arg.m);
+    testCond((s == NATS_OK)
+             && (msg != NULL)
+             && (strncmp(arg.string,
+                         natsMsg_GetData(msg),
+                         natsMsg_GetDataLength(msg)) == 0));
 
+    natsMsg_Destroy(msg);
     natsSubscription_Destroy(sub);
-    sub = NULL;
-
-    test("Create new sub: ");
-    s = natsConnection_Subscribe(&sub, nc, "foo", _recvTestString, (void*) &arg);
-    testCond(s == NATS_OK);
-
-    test("Unsubscribe after connection close: ");
     natsConnection_Destroy(nc);
-    s = natsSubscription_Unsubscribe(sub);
-    testCond(s == NATS_CONNECTION_CLOSED);
+    natsOptions_Destroy(opts);
 
-    natsSubscription_Destroy(sub);
     _destroyDefaultThreadArgs(&arg);
 
     _stopServer(serverPid);
 }
 
 static void
-test_DoubleUnsubscribe(void)
+_sendRequest(void *closure)
 {
+    struct threadArg    *arg = (struct threadArg*) closure;
     natsStatus          s;
-    natsConnection      *nc       = NULL;
-    natsSubscription    *sub      = NULL;
-    natsPid             serverPid = NATS_INVALID_PID;
-
-    serverPid = _startServer("nats://127.0.0.1:4222", NULL, true);
-    CHECK_SERVER_STARTED(serverPid);
-
-    test("Connect and create subscription: ");
-    s = natsConnection_ConnectTo(&nc, NATS_DEFAULT_URL);
-    IFOK(s, natsConnection_SubscribeSync(&sub, nc, "foo"));
-    testCond(s == NATS_OK);
-
-    test("Unsubscribe: ");
-    s = natsSubscription_Unsubscribe(sub);
-    testCond(s == NATS_OK);
-
-    test("Double Unsubscribe: ");
-    s = natsSubscription_Unsubscribe(sub);
-    testCond(s == NATS_INVALID_SUBSCRIPTION);
+    natsMsg             *msg = NULL;
 
-    natsSubscription_Destroy(sub);
-    natsConnection_Destroy(nc);
+    nats_Sleep(250);
 
-    _stopServer(serverPid);
+    s = natsConnection_RequestString(&msg, arg->nc, "foo", "Help!", 2000);
+    natsMutex_Lock(arg->m);
+    if ((s == NATS_OK)
+            && (msg != NULL)
+            && strncmp(arg->string,
+                       natsMsg_GetData(msg),
+                       natsMsg_GetDataLength(msg)) == 0)
+    {
+        arg->sum++;
+    }
+    else
+    {
+        arg->status = NATS_ERR;
+    }
+    natsMutex_Unlock(arg->m);
+    natsMsg_Destroy(msg);
 }
 
 static void
-test_SubRemovedWhileProcessingMsg(void)
+test_SimultaneousRequest(void)
 {
     natsStatus          s;
-    natsConnection      *nc       = NULL;
-    natsOptions         *opts     = NULL;
-    natsSubscription    *sub      = NULL;
-    natsPid             serverPid = NATS_INVALID_PID;
-
-    serverPid = _startServer("nats://127.0.0.1:4222", NULL, true);
-    CHECK_SERVER_STARTED(serverPid);
-
-    test("Connect and create sub: ")
-    s = natsConnection_ConnectTo(&nc, NATS_DEFAULT_URL);
-    IFOK(s, natsConnection_SubscribeSync(&sub, nc, "foo"));
-    testCond(s == NATS_OK);
+     natsConnection      *nc       = NULL;
+     natsSubscription    *sub      = NULL;
+     natsThread          *threads[10];
+     natsPid             serverPid = NATS_INVALID_PID;
+     struct threadArg    arg;
+     int                 i;
 
-    // Lock the sub so that we can remove while the connection
-    // readLoop is trying to push to the sub.
-    natsSub_Lock(sub);
+     s = _createDefaultThreadArgsForCbTests(&arg);
+     if ( s != NATS_OK)
+         FAIL("Unable to setup test!");
 
-    test("Send message: ");
-    s = natsConnection_PublishString(nc, "foo", "hello");
-    testCond(s == NATS_OK);
+     arg.string = "ok";
+     arg.status = NATS_OK;
+     arg.control= 4;
 
-    test("Close sub: ");
-    natsSub_Unlock(sub);
-    natsSub_close(sub, false);
-    testCond(s == NATS_OK);
+     serverPid = _startServer("nats://127.0.0.1:4222", NULL, true);
+     CHECK_SERVER_STARTED(serverPid);
 
-    test("Check msg not given: ");
-    natsSub_Lock(sub);
-    testCond(sub->msgList.msgs == 0);
-    natsSub_Unlock(sub);
+     s = natsConnection_ConnectTo(&nc, NATS_DEFAULT_URL);
+     if (s == NATS_OK)
+     {
+         arg.nc = nc;
+         s = natsConnection_Subscribe(&sub, nc, "foo", _recvTestString, (void*) &arg);
+     }
 
-    natsSubscription_Destroy(sub);
-    sub = NULL;
-    natsConnection_Destroy(nc);
-    nc = NULL;
+     for (i=0; i<10; i++)
+         threads[i] = NULL;
 
-    // Repeat with global message delivery option.
-    test("Set global delivery option: ");
-    s = natsOptions_Create(&opts);
-    IFOK(s, natsOptions_UseGlobalMessageDelivery(opts, true));
-    testCond(s == NATS_OK);
+     test("Test simultaneous requests: ")
+     for (i=0; (s == NATS_OK) && (i<10); i++)
+         s = natsThread_Create(&(threads[i]), _sendRequest, (void*) &arg);
 
-    test("Connect and create sub: ");
-    s = natsConnection_Connect(&nc, opts);
-    IFOK(s, natsConnection_Subscribe(&sub, nc, "foo", _dummyMsgHandler, NULL));
-    testCond(s == NATS_OK);
+     for (i=0; i<10; i++)
+     {
+         if (threads[i] != NULL)
+         {
+             natsThread_Join(threads[i]);
+             natsThread_Destroy(threads[i]);
+         }
+     }
 
-    natsSub_Lock(sub);
-    natsMutex_Lock(sub->libDlvWorker->lock);
-    test("Send message: ");
-    s = natsConnection_PublishString(nc, "foo", "hello");
-    testCond(s == NATS_OK);
+     natsMutex_Lock(arg.m);
+     if ((s != NATS_OK)
+             || ((s = arg.status) != NATS_OK)
+             || (arg.sum != 10))
+     {
+         s = NATS_ERR;
+     }
+     natsMutex_Unlock(arg.m);
 
-    test("Close sub: ");
-    natsMutex_Unlock(sub->libDlvWorker->lock);
-    natsSub_Unlock(sub);
-    natsSub_close(sub, false);
-    testCond(s == NATS_OK);
+     testCond(s == NATS_OK);
 
-    test("Check msg not given: ");
-    natsSub_Lock(sub);
-    natsMutex_Lock(sub->libDlvWorker->lock);
-    testCond(sub->msgList.msgs == 0);
-    natsMutex_Unlock(sub->libDlvWorker->lock);
-    natsSub_Unlock(sub);
+     natsSubscription_Destroy(sub);
+     natsConnection_Destroy(nc);
 
-    natsSubscription_Destroy(sub);
-    natsConnection_Destroy(nc);
-    natsOptions_Destroy(opts);
+     _destroyDefaultThreadArgs(&arg);
 
-    _stopServer(serverPid);
+     _stopServer(serverPid);
 }
 
 static void
-test_RequestTimeout(void)
+test_RequestClose(void)
 {
     natsStatus          s;
     natsConnection      *nc       = NULL;
+    natsSubscription    *sub      = NULL;
     natsMsg             *msg      = NULL;
+    natsThread          *t        = NULL;
     natsPid             serverPid = NATS_INVALID_PID;
 
     serverPid = _startServer("nats://127.0.0.1:4222", NULL, true);
     CHECK_SERVER_STARTED(serverPid);
 
-    test("Test Request should timeout: ")
+    // Because of no responders, we would get an immediate timeout.
+    // So we need to create a sync subscriber that is simply not
+    // going to send a reply back.
+
     s = natsConnection_ConnectTo(&nc, NATS_DEFAULT_URL);
-    IFOK(s, natsConnection_RequestString(&msg, nc, "foo", "bar", 500));
-    testCond(serverVersionAtLeast(2, 2, 0) ? (s == NATS_NO_RESPONDERS) : (s == NATS_TIMEOUT));
+    test("Test Request is kicked out with a connection close: ")
+    IFOK(s, natsThread_Create(&t, _closeConnWithDelay, (void*) nc));
+    IFOK(s, natsConnection_SubscribeSync(&sub, nc, "foo"));
+    IFOK(s, natsConnection_RequestString(&msg, nc, "foo", "help", 2000));
+
+    if (t != NULL)
+    {
+        natsThread_Join(t);
+        natsThread_Destroy(t);
+    }
+    testCond((s == NATS_CONNECTION_CLOSED) && (msg == NULL));
 
+    natsMsg_Destroy(msg);
+    natsSubscription_Destroy(sub);
     natsConnection_Destroy(nc);
 
     _stopServer(serverPid);
 }
 
 static void
-test_Request(void)
+_echoRequestHandler(natsConnection *nc, natsSubscription *sub, natsMsg *msg, void *closure)
+{
+    natsConnection_Publish(nc, natsMsg_GetReply(msg), natsMsg_GetData(msg),
+                           natsMsg_GetDataLength(msg));
+    natsMsg_Destroy(msg);
+}
+
+static void
+_asyncReplyHandler(natsConnection *nc, natsMsg *reply, natsStatus status, void *closure)
+{
+    struct threadArg *arg = (struct threadArg*) closure;
+
+    natsMutex_Lock(arg->m);
+    if (status == NATS_OK)
+    {
+        if ((reply == NULL) || (atoi(natsMsg_GetData(reply)) != arg->sum))
+            arg->status = NATS_ERR;
+        arg->sum++;
+    }
+    else
+    {
+        if (reply != NULL)
+            arg->status = NATS_ERR;
+        arg->results[0] = (int) status;
+        arg->results[1]++;
+    }
+    natsCondition_Broadcast(arg->c);
+    natsMutex_Unlock(arg->m);
+
+    natsMsg_Destroy(reply);
+}
+
+static void
+test_RequestAsync(void)
 {
     natsStatus          s;
     natsConnection      *nc       = NULL;
+    natsOptions         *opts     = NULL;
     natsSubscription    *sub      = NULL;
-    natsMsg             *msg      = NULL;
-    natsMsg             *req      = NULL;
+    natsSubscription    *sub2     = NULL;
+    natsRequest         *req      = NULL;
     natsPid             serverPid = NATS_INVALID_PID;
     struct threadArg    arg;
+    char                data[16];
     int                 i;
 
     s = _createDefaultThreadArgsForCbTests(&arg);
-    if ( s != NATS_OK)
-        FAIL("Unable to setup test!");
-
-    arg.string = "I will help you";
-    arg.status = NATS_OK;
-    arg.control= 4;
+    if (s != NATS_OK)
+        FAIL("Unable to setup test");
 
     serverPid = _startServer("nats://127.0.0.1:4222", NULL, true);
     CHECK_SERVER_STARTED(serverPid);
 
-    test("Connect and subscribe: ");
-    s = natsConnection_ConnectTo(&nc, NATS_DEFAULT_URL);
-    IFOK(s, natsConnection_Subscribe(&sub, nc, "foo", _recvTestString, (void*) &arg));
-    testCond(s == NATS_OK);
+    s = natsOptions_Create(&opts);
+    IFOK(s, natsOptions_SetURL(opts, NATS_DEFAULT_URL));
+    IFOK(s, natsConnection_Connect(&nc, opts));
+    IFOK(s, natsConnection_Subscribe(&sub, nc, "echo", _echoRequestHandler, NULL));
+    IFOK(s, natsConnection_SubscribeSync(&sub2, nc, "silent"));
+    IFOK(s, natsConnection_Flush(nc));
+    if (s != NATS_OK)
+        FAIL("Unable to setup test");
 
-    test("Test Request: ")
-    s = natsConnection_RequestString(&msg, nc, "foo", "help", 500);
+    test("Invalid args: ");
+    s = natsConnection_RequestAsync(&req, NULL, "echo", NULL, 0, 1000, _asyncReplyHandler, &arg);
+    if (s == NATS_INVALID_ARG)
+        s = natsConnection_RequestAsync(&req, nc, "echo", NULL, 0, 1000, NULL, &arg);
+    if (s == NATS_INVALID_ARG)
+        s = natsConnection_RequestAsync(&req, nc, "echo", NULL, 0, 0, _asyncReplyHandler, &arg);
+    if (s == NATS_INVALID_ARG)
+        s = natsConnection_RequestMsgAsync(&req, nc, NULL, 1000, _asyncReplyHandler, &arg);
+    if (s == NATS_INVALID_ARG)
+        s = natsRequest_Cancel(NULL);
+    testCond((s == NATS_INVALID_ARG) && (req == NULL));
+    nats_clearLastError();
 
+    test("Many requests in flight: ");
+    s = NATS_OK;
+    for (i=0; (s == NATS_OK) && (i<1000); i++)
+    {
+        snprintf(data, sizeof(data), "%d", i);
+        s = natsConnection_RequestAsync(NULL, nc, "echo", data, (int) strlen(data),
+                                        5000, _asyncReplyHandler, &arg);
+    }
     natsMutex_Lock(arg.m);
-    while ((s != NATS_TIMEOUT) && !arg.msgReceived)
-        s = natsCondition_TimedWait(arg.c, arg.m, 2000);
+    while ((s != NATS_TIMEOUT) && (arg.sum != 1000))
+        s = natsCondition_TimedWait(arg.c, arg.m, 5000);
     IFOK(s, arg.status);
+    testCond((s == NATS_OK) && (arg.results[1] == 0));
     natsMutex_Unlock(arg.m);
 
-    testCond((s == NATS_OK)
-             && (msg != NULL)
-             && (strncmp(arg.string,
-                         natsMsg_GetData(msg),
-                         natsMsg_GetDataLength(msg)) == 0));
-
-    natsMsg_Destroy(msg);
-    msg = NULL;
-
-    test("Create req message: ");
-    s = natsMsg_Create(&req, "foo", NULL, "help", 4);
-    testCond(s == NATS_OK);
-
-    test("Test RequestMsg: ");
-    s = natsConnection_RequestMsg(&msg, nc, req, 500);
-
+    test("Timeout: ");
+    s = natsConnection_RequestAsync(&req, nc, "silent", "help", 4, 50, _asyncReplyHandler, &arg);
     natsMutex_Lock(arg.m);
-    while ((s != NATS_TIMEOUT) && !arg.msgReceived)
+    while ((s != NATS_TIMEOUT) && (arg.results[1] != 1))
         s = natsCondition_TimedWait(arg.c, arg.m, 2000);
     IFOK(s, arg.status);
+    testCond((s == NATS_OK) && (arg.results[0] == NATS_TIMEOUT));
     natsMutex_Unlock(arg.m);
 
-    testCond((s == NATS_OK)
-             && (msg != NULL)
-             && (strncmp(arg.string,
-                         natsMsg_GetData(msg),
-                         natsMsg_GetDataLength(msg)) == 0));
-
-    natsMsg_Destroy(msg);
-    msg = NULL;
-    natsMsg_Destroy(req);
+    test("Cancel completed request fails: ");
+    s = natsRequest_Cancel(req);
+    testCond(s == NATS_ILLEGAL_STATE);
+    nats_clearLastError();
+    natsRequest_Destroy(req);
     req = NULL;
 
+    test("No responders: ");
+    s = natsConnection_RequestAsync(NULL, nc, "nobody", "help", 4, 2000, _asyncReplyHandler, &arg);
     natsMutex_Lock(arg.m);
-    arg.control = 11;
+    while ((s != NATS_TIMEOUT) && (arg.results[1] != 2))
+        s = natsCondition_TimedWait(arg.c, arg.m, 2000);
+    IFOK(s, arg.status);
+    testCond((s == NATS_OK) && (arg.results[0] == NATS_NO_RESPONDERS));
     natsMutex_Unlock(arg.m);
 
-    test("Race on timeout: ");
-    for (i=0; (s == NATS_OK) && (i<100); i++)
-    {
-        s = natsConnection_Request(&msg, nc, "foo", "help!", 5, 1);
-        // Make sure that we get either OK with msg != NULL
-        // or TIMEOUT but with msg == NULL
-        if (s == NATS_OK)
-        {
-            if (msg == NULL)
-                s = NATS_ERR;
-            else
-            {
-                natsMsg_Destroy(msg);
-                msg = NULL;
-            }
-        }
-        else if ((s == NATS_TIMEOUT) && (msg == NULL))
-        {
-            s = NATS_OK;
-            nats_clearLastError();
-        }
-        // else if timeout and msg != NULL, that is a bug!
-    }
-    testCond(s == NATS_OK);
+    test("Cancel: ");
+    s = natsConnection_RequestAsync(&req, nc, "silent", "help", 4, 100, _asyncReplyHandler, &arg);
+    IFOK(s, natsRequest_Cancel(req));
+    if (s == NATS_OK)
+        nats_Sleep(300);
+    natsMutex_Lock(arg.m);
+    testCond((s == NATS_OK) && (arg.results[1] == 2));
+    natsMutex_Unlock(arg.m);
 
-    // Ensure the last callback returns to avoid accessing data that has been freed.
+    test("Cancel twice fails: ");
+    s = natsRequest_Cancel(req);
+    testCond(s == NATS_ILLEGAL_STATE);
+    nats_clearLastError();
+    natsRequest_Destroy(req);
+    req = NULL;
+
+    test("Completed on close: ");
+    s = natsConnection_RequestAsync(&req, nc, "silent", "help", 4, 60000, _asyncReplyHandler, &arg);
+    if (s == NATS_OK)
+        natsConnection_Close(nc);
     natsMutex_Lock(arg.m);
-    s = NATS_OK;
-    while ((s != NATS_TIMEOUT) && (arg.sum != 100))
-        natsCondition_TimedWait(arg.c, arg.m, 2000);
+    while ((s != NATS_TIMEOUT) && (arg.results[1] != 3))
+        s = natsCondition_TimedWait(arg.c, arg.m, 2000);
+    IFOK(s, arg.status);
+    testCond((s == NATS_OK) && (arg.results[0] == NATS_CONNECTION_CLOSED));
     natsMutex_Unlock(arg.m);
+    natsRequest_Destroy(req);
+
+    test("Closed connection: ");
+    s = natsConnection_RequestAsync(NULL, nc, "echo", "help", 4, 1000, _asyncReplyHandler, &arg);
+    testCond(s == NATS_CONNECTION_CLOSED);
+    nats_clearLastError();
 
     natsSubscription_Destroy(sub);
+    natsSubscription_Destroy(sub2);
     natsConnection_Destroy(nc);
+    natsOptions_Destroy(opts);
 
     _destroyDefaultThreadArgs(&arg);
 
@@ -10946,223 +13615,236 @@ test_Request(void)
 }
 
 static void
-test_RequestNoBody(void)
+test_RequestInlineResponses(void)
 {
     natsStatus          s;
     natsConnection      *nc       = NULL;
+    natsOptions         *opts     = NULL;
     natsSubscription    *sub      = NULL;
     natsMsg             *msg      = NULL;
     natsPid             serverPid = NATS_INVALID_PID;
     struct threadArg    arg;
+    char                data[16];
+    int                 i;
 
     s = _createDefaultThreadArgsForCbTests(&arg);
-    if ( s != NATS_OK)
-        FAIL("Unable to setup test!");
-
-    arg.string = "I will help you";
-    arg.status = NATS_OK;
-    arg.control= 4;
+    if (s != NATS_OK)
+        FAIL("Unable to setup test");
 
     serverPid = _startServer("nats://127.0.0.1:4222", NULL, true);
     CHECK_SERVER_STARTED(serverPid);
 
-    test("Connect and subscribe: ");
-    s = natsConnection_ConnectTo(&nc, NATS_DEFAULT_URL);
-    IFOK(s, natsConnection_Subscribe(&sub, nc, "foo", _recvTestString, (void*) &arg));
-    testCond(s == NATS_OK);
-
-    test("Test Request with no body content: ")
-    s = natsConnection_RequestString(&msg, nc, "foo", NULL, 500);
-
-    natsMutex_Lock(arg.m);
-    while ((s != NATS_TIMEOUT)
-           && !arg.msgReceived)
-    {
-        s = natsCondition_TimedWait(arg.c, arg.m, 2000);
-    }
-    natsMutex_Unlock(arg.m);
-
-    IFOK(s, arg.status);
-
-    testCond((s == NATS_OK)
-             && (msg != NULL)
-             && (strncmp(arg.string,
-                         natsMsg_GetData(msg),
-                         natsMsg_GetDataLength(msg)) == 0));
-
-    natsMsg_Destroy(msg);
-    natsSubscription_Destroy(sub);
-    natsConnection_Destroy(nc);
-
-    _destroyDefaultThreadArgs(&arg);
-
-    _stopServer(serverPid);
-}
-
-static void
-_serverForMuxWithMappedSubject(void *closure)
-{
-    natsStatus          s = NATS_OK;
-    natsSock            sock = NATS_SOCK_INVALID;
-    struct threadArg    *arg = (struct threadArg*) closure;
-    natsSockCtx         ctx;
-
-    memset(&ctx, 0, sizeof(natsSockCtx));
-
-    s = _startMockupServer(&sock, "127.0.0.1", "4222");
-    natsMutex_Lock(arg->m);
-    arg->status = s;
-    natsCondition_Signal(arg->c);
-    natsMutex_Unlock(arg->m);
+    s = natsOptions_Create(&opts);
+    IFOK(s, natsOptions_SetURL(opts, NATS_DEFAULT_URL));
+    IFOK(s, natsOptions_UseInlineResponses(opts, true));
+    IFOK(s, natsConnection_Connect(&nc, opts));
+    IFOK(s, natsConnection_Subscribe(&sub, nc, "echo", _echoRequestHandler, NULL));
+    IFOK(s, natsConnection_Flush(nc));
+    if (s != NATS_OK)
+        FAIL("Unable to setup test");
 
-    if (((ctx.fd = accept(sock, NULL, NULL)) == NATS_SOCK_INVALID)
-            || (natsSock_SetCommonTcpOptions(ctx.fd) != NATS_OK))
+    test("Sync requests: ");
+    for (i=0; (s == NATS_OK) && (i<100); i++)
     {
-        s = NATS_SYS_ERROR;
+        snprintf(data, sizeof(data), "%d", i);
+        s = natsConnection_RequestString(&msg, nc, "echo", data, 1000);
+        if ((s == NATS_OK) && (strcmp(natsMsg_GetData(msg), data) != 0))
+            s = NATS_ERR;
+        natsMsg_Destroy(msg);
+        msg = NULL;
     }
-    if (s == NATS_OK)
-    {
-        char info[1024];
-
-        snprintf(info, sizeof(info), "%s", "INFO {\"server_id\":\"22\",\"version\":\"latest\",\"go\":\"latest\",\"port\":4222,\"max_payload\":1048576}\r\n");
+    testCond(s == NATS_OK);
 
-        // Send INFO.
-        s = natsSock_WriteFully(&ctx, info, (int) strlen(info));
-    }
-    if (s == NATS_OK)
+    test("Responses delivered by the reader: ");
     {
-        char buffer[1024];
-
-        memset(buffer, 0, sizeof(buffer));
-
-        // Read connect and ping commands sent from the client
-        s = natsSock_ReadLine(&ctx, buffer, sizeof(buffer));
-        IFOK(s, natsSock_ReadLine(&ctx, buffer, sizeof(buffer)));
+        int     pending     = -1;
+        int     maxPending  = -1;
+        int64_t delivered   = 0;
 
-        // Send PONG
-        IFOK(s, natsSock_WriteFully(&ctx, _PONG_PROTO_, _PONG_PROTO_LEN_));
-
-        // Now wait for the SUB proto and the Request
-        IFOK(s, natsSock_ReadLine(&ctx, buffer, sizeof(buffer)));
-        IFOK(s, natsSock_ReadLine(&ctx, buffer, sizeof(buffer)));
-
-        // Send the reply on a different subject
-        IFOK(s, natsSock_WriteFully(&ctx, "MSG bar 1 2\r\nok\r\n", 17));
-        if (s == NATS_OK)
-        {
-            // Wait for client to tell us it is done
-            natsMutex_Lock(arg->m);
-            while ((s != NATS_TIMEOUT) && !(arg->done))
-                s = natsCondition_TimedWait(arg->c, arg->m, 10000);
-            natsMutex_Unlock(arg->m);
-        }
-        natsSock_Close(ctx.fd);
+        // Had the responses been queued for the delivery thread, they
+        // would have been pending at some point.
+        s = natsSubscription_GetStats(nc->respMux, &pending, NULL, &maxPending, NULL,
+                                      &delivered, NULL);
+        testCond((s == NATS_OK) && (pending == 0) && (maxPending == 0)
+                 && (delivered == 100));
     }
-    natsSock_Close(sock);
-}
-
-static void
-test_RequestMuxWithMappedSubject(void)
-{
-    natsStatus          s;
-    natsConnection      *nc  = NULL;
-    natsMsg             *msg = NULL;
-    natsThread          *t   = NULL;
-    struct threadArg    arg;
-
-    s = _createDefaultThreadArgsForCbTests(&arg);
-    if ( s != NATS_OK)
-        FAIL("Unable to setup test!");
 
-    test("Start server: ");
-    arg.status = NATS_ERR;
-    s = natsThread_Create(&t, _serverForMuxWithMappedSubject, (void*) &arg);
-    if (s == NATS_OK)
+    test("Async requests: ");
+    for (i=0; (s == NATS_OK) && (i<1000); i++)
     {
-        // Wait for server to be ready
-        natsMutex_Lock(arg.m);
-        while ((s != NATS_TIMEOUT) && (arg.status != NATS_OK))
-            s = natsCondition_TimedWait(arg.c, arg.m, 2000);
-        s = arg.status;
-        natsMutex_Unlock(arg.m);
+        snprintf(data, sizeof(data), "%d", i);
+        s = natsConnection_RequestAsync(NULL, nc, "echo", data, (int) strlen(data),
+                                        5000, _asyncReplyHandler, &arg);
     }
-    testCond(s == NATS_OK);
-
-    test("Connect: ");
-    s = natsConnection_ConnectTo(&nc, NATS_DEFAULT_URL);
-    testCond(s == NATS_OK);
-
-    test("Request: ");
-    s = natsConnection_RequestString(&msg, nc, "foo", "help", 1000);
-    testCond(s == NATS_OK);
+    natsMutex_Lock(arg.m);
+    while ((s != NATS_TIMEOUT) && (arg.sum != 1000))
+        s = natsCondition_TimedWait(arg.c, arg.m, 5000);
+    IFOK(s, arg.status);
+    testCond((s == NATS_OK) && (arg.results[1] == 0));
+    natsMutex_Unlock(arg.m);
 
-    natsMsg_Destroy(msg);
-    natsConnection_Destroy(nc);
+    test("No responders: ");
+    s = natsConnection_RequestString(&msg, nc, "nobody", "help", 1000);
+    testCond((s == NATS_NO_RESPONDERS) && (msg == NULL));
+    nats_clearLastError();
 
-    // Notify mock server we are done
+    test("Async no responders: ");
+    s = natsConnection_RequestAsync(NULL, nc, "nobody", "help", 4, 2000, _asyncReplyHandler, &arg);
     natsMutex_Lock(arg.m);
-    arg.done = true;
-    natsCondition_Signal(arg.c);
+    while ((s != NATS_TIMEOUT) && (arg.results[1] != 1))
+        s = natsCondition_TimedWait(arg.c, arg.m, 2000);
+    IFOK(s, arg.status);
+    testCond((s == NATS_OK) && (arg.results[0] == NATS_NO_RESPONDERS));
     natsMutex_Unlock(arg.m);
 
-    natsThread_Join(t);
-    natsThread_Destroy(t);
+    natsSubscription_Destroy(sub);
+    natsConnection_Destroy(nc);
+    natsOptions_Destroy(opts);
 
     _destroyDefaultThreadArgs(&arg);
+
+    _stopServer(serverPid);
 }
 
 static void
-test_OldRequest(void)
+_routedReplyHandler(natsConnection *nc, natsMsg *reply, natsStatus status, void *closure)
+{
+    struct threadArg *arg = (struct threadArg*) closure;
+
+    natsMutex_Lock(arg->m);
+    if ((status != NATS_OK) || (reply == NULL))
+        arg->status = NATS_ERR;
+    else if (strcmp(natsMsg_GetData(reply), "fallback") == 0)
+        arg->results[0]++;
+    arg->sum++;
+    natsCondition_Broadcast(arg->c);
+    natsMutex_Unlock(arg->m);
+
+    natsMsg_Destroy(reply);
+}
+
+static natsStatus
+_checkRespStripes(natsConnection *nc, int expected)
+{
+    natsStatus  s = NATS_OK;
+    int         i;
+
+    for (i=0; (s == NATS_OK) && (i<NATS_RESP_MAP_STRIPES); i++)
+    {
+        natsMutex_Lock(nc->respMap[i].mu);
+        if (natsHash_Count(nc->respMap[i].map) != expected)
+            s = NATS_ERR;
+        natsMutex_Unlock(nc->respMap[i].mu);
+    }
+    return s;
+}
+
+static natsStatus
+_waitForRoutedReplies(struct threadArg *arg, int expected)
+{
+    natsStatus s = NATS_OK;
+
+    natsMutex_Lock(arg->m);
+    while ((s != NATS_TIMEOUT) && (arg->sum != expected))
+        s = natsCondition_TimedWait(arg->c, arg->m, 2000);
+    IFOK(s, arg->status);
+    natsMutex_Unlock(arg->m);
+
+    return s;
+}
+
+static void
+test_RequestRouting(void)
 {
     natsStatus          s;
     natsConnection      *nc       = NULL;
-    natsOptions         *opts     = NULL;
     natsSubscription    *sub      = NULL;
-    natsMsg             *msg      = NULL;
+    natsMsg             *req      = NULL;
+    natsMsg             *reqs[2]  = {NULL, NULL};
     natsPid             serverPid = NATS_INVALID_PID;
     struct threadArg    arg;
+    char                subj[256];
+    int                 count     = 8 * NATS_RESP_MAP_STRIPES;
+    int                 fallbacks = 0;
+    int                 i;
 
     s = _createDefaultThreadArgsForCbTests(&arg);
-    if ( s != NATS_OK)
-        FAIL("Unable to setup test!");
-
-    arg.string = "I will help you";
-    arg.status = NATS_OK;
-    arg.control= 4;
+    if (s != NATS_OK)
+        FAIL("Unable to setup test");
 
     serverPid = _startServer("nats://127.0.0.1:4222", NULL, true);
     CHECK_SERVER_STARTED(serverPid);
 
-    test("Setup: ");
-    s = natsOptions_Create(&opts);
-    IFOK(s, natsOptions_UseOldRequestStyle(opts, true));
-    IFOK(s, natsConnection_Connect(&nc, opts));
-    IFOK(s, natsConnection_Subscribe(&sub, nc, "foo", _recvTestString, (void*) &arg));
+    // Requests are received here, and answered (or not) by the test.
+    s = natsConnection_ConnectTo(&nc, NATS_DEFAULT_URL);
+    IFOK(s, natsConnection_SubscribeSync(&sub, nc, "svc"));
+    IFOK(s, natsConnection_Flush(nc));
+    if (s != NATS_OK)
+        FAIL("Unable to setup test");
+
+    test("Requests spread across stripes: ");
+    for (i=0; (s == NATS_OK) && (i<count); i++)
+        s = natsConnection_RequestAsync(NULL, nc, "svc", "req", 3, 10000, _routedReplyHandler, &arg);
+    // Request IDs are sequential, so each stripe has the same share.
+    IFOK(s, _checkRespStripes(nc, count / NATS_RESP_MAP_STRIPES));
     testCond(s == NATS_OK);
 
-    test("Test Old Request Style: ")
-    s = natsConnection_RequestString(&msg, nc, "foo", "help", 500);
+    test("Replies routed to their request: ");
+    for (i=0; (s == NATS_OK) && (i<count); i++)
+    {
+        s = natsSubscription_NextMsg(&req, sub, 2000);
+        IFOK(s, natsConnection_PublishString(nc, natsMsg_GetReply(req), "reply"));
+        natsMsg_Destroy(req);
+        req = NULL;
+    }
+    IFOK(s, _waitForRoutedReplies(&arg, count));
+    IFOK(s, _checkRespStripes(nc, 0));
+    testCond(s == NATS_OK);
 
-    natsMutex_Lock(arg.m);
-    while ((s != NATS_TIMEOUT)
-           && !arg.msgReceived)
+    test("Invalid request ID, single request pending: ");
+    s = natsConnection_RequestAsync(NULL, nc, "svc", "req", 3, 10000, _routedReplyHandler, &arg);
+    IFOK(s, natsSubscription_NextMsg(&req, sub, 2000));
+    natsMsg_Destroy(req);
+    req = NULL;
+    if (s == NATS_OK)
     {
-        s = natsCondition_TimedWait(arg.c, arg.m, 2000);
+        // Same prefix, but the last token is not a number. This goes through
+        // the same path as a rewritten subject.
+        snprintf(subj, sizeof(subj), "%s.notanumber", nc->respSub);
+        s = natsConnection_PublishString(nc, subj, "fallback");
     }
+    IFOK(s, _waitForRoutedReplies(&arg, count + 1));
+    IFOK(s, _checkRespStripes(nc, 0));
+    natsMutex_Lock(arg.m);
+    fallbacks = arg.results[0];
     natsMutex_Unlock(arg.m);
+    testCond((s == NATS_OK) && (fallbacks == 1));
 
-    IFOK(s, arg.status);
-
-    testCond((s == NATS_OK)
-             && (msg != NULL)
-             && (strncmp(arg.string,
-                         natsMsg_GetData(msg),
-                         natsMsg_GetDataLength(msg)) == 0));
+    test("Invalid request ID, several requests pending: ");
+    for (i=0; (s == NATS_OK) && (i<2); i++)
+    {
+        s = natsConnection_RequestAsync(NULL, nc, "svc", "req", 3, 10000, _routedReplyHandler, &arg);
+        IFOK(s, natsSubscription_NextMsg(&(reqs[i]), sub, 2000));
+    }
+    if (s == NATS_OK)
+    {
+        // Does not fit in an int64, and can't be matched: dropped.
+        snprintf(subj, sizeof(subj), "%s.99999999999999999999999", nc->respSub);
+        s = natsConnection_PublishString(nc, subj, "fallback");
+    }
+    for (i=0; (s == NATS_OK) && (i<2); i++)
+        s = natsConnection_PublishString(nc, natsMsg_GetReply(reqs[i]), "reply");
+    IFOK(s, _waitForRoutedReplies(&arg, count + 3));
+    IFOK(s, _checkRespStripes(nc, 0));
+    natsMutex_Lock(arg.m);
+    fallbacks = arg.results[0];
+    natsMutex_Unlock(arg.m);
+    testCond((s == NATS_OK) && (fallbacks == 1));
 
-    natsMsg_Destroy(msg);
+    for (i=0; i<2; i++)
+        natsMsg_Destroy(reqs[i]);
     natsSubscription_Destroy(sub);
     natsConnection_Destroy(nc);
-    natsOptions_Destroy(opts);
 
     _destroyDefaultThreadArgs(&arg);
 
@@ -11170,130 +13852,211 @@ test_OldRequest(void)
 }
 
 static void
-_sendRequest(void *closure)
+_asyncManyReplyHandler(natsConnection *nc, natsMsg *reply, natsStatus status, void *closure)
 {
-    struct threadArg    *arg = (struct threadArg*) closure;
-    natsStatus          s;
-    natsMsg             *msg = NULL;
-
-    nats_Sleep(250);
+    struct threadArg *arg = (struct threadArg*) closure;
 
-    s = natsConnection_RequestString(&msg, arg->nc, "foo", "Help!", 2000);
     natsMutex_Lock(arg->m);
-    if ((s == NATS_OK)
-            && (msg != NULL)
-            && strncmp(arg->string,
-                       natsMsg_GetData(msg),
-                       natsMsg_GetDataLength(msg)) == 0)
+    // Nothing is expected after the last invocation.
+    if (arg->done)
+        arg->status = NATS_ERR;
+    if (reply != NULL)
     {
+        if (status != NATS_OK)
+            arg->status = NATS_ERR;
         arg->sum++;
     }
     else
     {
-        arg->status = NATS_ERR;
+        arg->results[0] = (int) status;
+        arg->done = true;
     }
+    natsCondition_Broadcast(arg->c);
     natsMutex_Unlock(arg->m);
-    natsMsg_Destroy(msg);
+
+    natsMsg_Destroy(reply);
+}
+
+static natsStatus
+_waitManyReplies(struct threadArg *arg, int expected, natsStatus expectedSts)
+{
+    natsStatus s = NATS_OK;
+
+    natsMutex_Lock(arg->m);
+    while ((s != NATS_TIMEOUT) && !arg->done)
+        s = natsCondition_TimedWait(arg->c, arg->m, 5000);
+    IFOK(s, arg->status);
+    if ((s == NATS_OK) && ((arg->sum != expected) || (arg->results[0] != (int) expectedSts)))
+        s = NATS_ERR;
+    arg->sum        = 0;
+    arg->done       = false;
+    arg->results[0] = 0;
+    natsMutex_Unlock(arg->m);
+
+    return s;
 }
 
 static void
-test_SimultaneousRequest(void)
+test_RequestMany(void)
 {
     natsStatus          s;
-     natsConnection      *nc       = NULL;
-     natsSubscription    *sub      = NULL;
-     natsThread          *threads[10];
-     natsPid             serverPid = NATS_INVALID_PID;
-     struct threadArg    arg;
-     int                 i;
+    natsConnection      *nc       = NULL;
+    natsSubscription    *subs[3]  = {NULL, NULL, NULL};
+    natsSubscription    *sub      = NULL;
+    natsMsg             **replies = NULL;
+    natsRequest         *req      = NULL;
+    natsPid             serverPid = NATS_INVALID_PID;
+    int                 count     = 0;
+    int64_t             start     = 0;
+    int64_t             dur       = 0;
+    natsMsg             msg;
+    struct threadArg    arg;
+    int                 i;
 
-     s = _createDefaultThreadArgsForCbTests(&arg);
-     if ( s != NATS_OK)
-         FAIL("Unable to setup test!");
+    s = _createDefaultThreadArgsForCbTests(&arg);
+    if (s != NATS_OK)
+        FAIL("Unable to setup test");
 
-     arg.string = "ok";
-     arg.status = NATS_OK;
-     arg.control= 4;
+    serverPid = _startServer("nats://127.0.0.1:4222", NULL, true);
+    CHECK_SERVER_STARTED(serverPid);
 
-     serverPid = _startServer("nats://127.0.0.1:4222", NULL, true);
-     CHECK_SERVER_STARTED(serverPid);
+    s = natsConnection_ConnectTo(&nc, NATS_DEFAULT_URL);
+    for (i=0; (s == NATS_OK) && (i<3); i++)
+        s = natsConnection_Subscribe(&(subs[i]), nc, "svc", _echoRequestHandler, NULL);
+    IFOK(s, natsConnection_SubscribeSync(&sub, nc, "silent"));
+    IFOK(s, natsConnection_Flush(nc));
+    if (s != NATS_OK)
+        FAIL("Unable to setup test");
 
-     s = natsConnection_ConnectTo(&nc, NATS_DEFAULT_URL);
-     if (s == NATS_OK)
-     {
-         arg.nc = nc;
-         s = natsConnection_Subscribe(&sub, nc, "foo", _recvTestString, (void*) &arg);
-     }
+    natsMsg_init(&msg, "svc", NULL, "1", 1);
 
-     for (i=0; i<10; i++)
-         threads[i] = NULL;
+    test("Invalid args: ");
+    s = natsConnection_RequestMany(NULL, &count, nc, &msg, 0, 1000, 0);
+    if (s == NATS_INVALID_ARG)
+        s = natsConnection_RequestMany(&replies, NULL, nc, &msg, 0, 1000, 0);
+    if (s == NATS_INVALID_ARG)
+        s = natsConnection_RequestMany(&replies, &count, NULL, &msg, 0, 1000, 0);
+    if (s == NATS_INVALID_ARG)
+        s = natsConnection_RequestMany(&replies, &count, nc, NULL, 0, 1000, 0);
+    if (s == NATS_INVALID_ARG)
+        s = natsConnection_RequestMany(&replies, &count, nc, &msg, -1, 1000, 0);
+    if (s == NATS_INVALID_ARG)
+        s = natsConnection_RequestMany(&replies, &count, nc, &msg, 0, 0, 0);
+    if (s == NATS_INVALID_ARG)
+        s = natsConnection_RequestMany(&replies, &count, nc, &msg, 0, 1000, -1);
+    if (s == NATS_INVALID_ARG)
+        s = natsConnection_RequestManyAsync(&req, nc, &msg, -1, 1000, 0, _asyncManyReplyHandler, &arg);
+    if (s == NATS_INVALID_ARG)
+        s = natsConnection_RequestManyAsync(&req, nc, &msg, 0, 1000, -1, _asyncManyReplyHandler, &arg);
+    if (s == NATS_INVALID_ARG)
+        s = natsConnection_RequestManyAsync(&req, nc, &msg, 0, 1000, 0, NULL, &arg);
+    testCond((s == NATS_INVALID_ARG) && (replies == NULL) && (count == 0) && (req == NULL));
+    nats_clearLastError();
 
-     test("Test simultaneous requests: ")
-     for (i=0; (s == NATS_OK) && (i<10); i++)
-         s = natsThread_Create(&(threads[i]), _sendRequest, (void*) &arg);
+    test("Max replies: ");
+    s = natsConnection_RequestMany(&replies, &count, nc, &msg, 2, 5000, 0);
+    testCond((s == NATS_OK) && (replies != NULL) && (count == 2)
+                && (strcmp(natsMsg_GetData(replies[0]), "1") == 0)
+                && (strcmp(natsMsg_GetData(replies[1]), "1") == 0));
+    for (i=0; i<count; i++)
+        natsMsg_Destroy(replies[i]);
+    free(replies);
+    replies = NULL;
+
+    test("Stall timeout: ");
+    start = nats_Now();
+    s = natsConnection_RequestMany(&replies, &count, nc, &msg, 0, 5000, 100);
+    dur = nats_Now() - start;
+    testCond((s == NATS_OK) && (count == 3) && (dur < 2000));
+    for (i=0; i<count; i++)
+        natsMsg_Destroy(replies[i]);
+    free(replies);
+    replies = NULL;
+
+    test("All replies within timeout: ");
+    start = nats_Now();
+    s = natsConnection_RequestMany(&replies, &count, nc, &msg, 0, 300, 0);
+    dur = nats_Now() - start;
+    testCond((s == NATS_OK) && (count == 3) && (dur >= 250));
+    for (i=0; i<count; i++)
+        natsMsg_Destroy(replies[i]);
+    free(replies);
+    replies = NULL;
 
-     for (i=0; i<10; i++)
-     {
-         if (threads[i] != NULL)
-         {
-             natsThread_Join(threads[i]);
-             natsThread_Destroy(threads[i]);
-         }
-     }
+    test("Timeout: ");
+    natsMsg_init(&msg, "silent", NULL, "1", 1);
+    s = natsConnection_RequestMany(&replies, &count, nc, &msg, 0, 100, 0);
+    testCond((s == NATS_TIMEOUT) && (replies == NULL) && (count == 0));
+    nats_clearLastError();
 
-     natsMutex_Lock(arg.m);
-     if ((s != NATS_OK)
-             || ((s = arg.status) != NATS_OK)
-             || (arg.sum != 10))
-     {
-         s = NATS_ERR;
-     }
-     natsMutex_Unlock(arg.m);
+    test("No responders: ");
+    natsMsg_init(&msg, "nobody", NULL, "1", 1);
+    s = natsConnection_RequestMany(&replies, &count, nc, &msg, 0, 1000, 0);
+    testCond((s == NATS_NO_RESPONDERS) && (replies == NULL) && (count == 0));
+    nats_clearLastError();
 
-     testCond(s == NATS_OK);
+    natsMsg_init(&msg, "svc", NULL, "1", 1);
 
-     natsSubscription_Destroy(sub);
-     natsConnection_Destroy(nc);
+    test("Async max replies: ");
+    s = natsConnection_RequestManyAsync(NULL, nc, &msg, 2, 5000, 0, _asyncManyReplyHandler, &arg);
+    IFOK(s, _waitManyReplies(&arg, 2, NATS_OK));
+    testCond(s == NATS_OK);
 
-     _destroyDefaultThreadArgs(&arg);
+    test("Async stall timeout: ");
+    start = nats_Now();
+    s = natsConnection_RequestManyAsync(NULL, nc, &msg, 0, 5000, 100, _asyncManyReplyHandler, &arg);
+    IFOK(s, _waitManyReplies(&arg, 3, NATS_OK));
+    dur = nats_Now() - start;
+    testCond((s == NATS_OK) && (dur < 2000));
 
-     _stopServer(serverPid);
-}
+    test("Async all replies within timeout: ");
+    s = natsConnection_RequestManyAsync(NULL, nc, &msg, 0, 300, 0, _asyncManyReplyHandler, &arg);
+    IFOK(s, _waitManyReplies(&arg, 3, NATS_OK));
+    testCond(s == NATS_OK);
 
-static void
-test_RequestClose(void)
-{
-    natsStatus          s;
-    natsConnection      *nc       = NULL;
-    natsSubscription    *sub      = NULL;
-    natsMsg             *msg      = NULL;
-    natsThread          *t        = NULL;
-    natsPid             serverPid = NATS_INVALID_PID;
+    test("Async timeout: ");
+    natsMsg_init(&msg, "silent", NULL, "1", 1);
+    s = natsConnection_RequestManyAsync(NULL, nc, &msg, 0, 100, 0, _asyncManyReplyHandler, &arg);
+    IFOK(s, _waitManyReplies(&arg, 0, NATS_TIMEOUT));
+    testCond(s == NATS_OK);
 
-    serverPid = _startServer("nats://127.0.0.1:4222", NULL, true);
-    CHECK_SERVER_STARTED(serverPid);
+    test("Async no responders: ");
+    natsMsg_init(&msg, "nobody", NULL, "1", 1);
+    s = natsConnection_RequestManyAsync(NULL, nc, &msg, 0, 1000, 0, _asyncManyReplyHandler, &arg);
+    IFOK(s, _waitManyReplies(&arg, 0, NATS_NO_RESPONDERS));
+    testCond(s == NATS_OK);
 
-    // Because of no responders, we would get an immediate timeout.
-    // So we need to create a sync subscriber that is simply not
-    // going to send a reply back.
+    test("Async cancel: ");
+    natsMsg_init(&msg, "silent", NULL, "1", 1);
+    s = natsConnection_RequestManyAsync(&req, nc, &msg, 0, 100, 0, _asyncManyReplyHandler, &arg);
+    IFOK(s, natsRequest_Cancel(req));
+    if (s == NATS_OK)
+        nats_Sleep(300);
+    natsMutex_Lock(arg.m);
+    testCond((s == NATS_OK) && !arg.done && (arg.status == NATS_OK));
+    natsMutex_Unlock(arg.m);
+    natsRequest_Destroy(req);
+    req = NULL;
 
-    s = natsConnection_ConnectTo(&nc, NATS_DEFAULT_URL);
-    test("Test Request is kicked out with a connection close: ")
-    IFOK(s, natsThread_Create(&t, _closeConnWithDelay, (void*) nc));
-    IFOK(s, natsConnection_SubscribeSync(&sub, nc, "foo"));
-    IFOK(s, natsConnection_RequestString(&msg, nc, "foo", "help", 2000));
+    test("Async completed on close: ");
+    s = natsConnection_RequestManyAsync(NULL, nc, &msg, 0, 60000, 0, _asyncManyReplyHandler, &arg);
+    if (s == NATS_OK)
+        natsConnection_Close(nc);
+    IFOK(s, _waitManyReplies(&arg, 0, NATS_CONNECTION_CLOSED));
+    testCond(s == NATS_OK);
 
-    if (t != NULL)
-    {
-        natsThread_Join(t);
-        natsThread_Destroy(t);
-    }
-    testCond((s == NATS_CONNECTION_CLOSED) && (msg == NULL));
+    test("Closed connection: ");
+    s = natsConnection_RequestMany(&replies, &count, nc, &msg, 0, 1000, 0);
+    testCond((s == NATS_CONNECTION_CLOSED) && (replies == NULL) && (count == 0));
+    nats_clearLastError();
 
-    natsMsg_Destroy(msg);
+    for (i=0; i<3; i++)
+        natsSubscription_Destroy(subs[i]);
     natsSubscription_Destroy(sub);
     natsConnection_Destroy(nc);
 
+    _destroyDefaultThreadArgs(&arg);
+
     _stopServer(serverPid);
 }
 
@@ -11526,6 +14289,8 @@ test_Stats(void)
     uint64_t            outBytes = 0;
     uint64_t            inMsgs = 0;
     uint64_t            inBytes = 0;
+    uint64_t            hits = 1;
+    uint64_t            misses = 1;
 
     test("Check invalid arg: ");
     s = natsStatistics_GetCounts(NULL, NULL, NULL, NULL, NULL, NULL);
@@ -11567,6 +14332,15 @@ test_Stats(void)
     test("Tracking inBytes properly: ");
     testCond((s == NATS_OK) && (inBytes == (uint64_t)(2 * (iter * strlen(data)))));
 
+    test("No TLS handshakes: ");
+    s = natsStatistics_GetTLSSessionCounts(NULL, &hits, &misses);
+    if (s == NATS_INVALID_ARG)
+    {
+        nats_clearLastError();
+        s = natsStatistics_GetTLSSessionCounts(stats, &hits, &misses);
+    }
+    testCond((s == NATS_OK) && (hits == 0) && (misses == 0));
+
     natsStatistics_Destroy(stats);
     natsSubscription_Destroy(s1);
     natsSubscription_Destroy(s2);
@@ -11575,6 +14349,91 @@ test_Stats(void)
     _stopServer(serverPid);
 }
 
+static void
+test_FlushPolicy(void)
+{
+    natsStatus          s         = NATS_OK;
+    natsConnection      *nc       = NULL;
+    natsOptions         *opts     = NULL;
+    natsSubscription    *sub      = NULL;
+    natsStatistics      *stats    = NULL;
+    natsPid             serverPid = NATS_INVALID_PID;
+    uint64_t            flushes   = 0;
+    uint64_t            bytes     = 0;
+    uint64_t            ttf       = 0;
+    uint64_t            maxTtf    = 0;
+    uint64_t            inMsgs    = 0;
+    int                 policies[4] = {NATS_FLUSH_POLICY_DEFAULT,
+                                       NATS_FLUSH_POLICY_LATENCY,
+                                       NATS_FLUSH_POLICY_THROUGHPUT,
+                                       NATS_FLUSH_POLICY_ADAPTIVE};
+    int                 p, i;
+
+    test("Check invalid arg: ");
+    s = natsStatistics_GetFlushCounts(NULL, NULL, NULL, NULL, NULL);
+    testCond(s == NATS_INVALID_ARG);
+    nats_clearLastError();
+
+    s = natsStatistics_Create(&stats);
+    if (s != NATS_OK)
+        FAIL("Unable to setup test");
+
+    serverPid = _startServer("nats://127.0.0.1:4222", NULL, true);
+    CHECK_SERVER_STARTED(serverPid);
+
+    for (p=0; p<4; p++)
+    {
+        char buf[256];
+
+        s = natsOptions_Create(&opts);
+        IFOK(s, natsOptions_SetFlushPolicy(opts, (natsFlushPolicy) policies[p], 1024, 500));
+        if (s != NATS_OK)
+            FAIL("Unable to setup test");
+
+        snprintf(buf, sizeof(buf), "Policy %d, connect and subscribe: ", policies[p]);
+        test(buf);
+        s = natsConnection_Connect(&nc, opts);
+        IFOK(s, natsConnection_SubscribeSync(&sub, nc, "foo"));
+        IFOK(s, natsConnection_Flush(nc));
+        testCond(s == NATS_OK);
+
+        snprintf(buf, sizeof(buf), "Policy %d, messages are flushed without explicit flush: ", policies[p]);
+        test(buf);
+        for (i=0; (s == NATS_OK) && (i<100); i++)
+            s = natsConnection_PublishString(nc, "foo", "hello");
+        for (i=0; (s == NATS_OK) && (i<100); i++)
+        {
+            natsMsg *msg = NULL;
+
+            s = natsSubscription_NextMsg(&msg, sub, 2000);
+            natsMsg_Destroy(msg);
+        }
+        testCond(s == NATS_OK);
+
+        snprintf(buf, sizeof(buf), "Policy %d, flush stats: ", policies[p]);
+        test(buf);
+        s = natsConnection_GetStats(nc, stats);
+        IFOK(s, natsStatistics_GetCounts(stats, &inMsgs, NULL, NULL, NULL, NULL));
+        IFOK(s, natsStatistics_GetFlushCounts(stats, &flushes, &bytes, &ttf, &maxTtf));
+        testCond((s == NATS_OK)
+                    && (inMsgs == 100)
+                    && (flushes > 0)
+                    && (bytes >= (uint64_t) (100 * strlen("PUB foo 5\r\nhello\r\n")))
+                    && (ttf >= maxTtf));
+
+        natsSubscription_Destroy(sub);
+        sub = NULL;
+        natsConnection_Destroy(nc);
+        nc = NULL;
+        natsOptions_Destroy(opts);
+        opts = NULL;
+    }
+
+    natsStatistics_Destroy(stats);
+
+    _stopServer(serverPid);
+}
+
 static void
 test_BadSubject(void)
 {
@@ -18559,33 +21418,247 @@ _eventLoop(void *closure)
 }
 
 static void
-test_EventLoop(void)
+test_EventLoop(void)
+{
+    natsStatus          s;
+    natsConnection      *nc         = NULL;
+    natsOptions         *opts       = NULL;
+    natsSubscription    *sub        = NULL;
+    natsMsg             *msg        = NULL;
+    natsPid             pid         = NATS_INVALID_PID;
+    char                *large      = NULL;
+    int                 largeSize   = 256*1024;
+    int                 i;
+    struct threadArg    arg;
+
+    test("Set options: ");
+    s = _createDefaultThreadArgsForCbTests(&arg);
+    IFOK(s, natsOptions_Create(&opts));
+    IFOK(s, natsOptions_SetMaxReconnect(opts, 100));
+    IFOK(s, natsOptions_SetReconnectWait(opts, 50));
+    IFOK(s, natsOptions_SetEventLoop(opts, (void*) &arg,
+                                     _evLoopAttach,
+                                     _evLoopRead,
+                                     _evLoopWrite,
+                                     _evLoopDetach));
+    IFOK(s, natsOptions_SetDisconnectedCB(opts, _disconnectedCb, (void*) &arg));
+    IFOK(s, natsOptions_SetReconnectedCB(opts, _reconnectedCb, (void*) &arg));
+    IFOK(s, natsOptions_SetClosedCB(opts, _closedCb, (void*) &arg));
+    testCond(s == NATS_OK);
+
+    pid = _startServer("nats://127.0.0.1:4222", NULL, true);
+    CHECK_SERVER_STARTED(pid);
+
+    test("Start event loop: ");
+    natsMutex_Lock(arg.m);
+    arg.sock = NATS_SOCK_INVALID;
+    natsMutex_Unlock(arg.m);
+    s = natsThread_Create(&arg.t, _eventLoop, (void*) &arg);
+    testCond(s == NATS_OK);
+
+    test("Connect: ");
+    s = natsConnection_Connect(&nc, opts);
+    testCond(s == NATS_OK)
+
+    test("Create sub: ");
+    s = natsConnection_SubscribeSync(&sub, nc, "foo");
+    testCond(s == NATS_OK);
+
+    test("Stop server and wait for disconnect: ");
+    _stopServer(pid);
+    pid = NATS_INVALID_PID;
+    natsMutex_Lock(arg.m);
+    while ((s != NATS_TIMEOUT) && !arg.disconnected)
+        s = natsCondition_TimedWait(arg.c, arg.m, 2000);
+    natsMutex_Unlock(arg.m);
+    testCond(s == NATS_OK);
+
+    test("Restart server: ");
+    pid = _startServer("nats://127.0.0.1:4222", NULL, true);
+    CHECK_SERVER_STARTED(pid);
+    testCond(s == NATS_OK);
+
+    test("Wait for reconnect: ");
+    natsMutex_Lock(arg.m);
+    while ((s != NATS_TIMEOUT) && !arg.reconnected)
+        s = natsCondition_TimedWait(arg.c, arg.m, 2000);
+    natsMutex_Unlock(arg.m);
+    testCond(s == NATS_OK);
+
+    test("Publish: ");
+    s = natsConnection_PublishString(nc, "foo", "bar");
+    testCond(s == NATS_OK);
+
+    test("Check msg received: ");
+    s = natsSubscription_NextMsg(&msg, sub, 1000);
+    testCond(s == NATS_OK);
+    natsMsg_Destroy(msg);
+
+    large = (char*) malloc(largeSize);
+    if (large == NULL)
+        FAIL("Unable to setup test");
+    for (i=0; i<largeSize; i++)
+        large[i] = 'a' + (i % 26);
+
+    test("Large payloads of messages are referenced: ");
+    s = _publishSmallLargeMsgs(nc, large, largeSize, 4);
+    testCond(s == NATS_OK);
+
+    test("Sent from write events, in order and intact: ");
+    s = _checkSmallLargeMsgs(sub, large, largeSize, 4);
+    natsConn_Lock(nc);
+    testCond((s == NATS_OK) && (nc->out.count == 0) && (nc->out.bytes == 0));
+    natsConn_Unlock(nc);
+    free(large);
+
+    test("Close and wait for close cb: ");
+    natsConnection_Close(nc);
+    _waitForConnClosed(&arg);
+    testCond(s == NATS_OK);
+
+    natsMutex_Lock(arg.m);
+    arg.evStop = true;
+    natsCondition_Broadcast(arg.c);
+    natsMutex_Unlock(arg.m);
+
+    natsThread_Join(arg.t);
+    natsThread_Destroy(arg.t);
+
+    test("Check ev loop: ");
+    natsMutex_Lock(arg.m);
+    if (arg.attached != 2 || !arg.detached)
+        s = NATS_ERR;
+    testCond(s == NATS_OK);
+
+    natsSubscription_Destroy(sub);
+    natsConnection_Destroy(nc);
+    natsOptions_Destroy(opts);
+
+    _destroyDefaultThreadArgs(&arg);
+
+    _stopServer(pid);
+}
+
+static void
+test_EventLoopRetryOnFailedConnect(void)
+{
+    natsStatus          s;
+    natsConnection      *nc         = NULL;
+    natsOptions         *opts       = NULL;
+    natsSubscription    *sub        = NULL;
+    natsMsg             *msg        = NULL;
+    natsPid             pid         = NATS_INVALID_PID;
+    struct threadArg    arg;
+
+    test("Set options: ");
+    s = _createDefaultThreadArgsForCbTests(&arg);
+    IFOK(s, natsOptions_Create(&opts));
+    IFOK(s, natsOptions_SetMaxReconnect(opts, 100));
+    IFOK(s, natsOptions_SetReconnectWait(opts, 50));
+    IFOK(s, natsOptions_SetRetryOnFailedConnect(opts,
+                                                true,
+                                                _connectedCb,
+                                                (void*) &arg));
+    IFOK(s, natsOptions_SetClosedCB(opts, _closedCb, (void*) &arg));
+    IFOK(s, natsOptions_SetEventLoop(opts, (void*) &arg,
+                                     _evLoopAttach,
+                                     _evLoopRead,
+                                     _evLoopWrite,
+                                     _evLoopDetach));
+    testCond(s == NATS_OK);
+
+    test("Start event loop: ");
+    natsMutex_Lock(arg.m);
+    arg.sock = NATS_SOCK_INVALID;
+    natsMutex_Unlock(arg.m);
+    s = natsThread_Create(&arg.t, _eventLoop, (void*) &arg);
+    testCond(s == NATS_OK);
+
+    test("Start connect: ");
+    s = natsConnection_Connect(&nc, opts);
+    testCond(s == NATS_NOT_YET_CONNECTED);
+    if (s == NATS_NOT_YET_CONNECTED)
+        s = NATS_OK;
+
+    test("Create sub: ");
+    s = natsConnection_SubscribeSync(&sub, nc, "foo");
+    testCond(s == NATS_OK);
+
+    test("Start server: ");
+    pid = _startServer("nats://127.0.0.1:4222", NULL, true);
+    CHECK_SERVER_STARTED(pid);
+    testCond(s == NATS_OK);
+
+    test("Check connected: ");
+    natsMutex_Lock(arg.m);
+    while ((s != NATS_TIMEOUT) && !arg.connected)
+        s = natsCondition_TimedWait(arg.c, arg.m, 2000);
+    natsMutex_Unlock(arg.m);
+    testCond(s == NATS_OK);
+
+    test("Publish: ");
+    s = natsConnection_PublishString(nc, "foo", "bar");
+    testCond(s == NATS_OK);
+
+    test("Check msg received: ");
+    s = natsSubscription_NextMsg(&msg, sub, 1000);
+    testCond(s == NATS_OK);
+    natsMsg_Destroy(msg);
+
+    test("Close and wait for close cb: ");
+    natsConnection_Close(nc);
+    s = _waitForConnClosed(&arg);
+    testCond(s == NATS_OK);
+
+    natsMutex_Lock(arg.m);
+    arg.evStop = true;
+    natsCondition_Broadcast(arg.c);
+    natsMutex_Unlock(arg.m);
+
+    natsThread_Join(arg.t);
+    natsThread_Destroy(arg.t);
+
+    natsSubscription_Destroy(sub);
+    natsConnection_Destroy(nc);
+    natsOptions_Destroy(opts);
+
+    _destroyDefaultThreadArgs(&arg);
+
+    _stopServer(pid);
+}
+
+static void
+test_EventLoopTLS(void)
 {
+#if defined(NATS_HAS_TLS)
     natsStatus          s;
     natsConnection      *nc         = NULL;
     natsOptions         *opts       = NULL;
-    natsSubscription    *sub        = NULL;
-    natsMsg             *msg        = NULL;
     natsPid             pid         = NATS_INVALID_PID;
     struct threadArg    arg;
 
     test("Set options: ");
     s = _createDefaultThreadArgsForCbTests(&arg);
     IFOK(s, natsOptions_Create(&opts));
+    IFOK(s, natsOptions_SetURL(opts, "nats://localhost:4443"));
+    IFOK(s, natsOptions_SkipServerVerification(opts, true));
+    IFOK(s, natsOptions_SetSecure(opts, true));
     IFOK(s, natsOptions_SetMaxReconnect(opts, 100));
     IFOK(s, natsOptions_SetReconnectWait(opts, 50));
+    IFOK(s, natsOptions_SetDisconnectedCB(opts, _disconnectedCb, (void*) &arg));
+    IFOK(s, natsOptions_SetReconnectedCB(opts, _reconnectedCb, (void*) &arg));
+    IFOK(s, natsOptions_SetClosedCB(opts, _closedCb, (void*) &arg));
     IFOK(s, natsOptions_SetEventLoop(opts, (void*) &arg,
                                      _evLoopAttach,
                                      _evLoopRead,
                                      _evLoopWrite,
                                      _evLoopDetach));
-    IFOK(s, natsOptions_SetDisconnectedCB(opts, _disconnectedCb, (void*) &arg));
-    IFOK(s, natsOptions_SetReconnectedCB(opts, _reconnectedCb, (void*) &arg));
-    IFOK(s, natsOptions_SetClosedCB(opts, _closedCb, (void*) &arg));
     testCond(s == NATS_OK);
 
-    pid = _startServer("nats://127.0.0.1:4222", NULL, true);
+    test("Start server: ");
+    pid = _startServer("nats://127.0.0.1:4443", "-config tls.conf -DV", true);
     CHECK_SERVER_STARTED(pid);
+    testCond(s == NATS_OK);
 
     test("Start event loop: ");
     natsMutex_Lock(arg.m);
@@ -18596,13 +21669,9 @@ test_EventLoop(void)
 
     test("Connect: ");
     s = natsConnection_Connect(&nc, opts);
-    testCond(s == NATS_OK)
-
-    test("Create sub: ");
-    s = natsConnection_SubscribeSync(&sub, nc, "foo");
     testCond(s == NATS_OK);
 
-    test("Stop server and wait for disconnect: ");
+    test("Disconnect: ");
     _stopServer(pid);
     pid = NATS_INVALID_PID;
     natsMutex_Lock(arg.m);
@@ -18612,231 +21681,448 @@ test_EventLoop(void)
     testCond(s == NATS_OK);
 
     test("Restart server: ");
-    pid = _startServer("nats://127.0.0.1:4222", NULL, true);
+    pid = _startServer("nats://127.0.0.1:4443", "-config tls.conf", true);
     CHECK_SERVER_STARTED(pid);
     testCond(s == NATS_OK);
 
-    test("Wait for reconnect: ");
+    test("Check reconnected: ");
     natsMutex_Lock(arg.m);
     while ((s != NATS_TIMEOUT) && !arg.reconnected)
         s = natsCondition_TimedWait(arg.c, arg.m, 2000);
     natsMutex_Unlock(arg.m);
     testCond(s == NATS_OK);
 
-    test("Publish: ");
-    s = natsConnection_PublishString(nc, "foo", "bar");
-    testCond(s == NATS_OK);
-
-    test("Check msg received: ");
-    s = natsSubscription_NextMsg(&msg, sub, 1000);
-    testCond(s == NATS_OK);
-    natsMsg_Destroy(msg);
-
-    test("Close and wait for close cb: ");
-    natsConnection_Close(nc);
-    _waitForConnClosed(&arg);
-    testCond(s == NATS_OK);
-
+    test("Shutdown evLoop: ");
     natsMutex_Lock(arg.m);
     arg.evStop = true;
     natsCondition_Broadcast(arg.c);
     natsMutex_Unlock(arg.m);
-
     natsThread_Join(arg.t);
     natsThread_Destroy(arg.t);
+    testCond(s == NATS_OK);
 
-    test("Check ev loop: ");
-    natsMutex_Lock(arg.m);
-    if (arg.attached != 2 || !arg.detached)
-        s = NATS_ERR;
+    test("Close and wait for close cb: ");
+    natsConnection_Close(nc);
+    s = _waitForConnClosed(&arg);
     testCond(s == NATS_OK);
 
-    natsSubscription_Destroy(sub);
     natsConnection_Destroy(nc);
     natsOptions_Destroy(opts);
 
     _destroyDefaultThreadArgs(&arg);
 
     _stopServer(pid);
+#else
+    test("Skipped when built with no SSL support: ");
+    testCond(true);
+#endif
 }
 
 static void
-test_EventLoopRetryOnFailedConnect(void)
+test_IOEngine(void)
 {
+#if defined(__linux__)
     natsStatus          s;
-    natsConnection      *nc         = NULL;
+    natsConnection      *conns[3]   = {NULL, NULL, NULL};
     natsOptions         *opts       = NULL;
     natsSubscription    *sub        = NULL;
     natsMsg             *msg        = NULL;
     natsPid             pid         = NATS_INVALID_PID;
+    char                *large      = NULL;
+    int                 largeSize   = 512*1024;
+    char                data[16];
+    int                 i;
     struct threadArg    arg;
 
+    test("Set number of threads (invalid): ");
+    s = nats_SetIOEngineThreads(0);
+    testCond(s == NATS_INVALID_ARG);
+    nats_clearLastError();
+
+    test("Set number of threads: ");
+    s = nats_SetIOEngineThreads(2);
+    testCond(s == NATS_OK);
+
     test("Set options: ");
     s = _createDefaultThreadArgsForCbTests(&arg);
     IFOK(s, natsOptions_Create(&opts));
     IFOK(s, natsOptions_SetMaxReconnect(opts, 100));
     IFOK(s, natsOptions_SetReconnectWait(opts, 50));
-    IFOK(s, natsOptions_SetRetryOnFailedConnect(opts,
-                                                true,
-                                                _connectedCb,
-                                                (void*) &arg));
+    IFOK(s, natsOptions_UseIOEngine(opts, true));
+    IFOK(s, natsOptions_SetReconnectedCB(opts, _reconnectedCb, (void*) &arg));
     IFOK(s, natsOptions_SetClosedCB(opts, _closedCb, (void*) &arg));
-    IFOK(s, natsOptions_SetEventLoop(opts, (void*) &arg,
-                                     _evLoopAttach,
-                                     _evLoopRead,
-                                     _evLoopWrite,
-                                     _evLoopDetach));
     testCond(s == NATS_OK);
 
-    test("Start event loop: ");
-    natsMutex_Lock(arg.m);
-    arg.sock = NATS_SOCK_INVALID;
-    natsMutex_Unlock(arg.m);
-    s = natsThread_Create(&arg.t, _eventLoop, (void*) &arg);
+    pid = _startServer("nats://127.0.0.1:4222", NULL, true);
+    CHECK_SERVER_STARTED(pid);
+
+    test("Connect: ");
+    for (i=0; (s == NATS_OK) && (i<3); i++)
+        s = natsConnection_Connect(&(conns[i]), opts);
     testCond(s == NATS_OK);
 
-    test("Start connect: ");
-    s = natsConnection_Connect(&nc, opts);
-    testCond(s == NATS_NOT_YET_CONNECTED);
-    if (s == NATS_NOT_YET_CONNECTED)
-        s = NATS_OK;
+    test("Create responder: ");
+    s = natsConnection_Subscribe(&sub, conns[0], "foo", _echoRequestHandler, NULL);
+    IFOK(s, natsConnection_Flush(conns[0]));
+    testCond(s == NATS_OK);
 
-    test("Create sub: ");
-    s = natsConnection_SubscribeSync(&sub, nc, "foo");
+    test("Requests from all connections: ");
+    for (i=0; (s == NATS_OK) && (i<3); i++)
+    {
+        snprintf(data, sizeof(data), "req%d", i);
+        s = natsConnection_RequestString(&msg, conns[i], "foo", data, 1000);
+        if ((s == NATS_OK) && (strcmp(natsMsg_GetData(msg), data) != 0))
+            s = NATS_ERR;
+        natsMsg_Destroy(msg);
+        msg = NULL;
+    }
     testCond(s == NATS_OK);
 
-    test("Start server: ");
+    test("Large payload: ");
+    large = malloc(largeSize);
+    if (large == NULL)
+        s = NATS_NO_MEMORY;
+    else
+        memset(large, 'A', largeSize);
+    IFOK(s, natsConnection_Request(&msg, conns[1], "foo", large, largeSize, 2000));
+    if ((s == NATS_OK)
+        && ((natsMsg_GetDataLength(msg) != largeSize)
+            || (memcmp(natsMsg_GetData(msg), large, largeSize) != 0)))
+    {
+        s = NATS_ERR;
+    }
+    natsMsg_Destroy(msg);
+    msg = NULL;
+    free(large);
+    testCond(s == NATS_OK);
+
+    test("Stop and restart server: ");
+    _stopServer(pid);
     pid = _startServer("nats://127.0.0.1:4222", NULL, true);
     CHECK_SERVER_STARTED(pid);
-    testCond(s == NATS_OK);
+    testCond(true);
 
-    test("Check connected: ");
+    test("Wait for reconnects: ");
     natsMutex_Lock(arg.m);
-    while ((s != NATS_TIMEOUT) && !arg.connected)
-        s = natsCondition_TimedWait(arg.c, arg.m, 2000);
+    while ((s != NATS_TIMEOUT) && (arg.reconnects != 3))
+        s = natsCondition_TimedWait(arg.c, arg.m, 5000);
     natsMutex_Unlock(arg.m);
     testCond(s == NATS_OK);
 
-    test("Publish: ");
-    s = natsConnection_PublishString(nc, "foo", "bar");
+    test("Requests after reconnect: ");
+    IFOK(s, natsConnection_Flush(conns[0]));
+    for (i=0; (s == NATS_OK) && (i<3); i++)
+    {
+        s = natsConnection_RequestString(&msg, conns[i], "foo", "again", 1000);
+        natsMsg_Destroy(msg);
+        msg = NULL;
+    }
     testCond(s == NATS_OK);
 
-    test("Check msg received: ");
-    s = natsSubscription_NextMsg(&msg, sub, 1000);
+    test("Close connections: ");
+    natsSubscription_Destroy(sub);
+    for (i=0; (s == NATS_OK) && (i<3); i++)
+    {
+        natsConnection_Close(conns[i]);
+        s = _waitForConnClosed(&arg);
+    }
     testCond(s == NATS_OK);
-    natsMsg_Destroy(msg);
 
-    test("Close and wait for close cb: ");
-    natsConnection_Close(nc);
-    s = _waitForConnClosed(&arg);
+    for (i=0; i<3; i++)
+        natsConnection_Destroy(conns[i]);
+    natsOptions_Destroy(opts);
+
+    _destroyDefaultThreadArgs(&arg);
+
+    _stopServer(pid);
+#else
+    test("Skipped when not on Linux: ");
+    testCond(true);
+#endif
+}
+
+static void
+test_IOUring(void)
+{
+#if defined(NATS_HAS_IO_URING)
+    natsStatus          s;
+    natsConnection      *nc         = NULL;
+    natsOptions         *opts       = NULL;
+    natsSubscription    *sub        = NULL;
+    natsMsg             *msg        = NULL;
+    natsPid             pid         = NATS_INVALID_PID;
+    natsSockCtx         ctx;
+    bool                canWrite    = false;
+    char                data[4000];
+    int                 i, j;
+    struct threadArg    arg;
+
+    for (i=0; i<(int) sizeof(data); i++)
+        data[i] = 'a' + (i % 26);
+
+    test("Set options: ");
+    s = _createDefaultThreadArgsForCbTests(&arg);
+    IFOK(s, natsOptions_Create(&opts));
+    // Smaller than some of the messages, so that they span several buffers.
+    IFOK(s, natsOptions_SetIOBufSize(opts, 1024));
+    IFOK(s, natsOptions_SetMaxReconnect(opts, 100));
+    IFOK(s, natsOptions_SetReconnectWait(opts, 50));
+    IFOK(s, natsOptions_SetReconnectedCB(opts, _reconnectedCb, (void*) &arg));
+    IFOK(s, natsOptions_SetClosedCB(opts, _closedCb, (void*) &arg));
     testCond(s == NATS_OK);
 
-    natsMutex_Lock(arg.m);
-    arg.evStop = true;
-    natsCondition_Broadcast(arg.c);
-    natsMutex_Unlock(arg.m);
+    pid = _startServer("nats://127.0.0.1:4222", NULL, true);
+    CHECK_SERVER_STARTED(pid);
 
-    natsThread_Join(arg.t);
-    natsThread_Destroy(arg.t);
+    test("Connect: ");
+    s = natsConnection_Connect(&nc, opts);
+    IFOK(s, natsConnection_SubscribeSync(&sub, nc, "foo"));
+    IFOK(s, natsConnection_Flush(nc));
+    testCond(s == NATS_OK);
+
+    // Only expect the write ring if the kernel allows to create one.
+    memset(&ctx, 0, sizeof(ctx));
+    canWrite = natsSock_UringStartWrites(&ctx);
+    natsSock_UringStopWrites(&ctx);
+
+    test("Writes submitted through the ring: ");
+    natsConn_Lock(nc);
+    s = ((nc->sockCtx.wuring != NULL) == canWrite ? NATS_OK : NATS_ERR);
+    natsConn_Unlock(nc);
+    testCond(s == NATS_OK);
+
+    for (j=0; j<2; j++)
+    {
+        if (j == 1)
+        {
+            test("Stop and restart server: ");
+            _stopServer(pid);
+            pid = _startServer("nats://127.0.0.1:4222", NULL, true);
+            CHECK_SERVER_STARTED(pid);
+            testCond(true);
+
+            test("Wait for reconnect: ");
+            natsMutex_Lock(arg.m);
+            while ((s != NATS_TIMEOUT) && !arg.reconnected)
+                s = natsCondition_TimedWait(arg.c, arg.m, 5000);
+            natsMutex_Unlock(arg.m);
+            testCond(s == NATS_OK);
+        }
+
+        test("Send messages of various sizes: ");
+        for (i=0; (s == NATS_OK) && (i<100); i++)
+            s = natsConnection_Publish(nc, "foo", data, i * 37);
+        IFOK(s, natsConnection_Flush(nc));
+        testCond(s == NATS_OK);
+
+        test("Receive them in order: ");
+        for (i=0; (s == NATS_OK) && (i<100); i++)
+        {
+            s = natsSubscription_NextMsg(&msg, sub, 2000);
+            if ((s == NATS_OK)
+                && ((natsMsg_GetDataLength(msg) != i * 37)
+                    || (memcmp(natsMsg_GetData(msg), data, i * 37) != 0)))
+            {
+                s = NATS_ERR;
+            }
+            natsMsg_Destroy(msg);
+            msg = NULL;
+        }
+        testCond(s == NATS_OK);
+    }
 
+    test("Close: ");
     natsSubscription_Destroy(sub);
+    natsConnection_Close(nc);
+    s = _waitForConnClosed(&arg);
+    testCond(s == NATS_OK);
+
     natsConnection_Destroy(nc);
     natsOptions_Destroy(opts);
 
-    _destroyDefaultThreadArgs(&arg);
+    _destroyDefaultThreadArgs(&arg);
+
+    _stopServer(pid);
+#else
+    test("Skipped when built with no io_uring support: ");
+    testCond(true);
+#endif
+}
+
+static void
+_zeroCopyReleased(natsConnection *nc, const void *data, int dataLen, void *closure)
+{
+    struct threadArg *arg = (struct threadArg*) closure;
+
+    natsMutex_Lock(arg->m);
+    if ((data != (const void*) arg->string) || (nc != arg->nc))
+        arg->status = NATS_ERR;
+    arg->sum++;
+    natsCondition_Broadcast(arg->c);
+    natsMutex_Unlock(arg->m);
+}
+
+static void
+test_PublishZeroCopy(void)
+{
+    natsStatus          s;
+    natsConnection      *nc         = NULL;
+    natsOptions         *opts       = NULL;
+    natsSubscription    *sub        = NULL;
+    natsMsg             *msg        = NULL;
+    natsPid             pid         = NATS_INVALID_PID;
+    char                *large      = NULL;
+    int                 largeSize   = 256*1024;
+    int                 count       = 20;
+    int                 sum         = 0;
+    int                 i;
+    struct threadArg    arg;
+
+    s = _createDefaultThreadArgsForCbTests(&arg);
+    if (s == NATS_OK)
+    {
+        large = malloc(largeSize);
+        if (large == NULL)
+            s = NATS_NO_MEMORY;
+    }
+    if (s != NATS_OK)
+        FAIL("Unable to setup test!");
+
+    for (i=0; i<largeSize; i++)
+        large[i] = 'a' + (i % 26);
+    arg.string = (const char*) large;
 
-    _stopServer(pid);
-}
+    test("Completions out of order: ");
+    {
+        natsConnection fake;
 
-static void
-test_EventLoopTLS(void)
-{
-#if defined(NATS_HAS_TLS)
-    natsStatus          s;
-    natsConnection      *nc         = NULL;
-    natsOptions         *opts       = NULL;
-    natsPid             pid         = NATS_INVALID_PID;
-    struct threadArg    arg;
+        memset(&fake, 0, sizeof(fake));
+        natsConn_zeroCopyComplete(&fake, 2, 3);
+        s = ((fake.zc.doneId == 0) && (fake.zc.rangesCount == 1) ? NATS_OK : NATS_ERR);
+        if (s == NATS_OK)
+        {
+            natsConn_zeroCopyComplete(&fake, 5, 5);
+            natsConn_zeroCopyComplete(&fake, 0, 0);
+            s = ((fake.zc.doneId == 1) && (fake.zc.rangesCount == 2) ? NATS_OK : NATS_ERR);
+        }
+        if (s == NATS_OK)
+        {
+            natsConn_zeroCopyComplete(&fake, 1, 1);
+            s = ((fake.zc.doneId == 4) && (fake.zc.rangesCount == 1) ? NATS_OK : NATS_ERR);
+        }
+        if (s == NATS_OK)
+        {
+            // Already accounted for.
+            natsConn_zeroCopyComplete(&fake, 2, 3);
+            natsConn_zeroCopyComplete(&fake, 4, 6);
+            s = ((fake.zc.doneId == 7) && (fake.zc.rangesCount == 0) ? NATS_OK : NATS_ERR);
+        }
+        if (s == NATS_OK)
+        {
+            // Across the wrap around of sequence numbers.
+            fake.zc.doneId = 0xFFFFFFFE;
+            natsConn_zeroCopyComplete(&fake, 0, 1);
+            natsConn_zeroCopyComplete(&fake, 0xFFFFFFFE, 0xFFFFFFFF);
+            s = ((fake.zc.doneId == 2) && (fake.zc.rangesCount == 0) ? NATS_OK : NATS_ERR);
+        }
+        free(fake.zc.ranges);
+    }
+    testCond(s == NATS_OK);
 
     test("Set options: ");
-    s = _createDefaultThreadArgsForCbTests(&arg);
-    IFOK(s, natsOptions_Create(&opts));
-    IFOK(s, natsOptions_SetURL(opts, "nats://localhost:4443"));
-    IFOK(s, natsOptions_SkipServerVerification(opts, true));
-    IFOK(s, natsOptions_SetSecure(opts, true));
-    IFOK(s, natsOptions_SetMaxReconnect(opts, 100));
-    IFOK(s, natsOptions_SetReconnectWait(opts, 50));
-    IFOK(s, natsOptions_SetDisconnectedCB(opts, _disconnectedCb, (void*) &arg));
-    IFOK(s, natsOptions_SetReconnectedCB(opts, _reconnectedCb, (void*) &arg));
-    IFOK(s, natsOptions_SetClosedCB(opts, _closedCb, (void*) &arg));
-    IFOK(s, natsOptions_SetEventLoop(opts, (void*) &arg,
-                                     _evLoopAttach,
-                                     _evLoopRead,
-                                     _evLoopWrite,
-                                     _evLoopDetach));
+    s = natsOptions_Create(&opts);
+    IFOK(s, natsOptions_SetZeroCopyThreshold(opts, 64*1024));
     testCond(s == NATS_OK);
 
-    test("Start server: ");
-    pid = _startServer("nats://127.0.0.1:4443", "-config tls.conf -DV", true);
+    pid = _startServer("nats://127.0.0.1:4222", NULL, true);
     CHECK_SERVER_STARTED(pid);
+
+    test("Connect: ");
+    s = natsConnection_Connect(&nc, opts);
+    IFOK(s, natsConnection_SubscribeSync(&sub, nc, "foo"));
+    IFOK(s, natsConnection_Flush(nc));
     testCond(s == NATS_OK);
+    arg.nc = nc;
 
-    test("Start event loop: ");
+    test("Release callback required: ");
+    s = natsConnection_PublishZeroCopy(nc, "foo", large, largeSize, NULL, NULL);
+    testCond(s == NATS_INVALID_ARG);
+    nats_clearLastError();
+
+    test("Below threshold, released before returning: ");
+    s = natsConnection_PublishZeroCopy(nc, "foo", large, 100, _zeroCopyReleased, &arg);
     natsMutex_Lock(arg.m);
-    arg.sock = NATS_SOCK_INVALID;
+    sum = arg.sum;
     natsMutex_Unlock(arg.m);
-    s = natsThread_Create(&arg.t, _eventLoop, (void*) &arg);
-    testCond(s == NATS_OK);
+    testCond((s == NATS_OK) && (sum == 1));
 
-    test("Connect: ");
-    s = natsConnection_Connect(&nc, opts);
+    test("Publish large payloads: ");
+    for (i=0; (s == NATS_OK) && (i<count); i++)
+        s = natsConnection_PublishZeroCopy(nc, "foo", large, largeSize, _zeroCopyReleased, &arg);
+    IFOK(s, natsConnection_Flush(nc));
     testCond(s == NATS_OK);
 
-    test("Disconnect: ");
-    _stopServer(pid);
-    pid = NATS_INVALID_PID;
+    test("All released: ");
     natsMutex_Lock(arg.m);
-    while ((s != NATS_TIMEOUT) && !arg.disconnected)
+    while ((s != NATS_TIMEOUT) && (arg.sum != count + 1))
         s = natsCondition_TimedWait(arg.c, arg.m, 2000);
+    IFOK(s, arg.status);
     natsMutex_Unlock(arg.m);
     testCond(s == NATS_OK);
 
-    test("Restart server: ");
-    pid = _startServer("nats://127.0.0.1:4443", "-config tls.conf", true);
-    CHECK_SERVER_STARTED(pid);
+    test("Receive them: ");
+    s = natsSubscription_NextMsg(&msg, sub, 2000);
+    if ((s == NATS_OK)
+        && ((natsMsg_GetDataLength(msg) != 100)
+            || (memcmp(natsMsg_GetData(msg), large, 100) != 0)))
+    {
+        s = NATS_ERR;
+    }
+    natsMsg_Destroy(msg);
+    msg = NULL;
+    for (i=0; (s == NATS_OK) && (i<count); i++)
+    {
+        s = natsSubscription_NextMsg(&msg, sub, 2000);
+        if ((s == NATS_OK)
+            && ((natsMsg_GetDataLength(msg) != largeSize)
+                || (memcmp(natsMsg_GetData(msg), large, largeSize) != 0)))
+        {
+            s = NATS_ERR;
+        }
+        natsMsg_Destroy(msg);
+        msg = NULL;
+    }
     testCond(s == NATS_OK);
 
-    test("Check reconnected: ");
+    test("Released by close, once the kernel is done: ");
     natsMutex_Lock(arg.m);
-    while ((s != NATS_TIMEOUT) && !arg.reconnected)
-        s = natsCondition_TimedWait(arg.c, arg.m, 2000);
+    arg.sum = 0;
     natsMutex_Unlock(arg.m);
-    testCond(s == NATS_OK);
-
-    test("Shutdown evLoop: ");
+    for (i=0; (s == NATS_OK) && (i<count); i++)
+        s = natsConnection_PublishZeroCopy(nc, "foo", large, largeSize, _zeroCopyReleased, &arg);
+    natsConnection_Close(nc);
     natsMutex_Lock(arg.m);
-    arg.evStop = true;
-    natsCondition_Broadcast(arg.c);
+    sum = arg.sum;
+    IFOK(s, arg.status);
     natsMutex_Unlock(arg.m);
-    natsThread_Join(arg.t);
-    natsThread_Destroy(arg.t);
-    testCond(s == NATS_OK);
+    testCond((s == NATS_OK) && (sum == count));
 
-    test("Close and wait for close cb: ");
-    natsConnection_Close(nc);
-    s = _waitForConnClosed(&arg);
-    testCond(s == NATS_OK);
+    test("Closed connection, released before returning: ");
+    s = natsConnection_PublishZeroCopy(nc, "foo", large, largeSize, _zeroCopyReleased, &arg);
+    natsMutex_Lock(arg.m);
+    sum = arg.sum;
+    natsMutex_Unlock(arg.m);
+    testCond((s == NATS_CONNECTION_CLOSED) && (sum == count + 1));
+    nats_clearLastError();
 
+    natsSubscription_Destroy(sub);
     natsConnection_Destroy(nc);
     natsOptions_Destroy(opts);
+    free(large);
 
     _destroyDefaultThreadArgs(&arg);
 
     _stopServer(pid);
-#else
-    test("Skipped when built with no SSL support: ");
-    testCond(true);
-#endif
 }
 
 static void
@@ -19672,6 +22958,167 @@ test_SSLReconnectWithAuthError(void)
 #endif
 }
 
+static void
+test_SSLKernelTLS(void)
+{
+#if defined(NATS_HAS_KTLS)
+    natsStatus          s;
+    natsConnection      *nc       = NULL;
+    natsOptions         *opts     = NULL;
+    natsSubscription    *sub      = NULL;
+    natsMsg             *msg      = NULL;
+    natsPid             serverPid = NATS_INVALID_PID;
+    bool                send      = true;
+    bool                recv      = true;
+    struct threadArg    args;
+
+    s = _createDefaultThreadArgsForCbTests(&args);
+    if (s == NATS_OK)
+        opts = _createReconnectOptions();
+    if (opts == NULL)
+        FAIL("Unable to create reconnect options!");
+
+    serverPid = _startServer("nats://127.0.0.1:4443", "-config tls.conf", true);
+    CHECK_SERVER_STARTED(serverPid);
+
+    test("Connect without kernel TLS: ");
+    s = natsOptions_SetURL(opts, "nats://127.0.0.1:4443");
+    IFOK(s, natsOptions_SetSecure(opts, true));
+    IFOK(s, natsOptions_SkipServerVerification(opts, true));
+    IFOK(s, natsConnection_Connect(&nc, opts));
+    IFOK(s, natsConnection_GetKernelTLS(nc, &send, &recv));
+    testCond((s == NATS_OK) && !send && !recv);
+
+    natsConnection_Destroy(nc);
+    nc = NULL;
+
+    // Whether the offload engages depends on the kernel, so only check
+    // that the connection works either way.
+    test("Connect with kernel TLS: ");
+    s = natsOptions_UseKernelTLS(opts, true);
+    IFOK(s, natsOptions_SetReconnectedCB(opts, _reconnectedCb, &args));
+    IFOK(s, natsConnection_Connect(&nc, opts));
+    IFOK(s, natsConnection_GetKernelTLS(nc, &send, &recv));
+    testCond(s == NATS_OK);
+
+    test("Send and receive: ");
+    s = natsConnection_SubscribeSync(&sub, nc, "foo");
+    IFOK(s, natsConnection_PublishString(nc, "foo", "test"));
+    IFOK(s, natsSubscription_NextMsg(&msg, sub, 1000));
+    if ((s == NATS_OK) && (strcmp(natsMsg_GetData(msg), "test") != 0))
+        s = NATS_ERR;
+    natsMsg_Destroy(msg);
+    msg = NULL;
+    testCond(s == NATS_OK);
+
+    test("Check reconnects OK: ");
+    _stopServer(serverPid);
+
+    nats_Sleep(100);
+
+    serverPid = _startServer("nats://127.0.0.1:4443", "-config tls.conf", true);
+    CHECK_SERVER_STARTED(serverPid);
+
+    natsMutex_Lock(args.m);
+    while ((s != NATS_TIMEOUT) && !(args.reconnected))
+        s = natsCondition_TimedWait(args.c, args.m, 2000);
+    natsMutex_Unlock(args.m);
+
+    IFOK(s, natsConnection_PublishString(nc, "foo", "test"));
+    IFOK(s, natsSubscription_NextMsg(&msg, sub, 1000));
+    IFOK(s, natsConnection_GetKernelTLS(nc, &send, &recv));
+    testCond(s == NATS_OK)
+
+    natsMsg_Destroy(msg);
+    natsSubscription_Destroy(sub);
+    natsConnection_Destroy(nc);
+    natsOptions_Destroy(opts);
+
+    _destroyDefaultThreadArgs(&args);
+
+    _stopServer(serverPid);
+#else
+    test("Skipped when built with no kernel TLS support: ");
+    testCond(true);
+#endif
+}
+
+static void
+test_SSLSessionResumption(void)
+{
+#if defined(NATS_HAS_TLS)
+    natsStatus          s;
+    natsConnection      *nc       = NULL;
+    natsOptions         *opts     = NULL;
+    natsStatistics      *stats    = NULL;
+    natsPid             serverPid = NATS_INVALID_PID;
+    uint64_t            hits      = 0;
+    uint64_t            misses    = 0;
+    struct threadArg    args;
+
+    s = _createDefaultThreadArgsForCbTests(&args);
+    IFOK(s, natsStatistics_Create(&stats));
+    if (s == NATS_OK)
+        opts = _createReconnectOptions();
+    if (opts == NULL)
+        FAIL("Unable to create reconnect options!");
+
+    serverPid = _startServer("nats://127.0.0.1:4443", "-config tls.conf", true);
+    CHECK_SERVER_STARTED(serverPid);
+
+    test("First connect is a full handshake: ");
+    s = natsOptions_SetURL(opts, "nats://127.0.0.1:4443");
+    IFOK(s, natsOptions_SetSecure(opts, true));
+    IFOK(s, natsOptions_SkipServerVerification(opts, true));
+    IFOK(s, natsOptions_SetReconnectedCB(opts, _reconnectedCb, &args));
+    IFOK(s, natsConnection_Connect(&nc, opts));
+    // With TLS 1.3, the session ticket is sent after the handshake.
+    IFOK(s, natsConnection_Flush(nc));
+    IFOK(s, natsConnection_GetStats(nc, stats));
+    IFOK(s, natsStatistics_GetTLSSessionCounts(stats, &hits, &misses));
+    testCond((s == NATS_OK) && (hits == 0) && (misses == 1));
+
+    natsConnection_Destroy(nc);
+    nc = NULL;
+
+    test("Next connect resumes the session: ");
+    s = natsConnection_Connect(&nc, opts);
+    IFOK(s, natsConnection_Flush(nc));
+    IFOK(s, natsConnection_GetStats(nc, stats));
+    IFOK(s, natsStatistics_GetTLSSessionCounts(stats, &hits, &misses));
+    testCond((s == NATS_OK) && (hits == 1) && (misses == 0));
+
+    test("Server restarted, full handshake on reconnect: ");
+    _stopServer(serverPid);
+
+    nats_Sleep(100);
+
+    serverPid = _startServer("nats://127.0.0.1:4443", "-config tls.conf", true);
+    CHECK_SERVER_STARTED(serverPid);
+
+    natsMutex_Lock(args.m);
+    while ((s != NATS_TIMEOUT) && !(args.reconnected))
+        s = natsCondition_TimedWait(args.c, args.m, 2000);
+    natsMutex_Unlock(args.m);
+
+    IFOK(s, natsConnection_Flush(nc));
+    IFOK(s, natsConnection_GetStats(nc, stats));
+    IFOK(s, natsStatistics_GetTLSSessionCounts(stats, &hits, &misses));
+    testCond((s == NATS_OK) && (hits + misses == 2));
+
+    natsConnection_Destroy(nc);
+    natsOptions_Destroy(opts);
+    natsStatistics_Destroy(stats);
+
+    _destroyDefaultThreadArgs(&args);
+
+    _stopServer(serverPid);
+#else
+    test("Skipped when built with no SSL support: ");
+    testCond(true);
+#endif
+}
+
 #if defined(NATS_HAS_STREAMING)
 
 static int
@@ -21889,6 +25336,7 @@ static testInfo allTests[] =
     {"natsHash",                        test_natsHash},
     {"natsHashing",                     test_natsHashing},
     {"natsStrHash",                     test_natsStrHash},
+    {"natsSubTable",                    test_natsSubTable},
     {"natsInbox",                       test_natsInbox},
     {"natsOptions",                     test_natsOptions},
     {"natsSock_ConnectTcp",             test_natsSock_ConnectTcp},
@@ -21922,8 +25370,10 @@ static testInfo allTests[] =
     {"ParseINFO",                       test_ParseINFO},
     {"ParserShouldFail",                test_ParserShouldFail},
     {"ParserSplitMsg",                  test_ParserSplitMsg},
+    {"ParserFastPath",                  test_ParserFastPath},
     {"ProcessMsgArgs",                  test_ProcessMsgArgs},
     {"LibMsgDelivery",                  test_LibMsgDelivery},
+    {"LibMsgDeliveryWorkStealing",      test_LibMsgDeliveryWorkStealing},
     {"AsyncINFO",                       test_AsyncINFO},
     {"RequestPool",                     test_RequestPool},
     {"NoFlusherIfSendAsapOption",       test_NoFlusherIfSendAsap},
@@ -21934,6 +25384,7 @@ static testInfo allTests[] =
     {"DefaultConnection",               test_DefaultConnection},
     {"SimplifiedURLs",                  test_SimplifiedURLs},
     {"IPResolutionOrder",               test_IPResolutionOrder},
+    {"RacingConnect",                   test_RacingConnect},
     {"UseDefaultURLIfNoServerSpecified",test_UseDefaultURLIfNoServerSpecified},
     {"ConnectToWithMultipleURLs",       test_ConnectToWithMultipleURLs},
     {"ConnectionWithNULLOptions",       test_ConnectionWithNullOptions},
@@ -21975,9 +25426,19 @@ static testInfo allTests[] =
     {"SimplePublish",                   test_SimplePublish},
     {"SimplePublishNoData",             test_SimplePublishNoData},
     {"PublishMsg",                      test_PublishMsg},
+    {"PublishBatch",                    test_PublishBatch},
+    {"PublishLargeAfterBufferedData",   test_PublishLargeAfterBufferedData},
+    {"InboundZeroCopy",                 test_InboundZeroCopy},
+    {"MessagePool",                     test_MessagePool},
+    {"GCCounts",                        test_GCCounts},
+    {"LockFreeDelivery",                test_LockFreeDelivery},
+    {"BatchDelivery",                   test_BatchDelivery},
+    {"SubscribeBatch",                  test_SubscribeBatch},
+    {"SubscribePartitioned",            test_SubscribePartitioned},
     {"InvalidSubsArgs",                 test_InvalidSubsArgs},
     {"AsyncSubscribe",                  test_AsyncSubscribe},
     {"AsyncSubscribeTimeout",           test_AsyncSubscribeTimeout},
+    {"AsyncSubscribeTimeoutWithTraffic", test_AsyncSubscribeTimeoutWithTraffic},
     {"SyncSubscribe",                   test_SyncSubscribe},
     {"PubSubWithReply",                 test_PubSubWithReply},
     {"NoResponders",                    test_NoResponders},
@@ -21996,11 +25457,16 @@ static testInfo allTests[] =
     {"OldRequest",                      test_OldRequest},
     {"SimultaneousRequests",            test_SimultaneousRequest},
     {"RequestClose",                    test_RequestClose},
+    {"RequestAsync",                    test_RequestAsync},
+    {"RequestInlineResponses",          test_RequestInlineResponses},
+    {"RequestRouting",                  test_RequestRouting},
+    {"RequestMany",                     test_RequestMany},
     {"FlushInCb",                       test_FlushInCb},
     {"ReleaseFlush",                    test_ReleaseFlush},
     {"FlushErrOnDisconnect",            test_FlushErrOnDisconnect},
     {"Inbox",                           test_Inbox},
     {"Stats",                           test_Stats},
+    {"FlushPolicy",                     test_FlushPolicy},
     {"BadSubject",                      test_BadSubject},
     {"SubBadSubjectAndQueueNames",      test_SubBadSubjectAndQueueName},
     {"ClientAsyncAutoUnsub",            test_ClientAsyncAutoUnsub},
@@ -22049,6 +25515,9 @@ static testInfo allTests[] =
     {"EventLoop",                       test_EventLoop},
     {"EventLoopRetryOnFailedConnect",   test_EventLoopRetryOnFailedConnect},
     {"EventLoopTLS",                    test_EventLoopTLS},
+    {"IOEngine",                        test_IOEngine},
+    {"IOUring",                         test_IOUring},
+    {"PublishZeroCopy",                 test_PublishZeroCopy},
     {"SSLBasic",                        test_SSLBasic},
     {"SSLVerify",                       test_SSLVerify},
     {"SSLCAFromMemory",                 test_SSLLoadCAFromMemory},
@@ -22060,6 +25529,8 @@ static testInfo allTests[] =
     {"SSLConnectVerboseOption",         test_SSLConnectVerboseOption},
     {"SSLSocketLeakEventLoop",          test_SSLSocketLeakWithEventLoop},
     {"SSLReconnectWithAuthError",       test_SSLReconnectWithAuthError},
+    {"SSLKernelTLS",                    test_SSLKernelTLS},
+    {"SSLSessionResumption",            test_SSLSessionResumption},
 
     // Clusters Tests
 
@@ -22118,6 +25589,16 @@ static testInfo allTests[] =
 
 static int  maxTests = (int) (sizeof(allTests)/sizeof(testInfo));
 
+// Benchmarks are not part of the list of tests, they are run with:
+// testsuite bench [name]
+static testInfo allBenchs[] =
+{
+    {"Parser",                          bench_Parser},
+
+};
+
+static int  maxBenchs = (int) (sizeof(allBenchs)/sizeof(testInfo));
+
 static void
 generateList(void)
 {
@@ -22142,6 +25623,8 @@ generateList(void)
 int main(int argc, char **argv)
 {
     const char *envStr;
+    const char *benchName = NULL;
+    bool bench       = false;
     int testStart   = 0;
     int testEnd     = 0;
     int i;
@@ -22152,18 +25635,26 @@ int main(int argc, char **argv)
         return 0;
     }
 
-    if (argc == 3)
+    if ((argc >= 2) && (argc <= 3) && (strcmp(argv[1], "bench") == 0))
+    {
+        bench = true;
+        if (argc == 3)
+            benchName = argv[2];
+    }
+    else if (argc == 3)
     {
         testStart = atoi(argv[1]);
         testEnd   = atoi(argv[2]);
     }
 
-    if ((argc != 3)
-        || (testStart < 0) || (testStart >= maxTests)
-        || (testEnd < 0) || (testEnd >= maxTests)
-        || (testStart > testEnd))
+    if (!bench
+        && ((argc != 3)
+            || (testStart < 0) || (testStart >= maxTests)
+            || (testEnd < 0) || (testEnd >= maxTests)
+            || (testStart > testEnd)))
     {
         printf("@@ Usage: %s [start] [end] (0 .. %d)\n", argv[0], (maxTests - 1));
+        printf("@@        %s bench [name]\n", argv[0]);
         return 1;
     }
 
@@ -22224,8 +25715,21 @@ int main(int argc, char **argv)
         return 1;
     }
 
+    // Execute benchmarks
+    for (i=0; bench && (i<maxBenchs) && !failed; i++)
+    {
+        if ((benchName != NULL) && (strcmp(benchName, allBenchs[i].name) != 0))
+            continue;
+#ifdef _WIN32
+        printf("\n== Bench%s ==\n", allBenchs[i].name);
+#else
+        printf("\033[0;34m\n== Bench%s ==\n\033[0;0m", allBenchs[i].name);
+#endif
+        (*(allBenchs[i].func))();
+    }
+
     // Execute tests
-    for (i=testStart; (i<=testEnd) && !failed; i++)
+    for (i=testStart; !bench && (i<=testEnd) && !failed; i++)
     {
 #ifdef _WIN32
         printf("\n== %s ==\n", allTests[i].name);